@@ -0,0 +1,213 @@
+/**
+ * Work-Stealing Job Pool Implementation
+ *
+ * Each worker owns a range [next, end) of job indices behind its own mutex.
+ * The owner takes jobs from the front; a thief moves the back half of a
+ * victim's range into its own empty range while holding both locks (taken
+ * in worker order), so a job is always in exactly one range or running.
+ * Jobs are whole emulator runs, so the locks are taken a few times per job
+ * and never contended for long.
+ */
+
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/**
+ * Range of job indices owned by one worker
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t next; // First job not yet taken
+    size_t end;  // One past the last job
+} batch_range_t;
+
+/**
+ * Pool shared by the workers
+ */
+typedef struct
+{
+    batch_range_t *ranges;
+    int workers;
+    batch_job_fn fn;
+    void *context;
+} batch_pool_t;
+
+/**
+ * Argument of one worker thread
+ */
+typedef struct
+{
+    batch_pool_t *pool;
+    int index;
+} batch_worker_t;
+
+/**
+ * Take the next job of a worker's own range
+ * Returns 1 and sets *job, or 0 if the range is empty
+ */
+static int take_own(batch_range_t *range, size_t *job)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&range->lock);
+    if (range->next < range->end)
+    {
+        *job = range->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+/**
+ * Jobs left in a range (a hint: it may change as soon as the lock is dropped)
+ */
+static size_t range_size(batch_range_t *range)
+{
+    pthread_mutex_lock(&range->lock);
+    size_t size = range->end - range->next;
+    pthread_mutex_unlock(&range->lock);
+    return size;
+}
+
+/**
+ * Move the back half of the largest other range into worker self's range
+ * Returns 1 if jobs were stolen, 0 if every range is empty
+ */
+static int steal(batch_pool_t *pool, int self)
+{
+    for (;;)
+    {
+        int victim = -1;
+        size_t largest = 0;
+        for (int i = 0; i < pool->workers; i++)
+        {
+            if (i == self)
+                continue;
+            size_t size = range_size(&pool->ranges[i]);
+            if (size > largest)
+            {
+                largest = size;
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return 0;
+
+        // Both locks, lower worker index first
+        batch_range_t *first = &pool->ranges[victim < self ? victim : self];
+        batch_range_t *second = &pool->ranges[victim < self ? self : victim];
+        pthread_mutex_lock(&first->lock);
+        pthread_mutex_lock(&second->lock);
+
+        batch_range_t *from = &pool->ranges[victim];
+        batch_range_t *to = &pool->ranges[self];
+        size_t size = from->end - from->next;
+        int stolen = size > 0;
+        if (stolen)
+        {
+            // The victim keeps the front half (and the job it would take next)
+            size_t keep = size / 2;
+            to->next = from->next + keep;
+            to->end = from->end;
+            from->end = to->next;
+        }
+
+        pthread_mutex_unlock(&second->lock);
+        pthread_mutex_unlock(&first->lock);
+
+        if (stolen)
+            return 1;
+        // The victim emptied its range meanwhile: look again
+    }
+}
+
+/**
+ * Worker loop: own jobs first, then steal until nothing is left
+ */
+static void *batch_worker(void *arg)
+{
+    batch_worker_t *worker = (batch_worker_t *)arg;
+    batch_pool_t *pool = worker->pool;
+    batch_range_t *own = &pool->ranges[worker->index];
+    size_t job;
+
+    for (;;)
+    {
+        while (take_own(own, &job))
+            pool->fn(pool->context, job, worker->index);
+        if (!steal(pool, worker->index))
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * Get the default number of workers
+ */
+int batch_default_workers(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return cpus > BATCH_MAX_WORKERS ? BATCH_MAX_WORKERS : (int)cpus;
+}
+
+/**
+ * Run jobs on a pool of worker threads
+ */
+int batch_run(size_t job_count, int workers, batch_job_fn fn, void *context)
+{
+    if (job_count == 0)
+        return 0;
+    if (workers < 1)
+        workers = 1;
+    if (workers > BATCH_MAX_WORKERS)
+        workers = BATCH_MAX_WORKERS;
+    if ((size_t)workers > job_count)
+        workers = (int)job_count;
+
+    batch_range_t ranges[BATCH_MAX_WORKERS];
+    batch_worker_t args[BATCH_MAX_WORKERS];
+    pthread_t threads[BATCH_MAX_WORKERS];
+    int started[BATCH_MAX_WORKERS] = {0};
+    batch_pool_t pool = {ranges, workers, fn, context};
+
+    // Contiguous shares, the first job_count % workers one job longer
+    size_t share = job_count / (size_t)workers;
+    size_t extra = job_count % (size_t)workers;
+    size_t start = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        pthread_mutex_init(&ranges[i].lock, NULL);
+        ranges[i].next = start;
+        start += share + ((size_t)i < extra ? 1 : 0);
+        ranges[i].end = start;
+        args[i].pool = &pool;
+        args[i].index = i;
+    }
+
+    // Worker 0 is this thread; a worker that fails to start is stolen from
+    for (int i = 1; i < workers; i++)
+    {
+        if (pthread_create(&threads[i], NULL, batch_worker, &args[i]) == 0)
+            started[i] = 1;
+        else
+            fprintf(stderr, "Warning: Failed to start batch worker %d\n", i);
+    }
+    batch_worker(&args[0]);
+
+    for (int i = 1; i < workers; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < workers; i++)
+        pthread_mutex_destroy(&ranges[i].lock);
+
+    return workers;
+}
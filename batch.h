@@ -0,0 +1,47 @@
+/**
+ * Work-Stealing Job Pool for Spettrum (--batch)
+ *
+ * Runs N independent jobs on a fixed set of worker threads. Jobs are
+ * identified by index; each worker starts with a contiguous share of the
+ * indices and takes them in order from the front of its range. A worker
+ * that runs dry steals the back half of the largest remaining range, so
+ * uneven jobs (a tape that loads for minutes next to snapshots that halt at
+ * once) still keep every core busy without a shared queue to contend on.
+ *
+ * The calling thread is worker 0, so a pool of one worker creates no threads.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+// Upper bound on worker threads
+#define BATCH_MAX_WORKERS 256
+
+/**
+ * Job function
+ * @param context Pointer passed to batch_run()
+ * @param job Job index (0 to job_count - 1), run exactly once
+ * @param worker Index of the worker running it (0 to workers - 1)
+ */
+typedef void (*batch_job_fn)(void *context, size_t job, int worker);
+
+/**
+ * Get the default number of workers (online CPUs)
+ * @return Worker count, at least 1
+ */
+int batch_default_workers(void);
+
+/**
+ * Run jobs on a pool of worker threads and wait for all of them
+ * Workers that cannot be started leave their share to the others.
+ * @param job_count Number of jobs
+ * @param workers Number of workers (clamped to 1..BATCH_MAX_WORKERS and job_count)
+ * @param fn Job function (called concurrently from several threads)
+ * @param context Passed to fn
+ * @return Number of workers used
+ */
+int batch_run(size_t job_count, int workers, batch_job_fn fn, void *context);
+
+#endif
@@ -11,6 +11,12 @@
 #include <CoreAudio/CoreAudio.h>
 #endif
 
+#ifdef BEEPER_ALSA
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <pthread.h>
+#endif
+
 // Debug logging (define BEEPER_DEBUG to enable)
 #ifdef BEEPER_DEBUG
 static FILE *beeper_debug_log = NULL;
@@ -37,6 +43,12 @@ static FILE *beeper_debug_log = NULL;
 // Audio configuration
 #define BEEPER_CHANNELS 2 // Stereo output
 
+// Requested ALSA device latency; the period size is derived from it
+#define BEEPER_ALSA_LATENCY_US 40000
+
+// Samples buffered by the WAV recorder between writes
+#define BEEPER_WAV_BUFFER_FRAMES 4096
+
 // Beeper event: records state change with CPU cycle timestamp
 typedef struct
 {
@@ -58,6 +70,13 @@ struct beeper_state_s
 {
 #ifdef __APPLE__
     AudioComponentInstance audio_unit;
+#endif
+#ifdef BEEPER_ALSA
+    snd_pcm_t *pcm;
+    pthread_t thread;
+    atomic_bool thread_run;          // Output thread keeps going while set
+    snd_pcm_uframes_t period_frames; // Frames rendered per write
+    float *period_buffer;            // Interleaved stereo period
 #endif
     beeper_ring_buffer_t ring_buffer;
     beeper_stats_t stats;
@@ -72,6 +91,8 @@ struct beeper_state_s
     uint64_t rendered_cpu_cycle; // Last CPU cycle processed by audio thread
     uint8_t rendered_mic_bit;    // Last MIC state rendered
     uint8_t rendered_beeper_bit; // Last beeper state rendered
+    double rendered_cycle_frac;  // Sub-cycle remainder of the audio clock
+    float blep_carry;            // Step residual owed to the next window's first sample
 
     // Emulator thread state (updated in beeper_update)
     uint8_t queued_mic_bit;    // Last MIC state queued
@@ -106,153 +127,143 @@ static inline bool ring_buffer_push(beeper_ring_buffer_t *rb, beeper_event_t *ev
     return true;
 }
 
-static inline bool ring_buffer_pop(beeper_ring_buffer_t *rb, beeper_event_t *event)
-{
-    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
-    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
-
-    // Check if buffer is empty
-    if (tail == head)
-    {
-        return false; // Buffer empty
-    }
-
-    *event = rb->events[tail];
-    uint32_t next_tail = (tail + 1) & BEEPER_RING_BUFFER_MASK;
-    atomic_store_explicit(&rb->tail, next_tail, memory_order_release);
-    return true;
-}
-
-static inline bool ring_buffer_peek(beeper_ring_buffer_t *rb, beeper_event_t *event)
-{
-    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
-    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
-    if (tail == head)
-        return false;
-    *event = rb->events[tail];
-    return true;
-}
-
 static inline void ring_buffer_clear(beeper_ring_buffer_t *rb)
 {
     atomic_store_explicit(&rb->tail, 0, memory_order_relaxed);
     atomic_store_explicit(&rb->head, 0, memory_order_release);
 }
 
-#ifdef __APPLE__
-// CoreAudio render callback - called by audio thread to fill audio buffer
+// Band-limited step: an edge of height step lands x samples before sample k.
+// Two-sample polyBLEP residual - half of it goes on sample k-1 (*before, NULL
+// if k is 0) and the other half on sample k (accumulated into *pending).
+static inline void blep_add_step(float *before, float *pending, float x, float step)
+{
+    if (before)
+        *before += step * x * x * 0.5f;
+    *pending -= step * (1.0f - x) * (1.0f - x) * 0.5f;
+}
+
+#if defined(__APPLE__) || defined(BEEPER_ALSA)
+// Render frames of interleaved stereo audio, consuming due events
 //
 // The audio clock (rendered_cpu_cycle) advances at a steady rate matching
-// real-time: window_len CPU cycles per callback. Events are consumed as
+// real-time: one window of CPU cycles per call. Events are consumed as
 // the clock reaches them. If the CPU runs ahead in bursts, events queue
-// up and drain naturally over subsequent callbacks at the correct pace.
-static OSStatus audio_render_callback(
-    void *inRefCon,
-    AudioUnitRenderActionFlags *ioActionFlags,
-    const AudioTimeStamp *inTimeStamp,
-    UInt32 inBusNumber,
-    UInt32 inNumberFrames,
-    AudioBufferList *ioData)
+// up and drain naturally over subsequent calls at the correct pace.
+//
+// Each beeper edge is placed at its exact sub-sample position and smoothed
+// with a two-sample polyBLEP residual, so edges that fall between samples
+// do not alias the way point-sampling the square wave does. Events are read
+// straight out of the ring and the tail is published once per call.
+static void beeper_render(beeper_state_t *beeper, float *out, uint32_t frames)
 {
-    (void)ioActionFlags;
-    (void)inTimeStamp;
-    (void)inBusNumber;
-
-    beeper_state_t *beeper = (beeper_state_t *)inRefCon;
-
-    // Safety / disabled check — output silence
-    if (!beeper || !beeper->enabled || !beeper->running)
-    {
-        for (UInt32 i = 0; i < ioData->mNumberBuffers; i++)
-            memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);
-        return noErr;
-    }
-
-    if (ioData->mNumberBuffers < 1)
-        return noErr;
-    float *out = (float *)ioData->mBuffers[0].mData;
-    if (!out)
-        return noErr;
-
+    beeper_ring_buffer_t *rb = &beeper->ring_buffer;
     double cps = (double)beeper->cpu_clock_hz / (double)beeper->sample_rate;
-    uint64_t window_len = (uint64_t)(inNumberFrames * cps);
+    double window_exact = frames * cps + beeper->rendered_cycle_frac;
+    uint64_t window_len = (uint64_t)window_exact;
     uint64_t window_start = beeper->rendered_cpu_cycle;
 
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
     // Seed the audio clock from the first available event
     if (window_start == 0)
     {
-        beeper_event_t peek;
-        if (ring_buffer_peek(&beeper->ring_buffer, &peek))
-        {
-            window_start = peek.cpu_cycle;
-        }
-        else
+        if (tail == head)
         {
             // No events yet — silence, don't advance clock
-            for (UInt32 f = 0; f < inNumberFrames; f++)
-            {
-                out[f * 2] = 0.0f;
-                out[f * 2 + 1] = 0.0f;
-            }
-            return noErr;
+            memset(out, 0, frames * BEEPER_CHANNELS * sizeof(float));
+            return;
         }
+        window_start = rb->events[tail].cpu_cycle;
     }
 
     uint64_t window_end = window_start + window_len;
+    uint8_t current_beeper = beeper->rendered_beeper_bit;
+    uint64_t consumed = 0;
 
     // If we've fallen far behind the CPU (>1 frame), skip forward.
     // This handles long pauses or large bursts.
-    beeper_event_t peek;
-    if (ring_buffer_peek(&beeper->ring_buffer, &peek))
+    if (tail != head)
     {
         uint64_t one_frame = beeper->cpu_clock_hz / 50; // ~70000 cycles
-        if (peek.cpu_cycle > window_end + one_frame)
+        uint64_t first = rb->events[tail].cpu_cycle;
+        if (first > window_end + one_frame)
         {
             // Drain stale events, keeping last state
-            beeper_event_t ev;
-            uint64_t target = peek.cpu_cycle - window_len;
-            while (ring_buffer_peek(&beeper->ring_buffer, &ev) &&
-                   ev.cpu_cycle < target)
+            uint64_t target = first - window_len;
+            while (tail != head && rb->events[tail].cpu_cycle < target)
             {
-                ring_buffer_pop(&beeper->ring_buffer, &ev);
-                beeper->rendered_beeper_bit = ev.beeper_bit;
-                beeper->stats.events_rendered++;
+                current_beeper = rb->events[tail].beeper_bit;
+                tail = (tail + 1) & BEEPER_RING_BUFFER_MASK;
+                consumed++;
             }
             window_start = target;
             window_end = window_start + window_len;
+            beeper->blep_carry = 0.0f;
         }
     }
 
-    // Render sample-by-sample, consuming events from the ring buffer
-    // as the audio clock reaches each event's timestamp.
-    uint8_t current_beeper = beeper->rendered_beeper_bit;
+    // Walk the events inside this window, filling the samples before each edge
+    float volume = beeper->volume;
+    float level = current_beeper ? volume : -volume;
+    float pending = beeper->blep_carry; // residual owed to the next sample written
+    uint32_t frame = 0;
 
-    for (UInt32 frame = 0; frame < inNumberFrames; frame++)
+    while (tail != head)
     {
-        uint64_t frame_cycle = window_start + (uint64_t)(frame * cps);
-
-        beeper_event_t ev;
-        while (ring_buffer_peek(&beeper->ring_buffer, &ev) &&
-               ev.cpu_cycle <= frame_cycle)
+        beeper_event_t *ev = &rb->events[tail];
+        double pos = (double)(int64_t)(ev->cpu_cycle - window_start) / cps;
+        if (pos >= frames)
+            break;
+        if (pos < 0.0)
+            pos = 0.0;
+
+        // First sample at or after the edge, and how far past the edge it is
+        uint32_t k = (uint32_t)pos;
+        if (k < pos)
+            k++;
+        float x = (float)(k - pos);
+
+        // Left channel only; copied to the right once the window is done
+        for (; frame < k; frame++)
         {
-            ring_buffer_pop(&beeper->ring_buffer, &ev);
-            current_beeper = ev.beeper_bit;
-            beeper->stats.events_rendered++;
+            out[frame * 2] = level + pending;
+            pending = 0.0f;
         }
 
-        float amp = current_beeper ? beeper->volume : -beeper->volume;
-        out[frame * 2] = amp;
-        out[frame * 2 + 1] = amp;
+        float new_level = ev->beeper_bit ? volume : -volume;
+        if (new_level != level)
+            blep_add_step(k > 0 ? &out[(k - 1) * 2] : NULL, &pending, x, new_level - level);
+        level = new_level;
+        current_beeper = ev->beeper_bit;
+
+        tail = (tail + 1) & BEEPER_RING_BUFFER_MASK;
+        consumed++;
+    }
+
+    for (; frame < frames; frame++)
+    {
+        out[frame * 2] = level + pending;
+        pending = 0.0f;
     }
+    for (frame = 0; frame < frames; frame++)
+        out[frame * 2 + 1] = out[frame * 2];
+
+    // Publish the whole batch at once
+    atomic_store_explicit(&rb->tail, tail, memory_order_release);
+    beeper->stats.events_rendered += consumed;
 
     // Advance the steady audio clock
+    beeper->blep_carry = pending;
+    beeper->rendered_cycle_frac = window_exact - (double)window_len;
     beeper->rendered_cpu_cycle = window_end;
     beeper->rendered_beeper_bit = current_beeper;
 
     // If the ring buffer is now empty, the tone has ended.
     // Snap the audio clock forward to the CPU's current position
     // so we don't keep replaying the last beeper state while catching up.
-    if (!ring_buffer_peek(&beeper->ring_buffer, &peek))
+    if (tail == atomic_load_explicit(&rb->head, memory_order_acquire))
     {
         uint64_t cpu_now = atomic_load_explicit(&beeper->latest_cpu_cycle,
                                                 memory_order_relaxed);
@@ -261,11 +272,86 @@ static OSStatus audio_render_callback(
             beeper->rendered_cpu_cycle = cpu_now;
         }
     }
+}
+
+#endif
+
+#ifdef __APPLE__
+// CoreAudio render callback - called by audio thread to fill audio buffer
+static OSStatus audio_render_callback(
+    void *inRefCon,
+    AudioUnitRenderActionFlags *ioActionFlags,
+    const AudioTimeStamp *inTimeStamp,
+    UInt32 inBusNumber,
+    UInt32 inNumberFrames,
+    AudioBufferList *ioData)
+{
+    (void)ioActionFlags;
+    (void)inTimeStamp;
+    (void)inBusNumber;
+
+    beeper_state_t *beeper = (beeper_state_t *)inRefCon;
+
+    // Safety / disabled check — output silence
+    if (!beeper || !beeper->enabled || !beeper->running)
+    {
+        for (UInt32 i = 0; i < ioData->mNumberBuffers; i++)
+            memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);
+        return noErr;
+    }
 
+    if (ioData->mNumberBuffers < 1)
+        return noErr;
+    float *out = (float *)ioData->mBuffers[0].mData;
+    if (!out)
+        return noErr;
+
+    beeper_render(beeper, out, inNumberFrames);
     return noErr;
 }
 #endif
 
+#ifdef BEEPER_ALSA
+// ALSA output thread - renders one period at a time and blocks in writei.
+// On desktops the "default" PCM is routed through PulseAudio or PipeWire.
+static void *alsa_output_thread(void *arg)
+{
+    beeper_state_t *beeper = (beeper_state_t *)arg;
+    uint32_t frames = (uint32_t)beeper->period_frames;
+
+    while (atomic_load_explicit(&beeper->thread_run, memory_order_acquire))
+    {
+        if (beeper->enabled)
+            beeper_render(beeper, beeper->period_buffer, frames);
+        else
+            memset(beeper->period_buffer, 0, frames * BEEPER_CHANNELS * sizeof(float));
+
+        float *data = beeper->period_buffer;
+        uint32_t remaining = frames;
+        while (remaining > 0)
+        {
+            snd_pcm_sframes_t written = snd_pcm_writei(beeper->pcm, data, remaining);
+            if (written < 0)
+            {
+                // Device ran dry before we delivered the next period
+                if (written == -EPIPE)
+                    beeper->stats.buffer_underruns++;
+                written = snd_pcm_recover(beeper->pcm, (int)written, 1);
+                if (written < 0)
+                {
+                    fprintf(stderr, "beeper: ALSA write failed: %s\n", snd_strerror((int)written));
+                    return NULL;
+                }
+                continue;
+            }
+            data += written * BEEPER_CHANNELS;
+            remaining -= (uint32_t)written;
+        }
+    }
+    return NULL;
+}
+#endif
+
 beeper_state_t *beeper_init(uint32_t cpu_clock_hz, uint32_t sample_rate, bool enabled)
 {
     BEEPER_LOG("Beeper: Initializing (cpu_clock=%u, sample_rate=%u, enabled=%d)\n",
@@ -441,6 +527,45 @@ beeper_state_t *beeper_init(uint32_t cpu_clock_hz, uint32_t sample_rate, bool en
             (unsigned)outputDevice, sample_rate, BEEPER_CHANNELS);
 #endif
 
+#ifdef BEEPER_ALSA
+    int err = snd_pcm_open(&beeper->pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        fprintf(stderr, "beeper: failed to open ALSA device: %s\n", snd_strerror(err));
+        free(beeper);
+        return NULL;
+    }
+
+    err = snd_pcm_set_params(beeper->pcm, SND_PCM_FORMAT_FLOAT, SND_PCM_ACCESS_RW_INTERLEAVED,
+                             BEEPER_CHANNELS, sample_rate, 1, BEEPER_ALSA_LATENCY_US);
+    if (err < 0)
+    {
+        fprintf(stderr, "beeper: failed to configure ALSA device: %s\n", snd_strerror(err));
+        snd_pcm_close(beeper->pcm);
+        free(beeper);
+        return NULL;
+    }
+
+    snd_pcm_uframes_t buffer_frames = 0;
+    err = snd_pcm_get_params(beeper->pcm, &buffer_frames, &beeper->period_frames);
+    if (err < 0 || beeper->period_frames == 0)
+        beeper->period_frames = sample_rate / 100;
+
+    beeper->period_buffer = calloc(beeper->period_frames * BEEPER_CHANNELS, sizeof(float));
+    if (!beeper->period_buffer)
+    {
+        fprintf(stderr, "beeper: failed to allocate period buffer\n");
+        snd_pcm_close(beeper->pcm);
+        free(beeper);
+        return NULL;
+    }
+    atomic_init(&beeper->thread_run, false);
+
+    fprintf(stderr, "beeper: ALSA output initialized (%u Hz, %d ch, period=%lu, buffer=%lu)\n",
+            sample_rate, BEEPER_CHANNELS, (unsigned long)beeper->period_frames,
+            (unsigned long)buffer_frames);
+#endif
+
     BEEPER_LOG("Beeper: Initialization complete\n");
     return beeper;
 }
@@ -460,6 +585,11 @@ void beeper_destroy(beeper_state_t *beeper)
         AudioComponentInstanceDispose(beeper->audio_unit);
     }
 #endif
+#ifdef BEEPER_ALSA
+    if (beeper->pcm)
+        snd_pcm_close(beeper->pcm);
+    free(beeper->period_buffer);
+#endif
 
     free(beeper);
     BEEPER_LOG("Beeper: Destroyed\n");
@@ -491,6 +621,16 @@ bool beeper_start(beeper_state_t *beeper)
         return false;
     }
 #endif
+#ifdef BEEPER_ALSA
+    atomic_store_explicit(&beeper->thread_run, true, memory_order_release);
+    if (pthread_create(&beeper->thread, NULL, alsa_output_thread, beeper) != 0)
+    {
+        atomic_store_explicit(&beeper->thread_run, false, memory_order_release);
+        beeper->running = false;
+        fprintf(stderr, "Failed to start audio output thread\n");
+        return false;
+    }
+#endif
 
     return true;
 }
@@ -505,6 +645,12 @@ void beeper_stop(beeper_state_t *beeper)
 #ifdef __APPLE__
     AudioOutputUnitStop(beeper->audio_unit);
 #endif
+#ifdef BEEPER_ALSA
+    atomic_store_explicit(&beeper->thread_run, false, memory_order_release);
+    pthread_join(beeper->thread, NULL);
+    snd_pcm_drop(beeper->pcm);
+    snd_pcm_prepare(beeper->pcm);
+#endif
 
     beeper->running = false;
 }
@@ -588,8 +734,206 @@ void beeper_reset(beeper_state_t *beeper)
     ring_buffer_clear(&beeper->ring_buffer);
     memset(&beeper->stats, 0, sizeof(beeper->stats));
     beeper->rendered_cpu_cycle = 0;
+    beeper->rendered_cycle_frac = 0.0;
+    beeper->blep_carry = 0.0f;
     beeper->rendered_mic_bit = 0;
     beeper->rendered_beeper_bit = 0;
     beeper->queued_mic_bit = 0;
     beeper->queued_beeper_bit = 0;
 }
+
+// Offline WAV recorder - renders beeper edges on emulated time.
+// Sample n sits at CPU cycle n * cycles_per_sample, so the output depends only
+// on the event stream and not on how fast the emulator ran.
+struct beeper_recorder_s
+{
+    FILE *file;
+    uint32_t sample_rate;
+    double cycles_per_sample;
+    float volume;
+
+    uint8_t beeper_bit;    // Current EAR state
+    float level;           // Current output level
+    float pending;         // Step residual owed to the next sample produced
+    uint64_t next_sample;  // Index of the next sample to produce
+    uint64_t samples_done; // Samples already written to the file
+    bool write_error;
+
+    // Produced samples not yet written; the last one stays here so a
+    // following edge can still add its residual to it
+    float buffer[BEEPER_WAV_BUFFER_FRAMES];
+    uint32_t buffered;
+};
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+// Write the 44-byte RIFF header for 16-bit mono PCM
+static bool recorder_write_header(beeper_recorder_t *rec, uint32_t data_bytes)
+{
+    uint8_t header[44];
+
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le32(header + 16, 16);                   // fmt chunk size
+    put_le16(header + 20, 1);                    // PCM
+    put_le16(header + 22, 1);                    // Mono
+    put_le32(header + 24, rec->sample_rate);     // Sample rate
+    put_le32(header + 28, rec->sample_rate * 2); // Byte rate
+    put_le16(header + 32, 2);                    // Block align
+    put_le16(header + 34, 16);                   // Bits per sample
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, data_bytes);
+
+    return fwrite(header, sizeof(header), 1, rec->file) == 1;
+}
+
+// Write the first count buffered samples and shift the rest down
+static void recorder_flush(beeper_recorder_t *rec, uint32_t count)
+{
+    uint8_t bytes[BEEPER_WAV_BUFFER_FRAMES * 2];
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float s = rec->buffer[i];
+        if (s > 1.0f)
+            s = 1.0f;
+        else if (s < -1.0f)
+            s = -1.0f;
+        int16_t v = (int16_t)(s * 32767.0f + (s < 0.0f ? -0.5f : 0.5f));
+        put_le16(bytes + i * 2, (uint16_t)v);
+    }
+    if (count > 0 && fwrite(bytes, 2, count, rec->file) != count)
+        rec->write_error = true;
+
+    memmove(rec->buffer, rec->buffer + count, (rec->buffered - count) * sizeof(float));
+    rec->buffered -= count;
+    rec->samples_done += count;
+}
+
+// Produce samples up to (not including) index end at the current level
+static void recorder_fill(beeper_recorder_t *rec, uint64_t end)
+{
+    while (rec->next_sample < end)
+    {
+        if (rec->buffered == BEEPER_WAV_BUFFER_FRAMES)
+            recorder_flush(rec, BEEPER_WAV_BUFFER_FRAMES - 1);
+        rec->buffer[rec->buffered++] = rec->level + rec->pending;
+        rec->pending = 0.0f;
+        rec->next_sample++;
+    }
+}
+
+// Index of the first sample at or after cpu_cycle
+static uint64_t recorder_sample_at(beeper_recorder_t *rec, uint64_t cpu_cycle, float *x)
+{
+    double pos = (double)cpu_cycle / rec->cycles_per_sample;
+    uint64_t k = (uint64_t)pos;
+    if (k < pos)
+        k++;
+    if (x)
+        *x = (float)(k - pos);
+    return k;
+}
+
+beeper_recorder_t *beeper_recorder_open(const char *path, uint32_t cpu_clock_hz, uint32_t sample_rate, uint8_t volume)
+{
+    if (!path || cpu_clock_hz == 0 || sample_rate == 0)
+        return NULL;
+
+    beeper_recorder_t *rec = calloc(1, sizeof(beeper_recorder_t));
+    if (!rec)
+    {
+        fprintf(stderr, "Error: Failed to allocate audio recorder\n");
+        return NULL;
+    }
+
+    rec->file = fopen(path, "wb");
+    if (!rec->file)
+    {
+        fprintf(stderr, "Error: Cannot open audio output file '%s'\n", path);
+        free(rec);
+        return NULL;
+    }
+
+    if (volume > 100)
+        volume = 100;
+    rec->sample_rate = sample_rate;
+    rec->cycles_per_sample = (double)cpu_clock_hz / (double)sample_rate;
+    rec->volume = volume / 100.0f;
+    rec->level = -rec->volume;
+
+    // Sizes are patched in by beeper_recorder_close()
+    if (!recorder_write_header(rec, 0))
+    {
+        fprintf(stderr, "Error: Failed to write WAV header to '%s'\n", path);
+        fclose(rec->file);
+        free(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+void beeper_recorder_update(beeper_recorder_t *rec, uint64_t cpu_cycle, uint8_t mic_bit, uint8_t beeper_bit)
+{
+    (void)mic_bit;
+
+    if (!rec || beeper_bit == rec->beeper_bit)
+        return;
+
+    float x;
+    uint64_t k = recorder_sample_at(rec, cpu_cycle, &x);
+    recorder_fill(rec, k);
+
+    float new_level = beeper_bit ? rec->volume : -rec->volume;
+    float *before = (k > 0 && rec->buffered > 0) ? &rec->buffer[rec->buffered - 1] : NULL;
+    blep_add_step(before, &rec->pending, x, new_level - rec->level);
+    rec->level = new_level;
+    rec->beeper_bit = beeper_bit;
+}
+
+void beeper_recorder_advance(beeper_recorder_t *rec, uint64_t cpu_cycle)
+{
+    if (!rec)
+        return;
+    recorder_fill(rec, recorder_sample_at(rec, cpu_cycle, NULL));
+}
+
+int beeper_recorder_close(beeper_recorder_t *rec)
+{
+    if (!rec)
+        return 0;
+
+    recorder_flush(rec, rec->buffered);
+
+    // Patch the RIFF and data chunk sizes now the length is known
+    uint64_t data_bytes = rec->samples_done * 2;
+    if (data_bytes > UINT32_MAX - 36)
+    {
+        fprintf(stderr, "Error: Audio output exceeds the 4GB WAV limit\n");
+        rec->write_error = true;
+    }
+    else if (fseek(rec->file, 0, SEEK_SET) != 0 || !recorder_write_header(rec, (uint32_t)data_bytes))
+    {
+        rec->write_error = true;
+    }
+
+    if (fclose(rec->file) != 0)
+        rec->write_error = true;
+
+    int result = rec->write_error ? -1 : 0;
+    if (result < 0)
+        fprintf(stderr, "Error: Failed to write audio output file\n");
+    free(rec);
+    return result;
+}
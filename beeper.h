@@ -91,4 +91,52 @@ void beeper_get_stats(beeper_state_t *beeper, beeper_stats_t *stats);
  */
 void beeper_reset(beeper_state_t *beeper);
 
+/**
+ * Offline beeper recorder
+ *
+ * Renders the same beeper event stream to a 16-bit mono WAV file on emulated
+ * time instead of wall time, so the output is deterministic and independent
+ * of emulation speed. No audio device is used.
+ */
+typedef struct beeper_recorder_s beeper_recorder_t;
+
+/**
+ * Create a WAV file and start recording
+ *
+ * @param path Output file path
+ * @param cpu_clock_hz Z80 CPU clock rate in Hz (cycle 0 is sample 0)
+ * @param sample_rate Output sample rate in Hz
+ * @param volume Volume level (0-100)
+ * @return Pointer to recorder, or NULL on failure
+ */
+beeper_recorder_t *beeper_recorder_open(const char *path, uint32_t cpu_clock_hz, uint32_t sample_rate, uint8_t volume);
+
+/**
+ * Record a port 0xFE write
+ * Cycles must not go backwards between calls.
+ *
+ * @param rec Recorder
+ * @param cpu_cycle CPU cycle of the write
+ * @param mic_bit State of MIC bit (bit 3 of port 0xFE)
+ * @param beeper_bit State of beeper bit (bit 4 of port 0xFE)
+ */
+void beeper_recorder_update(beeper_recorder_t *rec, uint64_t cpu_cycle, uint8_t mic_bit, uint8_t beeper_bit);
+
+/**
+ * Render samples up to cpu_cycle at the current level
+ * Call periodically (e.g. once per frame) so silence is recorded too.
+ *
+ * @param rec Recorder
+ * @param cpu_cycle Current CPU cycle count
+ */
+void beeper_recorder_advance(beeper_recorder_t *rec, uint64_t cpu_cycle);
+
+/**
+ * Flush remaining samples, finalise the WAV header and free the recorder
+ *
+ * @param rec Recorder
+ * @return 0 on success, -1 if any write failed
+ */
+int beeper_recorder_close(beeper_recorder_t *rec);
+
 #endif // BEEPER_H
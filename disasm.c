@@ -1,1196 +1,669 @@
+/**
+ * Z80 Disassembler Implementation
+ *
+ * The three opcode tables are filled once from the regular structure of the
+ * Z80 instruction set (opcode = xx yyy zzz, y = pp q). Each entry holds the
+ * mnemonic and operand templates; decoding copies the templates and reads
+ * immediates, addresses and displacements from the instruction bytes.
+ */
+
 #include "disasm.h"
 #include "z80.h"
-#include "main.h"
-#include <unistd.h>
-#include <stdio.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
- * Decode CB prefix instruction
+ * Opcode table entry
  */
-static const char *decode_cb_instruction(uint8_t opcode)
+typedef struct
 {
-    static char buf[32];
+    uint8_t mnemonic;
+    uint8_t operand_count;
+    disasm_operand_t operands[DISASM_MAX_OPERANDS]; // Values of immediates are filled at decode
+} disasm_entry_t;
 
-    uint8_t operation = (opcode >> 6) & 0x03;
-    uint8_t bit_num = (opcode >> 3) & 0x07;
-    uint8_t reg_idx = opcode & 0x07;
+/**
+ * Decode cache: one entry per address
+ */
+struct disasm_cache_s
+{
+    disasm_insn_t entries[65536];
+};
 
-    const char *regs[] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
-    const char *ops[] = {"RLC", "RRC", "RL", "RR", "SLA", "SRA", "SLL", "SRL"};
+static const char *const mnemonic_names[DISASM_MNEMONIC_COUNT] = {
+    [DISASM_DB] = "DB", [DISASM_NOP] = "NOP", [DISASM_LD] = "LD", [DISASM_INC] = "INC",
+    [DISASM_DEC] = "DEC", [DISASM_RLCA] = "RLCA", [DISASM_RRCA] = "RRCA", [DISASM_RLA] = "RLA",
+    [DISASM_RRA] = "RRA", [DISASM_DAA] = "DAA", [DISASM_CPL] = "CPL", [DISASM_SCF] = "SCF",
+    [DISASM_CCF] = "CCF", [DISASM_EX] = "EX", [DISASM_EXX] = "EXX", [DISASM_DJNZ] = "DJNZ",
+    [DISASM_JR] = "JR", [DISASM_JP] = "JP", [DISASM_CALL] = "CALL", [DISASM_RET] = "RET",
+    [DISASM_RETI] = "RETI", [DISASM_RETN] = "RETN", [DISASM_RST] = "RST", [DISASM_PUSH] = "PUSH",
+    [DISASM_POP] = "POP", [DISASM_ADD] = "ADD", [DISASM_ADC] = "ADC", [DISASM_SUB] = "SUB",
+    [DISASM_SBC] = "SBC", [DISASM_AND] = "AND", [DISASM_XOR] = "XOR", [DISASM_OR] = "OR",
+    [DISASM_CP] = "CP", [DISASM_HALT] = "HALT", [DISASM_DI] = "DI", [DISASM_EI] = "EI",
+    [DISASM_IN] = "IN", [DISASM_OUT] = "OUT", [DISASM_RLC] = "RLC", [DISASM_RRC] = "RRC",
+    [DISASM_RL] = "RL", [DISASM_RR] = "RR", [DISASM_SLA] = "SLA", [DISASM_SRA] = "SRA",
+    [DISASM_SLL] = "SLL", [DISASM_SRL] = "SRL", [DISASM_BIT] = "BIT", [DISASM_RES] = "RES",
+    [DISASM_SET] = "SET", [DISASM_NEG] = "NEG", [DISASM_IM] = "IM", [DISASM_RRD] = "RRD",
+    [DISASM_RLD] = "RLD", [DISASM_LDI] = "LDI", [DISASM_CPI] = "CPI", [DISASM_INI] = "INI",
+    [DISASM_OUTI] = "OUTI", [DISASM_LDD] = "LDD", [DISASM_CPD] = "CPD", [DISASM_IND] = "IND",
+    [DISASM_OUTD] = "OUTD", [DISASM_LDIR] = "LDIR", [DISASM_CPIR] = "CPIR", [DISASM_INIR] = "INIR",
+    [DISASM_OTIR] = "OTIR", [DISASM_LDDR] = "LDDR", [DISASM_CPDR] = "CPDR", [DISASM_INDR] = "INDR",
+    [DISASM_OTDR] = "OTDR"};
 
-    if (operation == 0)
-    {
-        // Shift/rotate operations: 00xxxyyy
-        snprintf(buf, sizeof(buf), "%s %s", ops[bit_num], regs[reg_idx]);
-    }
-    else if (operation == 1)
-    {
-        // BIT operations: 01bbbyyy
-        snprintf(buf, sizeof(buf), "BIT %d, %s", bit_num, regs[reg_idx]);
-    }
-    else if (operation == 2)
-    {
-        // RES operations: 10bbbyyy
-        snprintf(buf, sizeof(buf), "RES %d, %s", bit_num, regs[reg_idx]);
-    }
-    else
-    {
-        // SET operations: 11bbbyyy
-        snprintf(buf, sizeof(buf), "SET %d, %s", bit_num, regs[reg_idx]);
-    }
+static const char *const reg8_names[] = {"B", "C", "D", "E", "H", "L", "A", "I", "R",
+                                         "IXH", "IXL", "IYH", "IYL"};
+static const char *const reg16_names[] = {"BC", "DE", "HL", "SP", "AF", "AF'", "IX", "IY"};
+static const char *const cond_names[] = {"NZ", "Z", "NC", "C", "PO", "PE", "P", "M"};
 
-    return buf;
+// Opcode field tables: r[z], rp[p], rp2[p], alu[y], rot[y]
+static const uint8_t table_r[8] = {DISASM_REG_B, DISASM_REG_C, DISASM_REG_D, DISASM_REG_E,
+                                   DISASM_REG_H, DISASM_REG_L, 0, DISASM_REG_A};
+static const uint8_t table_rp[4] = {DISASM_REG_BC, DISASM_REG_DE, DISASM_REG_HL, DISASM_REG_SP};
+static const uint8_t table_rp2[4] = {DISASM_REG_BC, DISASM_REG_DE, DISASM_REG_HL, DISASM_REG_AF};
+static const uint8_t table_alu[8] = {DISASM_ADD, DISASM_ADC, DISASM_SUB, DISASM_SBC,
+                                     DISASM_AND, DISASM_XOR, DISASM_OR, DISASM_CP};
+static const uint8_t table_rot[8] = {DISASM_RLC, DISASM_RRC, DISASM_RL, DISASM_RR,
+                                     DISASM_SLA, DISASM_SRA, DISASM_SLL, DISASM_SRL};
+static const uint8_t table_block[4][4] = {{DISASM_LDI, DISASM_CPI, DISASM_INI, DISASM_OUTI},
+                                          {DISASM_LDD, DISASM_CPD, DISASM_IND, DISASM_OUTD},
+                                          {DISASM_LDIR, DISASM_CPIR, DISASM_INIR, DISASM_OTIR},
+                                          {DISASM_LDDR, DISASM_CPDR, DISASM_INDR, DISASM_OTDR}};
+static const uint8_t table_im[8] = {0, 0, 1, 2, 0, 0, 1, 2};
+
+static disasm_entry_t main_table[256];
+static disasm_entry_t cb_table[256];
+static disasm_entry_t ed_table[256];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static disasm_operand_t operand(uint8_t type, uint8_t reg, uint16_t value)
+{
+    disasm_operand_t op = {type, reg, value};
+    return op;
 }
 
-/**
- * Decode ED prefix instruction
- */
-static const char *decode_dd_instruction(uint8_t opcode, uint8_t *memory, uint16_t pc)
+// r[z]: an 8-bit register, or (HL) for z = 6
+static disasm_operand_t operand_r(int z)
 {
-    static char buf[64];
+    if (z == 6)
+        return operand(DISASM_OPERAND_MEM_REG, DISASM_REG_HL, 0);
+    return operand(DISASM_OPERAND_REG8, table_r[z], 0);
+}
 
-    switch (opcode)
-    {
-    case 0x09:
-        return "ADD IX, BC";
-    case 0x19:
-        return "ADD IX, DE";
-    case 0x21:
-        return "LD IX, nn";
-    case 0x22:
-        return "LD (nn), IX";
-    case 0x23:
-        return "INC IX";
-    case 0x24:
-        return "INC IXH";
-    case 0x25:
-        return "DEC IXH";
-    case 0x26:
-        return "LD IXH, n";
-    case 0x29:
-        return "ADD IX, IX";
-    case 0x2A:
-        return "LD IX, (nn)";
-    case 0x2B:
-        return "DEC IX";
-    case 0x2C:
-        return "INC IXL";
-    case 0x2D:
-        return "DEC IXL";
-    case 0x2E:
-        return "LD IXL, n";
-    case 0x34:
-        return "INC (IX+d)";
-    case 0x35:
-        return "DEC (IX+d)";
-    case 0x36:
-        return "LD (IX+d), n";
-    case 0x39:
-        return "ADD IX, SP";
-    case 0x44:
-        return "LD B, IXH";
-    case 0x45:
-        return "LD B, IXL";
-    case 0x46:
-        return "LD B, (IX+d)";
-    case 0x4C:
-        return "LD C, IXH";
-    case 0x4D:
-        return "LD C, IXL";
-    case 0x4E:
-        return "LD C, (IX+d)";
-    case 0x54:
-        return "LD D, IXH";
-    case 0x55:
-        return "LD D, IXL";
-    case 0x56:
-        return "LD D, (IX+d)";
-    case 0x5C:
-        return "LD E, IXH";
-    case 0x5D:
-        return "LD E, IXL";
-    case 0x5E:
-        return "LD E, (IX+d)";
-    case 0x60:
-        return "LD IXH, B";
-    case 0x61:
-        return "LD IXH, C";
-    case 0x62:
-        return "LD IXH, D";
-    case 0x63:
-        return "LD IXH, E";
-    case 0x64:
-        return "LD IXH, IXH";
-    case 0x65:
-        return "LD IXH, IXL";
-    case 0x66:
-        return "LD H, (IX+d)";
-    case 0x67:
-        return "LD IXH, A";
-    case 0x68:
-        return "LD IXL, B";
-    case 0x69:
-        return "LD IXL, C";
-    case 0x6A:
-        return "LD IXL, D";
-    case 0x6B:
-        return "LD IXL, E";
-    case 0x6C:
-        return "LD IXL, IXH";
-    case 0x6D:
-        return "LD IXL, IXL";
-    case 0x6E:
-        return "LD L, (IX+d)";
-    case 0x6F:
-        return "LD IXL, A";
-    case 0x70:
-        return "LD (IX+d), B";
-    case 0x71:
-        return "LD (IX+d), C";
-    case 0x72:
-        return "LD (IX+d), D";
-    case 0x73:
-        return "LD (IX+d), E";
-    case 0x74:
-        return "LD (IX+d), H";
-    case 0x75:
-        return "LD (IX+d), L";
-    case 0x77:
-        return "LD (IX+d), A";
-    case 0x7C:
-        return "LD A, IXH";
-    case 0x7D:
-        return "LD A, IXL";
-    case 0x7E:
-        return "LD A, (IX+d)";
-    case 0x84:
-        return "ADD A, IXH";
-    case 0x85:
-        return "ADD A, IXL";
-    case 0x86:
-        return "ADD A, (IX+d)";
-    case 0x8C:
-        return "ADC A, IXH";
-    case 0x8D:
-        return "ADC A, IXL";
-    case 0x8E:
-        return "ADC A, (IX+d)";
-    case 0x94:
-        return "SUB IXH";
-    case 0x95:
-        return "SUB IXL";
-    case 0x96:
-        return "SUB (IX+d)";
-    case 0x9C:
-        return "SBC A, IXH";
-    case 0x9D:
-        return "SBC A, IXL";
-    case 0x9E:
-        return "SBC A, (IX+d)";
-    case 0xA4:
-        return "AND IXH";
-    case 0xA5:
-        return "AND IXL";
-    case 0xA6:
-        return "AND (IX+d)";
-    case 0xAC:
-        return "XOR IXH";
-    case 0xAD:
-        return "XOR IXL";
-    case 0xAE:
-        return "XOR (IX+d)";
-    case 0xB4:
-        return "OR IXH";
-    case 0xB5:
-        return "OR IXL";
-    case 0xB6:
-        return "OR (IX+d)";
-    case 0xBC:
-        return "CP IXH";
-    case 0xBD:
-        return "CP IXL";
-    case 0xBE:
-        return "CP (IX+d)";
-    case 0xCB:
-        if (pc + 3 < SPETTRUM_TOTAL_MEMORY)
-        {
-            uint8_t bit_op = memory[pc + 3];
-            snprintf(buf, sizeof(buf), "DD CB (IX+d) %02X", bit_op);
-            return buf;
-        }
-        return "DD CB (IX bit ops)";
-    case 0xE1:
-        return "POP IX";
-    case 0xE3:
-        return "EX (SP), IX";
-    case 0xE5:
-        return "PUSH IX";
-    case 0xE9:
-        return "JP (IX)";
-    case 0xF9:
-        return "LD SP, IX";
-    default:
-        snprintf(buf, sizeof(buf), "DD %02X (unknown)", opcode);
-        return buf;
-    }
+static disasm_operand_t operand_reg8(uint8_t reg)
+{
+    return operand(DISASM_OPERAND_REG8, reg, 0);
 }
 
-static const char *decode_fd_instruction(uint8_t opcode, uint8_t *memory, uint16_t pc)
+static disasm_operand_t operand_reg16(uint8_t reg)
 {
-    static char buf[64];
+    return operand(DISASM_OPERAND_REG16, reg, 0);
+}
 
-    switch (opcode)
-    {
-    case 0x09:
-        return "ADD IY, BC";
-    case 0x19:
-        return "ADD IY, DE";
-    case 0x21:
-        return "LD IY, nn";
-    case 0x22:
-        return "LD (nn), IY";
-    case 0x23:
-        return "INC IY";
-    case 0x24:
-        return "INC IYH";
-    case 0x25:
-        return "DEC IYH";
-    case 0x26:
-        return "LD IYH, n";
-    case 0x29:
-        return "ADD IY, IY";
-    case 0x2A:
-        return "LD IY, (nn)";
-    case 0x2B:
-        return "DEC IY";
-    case 0x2C:
-        return "INC IYL";
-    case 0x2D:
-        return "DEC IYL";
-    case 0x2E:
-        return "LD IYL, n";
-    case 0x34:
-        return "INC (IY+d)";
-    case 0x35:
-        return "DEC (IY+d)";
-    case 0x36:
-        return "LD (IY+d), n";
-    case 0x39:
-        return "ADD IY, SP";
-    case 0x44:
-        return "LD B, IYH";
-    case 0x45:
-        return "LD B, IYL";
-    case 0x46:
-        return "LD B, (IY+d)";
-    case 0x4C:
-        return "LD C, IYH";
-    case 0x4D:
-        return "LD C, IYL";
-    case 0x4E:
-        return "LD C, (IY+d)";
-    case 0x54:
-        return "LD D, IYH";
-    case 0x55:
-        return "LD D, IYL";
-    case 0x56:
-        return "LD D, (IY+d)";
-    case 0x5C:
-        return "LD E, IYH";
-    case 0x5D:
-        return "LD E, IYL";
-    case 0x5E:
-        return "LD E, (IY+d)";
-    case 0x60:
-        return "LD IYH, B";
-    case 0x61:
-        return "LD IYH, C";
-    case 0x62:
-        return "LD IYH, D";
-    case 0x63:
-        return "LD IYH, E";
-    case 0x64:
-        return "LD IYH, IYH";
-    case 0x65:
-        return "LD IYH, IYL";
-    case 0x66:
-        return "LD H, (IY+d)";
-    case 0x67:
-        return "LD IYH, A";
-    case 0x68:
-        return "LD IYL, B";
-    case 0x69:
-        return "LD IYL, C";
-    case 0x6A:
-        return "LD IYL, D";
-    case 0x6B:
-        return "LD IYL, E";
-    case 0x6C:
-        return "LD IYL, IYH";
-    case 0x6D:
-        return "LD IYL, IYL";
-    case 0x6E:
-        return "LD L, (IY+d)";
-    case 0x6F:
-        return "LD IYL, A";
-    case 0x70:
-        return "LD (IY+d), B";
-    case 0x71:
-        return "LD (IY+d), C";
-    case 0x72:
-        return "LD (IY+d), D";
-    case 0x73:
-        return "LD (IY+d), E";
-    case 0x74:
-        return "LD (IY+d), H";
-    case 0x75:
-        return "LD (IY+d), L";
-    case 0x77:
-        return "LD (IY+d), A";
-    case 0x7C:
-        return "LD A, IYH";
-    case 0x7D:
-        return "LD A, IYL";
-    case 0x7E:
-        return "LD A, (IY+d)";
-    case 0x84:
-        return "ADD A, IYH";
-    case 0x85:
-        return "ADD A, IYL";
-    case 0x86:
-        return "ADD A, (IY+d)";
-    case 0x8C:
-        return "ADC A, IYH";
-    case 0x8D:
-        return "ADC A, IYL";
-    case 0x8E:
-        return "ADC A, (IY+d)";
-    case 0x94:
-        return "SUB IYH";
-    case 0x95:
-        return "SUB IYL";
-    case 0x96:
-        return "SUB (IY+d)";
-    case 0x9C:
-        return "SBC A, IYH";
-    case 0x9D:
-        return "SBC A, IYL";
-    case 0x9E:
-        return "SBC A, (IY+d)";
-    case 0xA4:
-        return "AND IYH";
-    case 0xA5:
-        return "AND IYL";
-    case 0xA6:
-        return "AND (IY+d)";
-    case 0xAC:
-        return "XOR IYH";
-    case 0xAD:
-        return "XOR IYL";
-    case 0xAE:
-        return "XOR (IY+d)";
-    case 0xB4:
-        return "OR IYH";
-    case 0xB5:
-        return "OR IYL";
-    case 0xB6:
-        return "OR (IY+d)";
-    case 0xBC:
-        return "CP IYH";
-    case 0xBD:
-        return "CP IYL";
-    case 0xBE:
-        return "CP (IY+d)";
-    case 0xCB:
-        if (pc + 3 < SPETTRUM_TOTAL_MEMORY)
-        {
-            uint8_t bit_op = memory[pc + 3];
-            snprintf(buf, sizeof(buf), "FD CB (IY+d) %02X", bit_op);
-            return buf;
-        }
-        return "FD CB (IY bit ops)";
-    case 0xE1:
-        return "POP IY";
-    case 0xE3:
-        return "EX (SP), IY";
-    case 0xE5:
-        return "PUSH IY";
-    case 0xE9:
-        return "JP (IY)";
-    case 0xF9:
-        return "LD SP, IY";
-    default:
-        snprintf(buf, sizeof(buf), "FD %02X (unknown)", opcode);
-        return buf;
-    }
+static disasm_operand_t operand_type(uint8_t type)
+{
+    return operand(type, 0, 0);
 }
 
-static const char *decode_ed_instruction(uint8_t opcode)
+/**
+ * Fill a table entry: mnemonic, operand count, then the operands
+ */
+static void entry_set(disasm_entry_t *entry, uint8_t mnemonic, int count, ...)
 {
-    static char buf[32];
+    va_list args;
 
-    switch (opcode)
-    {
-    case 0x40:
-        return "IN B, (C)";
-    case 0x41:
-        return "OUT (C), B";
-    case 0x42:
-        return "SBC HL, BC";
-    case 0x43:
-        return "LD (nn), BC";
-    case 0x44:
-        return "NEG";
-    case 0x45:
-        return "RETN";
-    case 0x46:
-        return "IM 0";
-    case 0x47:
-        return "LD I, A";
-    case 0x48:
-        return "IN C, (C)";
-    case 0x49:
-        return "OUT (C), C";
-    case 0x4A:
-        return "ADC HL, BC";
-    case 0x4B:
-        return "LD BC, (nn)";
-    case 0x4C:
-        return "NEG";
-    case 0x4D:
-        return "RETI";
-    case 0x4E:
-        return "IM 0";
-    case 0x4F:
-        return "LD R, A";
-    case 0x50:
-        return "IN D, (C)";
-    case 0x51:
-        return "OUT (C), D";
-    case 0x52:
-        return "SBC HL, DE";
-    case 0x53:
-        return "LD (nn), DE";
-    case 0x54:
-        return "NEG";
-    case 0x55:
-        return "RETN";
-    case 0x56:
-        return "IM 1";
-    case 0x57:
-        return "LD A, I";
-    case 0x58:
-        return "IN E, (C)";
-    case 0x59:
-        return "OUT (C), E";
-    case 0x5A:
-        return "ADC HL, DE";
-    case 0x5B:
-        return "LD DE, (nn)";
-    case 0x5C:
-        return "NEG";
-    case 0x5D:
-        return "RETN";
-    case 0x5E:
-        return "IM 2";
-    case 0x5F:
-        return "LD A, R";
-    case 0x60:
-        return "IN H, (C)";
-    case 0x61:
-        return "OUT (C), H";
-    case 0x62:
-        return "SBC HL, HL";
-    case 0x63:
-        return "LD (nn), HL";
-    case 0x64:
-        return "NEG";
-    case 0x65:
-        return "RETN";
-    case 0x66:
-        return "IM 0";
-    case 0x67:
-        return "RRD";
-    case 0x68:
-        return "IN L, (C)";
-    case 0x69:
-        return "OUT (C), L";
-    case 0x6A:
-        return "ADC HL, HL";
-    case 0x6B:
-        return "LD HL, (nn)";
-    case 0x6C:
-        return "NEG";
-    case 0x6D:
-        return "RETN";
-    case 0x6E:
-        return "IM 0";
-    case 0x6F:
-        return "RLD";
-    case 0x70:
-        return "IN (C)";
-    case 0x71:
-        return "OUT (C), 0";
-    case 0x72:
-        return "SBC HL, SP";
-    case 0x73:
-        return "LD (nn), SP";
-    case 0x74:
-        return "NEG";
-    case 0x75:
-        return "RETN";
-    case 0x76:
-        return "IM 1";
-    case 0x78:
-        return "IN A, (C)";
-    case 0x79:
-        return "OUT (C), A";
-    case 0x7A:
-        return "ADC HL, SP";
-    case 0x7B:
-        return "LD SP, (nn)";
-    case 0x7C:
-        return "NEG";
-    case 0x7D:
-        return "RETN";
-    case 0x7E:
-        return "IM 2";
-    case 0xA0:
-        return "LDI";
-    case 0xA1:
-        return "CPI";
-    case 0xA2:
-        return "INI";
-    case 0xA3:
-        return "OUTI";
-    case 0xA8:
-        return "LDD";
-    case 0xA9:
-        return "CPD";
-    case 0xAA:
-        return "IND";
-    case 0xAB:
-        return "OUTD";
-    case 0xB0:
-        return "LDIR";
-    case 0xB1:
-        return "CPIR";
-    case 0xB2:
-        return "INIR";
-    case 0xB3:
-        return "OTIR";
-    case 0xB8:
-        return "LDDR";
-    case 0xB9:
-        return "CPDR";
-    case 0xBA:
-        return "INDR";
-    case 0xBB:
-        return "OTDR";
-    default:
-        snprintf(buf, sizeof(buf), "ED %02X (unknown)", opcode);
-        return buf;
-    }
+    memset(entry, 0, sizeof(*entry));
+    entry->mnemonic = mnemonic;
+    entry->operand_count = (uint8_t)count;
+    va_start(args, count);
+    for (int i = 0; i < count; i++)
+        entry->operands[i] = va_arg(args, disasm_operand_t);
+    va_end(args);
 }
 
 /**
- * Log instruction disassembly to file with register state and actual operand values
+ * Unprefixed opcodes
  */
-void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uint8_t opcode)
+static void build_main_entry(disasm_entry_t *e, int x, int y, int z)
 {
-    if (!emulator || !emulator->disasm_file)
-        return;
+    int p = y >> 1, q = y & 1;
+    const disasm_operand_t a = operand_reg8(DISASM_REG_A);
+    const disasm_operand_t hl = operand_reg16(DISASM_REG_HL);
+    const disasm_operand_t nn = operand_type(DISASM_OPERAND_IMM16);
+    const disasm_operand_t n = operand_type(DISASM_OPERAND_IMM8);
+    const disasm_operand_t target = operand_type(DISASM_OPERAND_ADDRESS);
+    const disasm_operand_t mem_nn = operand_type(DISASM_OPERAND_MEM_ADDR);
+    static const uint8_t misc_x0z7[8] = {DISASM_RLCA, DISASM_RRCA, DISASM_RLA, DISASM_RRA,
+                                         DISASM_DAA, DISASM_CPL, DISASM_SCF, DISASM_CCF};
 
-    z80_registers_t *regs = &emulator->cpu->regs;
-    z80_emulator_t *z80 = emulator->cpu;
-    char instr_buf[32] = "???";
+    if (x == 1)
+    {
+        if (y == 6 && z == 6)
+            entry_set(e, DISASM_HALT, 0);
+        else
+            entry_set(e, DISASM_LD, 2, operand_r(y), operand_r(z));
+        return;
+    }
+    if (x == 2)
+    {
+        uint8_t mnemonic = table_alu[y];
+        if (mnemonic == DISASM_ADD || mnemonic == DISASM_ADC || mnemonic == DISASM_SBC)
+            entry_set(e, mnemonic, 2, a, operand_r(z));
+        else
+            entry_set(e, mnemonic, 1, operand_r(z));
+        return;
+    }
 
-    // Read operand bytes for immediate values and addresses
-    uint8_t operand = 0;
-    uint16_t addr = 0;
-    if (pc + 1 < SPETTRUM_TOTAL_MEMORY)
-        operand = emulator->memory[pc + 1];
-    if (pc + 2 < SPETTRUM_TOTAL_MEMORY)
-        addr = emulator->memory[pc + 1] | (emulator->memory[pc + 2] << 8);
+    if (x == 0)
+    {
+        switch (z)
+        {
+        case 0:
+            if (y == 0)
+                entry_set(e, DISASM_NOP, 0);
+            else if (y == 1)
+                entry_set(e, DISASM_EX, 2, operand_reg16(DISASM_REG_AF), operand_reg16(DISASM_REG_AF_ALT));
+            else if (y == 2)
+                entry_set(e, DISASM_DJNZ, 1, target);
+            else if (y == 3)
+                entry_set(e, DISASM_JR, 1, target);
+            else
+                entry_set(e, DISASM_JR, 2, operand(DISASM_OPERAND_COND, (uint8_t)(y - 4), 0), target);
+            break;
+        case 1:
+            if (q == 0)
+                entry_set(e, DISASM_LD, 2, operand_reg16(table_rp[p]), nn);
+            else
+                entry_set(e, DISASM_ADD, 2, hl, operand_reg16(table_rp[p]));
+            break;
+        case 2:
+        {
+            disasm_operand_t mem = p == 0   ? operand(DISASM_OPERAND_MEM_REG, DISASM_REG_BC, 0)
+                                   : p == 1 ? operand(DISASM_OPERAND_MEM_REG, DISASM_REG_DE, 0)
+                                            : mem_nn;
+            disasm_operand_t reg = p == 2 ? hl : a;
+            if (q == 0)
+                entry_set(e, DISASM_LD, 2, mem, reg);
+            else
+                entry_set(e, DISASM_LD, 2, reg, mem);
+            break;
+        }
+        case 3:
+            entry_set(e, q == 0 ? DISASM_INC : DISASM_DEC, 1, operand_reg16(table_rp[p]));
+            break;
+        case 4:
+            entry_set(e, DISASM_INC, 1, operand_r(y));
+            break;
+        case 5:
+            entry_set(e, DISASM_DEC, 1, operand_r(y));
+            break;
+        case 6:
+            entry_set(e, DISASM_LD, 2, operand_r(y), n);
+            break;
+        default:
+            entry_set(e, misc_x0z7[y], 0);
+            break;
+        }
+        return;
+    }
 
-    // Decode instruction based on opcode with actual values
-    switch (opcode)
+    // x == 3
+    switch (z)
     {
-    // Root Instructions
-    case 0x00:
-        snprintf(instr_buf, sizeof(instr_buf), "NOP");
-        break;
-    case 0x01:
-        snprintf(instr_buf, sizeof(instr_buf), "LD BC, %04X", addr);
-        break;
-    case 0x02:
-        snprintf(instr_buf, sizeof(instr_buf), "LD (BC), A");
-        break;
-    case 0x03:
-        snprintf(instr_buf, sizeof(instr_buf), "INC BC");
-        break;
-    case 0x04:
-        snprintf(instr_buf, sizeof(instr_buf), "INC B");
-        break;
-    case 0x05:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC B");
-        break;
-    case 0x06:
-        snprintf(instr_buf, sizeof(instr_buf), "LD B, %02X", operand);
-        break;
-    case 0x07:
-        snprintf(instr_buf, sizeof(instr_buf), "RLCA");
-        break;
-    case 0x08:
-        snprintf(instr_buf, sizeof(instr_buf), "EX AF, AF'");
-        break;
-    case 0x09:
-        snprintf(instr_buf, sizeof(instr_buf), "ADD HL, BC");
-        break;
-    case 0x0A:
-        snprintf(instr_buf, sizeof(instr_buf), "LD A, (BC)");
-        break;
-    case 0x0B:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC BC");
-        break;
-    case 0x0C:
-        snprintf(instr_buf, sizeof(instr_buf), "INC C");
-        break;
-    case 0x0D:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC C");
-        break;
-    case 0x0E:
-        snprintf(instr_buf, sizeof(instr_buf), "LD C, %02X", operand);
-        break;
-    case 0x0F:
-        snprintf(instr_buf, sizeof(instr_buf), "RRCA");
-        break;
-    case 0x10:
-        snprintf(instr_buf, sizeof(instr_buf), "DJNZ %04X", pc + 2 + (int8_t)operand);
-        break;
-    case 0x11:
-        snprintf(instr_buf, sizeof(instr_buf), "LD DE, %04X", addr);
-        break;
-    case 0x12:
-        snprintf(instr_buf, sizeof(instr_buf), "LD (DE), A");
-        break;
-    case 0x13:
-        snprintf(instr_buf, sizeof(instr_buf), "INC DE");
-        break;
-    case 0x14:
-        snprintf(instr_buf, sizeof(instr_buf), "INC D");
-        break;
-    case 0x15:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC D");
-        break;
-    case 0x16:
-        snprintf(instr_buf, sizeof(instr_buf), "LD D, %02X", operand);
-        break;
-    case 0x17:
-        snprintf(instr_buf, sizeof(instr_buf), "RLA");
-        break;
-    case 0x18:
-        snprintf(instr_buf, sizeof(instr_buf), "JR %04X", pc + 2 + (int8_t)operand);
-        break;
-    case 0x19:
-        snprintf(instr_buf, sizeof(instr_buf), "ADD HL, DE");
-        break;
-    case 0x1A:
-        snprintf(instr_buf, sizeof(instr_buf), "LD A, (DE)");
-        break;
-    case 0x1B:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC DE");
-        break;
-    case 0x1C:
-        snprintf(instr_buf, sizeof(instr_buf), "INC E");
-        break;
-    case 0x1D:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC E");
-        break;
-    case 0x1E:
-        snprintf(instr_buf, sizeof(instr_buf), "LD E, %02X", operand);
-        break;
-    case 0x1F:
-        snprintf(instr_buf, sizeof(instr_buf), "RRA");
-        break;
-    case 0x20:
-        snprintf(instr_buf, sizeof(instr_buf), "JR NZ, %04X", pc + 2 + (int8_t)operand);
-        break;
-    case 0x21:
-        snprintf(instr_buf, sizeof(instr_buf), "LD HL, %04X", addr);
-        break;
-    case 0x22:
-        snprintf(instr_buf, sizeof(instr_buf), "LD (%04X), HL", addr);
-        break;
-    case 0x23:
-        snprintf(instr_buf, sizeof(instr_buf), "INC HL");
-        break;
-    case 0x24:
-        snprintf(instr_buf, sizeof(instr_buf), "INC H");
-        break;
-    case 0x25:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC H");
-        break;
-    case 0x26:
-        snprintf(instr_buf, sizeof(instr_buf), "LD H, %02X", operand);
-        break;
-    case 0x27:
-        snprintf(instr_buf, sizeof(instr_buf), "DAA");
-        break;
-    case 0x28:
-        snprintf(instr_buf, sizeof(instr_buf), "JR Z, %04X", pc + 2 + (int8_t)operand);
-        break;
-    case 0x29:
-        snprintf(instr_buf, sizeof(instr_buf), "ADD HL, HL");
-        break;
-    case 0x2A:
-        snprintf(instr_buf, sizeof(instr_buf), "LD HL, (%04X)", addr);
-        break;
-    case 0x2B:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC HL");
-        break;
-    case 0x2C:
-        snprintf(instr_buf, sizeof(instr_buf), "INC L");
-        break;
-    case 0x2D:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC L");
+    case 0:
+        entry_set(e, DISASM_RET, 1, operand(DISASM_OPERAND_COND, (uint8_t)y, 0));
+        break;
+    case 1:
+        if (q == 0)
+            entry_set(e, DISASM_POP, 1, operand_reg16(table_rp2[p]));
+        else if (p == 0)
+            entry_set(e, DISASM_RET, 0);
+        else if (p == 1)
+            entry_set(e, DISASM_EXX, 0);
+        else if (p == 2)
+            entry_set(e, DISASM_JP, 1, operand(DISASM_OPERAND_MEM_REG, DISASM_REG_HL, 0));
+        else
+            entry_set(e, DISASM_LD, 2, operand_reg16(DISASM_REG_SP), hl);
         break;
-    case 0x2E:
-        snprintf(instr_buf, sizeof(instr_buf), "LD L, %02X", operand);
+    case 2:
+        entry_set(e, DISASM_JP, 2, operand(DISASM_OPERAND_COND, (uint8_t)y, 0), target);
         break;
-    case 0x2F:
-        snprintf(instr_buf, sizeof(instr_buf), "CPL");
+    case 3:
+        switch (y)
+        {
+        case 0:
+            entry_set(e, DISASM_JP, 1, target);
+            break;
+        case 2:
+            entry_set(e, DISASM_OUT, 2, operand_type(DISASM_OPERAND_PORT), a);
+            break;
+        case 3:
+            entry_set(e, DISASM_IN, 2, a, operand_type(DISASM_OPERAND_PORT));
+            break;
+        case 4:
+            entry_set(e, DISASM_EX, 2, operand(DISASM_OPERAND_MEM_REG, DISASM_REG_SP, 0), hl);
+            break;
+        case 5:
+            entry_set(e, DISASM_EX, 2, operand_reg16(DISASM_REG_DE), hl);
+            break;
+        case 6:
+            entry_set(e, DISASM_DI, 0);
+            break;
+        case 7:
+            entry_set(e, DISASM_EI, 0);
+            break;
+        default: // CB prefix, decoded from cb_table
+            entry_set(e, DISASM_DB, 0);
+            break;
+        }
         break;
-    case 0x30:
-        snprintf(instr_buf, sizeof(instr_buf), "JR NC, %04X", pc + 2 + (int8_t)operand);
+    case 4:
+        entry_set(e, DISASM_CALL, 2, operand(DISASM_OPERAND_COND, (uint8_t)y, 0), target);
         break;
-    case 0x31:
-        snprintf(instr_buf, sizeof(instr_buf), "LD SP, %04X", addr);
+    case 5:
+        if (q == 0)
+            entry_set(e, DISASM_PUSH, 1, operand_reg16(table_rp2[p]));
+        else if (p == 0)
+            entry_set(e, DISASM_CALL, 1, target);
+        else // DD, ED and FD prefixes
+            entry_set(e, DISASM_DB, 0);
         break;
-    case 0x32:
-        snprintf(instr_buf, sizeof(instr_buf), "LD (%04X), A", addr);
+    case 6:
+    {
+        uint8_t mnemonic = table_alu[y];
+        if (mnemonic == DISASM_ADD || mnemonic == DISASM_ADC || mnemonic == DISASM_SBC)
+            entry_set(e, mnemonic, 2, a, n);
+        else
+            entry_set(e, mnemonic, 1, n);
         break;
-    case 0x33:
-        snprintf(instr_buf, sizeof(instr_buf), "INC SP");
+    }
+    default:
+        entry_set(e, DISASM_RST, 1, operand(DISASM_OPERAND_VECTOR, 0, (uint16_t)(y * 8)));
         break;
-    case 0x34:
-        snprintf(instr_buf, sizeof(instr_buf), "INC (HL)");
+    }
+}
+
+/**
+ * ED-prefixed opcodes (anything not listed is shown as data)
+ */
+static void build_ed_entry(disasm_entry_t *e, int x, int y, int z)
+{
+    int p = y >> 1, q = y & 1;
+    const disasm_operand_t a = operand_reg8(DISASM_REG_A);
+    const disasm_operand_t port_c = operand_type(DISASM_OPERAND_PORT_C);
+
+    entry_set(e, DISASM_DB, 0);
+    if (x == 2 && z <= 3 && y >= 4)
+    {
+        entry_set(e, table_block[y - 4][z], 0);
+        return;
+    }
+    if (x != 1)
+        return;
+
+    switch (z)
+    {
+    case 0:
+        if (y == 6)
+            entry_set(e, DISASM_IN, 1, port_c);
+        else
+            entry_set(e, DISASM_IN, 2, operand_r(y), port_c);
         break;
-    case 0x35:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC (HL)");
+    case 1:
+        if (y == 6)
+            entry_set(e, DISASM_OUT, 2, port_c, operand(DISASM_OPERAND_NUMBER, 0, 0));
+        else
+            entry_set(e, DISASM_OUT, 2, port_c, operand_r(y));
         break;
-    case 0x36:
-        snprintf(instr_buf, sizeof(instr_buf), "LD (HL), %02X", operand);
+    case 2:
+        entry_set(e, q == 0 ? DISASM_SBC : DISASM_ADC, 2, operand_reg16(DISASM_REG_HL),
+                  operand_reg16(table_rp[p]));
         break;
-    case 0x37:
-        snprintf(instr_buf, sizeof(instr_buf), "SCF");
+    case 3:
+        if (q == 0)
+            entry_set(e, DISASM_LD, 2, operand_type(DISASM_OPERAND_MEM_ADDR), operand_reg16(table_rp[p]));
+        else
+            entry_set(e, DISASM_LD, 2, operand_reg16(table_rp[p]), operand_type(DISASM_OPERAND_MEM_ADDR));
         break;
-    case 0x38:
-        snprintf(instr_buf, sizeof(instr_buf), "JR C, %04X", pc + 2 + (int8_t)operand);
+    case 4:
+        entry_set(e, DISASM_NEG, 0);
         break;
-    case 0x39:
-        snprintf(instr_buf, sizeof(instr_buf), "ADD HL, SP");
+    case 5:
+        entry_set(e, y == 1 ? DISASM_RETI : DISASM_RETN, 0);
         break;
-    case 0x3A:
-        snprintf(instr_buf, sizeof(instr_buf), "LD A, (%04X)", addr);
+    case 6:
+        entry_set(e, DISASM_IM, 1, operand(DISASM_OPERAND_NUMBER, 0, table_im[y]));
         break;
-    case 0x3B:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC SP");
+    default:
+        if (y == 0)
+            entry_set(e, DISASM_LD, 2, operand_reg8(DISASM_REG_I), a);
+        else if (y == 1)
+            entry_set(e, DISASM_LD, 2, operand_reg8(DISASM_REG_R), a);
+        else if (y == 2)
+            entry_set(e, DISASM_LD, 2, a, operand_reg8(DISASM_REG_I));
+        else if (y == 3)
+            entry_set(e, DISASM_LD, 2, a, operand_reg8(DISASM_REG_R));
+        else if (y == 4)
+            entry_set(e, DISASM_RRD, 0);
+        else if (y == 5)
+            entry_set(e, DISASM_RLD, 0);
         break;
-    case 0x3C:
-        snprintf(instr_buf, sizeof(instr_buf), "INC A");
+    }
+}
+
+/**
+ * CB-prefixed opcodes (the r[z] operand is always last)
+ */
+static void build_cb_entry(disasm_entry_t *e, int x, int y, int z)
+{
+    static const uint8_t bit_ops[4] = {0, DISASM_BIT, DISASM_RES, DISASM_SET};
+
+    if (x == 0)
+        entry_set(e, table_rot[y], 1, operand_r(z));
+    else
+        entry_set(e, bit_ops[x], 2, operand(DISASM_OPERAND_NUMBER, 0, (uint16_t)y), operand_r(z));
+}
+
+static void build_tables(void)
+{
+    for (int op = 0; op < 256; op++)
+    {
+        int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+        build_main_entry(&main_table[op], x, y, z);
+        build_ed_entry(&ed_table[op], x, y, z);
+        build_cb_entry(&cb_table[op], x, y, z);
+    }
+}
+
+/**
+ * Decode bytes that are not an instruction as data
+ */
+static int decode_data(const uint8_t *bytes, int length, disasm_insn_t *insn)
+{
+    insn->mnemonic = DISASM_DB;
+    insn->operand_count = (uint8_t)length;
+    for (int i = 0; i < length; i++)
+        insn->operands[i] = operand(DISASM_OPERAND_IMM8, 0, bytes[i]);
+    insn->length = (uint8_t)length;
+    return length;
+}
+
+/**
+ * DD CB d op / FD CB d op: the CB entry applied to (IX+d)/(IY+d)
+ * Undocumented forms with a register in r[z] also copy the result there.
+ */
+static int decode_indexed_cb(const uint8_t *bytes, uint8_t index_reg, disasm_insn_t *insn)
+{
+    const disasm_entry_t *entry = &cb_table[bytes[3]];
+    int last = entry->operand_count - 1;
+
+    insn->mnemonic = entry->mnemonic;
+    insn->operand_count = entry->operand_count;
+    memcpy(insn->operands, entry->operands, sizeof(insn->operands));
+    insn->operands[last] = operand(DISASM_OPERAND_INDEXED, index_reg, (uint16_t)(int8_t)bytes[2]);
+    if (entry->mnemonic != DISASM_BIT && entry->operands[last].type == DISASM_OPERAND_REG8)
+        insn->operands[insn->operand_count++] = entry->operands[last];
+    insn->length = 4;
+    return 4;
+}
+
+/**
+ * Decode one instruction
+ */
+int disasm_decode(const uint8_t *bytes, uint16_t pc, disasm_insn_t *insn)
+{
+    const disasm_entry_t *entry;
+    int index_reg = -1; // IX or IY after a DD/FD prefix
+    int pos;            // Next operand byte
+
+    pthread_once(&tables_once, build_tables);
+    memset(insn, 0, sizeof(*insn));
+    memcpy(insn->bytes, bytes, DISASM_MAX_LENGTH);
+
+    switch (bytes[0])
+    {
+    case 0xCB:
+        entry = &cb_table[bytes[1]];
+        pos = 2;
         break;
-    case 0x3D:
-        snprintf(instr_buf, sizeof(instr_buf), "DEC A");
+    case 0xED:
+        entry = &ed_table[bytes[1]];
+        if (entry->mnemonic == DISASM_DB)
+            return decode_data(bytes, 2, insn);
+        pos = 2;
         break;
-    case 0x3E:
-        snprintf(instr_buf, sizeof(instr_buf), "LD A, %02X", operand);
+    case 0xDD:
+    case 0xFD:
+        index_reg = bytes[0] == 0xDD ? DISASM_REG_IX : DISASM_REG_IY;
+        // A prefix followed by another prefix does nothing on its own
+        if (bytes[1] == 0xDD || bytes[1] == 0xFD || bytes[1] == 0xED)
+            return decode_data(bytes, 1, insn);
+        if (bytes[1] == 0xCB)
+            return decode_indexed_cb(bytes, (uint8_t)index_reg, insn);
+        entry = &main_table[bytes[1]];
+        pos = 2;
         break;
-    case 0x3F:
-        snprintf(instr_buf, sizeof(instr_buf), "CCF");
+    default:
+        entry = &main_table[bytes[0]];
+        pos = 1;
         break;
+    }
 
-    // LD r, r' instructions (0x40-0x7F)
-    case 0x40:
-    case 0x41:
-    case 0x42:
-    case 0x43:
-    case 0x44:
-    case 0x45:
-    case 0x46:
-    case 0x47:
-    case 0x48:
-    case 0x49:
-    case 0x4A:
-    case 0x4B:
-    case 0x4C:
-    case 0x4D:
-    case 0x4E:
-    case 0x4F:
-    case 0x50:
-    case 0x51:
-    case 0x52:
-    case 0x53:
-    case 0x54:
-    case 0x55:
-    case 0x56:
-    case 0x57:
-    case 0x58:
-    case 0x59:
-    case 0x5A:
-    case 0x5B:
-    case 0x5C:
-    case 0x5D:
-    case 0x5E:
-    case 0x5F:
-    case 0x60:
-    case 0x61:
-    case 0x62:
-    case 0x63:
-    case 0x64:
-    case 0x65:
-    case 0x66:
-    case 0x67:
-    case 0x68:
-    case 0x69:
-    case 0x6A:
-    case 0x6B:
-    case 0x6C:
-    case 0x6D:
-    case 0x6E:
-    case 0x6F:
-    case 0x70:
-    case 0x71:
-    case 0x72:
-    case 0x73:
-    case 0x74:
-    case 0x75:
-    case 0x76:
-    case 0x77:
-    case 0x78:
-    case 0x79:
-    case 0x7A:
-    case 0x7B:
-    case 0x7C:
-    case 0x7D:
-    case 0x7E:
-    case 0x7F:
+    insn->mnemonic = entry->mnemonic;
+    insn->operand_count = entry->operand_count;
+    memcpy(insn->operands, entry->operands, sizeof(insn->operands));
+
+    // DD/FD: HL becomes IX/IY, H and L become its halves, unless (HL) is an
+    // operand, which becomes (IX+d) and leaves H and L alone. EX DE, HL is
+    // unaffected; an opcode without HL just ignores the prefix.
+    if (index_reg >= 0 && bytes[1] != 0xEB)
     {
-        const char *dests[] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
-        const char *srcs[] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
-        uint8_t dest = (opcode >> 3) & 0x07;
-        uint8_t src = opcode & 0x07;
+        int has_mem_hl = 0;
+        for (int i = 0; i < insn->operand_count; i++)
+            if (insn->operands[i].type == DISASM_OPERAND_MEM_REG && insn->operands[i].reg == DISASM_REG_HL)
+                has_mem_hl = 1;
 
-        // Special case: HALT
-        if (opcode == 0x76)
+        for (int i = 0; i < insn->operand_count; i++)
         {
-            snprintf(instr_buf, sizeof(instr_buf), "HALT");
+            disasm_operand_t *op = &insn->operands[i];
+            if (op->type == DISASM_OPERAND_REG16 && op->reg == DISASM_REG_HL)
+                op->reg = (uint8_t)index_reg;
+            else if (op->type == DISASM_OPERAND_MEM_REG && op->reg == DISASM_REG_HL)
+            {
+                if (bytes[1] == 0xE9) // JP (IX) has no displacement
+                    op->reg = (uint8_t)index_reg;
+                else
+                    *op = operand(DISASM_OPERAND_INDEXED, (uint8_t)index_reg, 0);
+            }
+            else if (op->type == DISASM_OPERAND_REG8 && !has_mem_hl &&
+                     (op->reg == DISASM_REG_H || op->reg == DISASM_REG_L))
+            {
+                int low = op->reg == DISASM_REG_L;
+                op->reg = (uint8_t)(index_reg == DISASM_REG_IX ? DISASM_REG_IXH + low : DISASM_REG_IYH + low);
+            }
         }
-        else
-        {
-            snprintf(instr_buf, sizeof(instr_buf), "LD %s, %s", dests[dest], srcs[src]);
-        }
-        break;
     }
 
-    // ALU operations (0x80-0xBF)
-    case 0x80:
-    case 0x81:
-    case 0x82:
-    case 0x83:
-    case 0x84:
-    case 0x85:
-    case 0x86:
-    case 0x87:
-    case 0x88:
-    case 0x89:
-    case 0x8A:
-    case 0x8B:
-    case 0x8C:
-    case 0x8D:
-    case 0x8E:
-    case 0x8F:
-    case 0x90:
-    case 0x91:
-    case 0x92:
-    case 0x93:
-    case 0x94:
-    case 0x95:
-    case 0x96:
-    case 0x97:
-    case 0x98:
-    case 0x99:
-    case 0x9A:
-    case 0x9B:
-    case 0x9C:
-    case 0x9D:
-    case 0x9E:
-    case 0x9F:
-    case 0xA0:
-    case 0xA1:
-    case 0xA2:
-    case 0xA3:
-    case 0xA4:
-    case 0xA5:
-    case 0xA6:
-    case 0xA7:
-    case 0xA8:
-    case 0xA9:
-    case 0xAA:
-    case 0xAB:
-    case 0xAC:
-    case 0xAD:
-    case 0xAE:
-    case 0xAF:
-    case 0xB0:
-    case 0xB1:
-    case 0xB2:
-    case 0xB3:
-    case 0xB4:
-    case 0xB5:
-    case 0xB6:
-    case 0xB7:
-    case 0xB8:
-    case 0xB9:
-    case 0xBA:
-    case 0xBB:
-    case 0xBC:
-    case 0xBD:
-    case 0xBE:
-    case 0xBF:
+    // Operand bytes follow the opcode in operand order
+    for (int i = 0; i < insn->operand_count; i++)
     {
-        const char *ops[] = {"ADD", "ADC", "SUB", "SBC", "AND", "XOR", "OR", "CP"};
-        const char *regs[] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
-        uint8_t op = (opcode >> 3) & 0x07;
-        uint8_t reg = opcode & 0x07;
-        snprintf(instr_buf, sizeof(instr_buf), "%s A, %s", ops[op], regs[reg]);
-        break;
+        disasm_operand_t *op = &insn->operands[i];
+        switch (op->type)
+        {
+        case DISASM_OPERAND_IMM8:
+        case DISASM_OPERAND_PORT:
+            op->value = bytes[pos++];
+            break;
+        case DISASM_OPERAND_INDEXED:
+            op->value = (uint16_t)(int8_t)bytes[pos++];
+            break;
+        case DISASM_OPERAND_IMM16:
+        case DISASM_OPERAND_MEM_ADDR:
+            op->value = (uint16_t)(bytes[pos] | (bytes[pos + 1] << 8));
+            pos += 2;
+            break;
+        case DISASM_OPERAND_ADDRESS:
+            if (insn->mnemonic == DISASM_JR || insn->mnemonic == DISASM_DJNZ)
+            {
+                op->value = (uint16_t)(pc + pos + 1 + (int8_t)bytes[pos]);
+                pos++;
+            }
+            else
+            {
+                op->value = (uint16_t)(bytes[pos] | (bytes[pos + 1] << 8));
+                pos += 2;
+            }
+            break;
+        }
     }
 
-    // Control flow and jumps (0xC0-0xFF)
-    case 0xC0:
-        snprintf(instr_buf, sizeof(instr_buf), "RET NZ");
-        break;
-    case 0xC1:
-        snprintf(instr_buf, sizeof(instr_buf), "POP BC");
-        break;
-    case 0xC2:
-        snprintf(instr_buf, sizeof(instr_buf), "JP NZ, %04X", addr);
-        break;
-    case 0xC3:
-        snprintf(instr_buf, sizeof(instr_buf), "JP %04X", addr);
-        break;
-    case 0xC4:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL NZ, %04X", addr);
-        break;
-    case 0xC5:
-        snprintf(instr_buf, sizeof(instr_buf), "PUSH BC");
-        break;
-    case 0xC6:
-        snprintf(instr_buf, sizeof(instr_buf), "ADD A, %02X", operand);
-        break;
-    case 0xC7:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 00");
-        break;
-    case 0xC8:
-        snprintf(instr_buf, sizeof(instr_buf), "RET Z");
-        break;
-    case 0xC9:
-        snprintf(instr_buf, sizeof(instr_buf), "RET");
-        break;
-    case 0xCA:
-        snprintf(instr_buf, sizeof(instr_buf), "JP Z, %04X", addr);
-        break;
-    case 0xCB:
+    insn->length = (uint8_t)pos;
+    return pos;
+}
+
+/**
+ * Format one operand
+ */
+static int format_operand(const disasm_operand_t *op, char *buf, size_t size)
+{
+    switch (op->type)
     {
-        uint8_t cb_opcode = operand;
-        snprintf(instr_buf, sizeof(instr_buf), "CB %s", decode_cb_instruction(cb_opcode));
-        break;
-    }
-    case 0xCC:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL Z, %04X", addr);
-        break;
-    case 0xCD:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL %04X", addr);
-        break;
-    case 0xCE:
-        snprintf(instr_buf, sizeof(instr_buf), "ADC A, %02X", operand);
-        break;
-    case 0xCF:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 08");
-        break;
-    case 0xD0:
-        snprintf(instr_buf, sizeof(instr_buf), "RET NC");
-        break;
-    case 0xD1:
-        snprintf(instr_buf, sizeof(instr_buf), "POP DE");
-        break;
-    case 0xD2:
-        snprintf(instr_buf, sizeof(instr_buf), "JP NC, %04X", addr);
-        break;
-    case 0xD3:
-        snprintf(instr_buf, sizeof(instr_buf), "OUT %02X, A", operand);
-        break;
-    case 0xD4:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL NC, %04X", addr);
-        break;
-    case 0xD5:
-        snprintf(instr_buf, sizeof(instr_buf), "PUSH DE");
-        break;
-    case 0xD6:
-        snprintf(instr_buf, sizeof(instr_buf), "SUB %02X", operand);
-        break;
-    case 0xD7:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 10");
-        break;
-    case 0xD8:
-        snprintf(instr_buf, sizeof(instr_buf), "RET C");
-        break;
-    case 0xD9:
-        snprintf(instr_buf, sizeof(instr_buf), "EXX");
-        break;
-    case 0xDA:
-        snprintf(instr_buf, sizeof(instr_buf), "JP C, %04X", addr);
-        break;
-    case 0xDB:
-        snprintf(instr_buf, sizeof(instr_buf), "IN A, %02X", operand);
-        break;
-    case 0xDC:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL C, %04X", addr);
-        break;
-    case 0xDD:
+    case DISASM_OPERAND_REG8:
+        return snprintf(buf, size, "%s", reg8_names[op->reg]);
+    case DISASM_OPERAND_REG16:
+        return snprintf(buf, size, "%s", reg16_names[op->reg]);
+    case DISASM_OPERAND_IMM8:
+    case DISASM_OPERAND_VECTOR:
+        return snprintf(buf, size, "%02X", op->value);
+    case DISASM_OPERAND_IMM16:
+    case DISASM_OPERAND_ADDRESS:
+        return snprintf(buf, size, "%04X", op->value);
+    case DISASM_OPERAND_MEM_REG:
+        return snprintf(buf, size, "(%s)", reg16_names[op->reg]);
+    case DISASM_OPERAND_MEM_ADDR:
+        return snprintf(buf, size, "(%04X)", op->value);
+    case DISASM_OPERAND_INDEXED:
     {
-        uint8_t dd_opcode = (pc + 1 < SPETTRUM_TOTAL_MEMORY) ? emulator->memory[pc + 1] : 0;
-        const char *dd_instr = decode_dd_instruction(dd_opcode, emulator->memory, pc);
-        snprintf(instr_buf, sizeof(instr_buf), "DD %02X %s", dd_opcode, dd_instr);
-        break;
+        int d = (int16_t)op->value;
+        return snprintf(buf, size, "(%s%c%02X)", reg16_names[op->reg], d < 0 ? '-' : '+', d < 0 ? -d : d);
     }
-    case 0xDE:
-        snprintf(instr_buf, sizeof(instr_buf), "SBC A, %02X", operand);
-        break;
-    case 0xDF:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 18");
-        break;
-    case 0xE0:
-        snprintf(instr_buf, sizeof(instr_buf), "RET PO");
-        break;
-    case 0xE1:
-        snprintf(instr_buf, sizeof(instr_buf), "POP HL");
-        break;
-    case 0xE2:
-        snprintf(instr_buf, sizeof(instr_buf), "JP PO, %04X", addr);
-        break;
-    case 0xE3:
-        snprintf(instr_buf, sizeof(instr_buf), "EX (SP), HL");
-        break;
-    case 0xE4:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL PO, %04X", addr);
-        break;
-    case 0xE5:
-        snprintf(instr_buf, sizeof(instr_buf), "PUSH HL");
-        break;
-    case 0xE6:
-        snprintf(instr_buf, sizeof(instr_buf), "AND %02X", operand);
-        break;
-    case 0xE7:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 20");
-        break;
-    case 0xE8:
-        snprintf(instr_buf, sizeof(instr_buf), "RET PE");
-        break;
-    case 0xE9:
-        snprintf(instr_buf, sizeof(instr_buf), "JP (HL)");
-        break;
-    case 0xEA:
-        snprintf(instr_buf, sizeof(instr_buf), "JP PE, %04X", addr);
-        break;
-    case 0xEB:
-        snprintf(instr_buf, sizeof(instr_buf), "EX DE, HL");
-        break;
-    case 0xEC:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL PE, %04X", addr);
-        break;
-    case 0xED:
-    {
-        uint8_t ed_opcode = operand;
-        const char *ed_instr = decode_ed_instruction(ed_opcode);
-        snprintf(instr_buf, sizeof(instr_buf), "ED %s", ed_instr);
-        break;
+    case DISASM_OPERAND_PORT:
+        return snprintf(buf, size, "(%02X)", op->value);
+    case DISASM_OPERAND_PORT_C:
+        return snprintf(buf, size, "(C)");
+    case DISASM_OPERAND_NUMBER:
+        return snprintf(buf, size, "%d", op->value);
+    case DISASM_OPERAND_COND:
+        return snprintf(buf, size, "%s", cond_names[op->reg]);
+    default:
+        if (size > 0)
+            buf[0] = '\0';
+        return 0;
     }
-    case 0xEE:
-        snprintf(instr_buf, sizeof(instr_buf), "XOR %02X", operand);
-        break;
-    case 0xEF:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 28");
-        break;
-    case 0xF0:
-        snprintf(instr_buf, sizeof(instr_buf), "RET P");
-        break;
-    case 0xF1:
-        snprintf(instr_buf, sizeof(instr_buf), "POP AF");
-        break;
-    case 0xF2:
-        snprintf(instr_buf, sizeof(instr_buf), "JP P, %04X", addr);
-        break;
-    case 0xF3:
-        snprintf(instr_buf, sizeof(instr_buf), "DI");
-        break;
-    case 0xF4:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL P, %04X", addr);
-        break;
-    case 0xF5:
-        snprintf(instr_buf, sizeof(instr_buf), "PUSH AF");
-        break;
-    case 0xF6:
-        snprintf(instr_buf, sizeof(instr_buf), "OR %02X", operand);
-        break;
-    case 0xF7:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 30");
-        break;
-    case 0xF8:
-        snprintf(instr_buf, sizeof(instr_buf), "RET M");
-        break;
-    case 0xF9:
-        snprintf(instr_buf, sizeof(instr_buf), "LD SP, HL");
-        break;
-    case 0xFA:
-        snprintf(instr_buf, sizeof(instr_buf), "JP M, %04X", addr);
-        break;
-    case 0xFB:
-        snprintf(instr_buf, sizeof(instr_buf), "EI");
-        break;
-    case 0xFC:
-        snprintf(instr_buf, sizeof(instr_buf), "CALL M, %04X", addr);
-        break;
-    case 0xFD:
+}
+
+/**
+ * Format a decoded instruction as text
+ */
+int disasm_format(const disasm_insn_t *insn, char *buf, size_t size)
+{
+    char text[64];
+    size_t len = (size_t)snprintf(text, sizeof(text), "%s", disasm_mnemonic_name(insn->mnemonic));
+
+    for (int i = 0; i < insn->operand_count && len < sizeof(text); i++)
     {
-        uint8_t fd_opcode = (pc + 1 < SPETTRUM_TOTAL_MEMORY) ? emulator->memory[pc + 1] : 0;
-        const char *fd_instr = decode_fd_instruction(fd_opcode, emulator->memory, pc);
-        snprintf(instr_buf, sizeof(instr_buf), "FD %02X %s", fd_opcode, fd_instr);
-        break;
+        len += (size_t)snprintf(text + len, sizeof(text) - len, i == 0 ? " " : ", ");
+        if (len < sizeof(text))
+            len += (size_t)format_operand(&insn->operands[i], text + len, sizeof(text) - len);
     }
-    case 0xFE:
-        snprintf(instr_buf, sizeof(instr_buf), "CP %02X", operand);
-        break;
-    case 0xFF:
-        snprintf(instr_buf, sizeof(instr_buf), "RST 38");
-        break;
+    return snprintf(buf, size, "%s", text);
+}
+
+/**
+ * Get the text of a mnemonic id
+ */
+const char *disasm_mnemonic_name(uint8_t mnemonic)
+{
+    return mnemonic < DISASM_MNEMONIC_COUNT ? mnemonic_names[mnemonic] : "???";
+}
+
+/**
+ * Create an empty decode cache for a 64KB address space
+ */
+disasm_cache_t *disasm_cache_create(void)
+{
+    disasm_cache_t *cache = (disasm_cache_t *)calloc(1, sizeof(disasm_cache_t));
+    if (!cache)
+        fprintf(stderr, "Error: Memory allocation failed for disassembly cache\n");
+    return cache;
+}
 
-        // All cases handled - should never reach default
+/**
+ * Destroy a decode cache
+ */
+void disasm_cache_destroy(disasm_cache_t *cache)
+{
+    free(cache);
+}
+
+/**
+ * Decode the instruction at an address through the cache
+ */
+const disasm_insn_t *disasm_cache_decode(disasm_cache_t *cache, const uint8_t *memory, uint16_t pc)
+{
+    disasm_insn_t *insn = &cache->entries[pc];
+
+    // Still valid while memory holds the bytes it was decoded from
+    if (insn->length > 0)
+    {
+        int i = 0;
+        while (i < insn->length && memory[(uint16_t)(pc + i)] == insn->bytes[i])
+            i++;
+        if (i == insn->length)
+            return insn;
     }
 
+    uint8_t bytes[DISASM_MAX_LENGTH];
+    for (int i = 0; i < DISASM_MAX_LENGTH; i++)
+        bytes[i] = memory[(uint16_t)(pc + i)];
+    disasm_decode(bytes, pc, insn);
+    return insn;
+}
+
+/**
+ * Print one trace record as disassembly with register state and actual operand values
+ */
+void disasm_print_record(FILE *out, const trace_record_t *record)
+{
+    if (!out || !record)
+        return;
+
+    const trace_record_t *regs = record;
+    uint16_t pc = record->pc;
+    uint8_t opcode = record->bytes[0];
+    disasm_insn_t insn;
+    char instr_buf[64];
+
+    disasm_decode(record->bytes, pc, &insn);
+    disasm_format(&insn, instr_buf, sizeof(instr_buf));
+
+    // Operand bytes for the memory access info below
+    uint8_t operand = record->bytes[1];
+    uint16_t addr = record->bytes[1] | (record->bytes[2] << 8);
+
     // Decode flags: S Z H P/V N C (uppercase = 1, lowercase = 0)
     char flags[16];
+    uint8_t f = record->f;
     snprintf(flags, sizeof(flags), "%c%c%c%c%c%c",
-             (regs->sf) ? 'S' : 's',
-             (regs->zf) ? 'Z' : 'z',
-             (regs->hf) ? 'H' : 'h',
-             (regs->pf) ? 'P' : 'p',
-             (regs->nf) ? 'N' : 'n',
-             (regs->cf) ? 'C' : 'c');
+             (f & Z80_FLAG_S) ? 'S' : 's',
+             (f & Z80_FLAG_Z) ? 'Z' : 'z',
+             (f & Z80_FLAG_H) ? 'H' : 'h',
+             (f & Z80_FLAG_PV) ? 'P' : 'p',
+             (f & Z80_FLAG_N) ? 'N' : 'n',
+             (f & Z80_FLAG_C) ? 'C' : 'c');
 
-    // Add memory access info for certain instructions
+    // Add memory access info for certain instructions, from the registers after execution
     char mem_info[64] = "";
     uint16_t bc = (regs->b << 8) | regs->c;
     uint16_t de = (regs->d << 8) | regs->e;
@@ -1200,14 +673,17 @@ void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uin
     {
     // POP instructions - show what was popped
     case 0xC1: // POP BC
+        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", bc);
+        break;
     case 0xD1: // POP DE
+        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", de);
+        break;
     case 0xE1: // POP HL
+        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", hl);
+        break;
     case 0xF1: // POP AF
-    {
-        uint16_t val = emulator->memory[regs->sp] | (emulator->memory[regs->sp + 1] << 8);
-        snprintf(mem_info, sizeof(mem_info), " [SP]=%04X", val);
+        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", (regs->a << 8) | f);
         break;
-    }
     // PUSH instructions - show what will be pushed
     case 0xC5: // PUSH BC
         snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", bc);
@@ -1219,7 +695,7 @@ void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uin
         snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", hl);
         break;
     case 0xF5: // PUSH AF
-        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", (regs->a << 8) | get_f(z80));
+        snprintf(mem_info, sizeof(mem_info), " [SP-2]=%04X", (regs->a << 8) | f);
         break;
     // LD (addr), reg - show what's being written
     case 0x02: // LD (BC), A
@@ -1272,27 +748,39 @@ void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uin
     }
     // LD reg, (addr) - show what's being read
     case 0x0A: // LD A, (BC)
-        snprintf(mem_info, sizeof(mem_info), " [BC]=%02X", emulator->memory[bc]);
+        snprintf(mem_info, sizeof(mem_info), " [BC]=%02X", regs->a);
         break;
     case 0x1A: // LD A, (DE)
-        snprintf(mem_info, sizeof(mem_info), " [DE]=%02X", emulator->memory[de]);
+        snprintf(mem_info, sizeof(mem_info), " [DE]=%02X", regs->a);
         break;
     case 0x3A: // LD A, (nn)
-        snprintf(mem_info, sizeof(mem_info), " [%04X]=%02X", addr, emulator->memory[addr]);
+        snprintf(mem_info, sizeof(mem_info), " [%04X]=%02X", addr, regs->a);
+        break;
+    case 0x46: // LD B, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->b);
+        break;
+    case 0x4E: // LD C, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->c);
+        break;
+    case 0x56: // LD D, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->d);
+        break;
+    case 0x5E: // LD E, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->e);
+        break;
+    case 0x66: // LD H, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->h);
+        break;
+    case 0x6E: // LD L, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->l);
         break;
-    case 0x46:
-    case 0x4E:
-    case 0x56:
-    case 0x5E: // LD r, (HL)
-    case 0x66:
-    case 0x6E:
-    case 0x7E:
-        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", emulator->memory[hl]);
+    case 0x7E: // LD A, (HL)
+        snprintf(mem_info, sizeof(mem_info), " [HL]=%02X", regs->a);
         break;
     }
 
     // Format: PC: opcode instruction ; registers with decoded flags
-    fprintf(emulator->disasm_file, "%04X: %02X %-28s ; A=%02X F=%s BC=%04X DE=%04X HL=%04X IX=%04X IY=%04X SP=%04X%s\n",
+    fprintf(out, "%04X: %02X %-28s ; A=%02X F=%s BC=%04X DE=%04X HL=%04X IX=%04X IY=%04X SP=%04X%s\n",
             pc, opcode, instr_buf,
             regs->a, flags,
             bc, de, hl,
@@ -1300,5 +788,4 @@ void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uin
             regs->iy,
             regs->sp,
             mem_info);
-    fflush(emulator->disasm_file);
 }
@@ -1,9 +1,265 @@
+/**
+ * Z80 Disassembler for Spettrum
+ *
+ * A single table-driven decoder shared by the trace viewer, the step-mode
+ * debugger and profilers. disasm_decode() turns the bytes of one instruction
+ * into a disasm_insn_t (length, mnemonic id, operands) in a caller-provided
+ * buffer; text is only produced when disasm_format() is called. The decoder
+ * keeps no per-call state, so it is safe to use from several threads.
+ *
+ * Decoding is a lookup in tables built once on first use: one per opcode
+ * page (unprefixed, CB, ED). DD/FD forms are the unprefixed entries with HL
+ * replaced by IX/IY, and DD CB/FD CB the CB entries on (IX+d)/(IY+d).
+ *
+ * A disasm_cache_t remembers the decoded instruction at every address of a
+ * 64KB memory image. Each entry keeps the bytes it was decoded from and is
+ * dropped as soon as memory no longer holds them, so writes to code (self-
+ * modifying code, tape loads, snapshots) never return a stale decode.
+ */
+
 #ifndef DISASM_H
 #define DISASM_H
 
 #include <stdint.h>
-#include "main.h"
+#include <stddef.h>
+#include <stdio.h>
+#include "trace.h"
+
+// Longest Z80 instruction in bytes
+#define DISASM_MAX_LENGTH 4
+
+// Most operands of one instruction (undocumented "RES b, (IX+d), r")
+#define DISASM_MAX_OPERANDS 3
+
+/**
+ * Mnemonic ids
+ */
+typedef enum
+{
+    DISASM_DB = 0, // Not an instruction: bytes shown as data
+    DISASM_NOP,
+    DISASM_LD,
+    DISASM_INC,
+    DISASM_DEC,
+    DISASM_RLCA,
+    DISASM_RRCA,
+    DISASM_RLA,
+    DISASM_RRA,
+    DISASM_DAA,
+    DISASM_CPL,
+    DISASM_SCF,
+    DISASM_CCF,
+    DISASM_EX,
+    DISASM_EXX,
+    DISASM_DJNZ,
+    DISASM_JR,
+    DISASM_JP,
+    DISASM_CALL,
+    DISASM_RET,
+    DISASM_RETI,
+    DISASM_RETN,
+    DISASM_RST,
+    DISASM_PUSH,
+    DISASM_POP,
+    DISASM_ADD,
+    DISASM_ADC,
+    DISASM_SUB,
+    DISASM_SBC,
+    DISASM_AND,
+    DISASM_XOR,
+    DISASM_OR,
+    DISASM_CP,
+    DISASM_HALT,
+    DISASM_DI,
+    DISASM_EI,
+    DISASM_IN,
+    DISASM_OUT,
+    DISASM_RLC,
+    DISASM_RRC,
+    DISASM_RL,
+    DISASM_RR,
+    DISASM_SLA,
+    DISASM_SRA,
+    DISASM_SLL,
+    DISASM_SRL,
+    DISASM_BIT,
+    DISASM_RES,
+    DISASM_SET,
+    DISASM_NEG,
+    DISASM_IM,
+    DISASM_RRD,
+    DISASM_RLD,
+    DISASM_LDI,
+    DISASM_CPI,
+    DISASM_INI,
+    DISASM_OUTI,
+    DISASM_LDD,
+    DISASM_CPD,
+    DISASM_IND,
+    DISASM_OUTD,
+    DISASM_LDIR,
+    DISASM_CPIR,
+    DISASM_INIR,
+    DISASM_OTIR,
+    DISASM_LDDR,
+    DISASM_CPDR,
+    DISASM_INDR,
+    DISASM_OTDR,
+    DISASM_MNEMONIC_COUNT
+} disasm_mnemonic_t;
+
+/**
+ * Operand kinds
+ */
+typedef enum
+{
+    DISASM_OPERAND_NONE = 0,
+    DISASM_OPERAND_REG8,     // reg: disasm_reg8_t
+    DISASM_OPERAND_REG16,    // reg: disasm_reg16_t
+    DISASM_OPERAND_IMM8,     // value: immediate byte
+    DISASM_OPERAND_IMM16,    // value: immediate word
+    DISASM_OPERAND_ADDRESS,  // value: jump, call or relative branch target
+    DISASM_OPERAND_MEM_REG,  // (reg): register pair indirect, reg: disasm_reg16_t
+    DISASM_OPERAND_MEM_ADDR, // (value): absolute memory address
+    DISASM_OPERAND_INDEXED,  // (reg+value): reg is IX or IY, value the signed displacement
+    DISASM_OPERAND_PORT,     // (value): immediate port
+    DISASM_OPERAND_PORT_C,   // (C)
+    DISASM_OPERAND_NUMBER,   // value: bit number, interrupt mode or the 0 of OUT (C), 0
+    DISASM_OPERAND_VECTOR,   // value: RST target
+    DISASM_OPERAND_COND      // reg: disasm_cond_t
+} disasm_operand_type_t;
+
+/**
+ * 8-bit registers
+ */
+typedef enum
+{
+    DISASM_REG_B = 0,
+    DISASM_REG_C,
+    DISASM_REG_D,
+    DISASM_REG_E,
+    DISASM_REG_H,
+    DISASM_REG_L,
+    DISASM_REG_A,
+    DISASM_REG_I,
+    DISASM_REG_R,
+    DISASM_REG_IXH,
+    DISASM_REG_IXL,
+    DISASM_REG_IYH,
+    DISASM_REG_IYL
+} disasm_reg8_t;
+
+/**
+ * Register pairs
+ */
+typedef enum
+{
+    DISASM_REG_BC = 0,
+    DISASM_REG_DE,
+    DISASM_REG_HL,
+    DISASM_REG_SP,
+    DISASM_REG_AF,
+    DISASM_REG_AF_ALT,
+    DISASM_REG_IX,
+    DISASM_REG_IY
+} disasm_reg16_t;
+
+/**
+ * Branch conditions (in opcode order)
+ */
+typedef enum
+{
+    DISASM_COND_NZ = 0,
+    DISASM_COND_Z,
+    DISASM_COND_NC,
+    DISASM_COND_C,
+    DISASM_COND_PO,
+    DISASM_COND_PE,
+    DISASM_COND_P,
+    DISASM_COND_M
+} disasm_cond_t;
+
+/**
+ * One operand
+ */
+typedef struct
+{
+    uint8_t type;   // disasm_operand_type_t
+    uint8_t reg;    // Register, register pair or condition
+    uint16_t value; // Immediate, address, port, displacement, bit, mode or vector
+} disasm_operand_t;
+
+/**
+ * Decoded instruction
+ */
+typedef struct
+{
+    uint8_t length;        // Bytes used, 1 to DISASM_MAX_LENGTH (0 = empty cache entry)
+    uint8_t mnemonic;      // disasm_mnemonic_t
+    uint8_t operand_count; // Operands used
+    uint8_t bytes[DISASM_MAX_LENGTH]; // Instruction bytes (only length are meaningful)
+    disasm_operand_t operands[DISASM_MAX_OPERANDS];
+} disasm_insn_t;
+
+/**
+ * Per-address decode cache
+ */
+typedef struct disasm_cache_s disasm_cache_t;
+
+/**
+ * Decode one instruction
+ * @param bytes DISASM_MAX_LENGTH bytes starting at the instruction
+ * @param pc Address of the instruction (for relative branch targets)
+ * @param insn Receives the decoded instruction
+ * @return Instruction length in bytes
+ */
+int disasm_decode(const uint8_t *bytes, uint16_t pc, disasm_insn_t *insn);
+
+/**
+ * Format a decoded instruction as text, e.g. "LD (IX+05), 3E"
+ * @param insn Decoded instruction
+ * @param buf Output buffer
+ * @param size Size of buf
+ * @return Length of the full text, as snprintf()
+ */
+int disasm_format(const disasm_insn_t *insn, char *buf, size_t size);
+
+/**
+ * Get the text of a mnemonic id
+ * @param mnemonic disasm_mnemonic_t value
+ * @return Mnemonic, or "???" if out of range
+ */
+const char *disasm_mnemonic_name(uint8_t mnemonic);
+
+/**
+ * Create an empty decode cache for a 64KB address space
+ * A cache is not locked: use one per thread.
+ * @return Cache, or NULL on allocation failure
+ */
+disasm_cache_t *disasm_cache_create(void);
+
+/**
+ * Destroy a decode cache
+ * @param cache Cache (NULL is ignored)
+ */
+void disasm_cache_destroy(disasm_cache_t *cache);
+
+/**
+ * Decode the instruction at an address through the cache
+ * @param cache Cache
+ * @param memory 64KB memory image the cache describes
+ * @param pc Address of the instruction
+ * @return Decoded instruction, valid until the next call for the same address
+ */
+const disasm_insn_t *disasm_cache_decode(disasm_cache_t *cache, const uint8_t *memory, uint16_t pc);
 
-void log_instruction_disassembly(spettrum_emulator_t *emulator, uint16_t pc, uint8_t opcode);
+/**
+ * Print one trace record as a line of disassembly
+ * Operand values shown for loads and POPs come from the registers the record
+ * captured after the instruction, so no memory image is needed.
+ * @param out Output stream
+ * @param record Record to print
+ */
+void disasm_print_record(FILE *out, const trace_record_t *record);
 
-#endif
\ No newline at end of file
+#endif
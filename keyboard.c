@@ -17,6 +17,16 @@
  * Row 7 (0x7F): SPACE, SYMBOL SHIFT, M, N, B
  *
  * Host keyboard is mapped to Spectrum keys via character matching.
+ *
+ * Threads: the input thread owns stdin. It translates every character into
+ * a set of matrix keys and queues it (lock-free ring, single producer and
+ * consumer); host control keys go to a second ring. The emulation thread
+ * applies queued presses in keyboard_frame(), releases keys after
+ * KEY_HOLD_FRAMES emulated frames, and publishes the pressed keys as one
+ * 64-bit word: byte r holds half-row r, bit c column c (1 = pressed).
+ *
+ * All state lives in a keyboard_t per machine; only the machine attached to
+ * the host terminal starts an input thread.
  */
 
 #include "keyboard.h"
@@ -24,137 +34,166 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <termios.h>
-#include <fcntl.h>
-#include <errno.h>
-#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
-// Key state buffer - tracks which ASCII/keycodes are currently pressed
-#define MAX_PRESSED_KEYS 64
-static unsigned char pressed_keys[MAX_PRESSED_KEYS];
-static uint64_t key_timestamps[MAX_PRESSED_KEYS]; // Timestamp when key was added (for auto-release)
-static int num_pressed_keys = 0;
+// Spectrum key codes used by the translation (besides plain characters)
+#define KEY_CAPS_SHIFT 0x10
+#define KEY_SYMBOL_SHIFT 0x11
 
-// Key hold duration in milliseconds before auto-release
-#define KEY_HOLD_TIME_MS 100
+// Presses held at once (each a set of matrix keys)
+#define MAX_HELD_PRESSES 64
 
-// Last row selector written via OUT (C), B
-static uint8_t current_row_selector = 0xFF; // Start with no row selected
+// Queued events between the input thread and the emulation thread (power of 2)
+#define KEYBOARD_QUEUE_SIZE 64
+#define KEYBOARD_QUEUE_MASK (KEYBOARD_QUEUE_SIZE - 1)
+
+// Input thread wake-up interval to notice keyboard_cleanup()
+#define INPUT_POLL_MS 50
 
 /**
- * Get current time in milliseconds
+ * Single-producer/single-consumer ring of 64-bit items
  */
-static uint64_t get_time_ms(void)
+typedef struct
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
-}
+    uint64_t items[KEYBOARD_QUEUE_SIZE];
+    atomic_uint head; // Write index (input thread)
+    atomic_uint tail; // Read index (emulation thread)
+} key_queue_t;
 
 /**
- * Update the row selector (called when CPU executes OUT to port 0xFE)
- * The upper byte of the port address contains the row selector bits
+ * A held press: matrix keys and the frame they are released at
  */
-void keyboard_set_row_selector(uint8_t row_selector)
+typedef struct
 {
-    current_row_selector = row_selector;
+    uint64_t keys;
+    uint64_t release_frame;
+} held_press_t;
+
+/**
+ * Keyboard of one machine
+ */
+struct keyboard_s
+{
+    // Matrix published to port reads (emulation thread writes, anyone reads)
+    _Atomic uint64_t key_matrix;
+
+    // Held presses (emulation thread only)
+    held_press_t held_presses[MAX_HELD_PRESSES];
+    int num_held_presses;
+    uint64_t keyboard_frames; // Emulated frames since keyboard_init()
+
+    // Input thread to emulation thread
+    key_queue_t press_queue;
+    key_queue_t control_queue;
+    pthread_t input_thread;
+    bool input_thread_running;
+    atomic_bool input_thread_stop;
+
+    // Last row selector written via OUT (C), B
+    uint8_t current_row_selector;
+};
+
+/**
+ * Queue an item; returns 0 if the ring is full
+ */
+static int key_queue_push(key_queue_t *queue, uint64_t item)
+{
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned next = (head + 1) & KEYBOARD_QUEUE_MASK;
+    if (next == atomic_load_explicit(&queue->tail, memory_order_acquire))
+        return 0;
+    queue->items[head] = item;
+    atomic_store_explicit(&queue->head, next, memory_order_release);
+    return 1;
 }
 
 /**
- * Get current row selector
+ * Take the oldest item; returns 0 if the ring is empty
  */
-uint8_t keyboard_get_row_selector(void)
+static int key_queue_pop(key_queue_t *queue, uint64_t *item)
+{
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&queue->head, memory_order_acquire))
+        return 0;
+    *item = queue->items[tail];
+    atomic_store_explicit(&queue->tail, (tail + 1) & KEYBOARD_QUEUE_MASK, memory_order_release);
+    return 1;
+}
+
+static void key_queue_reset(key_queue_t *queue)
 {
-    return current_row_selector;
+    atomic_store(&queue->head, 0);
+    atomic_store(&queue->tail, 0);
 }
 
 /**
- * Check if a key is currently in the pressed set
+ * Matrix bit of a Spectrum key code (0 if the code is not a key)
+ * Letters match either case; ENTER is CR or LF.
  */
-static int is_key_pressed_state(unsigned char key)
+static uint64_t key_mask(unsigned char key)
 {
-    for (int i = 0; i < num_pressed_keys; i++)
-    {
-        if (pressed_keys[i] == key)
-            return 1;
-    }
+    // Keys of each half-row, column 0 first
+    static const char rows[8][5] = {
+        {KEY_CAPS_SHIFT, 'z', 'x', 'c', 'v'},
+        {'a', 's', 'd', 'f', 'g'},
+        {'q', 'w', 'e', 'r', 't'},
+        {'1', '2', '3', '4', '5'},
+        {'0', '9', '8', '7', '6'},
+        {'p', 'o', 'i', 'u', 'y'},
+        {'\r', 'l', 'k', 'j', 'h'},
+        {' ', KEY_SYMBOL_SHIFT, 'm', 'n', 'b'}};
+
+    if (key >= 'A' && key <= 'Z')
+        key = (unsigned char)(key + 32);
+    if (key == '\n')
+        key = '\r';
+
+    for (int row = 0; row < 8; row++)
+        for (int col = 0; col < 5; col++)
+            if ((unsigned char)rows[row][col] == key)
+                return 1ULL << (row * 8 + col);
     return 0;
 }
 
-// Forward declaration
-static void add_pressed_key(unsigned char key);
-
 /**
  * Translate a character input into appropriate Spectrum key(s)
  * Handles uppercase (via CAPS SHIFT + letter), special characters (via SYMBOL SHIFT + key),
  * and special keys like backspace and arrows.
+ * Returns the matrix keys to press (0 = no Spectrum key)
  */
-static void translate_and_add_key(unsigned char ch)
+static uint64_t translate_key(unsigned char ch)
 {
     // Tab: CAPS SHIFT + SYMBOL SHIFT (Extended Mode)
-    if (ch == '\t' || ch == 0x09) // Tab key
-    {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key(0x11); // SYMBOL SHIFT
-        return;
-    }
+    if (ch == '\t')
+        return key_mask(KEY_CAPS_SHIFT) | key_mask(KEY_SYMBOL_SHIFT);
 
     // Backspace: CAPS SHIFT + 0
     if (ch == 0x08 || ch == 0x7F) // Backspace or DEL
-    {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key('0');
-        return;
-    }
+        return key_mask(KEY_CAPS_SHIFT) | key_mask('0');
 
-    // Arrow keys via CAPS SHIFT + number:
-    // Up: CAPS SHIFT + 7, Down: CAPS SHIFT + 6, Left: CAPS SHIFT + 5, Right: CAPS SHIFT + 8
-    // These are mapped to special key codes for easier terminal handling
-    if (ch == 'A' - 'A' + 1 || ch == 27) // ESC or special escape marker
-    {
-        // This would need special handling for multi-byte escape sequences
-        // For now, we support direct key codes for arrows (if passed from command-line)
-        return;
-    }
+    // ESC: multi-byte escape sequences (terminal arrow keys) are not decoded
+    if (ch == 27)
+        return 0;
 
     // Direct arrow key support via special key codes (for programmatic input)
     // Up arrow: code 128, Down: 129, Left: 130, Right: 131
-    if (ch == 128) // UP
-    {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key('7');
-        return;
-    }
-    if (ch == 129) // DOWN
-    {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key('6');
-        return;
-    }
-    if (ch == 130) // LEFT
-    {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key('5');
-        return;
-    }
-    if (ch == 131) // RIGHT
+    // Up: CAPS SHIFT + 7, Down: CAPS SHIFT + 6, Left: CAPS SHIFT + 5, Right: CAPS SHIFT + 8
+    if (ch >= 128 && ch <= 131)
     {
-        add_pressed_key(0x10); // CAPS SHIFT
-        add_pressed_key('8');
-        return;
+        static const char arrow_keys[4] = {'7', '6', '5', '8'};
+        return key_mask(KEY_CAPS_SHIFT) | key_mask((unsigned char)arrow_keys[ch - 128]);
     }
 
-    // Uppercase letters: add CAPS SHIFT (0x10) + the lowercase letter
+    // Uppercase letters: add CAPS SHIFT + the lowercase letter
     if (ch >= 'A' && ch <= 'Z')
-    {
-        add_pressed_key(0x10);    // CAPS SHIFT
-        add_pressed_key(ch + 32); // Convert to lowercase
-        return;
-    }
+        return key_mask(KEY_CAPS_SHIFT) | key_mask(ch);
 
-    // Special characters mapped via SYMBOL SHIFT (0x11) + their key
+    // Special characters mapped via SYMBOL SHIFT + their key
     // Format: character -> lowercase letter key to press with SYMBOL SHIFT
-    struct
+    static const struct
     {
         unsigned char ch;
         unsigned char key;
@@ -182,100 +221,177 @@ static void translate_and_add_key(unsigned char ch)
         {0, 0}       // Terminator
     };
 
-    // Check special characters
     for (int i = 0; special_chars[i].ch != 0; i++)
     {
         if (ch == special_chars[i].ch)
-        {
-            add_pressed_key(0x11); // SYMBOL SHIFT (represented as 0x11)
-            add_pressed_key(special_chars[i].key);
-            return;
-        }
+            return key_mask(KEY_SYMBOL_SHIFT) | key_mask(special_chars[i].key);
     }
 
-    // Regular character: add as-is (for lowercase letters, digits, space, etc.)
-    add_pressed_key(ch);
+    // Regular character: lowercase letters, digits, space, ENTER, shifts
+    return key_mask(ch);
 }
 
 /**
- * Update key states: remove any keys that have expired (held for KEY_HOLD_TIME_MS)
+ * Hold a press until KEY_HOLD_FRAMES frames from now (emulation thread)
  */
-static void update_key_states(void)
+static void hold_press(keyboard_t *keyboard, uint64_t keys)
 {
-    uint64_t now = get_time_ms();
-    int write_idx = 0;
+    if (keys == 0 || keyboard->num_held_presses >= MAX_HELD_PRESSES)
+        return;
+    held_press_t *press = &keyboard->held_presses[keyboard->num_held_presses++];
+    press->keys = keys;
+    press->release_frame = keyboard->keyboard_frames + KEY_HOLD_FRAMES;
+}
+
+/**
+ * Recompute and publish the matrix from the held presses
+ */
+static void publish_matrix(keyboard_t *keyboard)
+{
+    uint64_t matrix = 0;
+    for (int i = 0; i < keyboard->num_held_presses; i++)
+        matrix |= keyboard->held_presses[i].keys;
+    atomic_store_explicit(&keyboard->key_matrix, matrix, memory_order_release);
+}
+
+/**
+ * Input thread: read stdin, queue Spectrum presses and control keys
+ */
+static void *keyboard_input_thread(void *arg)
+{
+    keyboard_t *keyboard = (keyboard_t *)arg;
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
 
-    for (int i = 0; i < num_pressed_keys; i++)
+    while (!atomic_load_explicit(&keyboard->input_thread_stop, memory_order_acquire))
     {
-        // Check if this key has expired
-        if (now - key_timestamps[i] < KEY_HOLD_TIME_MS)
+        if (poll(&pfd, 1, INPUT_POLL_MS) <= 0)
+            continue;
+
+        unsigned char buf[64];
+        ssize_t nread = read(STDIN_FILENO, buf, sizeof(buf));
+        if (nread <= 0)
+            break; // End of input (or error): nothing more to read
+
+        for (ssize_t i = 0; i < nread; i++)
         {
-            // Keep this key
-            pressed_keys[write_idx] = pressed_keys[i];
-            key_timestamps[write_idx] = key_timestamps[i];
-            write_idx++;
+            if (keyboard_is_control_key(buf[i]))
+                key_queue_push(&keyboard->control_queue, buf[i]);
+            else
+                key_queue_push(&keyboard->press_queue, translate_key(buf[i]));
         }
     }
+    return NULL;
+}
+
+/**
+ * Update the row selector (called when CPU executes OUT to port 0xFE)
+ * The upper byte of the port address contains the row selector bits
+ */
+void keyboard_set_row_selector(keyboard_t *keyboard, uint8_t row_selector)
+{
+    keyboard->current_row_selector = row_selector;
+}
+
+/**
+ * Get current row selector
+ */
+uint8_t keyboard_get_row_selector(const keyboard_t *keyboard)
+{
+    return keyboard->current_row_selector;
+}
+
+/**
+ * Initialize keyboard
+ */
+keyboard_t *keyboard_init(void)
+{
+    keyboard_t *keyboard = calloc(1, sizeof(keyboard_t));
+    if (!keyboard)
+        return NULL;
+
+    keyboard->current_row_selector = 0xFF; // Start with no row selected
+    key_queue_reset(&keyboard->press_queue);
+    key_queue_reset(&keyboard->control_queue);
+    atomic_init(&keyboard->key_matrix, 0);
+    atomic_init(&keyboard->input_thread_stop, false);
 
-    num_pressed_keys = write_idx;
+    return keyboard;
 }
 
 /**
- * Add a key to the pressed set (simulated key press)
- * Keys will auto-release after KEY_HOLD_TIME_MS
+ * Start the input thread
  */
-static void add_pressed_key(unsigned char key)
+int keyboard_start_input(keyboard_t *keyboard)
 {
-    if (num_pressed_keys < MAX_PRESSED_KEYS)
+    if (keyboard->input_thread_running)
+        return 0;
+
+    atomic_store(&keyboard->input_thread_stop, false);
+    if (pthread_create(&keyboard->input_thread, NULL, keyboard_input_thread, keyboard) != 0)
     {
-        // Check if already present
-        if (!is_key_pressed_state(key))
-        {
-            pressed_keys[num_pressed_keys] = key;
-            key_timestamps[num_pressed_keys] = get_time_ms();
-            num_pressed_keys++;
-        }
+        fprintf(stderr, "Error: Failed to create keyboard input thread\n");
+        return -1;
     }
+    keyboard->input_thread_running = true;
+    return 0;
 }
 
 /**
- * Poll stdin and update pressed key state (non-blocking)
- * This allows the emulator to simulate keyboard input from the terminal
+ * Cleanup keyboard
  */
-static void keyboard_poll_stdin(void)
+void keyboard_cleanup(keyboard_t *keyboard)
 {
-    unsigned char ch;
-    int nread;
+    if (!keyboard)
+        return;
 
-    while (1)
+    if (keyboard->input_thread_running)
     {
-        nread = read(STDIN_FILENO, &ch, 1);
-        if (nread != 1)
-            break; // No more input available
-
-        // Translate the input character to appropriate Spectrum key(s)
-        translate_and_add_key(ch);
+        atomic_store_explicit(&keyboard->input_thread_stop, true, memory_order_release);
+        pthread_join(keyboard->input_thread, NULL);
     }
+    free(keyboard);
 }
 
 /**
- * Initialize keyboard
+ * Advance the keyboard by one emulated frame
  */
-int keyboard_init(void)
+void keyboard_frame(keyboard_t *keyboard)
 {
-    current_row_selector = 0xFF;
-    num_pressed_keys = 0;
+    keyboard->keyboard_frames++;
 
-    return 0;
+    // Release presses that have been held long enough
+    int write_idx = 0;
+    for (int i = 0; i < keyboard->num_held_presses; i++)
+    {
+        if (keyboard->held_presses[i].release_frame > keyboard->keyboard_frames)
+            keyboard->held_presses[write_idx++] = keyboard->held_presses[i];
+    }
+    keyboard->num_held_presses = write_idx;
+
+    // Apply presses typed since the last frame
+    uint64_t keys;
+    while (key_queue_pop(&keyboard->press_queue, &keys))
+        hold_press(keyboard, keys);
+
+    publish_matrix(keyboard);
 }
 
 /**
- * Cleanup keyboard
+ * Take the next host control key
+ */
+int keyboard_get_control_key(keyboard_t *keyboard)
+{
+    uint64_t key;
+    return key_queue_pop(&keyboard->control_queue, &key) ? (int)key : -1;
+}
+
+/**
+ * Check whether a host character is an emulator control key
  */
-void keyboard_cleanup(void)
+int keyboard_is_control_key(unsigned char ch)
 {
-    num_pressed_keys = 0;
-    current_row_selector = 0xFF;
+    return ch == KEYBOARD_CTRL_D || ch == KEYBOARD_CTRL_P || ch == KEYBOARD_CTRL_R ||
+           ch == KEYBOARD_CTRL_S || ch == '[' || ch == ']';
 }
 
 /**
@@ -286,11 +402,12 @@ void keyboard_cleanup(void)
  *
  * @param key The ASCII character to simulate as pressed
  */
-void keyboard_set_simulated_key(char key)
+void keyboard_set_simulated_key(keyboard_t *keyboard, char key)
 {
     if (key != 0)
     {
-        translate_and_add_key((unsigned char)key);
+        hold_press(keyboard, translate_key((unsigned char)key));
+        publish_matrix(keyboard);
     }
 }
 
@@ -301,260 +418,29 @@ void keyboard_set_simulated_key(char key)
  *   - Low byte (0xFE): Selects the ULA port
  *   - High byte: Row selector bitmask (from A register)
  *
- * Row selector bits (active-low, each bit selects a row when LOW):
- *   Bit 0 low (0xFE): Row 0 - SHIFT, Z, X, C, V
- *   Bit 1 low (0xFD): Row 1 - A, S, D, F, G
- *   Bit 2 low (0xFB): Row 2 - Q, W, E, R, T
- *   Bit 3 low (0xF7): Row 3 - 1, 2, 3, 4, 5
- *   Bit 4 low (0xEF): Row 4 - 0, 9, 8, 7, 6
- *   Bit 5 low (0xDF): Row 5 - ENTER, L, K, J, H
- *   Bit 6 low (0xBF): Row 6 - SPACE, SYMBOL SHIFT, M, N, B
- *   Bit 7 low (0x7F): Row 7 - P, O, I, U, Y
- *
- * Multiple rows can be selected simultaneously by having multiple bits low.
- * Results from all selected rows are ANDed together.
+ * Each half-row whose selector bit is low contributes its byte of the
+ * matrix; results from all selected rows are ANDed together (ORed as
+ * pressed bits, then inverted).
  *
  * @param port Full 16-bit port address (high byte = row selector)
  * @return 8-bit value: bits 0-4 = key states (0=pressed), bits 5-7 = always 1
  */
-uint8_t keyboard_read_port(uint16_t port)
+uint8_t keyboard_read_port(const keyboard_t *keyboard, uint16_t port)
 {
-    // Start with all keys released (0xFF = 0b11111111)
-    uint8_t result = 0xFF;
-
-    // Extract the row selector from the HIGH byte of the port address
+    uint64_t matrix = atomic_load_explicit(&keyboard->key_matrix, memory_order_acquire);
     uint8_t selector = (port >> 8) & 0xFF;
+    uint8_t pressed = 0;
 
-    // Update key states: remove expired keys
-    update_key_states();
-
-    // Poll stdin for any new key input
-    keyboard_poll_stdin();
+    // Fast path: nothing pressed (almost every scan)
+    if (matrix == 0)
+        return 0xFF;
 
-    // Check each row - multiple rows can be selected at once (when bit is LOW)
-    // Results from all selected rows are ANDed together
-
-    // Row 0: SHIFT, Z, X, C, V (bit 0 is low)
-    if (!(selector & 0x01))
+    for (int row = 0; row < 8; row++)
     {
-        if (is_key_pressed_state(16) || is_key_pressed_state('\x10'))
-            result &= ~0x01; // SHIFT
-        if (is_key_pressed_state('z') || is_key_pressed_state('Z'))
-            result &= ~0x02; // Z
-        if (is_key_pressed_state('x') || is_key_pressed_state('X'))
-            result &= ~0x04; // X
-        if (is_key_pressed_state('c') || is_key_pressed_state('C'))
-            result &= ~0x08; // C
-        if (is_key_pressed_state('v') || is_key_pressed_state('V'))
-            result &= ~0x10; // V
+        if (!(selector & (1 << row)))
+            pressed |= (uint8_t)(matrix >> (row * 8));
     }
 
-    // Row 1: A, S, D, F, G (bit 1 is low)
-    if (!(selector & 0x02))
-    {
-        // Bit 0: A
-        if (is_key_pressed_state('a') || is_key_pressed_state('A'))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: S
-        if (is_key_pressed_state('s') || is_key_pressed_state('S'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: D
-        if (is_key_pressed_state('d') || is_key_pressed_state('D'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: F
-        if (is_key_pressed_state('f') || is_key_pressed_state('F'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: G
-        if (is_key_pressed_state('g') || is_key_pressed_state('G'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 2: Q, W, E, R, T (bit 2 is low)
-    if (!(selector & 0x04))
-    {
-        // Bit 0: Q
-        if (is_key_pressed_state('q') || is_key_pressed_state('Q'))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: W
-        if (is_key_pressed_state('w') || is_key_pressed_state('W'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: E
-        if (is_key_pressed_state('e') || is_key_pressed_state('E'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: R
-        if (is_key_pressed_state('r') || is_key_pressed_state('R'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: T
-        if (is_key_pressed_state('t') || is_key_pressed_state('T'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 3: 1, 2, 3, 4, 5 (bit 3 is low)
-    if (!(selector & 0x08))
-    {
-        // Bit 0: 1
-        if (is_key_pressed_state('1'))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: 2
-        if (is_key_pressed_state('2'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: 3
-        if (is_key_pressed_state('3'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: 4
-        if (is_key_pressed_state('4'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: 5
-        if (is_key_pressed_state('5'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 4: 0, 9, 8, 7, 6 (bit 4 is low)
-    if (!(selector & 0x10))
-    {
-        // Bit 0: 0
-        if (is_key_pressed_state('0'))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: 9
-        if (is_key_pressed_state('9'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: 8
-        if (is_key_pressed_state('8'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: 7
-        if (is_key_pressed_state('7'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: 6
-        if (is_key_pressed_state('6'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 5: P, O, I, U, Y (bit 5 is low)
-    if (!(selector & 0x20))
-    {
-        // Bit 0: P
-        if (is_key_pressed_state('p') || is_key_pressed_state('P'))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: O
-        if (is_key_pressed_state('o') || is_key_pressed_state('O'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: I
-        if (is_key_pressed_state('i') || is_key_pressed_state('I'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: U
-        if (is_key_pressed_state('u') || is_key_pressed_state('U'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: Y
-        if (is_key_pressed_state('y') || is_key_pressed_state('Y'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 6: ENTER, L, K, J, H (bit 6 is low)
-    if (!(selector & 0x40))
-    {
-        // Bit 0: ENTER
-        if (is_key_pressed_state('\r') || is_key_pressed_state('\n') || is_key_pressed_state(13))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: L
-        if (is_key_pressed_state('l') || is_key_pressed_state('L'))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: K
-        if (is_key_pressed_state('k') || is_key_pressed_state('K'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: J
-        if (is_key_pressed_state('j') || is_key_pressed_state('J'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: H
-        if (is_key_pressed_state('h') || is_key_pressed_state('H'))
-        {
-            result &= ~0x10;
-        }
-    }
-    // Row 7: SPACE, SYMBOL SHIFT, M, N, B (bit 7 is low)
-    if (!(selector & 0x80))
-    {
-        // Bit 0: SPACE
-        if (is_key_pressed_state(' '))
-        {
-            result &= ~0x01;
-        }
-        // Bit 1: SYMBOL SHIFT (CTRL on modern keyboards, or 0x11 from character translation)
-        if (is_key_pressed_state(17) || is_key_pressed_state(0x11))
-        {
-            result &= ~0x02;
-        }
-        // Bit 2: M
-        if (is_key_pressed_state('m') || is_key_pressed_state('M'))
-        {
-            result &= ~0x04;
-        }
-        // Bit 3: N
-        if (is_key_pressed_state('n') || is_key_pressed_state('N'))
-        {
-            result &= ~0x08;
-        }
-        // Bit 4: B
-        if (is_key_pressed_state('b') || is_key_pressed_state('B'))
-        {
-            result &= ~0x10;
-        }
-    }
-
-    // Per Spectrum ROM spec, bits 5-7 should be set to 1
-    result |= 0xE0;
-
-    return result;
+    // Per Spectrum ROM spec, bits 5-7 are set to 1
+    return (uint8_t)(~pressed & 0x1F) | 0xE0;
 }
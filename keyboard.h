@@ -23,6 +23,10 @@
  * Row 5 (0xDF - bit 5 low): ENTER, L, K, J, H
  * Row 6 (0xBF - bit 6 low): SPACE, SYMBOL SHIFT, M, N, B
  * Row 7 (0x7F - bit 7 low): (alternate/duplicate)
+ *
+ * Host input is read by a dedicated thread (keyboard_start_input()) and only
+ * reaches the matrix at the next emulated frame (keyboard_frame()), so key
+ * timing follows emulated time at any speed. Port reads never block.
  */
 
 #ifndef KEYBOARD_H
@@ -30,30 +34,56 @@
 
 #include <stdint.h>
 
+/**
+ * Keyboard state of one machine (matrix, held keys, host input queues)
+ */
+typedef struct keyboard_s keyboard_t;
+
+// Emulated frames a typed key stays pressed (100ms at 50Hz)
+#define KEY_HOLD_FRAMES 5
+
+// Host control keys (handled by the emulator, never sent to the Spectrum)
+#define KEYBOARD_CTRL_D 4  // Debug display
+#define KEYBOARD_CTRL_P 16 // Pause
+#define KEYBOARD_CTRL_R 18 // Rewind
+#define KEYBOARD_CTRL_S 19 // Step
+
 /**
  * Initialize keyboard - sets up internal state for keyboard scanning
+ * @return Keyboard with no keys pressed, or NULL on allocation failure
+ */
+keyboard_t *keyboard_init(void);
+
+/**
+ * Start the input thread reading host keys from stdin
+ * The thread runs until keyboard_cleanup() or the end of stdin. Only one
+ * keyboard per process should read the host terminal.
+ * @param keyboard Keyboard receiving the keys
  * @return 0 on success, -1 on error
  */
-int keyboard_init(void);
+int keyboard_start_input(keyboard_t *keyboard);
 
 /**
- * Cleanup keyboard - reset internal state
+ * Cleanup keyboard - stop the input thread and free the keyboard
+ * @param keyboard Keyboard (NULL is ignored)
  */
-void keyboard_cleanup(void);
+void keyboard_cleanup(keyboard_t *keyboard);
 
 /**
  * Set the current row selector (called when CPU executes OUT to port 0xFE)
  *
  * The row selector contains a row mask where one bit is low to select that row.
+ * @param keyboard Keyboard
  * @param row_selector The 8-bit value written to port 0xFE
  */
-void keyboard_set_row_selector(uint8_t row_selector);
+void keyboard_set_row_selector(keyboard_t *keyboard, uint8_t row_selector);
 
 /**
  * Get the current row selector
+ * @param keyboard Keyboard
  * @return The current row selector byte
  */
-uint8_t keyboard_get_row_selector(void);
+uint8_t keyboard_get_row_selector(const keyboard_t *keyboard);
 
 /**
  * Read keyboard state for the currently selected row
@@ -62,6 +92,7 @@ uint8_t keyboard_get_row_selector(void);
  * Returns the key states for whichever row was most recently selected
  * via keyboard_set_row_selector().
  *
+ * @param keyboard Keyboard
  * @param port The full 16-bit port address. For Spectrum keyboard:
  *             - Low byte: 0xFE (ULA port)
  *             - High byte: Row selector bitmask (active-low)
@@ -70,14 +101,37 @@ uint8_t keyboard_get_row_selector(void);
  *         - Bits 0-4: Key states (0=pressed, 1=released)
  *         - Bits 5-7: Always set to 1 (per Spectrum ROM spec)
  */
-uint8_t keyboard_read_port(uint16_t port);
+uint8_t keyboard_read_port(const keyboard_t *keyboard, uint16_t port);
+
+/**
+ * Advance the keyboard by one emulated frame (emulation thread)
+ * Applies keys typed since the previous frame and releases keys held for
+ * KEY_HOLD_FRAMES frames.
+ * @param keyboard Keyboard
+ */
+void keyboard_frame(keyboard_t *keyboard);
+
+/**
+ * Take the next host control key typed (emulation thread)
+ * @param keyboard Keyboard
+ * @return KEYBOARD_CTRL_*, '[' or ']', or -1 if none is pending
+ */
+int keyboard_get_control_key(keyboard_t *keyboard);
+
+/**
+ * Check whether a host character is an emulator control key
+ * @param ch Character read from the host terminal
+ * @return Non-zero for KEYBOARD_CTRL_*, '[' and ']'
+ */
+int keyboard_is_control_key(unsigned char ch);
 
 /**
  * Set a simulated key for testing (for command-line key injection)
- * Adds the key to the pressed set so it will be detected in subsequent scans
+ * Presses the key immediately for KEY_HOLD_FRAMES frames (emulation thread)
  *
+ * @param keyboard Keyboard
  * @param key The ASCII character to simulate as pressed
  */
-void keyboard_set_simulated_key(char key);
+void keyboard_set_simulated_key(keyboard_t *keyboard, char key);
 
 #endif // KEYBOARD_H
@@ -8,29 +8,76 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdarg.h>
 #include <getopt.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
 #include <signal.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <sys/select.h>
+#include <dirent.h>
+#include <strings.h>
 
 #include "z80.h"
 #include "ula.h"
 #include "main.h"
-#include "disasm.h"
+#include "trace.h"
 #include "keyboard.h"
 #include "z80snapshot.h"
 #include "tap.h"
+#include "mapfile.h"
+#include "batch.h"
 
-// Global emulator reference for signal handling
+// Machine attached to the terminal, the target of the signal handlers.
+// Emulator state itself is per instance; --batch runs have none here.
 static spettrum_emulator_t *g_emulator = NULL;
 
+// Set by SIGINT/SIGQUIT to stop a --batch run after the running images
+static volatile sig_atomic_t batch_interrupted = 0;
+
+/**
+ * Read a byte as the CPU sees it, through the current paging
+ */
+static inline uint8_t emulator_peek(const spettrum_emulator_t *emulator, uint16_t addr)
+{
+    return emulator->slots[addr / SPETTRUM_BANK_SIZE][addr % SPETTRUM_BANK_SIZE];
+}
+
+/**
+ * Check whether the address space is the first 64KB of memory as laid out
+ * (always on a 48K; on a 128K while ROM 0 and bank 0 are paged in)
+ */
+static int emulator_is_flat(const spettrum_emulator_t *emulator)
+{
+    return emulator->slots[0] == &emulator->memory[0] &&
+           emulator->slots[3] == &emulator->memory[3 * SPETTRUM_BANK_SIZE];
+}
+
+/**
+ * Get a 64KB image of the address space as the CPU sees it
+ * That is memory itself unless a 128K has other banks paged in; then the
+ * slots are copied into a scratch image. For debugger output only.
+ */
+static const uint8_t *emulator_address_space(spettrum_emulator_t *emulator)
+{
+    if (emulator_is_flat(emulator))
+        return emulator->memory;
+    if (!emulator->view && !(emulator->view = malloc(SPETTRUM_TOTAL_MEMORY)))
+        return emulator->memory;
+    for (int slot = 0; slot < 4; slot++)
+        memcpy(emulator->view + slot * SPETTRUM_BANK_SIZE, emulator->slots[slot], SPETTRUM_BANK_SIZE);
+    return emulator->view;
+}
+
 /**
- * ULA render thread - continuously renders display
+ * ULA render thread - renders each new emulated frame
+ * Frames are the snapshots published at each INT, never live video RAM.
+ * Rendering is capped at 50Hz wall time by ula_render_to_terminal(), so in
+ * turbo mode only the latest frame is shown and the rest are skipped.
  */
 static void *ula_render_thread(void *arg)
 {
@@ -39,11 +86,19 @@ static void *ula_render_thread(void *arg)
     // Render loop - runs while emulator is running
     while (emulator->running)
     {
-        // Convert VRAM to character matrix
-        convert_vram_to_matrix(&emulator->memory[SPETTRUM_VRAM_START], emulator->display->render_mode);
+        // Nothing new to show (paused or running slower than real time)
+        const ula_frame_t *frame = ula_take_frame(emulator->display);
+        if (!frame)
+        {
+            usleep(1000);
+            continue;
+        }
+
+        // Convert the cells that changed since the last shown frame
+        convert_frame_to_matrix(emulator->display, frame, emulator->display->render_mode);
 
         // Render matrix to terminal
-        ula_render_to_terminal();
+        ula_render_to_terminal(emulator->display);
     }
 
     return NULL;
@@ -101,22 +156,30 @@ static void display_debug_info(spettrum_emulator_t *emulator)
 {
     z80_registers_t *regs = &emulator->cpu->regs;
     z80_emulator_t *z80 = emulator->cpu;
+    uint8_t f = get_f(z80);
 
     // Move to line 49 (bottom area)
     printf("\033[49;1H\033[K");
     printf("PC:%04X SP:%04X AF:%04X BC:%04X DE:%04X HL:%04X IX:%04X IY:%04X\n",
-           regs->pc, regs->sp, (regs->a << 8) | get_f(z80),
+           regs->pc, regs->sp, (regs->a << 8) | f,
            (regs->b << 8) | regs->c, (regs->d << 8) | regs->e,
            (regs->h << 8) | regs->l, regs->ix, regs->iy);
 
     printf("\033[50;1H\033[K");
-    printf("Flags: S=%d Z=%d H=%d P=%d N=%d C=%d | Inst:%llu\n",
-           regs->sf, regs->zf, regs->hf, regs->pf, regs->nf, regs->cf,
+    printf("Flags: S=%d Z=%d H=%d P=%d N=%d C=%d | Inst:%" PRIu64 "\n",
+           !!(f & Z80_FLAG_S), !!(f & Z80_FLAG_Z), !!(f & Z80_FLAG_H),
+           !!(f & Z80_FLAG_PV), !!(f & Z80_FLAG_N), !!(f & Z80_FLAG_C),
            emulator->total_instructions);
 
-    // Show last few instructions
+    // Show the next instruction, then the last few opcodes
+    char next[40] = "";
+    if (!emulator->disasm_cache)
+        emulator->disasm_cache = disasm_cache_create();
+    if (emulator->disasm_cache)
+        disasm_format(disasm_cache_decode(emulator->disasm_cache, emulator_address_space(emulator), regs->pc),
+                      next, sizeof(next));
     printf("\033[51;1H\033[K");
-    printf("Last instructions: ");
+    printf("Next: %-20s | Last: ", next);
     for (int i = 0; i < 5; i++)
     {
         int idx = (emulator->history_index - 5 + i + 10) % 10;
@@ -128,6 +191,36 @@ static void display_debug_info(spettrum_emulator_t *emulator)
     fflush(stdout);
 }
 
+/**
+ * Breakpoint or watchpoint hit (--break, --watch): remember it and stop the CPU
+ */
+static int emulator_break_hit(void *user_data, int id, int kind, uint16_t addr)
+{
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)user_data;
+
+    emulator->break_id = id;
+    emulator->break_kind = kind;
+    emulator->break_addr = addr;
+    return 1;
+}
+
+/**
+ * Pause where a breakpoint or watchpoint stopped the CPU and show the hit
+ */
+static void display_break(spettrum_emulator_t *emulator)
+{
+    const char *access = emulator->break_kind == Z80_WATCH_READ    ? "read"
+                         : emulator->break_kind == Z80_WATCH_WRITE ? "write"
+                                                                   : "exec";
+
+    emulator->paused = 1;
+    display_debug_info(emulator);
+    printf("\033[48;1H\033[K[%s %d: %s 0x%04X]\033[48;1H",
+           emulator->break_kind == Z80_WATCH_EXEC ? "Breakpoint" : "Watchpoint",
+           emulator->break_id, access, emulator->break_addr);
+    fflush(stdout);
+}
+
 /**
  * Detect CPU anomalies (warnings collected, displayed after emulation)
  */
@@ -152,7 +245,7 @@ static void check_cpu_anomalies(spettrum_emulator_t *emulator)
 
         const char *area = (pc >= 0x5800) ? "attributes" : "bitmap";
         // Append to warning buffer instead of printing to screen
-        append_warning_buffer(emulator, "  ⚠️  PC in VRAM %s (PC=0x%04X SP=0x%04X) [%llu times]\n",
+        append_warning_buffer(emulator, "  ⚠️  PC in VRAM %s (PC=0x%04X SP=0x%04X) [%" PRIu64 " times]\n",
                               area, pc, sp, emulator->warnings_pc_in_vram);
     }
 
@@ -163,7 +256,7 @@ static void check_cpu_anomalies(spettrum_emulator_t *emulator)
         emulator->last_warn_sp = sp;
         emulator->warn_pc_at_sp_fault = pc;
         // Append to warning buffer instead of printing to screen
-        append_warning_buffer(emulator, "  ⚠️  SP in VRAM (SP=0x%04X PC=0x%04X) [%llu times]\n",
+        append_warning_buffer(emulator, "  ⚠️  SP in VRAM (SP=0x%04X PC=0x%04X) [%" PRIu64 " times]\n",
                               sp, pc, emulator->warnings_sp_in_vram);
     }
 }
@@ -179,7 +272,7 @@ static void display_anomaly_summary(spettrum_emulator_t *emulator)
     printf("\n\n=== CPU Anomaly Summary ===\n");
     if (emulator->warnings_pc_in_vram > 0)
     {
-        printf("⚠️  PC in VRAM: %llu occurrences\n", emulator->warnings_pc_in_vram);
+        printf("⚠️  PC in VRAM: %" PRIu64 " occurrences\n", emulator->warnings_pc_in_vram);
         printf("   Last fault: PC=0x%04X, SP=0x%04X\n",
                emulator->last_warn_pc, emulator->warn_sp_at_fault);
         printf("   PC history before fault: ");
@@ -192,7 +285,7 @@ static void display_anomaly_summary(spettrum_emulator_t *emulator)
     }
     if (emulator->warnings_sp_in_vram > 0)
     {
-        printf("⚠️  SP in VRAM: %llu occurrences\n", emulator->warnings_sp_in_vram);
+        printf("⚠️  SP in VRAM: %" PRIu64 " occurrences\n", emulator->warnings_sp_in_vram);
         printf("   Last fault: SP=0x%04X, PC=0x%04X\n",
                emulator->last_warn_sp, emulator->warn_pc_at_sp_fault);
     }
@@ -208,7 +301,7 @@ static void display_anomaly_summary(spettrum_emulator_t *emulator)
         printf("%s", emulator->warning_buffer);
     }
 
-    printf("Total instructions executed: %llu\n", emulator->total_instructions);
+    printf("Total instructions executed: %" PRIu64 "\n", emulator->total_instructions);
     fflush(stdout);
 }
 
@@ -218,6 +311,7 @@ static void display_anomaly_summary(spettrum_emulator_t *emulator)
 static void signal_handler(int sig)
 {
     (void)sig; // Unused
+    batch_interrupted = 1;
     if (g_emulator)
     {
         g_emulator->running = 0;
@@ -235,6 +329,26 @@ static void dump_memory_handler(int sig)
         g_emulator->dump_memory = 1;
 }
 
+/**
+ * Signal handler for a profile dump request
+ */
+static void dump_profile_handler(int sig)
+{
+    (void)sig; // Unused
+    if (g_emulator)
+        g_emulator->dump_profile = 1;
+}
+
+/**
+ * Signal handler for a rewind request
+ */
+static void rewind_handler(int sig)
+{
+    (void)sig; // Unused
+    if (g_emulator)
+        g_emulator->rewind_request = 1;
+}
+
 /**
  * Dump memory to file
  */
@@ -254,13 +368,27 @@ static void dump_memory_to_file(spettrum_emulator_t *emulator)
         return;
     }
 
-    // Write entire 64KB memory
-    size_t written = fwrite(emulator->memory, 1, SPETTRUM_TOTAL_MEMORY, file);
+    // Write entire 64KB address space as currently paged
+    size_t written = fwrite(emulator_address_space(emulator), 1, SPETTRUM_TOTAL_MEMORY, file);
     fclose(file);
 
     fprintf(stderr, "Memory dumped to '%s' (%zu bytes)\n", filename, written);
 }
 
+/**
+ * Write the profile report and collapsed stacks (--profile)
+ * The counters keep accumulating, so every dump covers the whole run.
+ */
+static void dump_profile_to_files(spettrum_emulator_t *emulator)
+{
+    if (!emulator || !emulator->profile)
+        return;
+
+    if (z80_profile_dump(emulator->profile, emulator->profile_prefix, emulator_address_space(emulator)) == 0)
+        fprintf(stderr, "Profile written to '%s.txt' and '%s.folded'\n", emulator->profile_prefix,
+                emulator->profile_prefix);
+}
+
 /**
  * Print version information
  */
@@ -281,15 +409,32 @@ static void print_help(const char *program_name)
     printf("  -v, --version             Show version information\n");
     printf("  -r, --rom FILE            Load ROM from file\n");
     printf("  -s, --snapshot FILE       Load Z80 snapshot file (restores CPU and memory state)\n");
-    printf("  -t, --tap FILE            Load TAP tape image file (uses ROM loader by default)\n");
+    printf("  -t, --tap FILE            Load TAP or TZX tape image file (uses ROM loader by default)\n");
     printf("  -q, --quick-load          Quick-load TAP directly to memory (bypass ROM loader)\n");
+    printf("  -F, --flash-load          Serve ROM tape loads instantly (custom loaders still get pulses)\n");
     printf("  -d, --disk FILE           Load disk image from file\n");
     printf("  -i, --instructions NUM    Number of instructions to execute (0=unlimited, default=0)\n");
-    printf("  -D, --disassemble FILE    Write disassembly to FILE\n");
+    printf("  -D, --disassemble FILE    Write a binary instruction trace to FILE\n");
+    printf("  -P, --profile PREFIX      Profile hot PCs, opcodes and calls to PREFIX.txt/.folded (on exit or SIGPROF)\n");
     printf("  -m, --render-mode MODE    Rendering mode: block (2x2), braille (2x4), or ocr (32x24, default)\n");
     printf("  -k, --simulate-key STRING Simulate key presses (auto-replay starting at 3s, spaced 500ms)\n");
     printf("  -a, --audio on|off        Enable or disable beeper audio (default: on)\n");
     printf("  -V, --volume NUM          Set audio volume 0-100 (default: 50)\n");
+    printf("  -S, --speed N[%%]          Emulation speed in percent of real time (default: 100)\n");
+    printf("  -T, --turbo               Run as fast as possible (audio muted)\n");
+    printf("  -B, --blocks              Run the CPU on the predecoded block engine instead of the interpreter\n");
+    printf("  -w, --audio-out FILE.wav  Render beeper audio to a WAV file on emulated time (no audio device)\n");
+    printf("  -l, --load-state FILE     Restore a machine state saved with --save-state before running\n");
+    printf("  -o, --save-state FILE     Save the full machine state to FILE when emulation stops\n");
+    printf("  -R, --rewind SECS[,MB]    Keep the last SECS seconds for rewinding (Ctrl+R or SIGUSR2, default %d MB)\n",
+           REWIND_DEFAULT_MB);
+    printf("  -b, --batch DIR           Run every .z80/.tap/.tzx in DIR headless, one machine per image\n");
+    printf("                            (stops at -i, %d frames, or DI+HALT; tapes flash-load LOAD \"\")\n",
+           BATCH_DEFAULT_FRAMES);
+    printf("  -j, --jobs N              Worker threads for --batch (default: online CPUs)\n");
+    printf("  -x, --break ADDR[,R=V]    Pause before executing ADDR (only while register R holds V)\n");
+    printf("  -W, --watch KINDS:A[-B][,R=V]\n");
+    printf("                            Pause on reads (r), writes (w) or execution (x) of A-B\n");
     printf("\n");
 }
 
@@ -300,7 +445,7 @@ static uint8_t emulator_read_memory(void *user_data, uint16_t addr)
 {
     z80_callback_context_t *ctx = (z80_callback_context_t *)user_data;
     spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->memory_data;
-    return emulator->memory[addr];
+    return emulator_peek(emulator, addr);
 }
 
 /**
@@ -315,103 +460,366 @@ static void emulator_write_memory(void *user_data, uint16_t addr, uint8_t value)
     if (addr < SPETTRUM_ROM_SIZE)
         return;
 
-    emulator->memory[addr] = value;
+    emulator->slots[addr / SPETTRUM_BANK_SIZE][addr % SPETTRUM_BANK_SIZE] = value;
 }
 
 /**
- * Keyboard port IN handler (port 0xFE and variants)
- *
- * The Spectrum reads keyboard state via port 0xFE.
- * This handler queries the current host keyboard state and returns it
- * in Spectrum keyboard matrix format.
+ * Page a bank into a 16KB slot of the address space
+ * Only the CPU page table entries change; the bank's contents stay put.
+ */
+static void emulator_map_slot(spettrum_emulator_t *emulator, int slot, uint8_t *bank)
+{
+    uint16_t start = (uint16_t)(slot * SPETTRUM_BANK_SIZE);
+
+    emulator->slots[slot] = bank;
+    if (slot == 0)
+    {
+        z80_map_pages(emulator->cpu, start, SPETTRUM_BANK_SIZE, bank, Z80_PAGE_ROM);
+        return;
+    }
+    z80_map_pages(emulator->cpu, start, SPETTRUM_BANK_SIZE, bank, Z80_PAGE_RAM);
+}
+
+/**
+ * Apply a port 0x7FFD value: ROM at 0x0000, RAM bank at 0xC000, displayed screen
+ * Bank 5 stays at 0x4000 and bank 2 at 0x8000. On a 48K this is the fixed
+ * mapping (value 0).
+ */
+static void emulator_set_paging(spettrum_emulator_t *emulator, uint8_t value)
+{
+    int is_128k = emulator->model == SPETTRUM_MODEL_128K;
+    uint8_t *screen = emulator->ram_banks[is_128k && (value & SPETTRUM_7FFD_SCREEN) ? 7 : 5];
+
+    emulator->port_7ffd = is_128k ? value : 0;
+    if (screen != emulator->screen)
+    {
+        emulator->screen = screen;
+        ula_mark_all_dirty(emulator->display);
+    }
+    emulator_map_slot(emulator, 0, emulator->rom_banks[is_128k && (value & SPETTRUM_7FFD_ROM) ? 1 : 0]);
+    emulator_map_slot(emulator, 1, emulator->ram_banks[5]);
+    emulator_map_slot(emulator, 2, emulator->ram_banks[2]);
+    emulator_map_slot(emulator, 3, emulator->ram_banks[is_128k ? value & SPETTRUM_7FFD_RAM_MASK : 0]);
+}
+
+// ROM LD-SAMPLE edge loop, position independent so RAM copies match too:
+// INC B / RET Z / LD A,0x7F / IN A,(0xFE) / RRA / RET NC / XOR C / AND 0x20 / JR Z,LD-SAMPLE
+static const uint8_t ld_sample_loop[] = {0x04, 0xC8, 0x3E, 0x7F, 0xDB, 0xFE, 0x1F,
+                                         0xD0, 0xA9, 0xE6, 0x20, 0x28, 0xF3};
+#define LD_SAMPLE_IN_END 6       // Offset just past IN A,(0xFE) within the loop
+#define LD_SAMPLE_CYCLES 59      // T-states per iteration
+#define LD_SAMPLE_INSTRUCTIONS 8 // Instructions per iteration (for R)
+
+/**
+ * Fast-forward a tape edge-detection loop
  *
- * If a tape is being played, bit 6 (EAR) is overridden with tape data.
+ * Called while the loop's IN A,(0xFE) is executing and has sampled value.
+ * If that sample keeps the loop going (no edge, no BREAK), every following
+ * iteration that samples before the next tape edge would do the same, so
+ * they are skipped at once: only B, R and the cycle counter change. Never
+ * skips past the B wrap-around exit or the next scheduler deadline.
  */
-static uint8_t keyboard_read_handler(void *user_data, uint16_t port)
+static void tape_skip_edge_loop(spettrum_emulator_t *emulator, uint8_t value)
 {
-    static uint64_t total_calls = 0;
-    static uint64_t port_0xfe_calls = 0;
-    static uint64_t tape_player_calls = 0;
-    static FILE *port_log = NULL;
+    z80_emulator_t *cpu = emulator->cpu;
+    z80_registers_t *regs = &cpu->regs;
 
-    total_calls++;
+    // BREAK pressed (bit 0 low) or edge seen: the loop exits on this sample
+    if (!(value & 0x01) || (((value >> 1) ^ regs->c) & 0x20))
+        return;
 
-    // Open debug log on first call
-    if (!port_log)
+    uint16_t loop = regs->pc - LD_SAMPLE_IN_END;
+    for (size_t i = 0; i < sizeof(ld_sample_loop); i++)
     {
-        port_log = fopen("tap_port.log", "w");
-        if (port_log)
-        {
-            fprintf(port_log, "=== Port Read Handler Debug ===\n\n");
-            fflush(port_log);
-        }
+        if (emulator_peek(emulator, (uint16_t)(loop + i)) != ld_sample_loop[i])
+            return;
     }
 
-    z80_callback_context_t *ctx = (z80_callback_context_t *)user_data;
-    uint8_t result = keyboard_read_port(port);
+    // Iterations whose sample still lands before the edge, the B wrap and
+    // the next deadline (whichever comes first)
+    uint64_t to_edge = tape_player_cycles_to_edge(emulator->tape_player, cpu->cyc);
+    uint64_t deadline = scheduler_next_cycle(emulator->scheduler);
+    if (to_edge == UINT64_MAX || deadline <= cpu->cyc)
+        return;
+
+    uint64_t skip = (to_edge - 1) / LD_SAMPLE_CYCLES;
+    if (skip > 255u - regs->b)
+        skip = 255u - regs->b;
+    if (skip > (deadline - cpu->cyc) / LD_SAMPLE_CYCLES)
+        skip = (deadline - cpu->cyc) / LD_SAMPLE_CYCLES;
+    if (skip == 0)
+        return;
 
-    // Log first 50 calls regardless of port
-    if (port_log && total_calls <= 50)
+    regs->b += (uint8_t)skip;
+    regs->r = (regs->r & 0x80) | ((regs->r + skip * LD_SAMPLE_INSTRUCTIONS) & 0x7F);
+    cpu->cyc += skip * LD_SAMPLE_CYCLES;
+}
+
+/**
+ * Execution trap at the ROM LD-BYTES routine (--flash-load)
+ *
+ * Serves the load from the data block at the tape head (TAP, or TZX standard,
+ * turbo and pure data) instead of playing its pulses: checks the flag byte
+ * against A, loads (carry set) or verifies (carry clear) DE bytes at IX,
+ * checks the parity byte, then returns to the caller the way the ROM exit
+ * path SA/LD-RET would, with carry set on success.
+ * Custom loaders never reach this address and keep getting pulse playback.
+ */
+static int flash_load_trap(void *user_data, uint16_t addr)
+{
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)user_data;
+    z80_emulator_t *cpu = emulator->cpu;
+    z80_registers_t *regs = &cpu->regs;
+    const uint8_t *block;
+    uint32_t block_len;
+
+    // Only the stock routine (INC D; EX AF,AF') and only while a data block remains;
+    // the tape moves on to the following block right away
+    if (emulator_peek(emulator, addr) != 0x14 || emulator_peek(emulator, addr + 1) != 0x08)
+        return 0;
+    if (tape_player_take_block(emulator->tape_player, cpu->cyc, &block, &block_len) != 0)
+        return 0;
+
+    int load = get_f(cpu) & Z80_FLAG_C;
+    uint16_t ix = regs->ix;
+    uint16_t de = ((uint16_t)regs->d << 8) | regs->e;
+    uint8_t parity = block[0];
+    uint8_t last = block[0];
+    int ok = block[0] == regs->a;
+    uint32_t pos = 1;
+    uint16_t start = ix;
+
+    // Data bytes follow the flag; a short block fails like a timeout would
+    while (ok && de > 0 && pos < block_len)
     {
-        fprintf(port_log, "Call #%llu: port=0x%04X, ctx=%p", total_calls, port, (void *)ctx);
-        if (ctx)
-        {
-            fprintf(port_log, ", io_data=%p", ctx->io_data);
-            if (ctx->io_data)
-            {
-                spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->io_data;
-                fprintf(port_log, ", tape_player=%p", (void *)emulator->tape_player);
-            }
-        }
-        fprintf(port_log, "\n");
-        fflush(port_log);
+        uint8_t byte = block[pos++];
+        if (load)
+            emulator_write_memory(cpu->user_data, ix, byte);
+        else if (emulator_peek(emulator, ix) != byte)
+            ok = 0;
+        parity ^= byte;
+        last = byte;
+        ix++;
+        de--;
     }
 
-    // Check if this is a port 0xFE read
-    if ((port & 0xFF) == 0xFE)
+    // Code predecoded from the bytes just loaded is stale
+    if (load)
+        z80_invalidate_code(cpu, start, (uint16_t)(ix - start));
+
+    // The byte after the data is the checksum
+    if (ok && de == 0 && pos < block_len)
+        parity ^= block[pos];
+    else
+        ok = 0;
+    if (parity != 0)
+        ok = 0;
+
+    regs->ix = ix;
+    regs->d = de >> 8;
+    regs->e = de & 0xFF;
+    regs->h = parity;
+    regs->l = last;
+    if (ok)
     {
-        port_0xfe_calls++;
-        if (port_log && port_0xfe_calls <= 20)
-        {
-            fprintf(port_log, "  Port 0xFE read #%llu (total call #%llu)\n", port_0xfe_calls, total_calls);
-            fflush(port_log);
-        }
+        regs->a = 0;
+        set_f(cpu, Z80_FLAG_S | Z80_FLAG_H | Z80_FLAG_N | Z80_FLAG_C); // CP 1 with A=0
+    }
+    else
+    {
+        set_f(cpu, 0);
     }
 
-    // If tape player is active and reading from port 0xFE, inject EAR bit
-    if (ctx && ctx->io_data)
+    // SA/LD-RET: restore the border, re-enable interrupts and return
+    ula_set_border_color(emulator->display, (emulator_peek(emulator, SPECTRUM_SYSVAR_BORDCR) >> 3) & 0x07);
+    regs->iff1 = 1;
+    regs->iff2 = 1;
+    regs->pc = emulator_peek(emulator, regs->sp) | ((uint16_t)emulator_peek(emulator, regs->sp + 1) << 8);
+    regs->sp += 2;
+    return 1;
+}
+
+/**
+ * Scheduler event: end of the ULA INT pulse
+ * An interrupt not accepted within INT_PULSE_CYCLES is lost, as on hardware.
+ */
+static void int_end_event(void *user_data, uint64_t cycle)
+{
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)user_data;
+    (void)cycle;
+
+    z80_clear_int(emulator->cpu);
+    emulator->int_asserted = 0;
+}
+
+/**
+ * Scheduler event: 50Hz ULA frame interrupt
+ * Asserts INT, then schedules its release and the next frame relative to
+ * the deadline (not the current cycle) so frames never drift.
+ */
+static void frame_int_event(void *user_data, uint64_t cycle)
+{
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)user_data;
+
+    z80_gen_int(emulator->cpu, 0xFF); // Data 0xFF for IM1 / IM2 vector low byte
+    emulator->int_asserted = 1;
+    emulator->int_asserted_time = cycle;
+
+    scheduler_add(emulator->scheduler, cycle + INT_PULSE_CYCLES, int_end_event, emulator);
+    scheduler_add(emulator->scheduler, cycle + SPECTRUM_FRAME_CYCLES, frame_int_event, emulator);
+    emulator->next_frame_cycle = cycle + SPECTRUM_FRAME_CYCLES;
+
+    // Keep the WAV output in step with emulated time through silent stretches
+    beeper_recorder_advance(emulator->audio_recorder, cycle);
+
+    // Apply typed keys and release held ones on emulated frame boundaries
+    keyboard_frame(emulator->keyboard);
+
+    emulator->frame_count++;
+    emulator->frame_complete = 1;
+
+    // Hand the finished frame to the render thread
+    if (emulator->publish_frames)
+        ula_publish_frame(emulator->display, emulator->screen, emulator->frame_count);
+}
+
+#ifdef SPETTRUM_IO_DEBUG
+/**
+ * Port debug logs (make IO_DEBUG=1): the first ULA port reads go to
+ * tap_port.log, the first port 0xFE writes to io_debug.log
+ */
+static void io_debug_log_read(spettrum_emulator_t *emulator, uint16_t port, uint8_t result)
+{
+    emulator->io_read_count++;
+    if (!emulator->io_read_log)
     {
-        spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->io_data;
-        if (emulator && emulator->tape_player && (port & 0xFF) == 0xFE)
-        {
-            tape_player_calls++;
+        emulator->io_read_log = fopen("tap_port.log", "w");
+        if (emulator->io_read_log)
+            fprintf(emulator->io_read_log, "=== Port Read Handler Debug ===\n\n");
+    }
+    if (emulator->io_read_log && emulator->io_read_count <= 50)
+    {
+        fprintf(emulator->io_read_log, "Call #%llu: port=0x%04X, tape_player=%p, cycle=%llu, result=0x%02X\n",
+                (unsigned long long)emulator->io_read_count, port, (void *)emulator->tape_player,
+                (unsigned long long)emulator->cpu->cyc, result);
+        fflush(emulator->io_read_log);
+    }
+}
 
-            if (port_log && tape_player_calls <= 20)
-            {
-                fprintf(port_log, "  TAPE: Reading tape at cycle %llu\n", emulator->cpu->cyc);
-                fflush(port_log);
-            }
+static void io_debug_log_write(spettrum_emulator_t *emulator, uint8_t value)
+{
+    if (emulator->io_write_count >= 10)
+        return;
+    if (!emulator->io_write_log)
+        emulator->io_write_log = fopen("io_debug.log", "w");
+    if (emulator->io_write_log)
+    {
+        fprintf(emulator->io_write_log, "Port 0xFE write #%d: value=0x%02X (border=%d, mic=%d, beeper=%d)\n",
+                emulator->io_write_count, value, value & 0x07, (value >> 3) & 0x01, (value >> 4) & 0x01);
+        fflush(emulator->io_write_log);
+    }
+    emulator->io_write_count++;
+}
+#endif
 
-            // Bit 6 is EAR input - overwrite with tape data
-            uint8_t ear_bit = tape_player_read_ear(emulator->tape_player, emulator->cpu->cyc);
-            if (ear_bit)
-                result |= 0x40; // Set bit 6
-            else
-                result &= ~0x40; // Clear bit 6
+/**
+ * ULA port IN handler (any even port, usually 0xFE)
+ *
+ * The Spectrum reads keyboard state via port 0xFE.
+ * This handler queries the current host keyboard state and returns it
+ * in Spectrum keyboard matrix format; the high byte selects the rows.
+ *
+ * If a tape is being played, bit 6 (EAR) is overridden with tape data.
+ */
+static uint8_t keyboard_read_handler(void *user_data, uint16_t port)
+{
+    z80_callback_context_t *ctx = (z80_callback_context_t *)user_data;
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->io_data;
+    uint8_t result = keyboard_read_port(emulator->keyboard, port);
 
-            if (port_log && tape_player_calls <= 20)
-            {
-                fprintf(port_log, "  TAPE: ear_bit=%u, result=0x%02X\n", ear_bit, result);
-                fflush(port_log);
-            }
-        }
+    // If tape player is active, inject the EAR bit
+    if (emulator->tape_player)
+    {
+        // Bit 6 is EAR input - overwrite with tape data
+        uint8_t ear_bit = tape_player_read_ear(emulator->tape_player, emulator->cpu->cyc);
+
+        // Untraced runs may skip polling iterations up to the next edge
+        if (!emulator->trace && !emulator->step_mode && emulator->speed_delay == 0)
+            tape_skip_edge_loop(emulator, ear_bit ? result | 0x40 : result & ~0x40);
+        if (ear_bit)
+            result |= 0x40; // Set bit 6
+        else
+            result &= ~0x40; // Clear bit 6
     }
 
+#ifdef SPETTRUM_IO_DEBUG
+    io_debug_log_read(emulator, port, result);
+#endif
     return result;
 }
 
 /**
- * Generic I/O read callback - fallback for unregistered ports
+ * ULA port OUT handler (any even port, usually 0xFE)
+ *
+ * Runs for every border and beeper write, so it takes no locks: the border
+ * colour is an atomic store, and beeper edges go into the lock-free event
+ * ring (unchanged levels are dropped there).
+ */
+static void ula_port_write(void *user_data, uint16_t port, uint8_t value)
+{
+    z80_callback_context_t *ctx = (z80_callback_context_t *)user_data;
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->io_data;
+    (void)port;
+
+    emulator->port_fe_out = value;
+#ifdef SPETTRUM_IO_DEBUG
+    io_debug_log_write(emulator, value);
+#endif
+
+    // Bits 0-2: border color
+    ula_set_border_color(emulator->display, value & 0x07);
+
+    // Bit 3: MIC output (cassette), bit 4: beeper/speaker, timed on the
+    // current cycle (read directly: this runs inside the CPU loop)
+    uint8_t mic_bit = (value >> 3) & 0x01;
+    uint8_t beeper_bit = (value >> 4) & 0x01;
+    if (emulator->beeper)
+        beeper_update(emulator->beeper, emulator->cpu->cyc, mic_bit, beeper_bit);
+    if (emulator->audio_recorder)
+        beeper_recorder_update(emulator->audio_recorder, emulator->cpu->cyc, mic_bit, beeper_bit);
+
+    // Bits 5-7: keyboard row selector
+    keyboard_set_row_selector(emulator->keyboard, value);
+}
+
+/**
+ * Kempston joystick port IN handler (A5-A7 low, usually 0x1F)
+ * No host joystick is wired up, so it reports nothing pressed.
+ */
+static uint8_t kempston_read_handler(void *user_data, uint16_t port)
+{
+    (void)user_data;
+    (void)port;
+    return 0x00;
+}
+
+/**
+ * 128K memory paging port OUT handler (A15 and A1 low, usually 0x7FFD)
+ * Ignored on a 48K, and on a 128K once bit 5 has locked the paging.
+ */
+static void paging_port_write(void *user_data, uint16_t port, uint8_t value)
+{
+    z80_callback_context_t *ctx = (z80_callback_context_t *)user_data;
+    spettrum_emulator_t *emulator = (spettrum_emulator_t *)ctx->io_data;
+    (void)port;
+
+    if (emulator->model != SPETTRUM_MODEL_128K || (emulator->port_7ffd & SPETTRUM_7FFD_LOCK))
+        return;
+    emulator_set_paging(emulator, value);
+}
+
+/**
+ * Generic I/O read callback - fallback for unmapped ports
  * Returns 0xFF (all bits set) for unimplemented ports
  */
 static uint8_t generic_io_read(void *user_data, uint16_t port)
@@ -422,71 +830,22 @@ static uint8_t generic_io_read(void *user_data, uint16_t port)
 }
 
 /**
- * Generic I/O write callback - fallback for unregistered ports
- * Handles border color (port 0xFE bits 0-2), keyboard row selection, and other ports
+ * Generic I/O write callback - fallback for unmapped ports
+ * Nothing else is attached to a 48K, so writes are ignored.
  */
 static void generic_io_write(void *user_data, uint16_t port, uint8_t value)
 {
-    static FILE *io_log = NULL;
-    static int io_write_count = 0;
-
-    // user_data is directly the emulator pointer (z80.c extracts it from context)
-    spettrum_emulator_t *emulator = (spettrum_emulator_t *)user_data;
-    if (!emulator)
-        return;
-
-    // Port 0xFE - ULA control and keyboard row selection
-    if ((port & 0xFF) == 0xFE)
-    {
-        // Log first few port writes
-        if (io_write_count < 10)
-        {
-            if (!io_log)
-                io_log = fopen("io_debug.log", "w");
-            if (io_log)
-            {
-                fprintf(io_log, "Port 0xFE write #%d: value=0x%02X (border=%d, mic=%d, beeper=%d)\n",
-                        io_write_count, value, value & 0x07, (value >> 3) & 0x01, (value >> 4) & 0x01);
-                fflush(io_log);
-            }
-            io_write_count++;
-        }
-
-        // Bits 0-2: border color
-        uint8_t border_color = value & 0x07;
-        ula_set_border_color(emulator->display, border_color);
-
-        // Bit 3: MIC output (cassette)
-        uint8_t mic_bit = (value >> 3) & 0x01;
-
-        // Bit 4: Beeper/speaker
-        uint8_t beeper_bit = (value >> 4) & 0x01;
-
-        // Update beeper with current CPU cycle count
-        if (emulator->beeper && emulator->cpu)
-        {
-            uint64_t cpu_cycle = z80_get_cycles(emulator->cpu);
-            beeper_update(emulator->beeper, cpu_cycle, mic_bit, beeper_bit);
-        }
-        else if (io_write_count < 10 && io_log)
-        {
-            fprintf(io_log, "  WARNING: beeper_update skipped (beeper=%p, cpu=%p)\n",
-                    (void *)emulator->beeper, (void *)emulator->cpu);
-            fflush(io_log);
-        }
-
-        // Bits 5-7: keyboard row selector
-        // The ROM code uses OUT (C), B to set the row selector
-        // which tells us which row of the keyboard matrix to scan
-        keyboard_set_row_selector(value);
-    }
-    // Other ports: silently ignore (not implemented)
+    (void)user_data;
+    (void)port;
+    (void)value;
 }
 
 /**
  * Initialize emulator components
+ * Everything a machine needs lives in the returned instance, so several
+ * can run side by side (--batch); host_audio opens the sound device.
  */
-static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
+static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode, bool host_audio)
 {
     spettrum_emulator_t *emulator = malloc(sizeof(spettrum_emulator_t));
     if (!emulator)
@@ -496,7 +855,7 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
     }
 
     // Initialize memory
-    memset(emulator->memory, 0, SPETTRUM_TOTAL_MEMORY);
+    memset(emulator->memory, 0, sizeof(emulator->memory));
 
     // Initialize Z80 CPU
     emulator->cpu = z80_init();
@@ -510,6 +869,15 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
     // Set memory callbacks
     z80_set_memory_callbacks(emulator->cpu, emulator_read_memory, emulator_write_memory, emulator);
 
+    // Memory banks in the order of the memory layout (see spettrum_emulator_t)
+    static const uint8_t bank_order[SPETTRUM_RAM_BANKS] = {5, 2, 0, 1, 3, 4, 6, 7};
+    emulator->model = SPETTRUM_MODEL_48K;
+    emulator->rom_banks[0] = &emulator->memory[0];
+    emulator->rom_banks[1] = &emulator->memory[4 * SPETTRUM_BANK_SIZE];
+    for (int i = 0; i < SPETTRUM_RAM_BANKS; i++)
+        emulator->ram_banks[bank_order[i]] = &emulator->memory[(i < 3 ? i + 1 : i + 2) * SPETTRUM_BANK_SIZE];
+    emulator->view = NULL;
+
     // Set I/O callbacks context data
     z80_set_io_callbacks(emulator->cpu, emulator);
 
@@ -523,8 +891,15 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
         return NULL;
     }
 
-    // Initialize keyboard handler (sets terminal to raw mode)
-    if (keyboard_init() != 0)
+    // Map ROM and RAM directly so the CPU bypasses the callbacks on every
+    // access, video RAM included (frames reach the renderer through
+    // ula_publish_frame())
+    emulator->screen = NULL;
+    emulator_set_paging(emulator, 0);
+
+    // Initialize keyboard matrix (host keys are read later by emulator_run)
+    emulator->keyboard = keyboard_init();
+    if (!emulator->keyboard)
     {
         fprintf(stderr, "Error: Failed to initialize keyboard\n");
         ula_cleanup(emulator->display);
@@ -537,20 +912,21 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
     emulator->cpu->read_io = generic_io_read;   // Default read handler for all ports
     emulator->cpu->write_io = generic_io_write; // Default write handler for all ports
 
-    // Register keyboard port handlers (override the generic handler for these ports)
-    // Each port reads a different row of the keyboard matrix
-    z80_register_port_in(emulator->cpu, 0xFE, keyboard_read_handler); // CAPS SHIFT, Z, X, C, V
-    z80_register_port_in(emulator->cpu, 0xFD, keyboard_read_handler); // A, S, D, F, G
-    z80_register_port_in(emulator->cpu, 0xFB, keyboard_read_handler); // Q, W, E, R, T
-    z80_register_port_in(emulator->cpu, 0xF7, keyboard_read_handler); // 1, 2, 3, 4, 5
-    z80_register_port_in(emulator->cpu, 0xEF, keyboard_read_handler); // 6, 7, 8, 9, 0
-    z80_register_port_in(emulator->cpu, 0xDF, keyboard_read_handler); // SPACE, SHIFT, ENTER, SYMBOL SHIFT
-    z80_register_port_in(emulator->cpu, 0xBF, keyboard_read_handler); // P, O, I, U, Y
-    z80_register_port_in(emulator->cpu, 0x7F, keyboard_read_handler); // M, N, B, T, G
+    // Map devices by the address lines they decode. The ULA goes last so it
+    // answers the even IN ports it shares with the Kempston interface; OUTs
+    // reach every device decoding the port, so 0x7FFC pages memory and sets
+    // the border. Keyboard rows are selected by the high byte of the ULA
+    // port address.
+    z80_map_port_in(emulator->cpu, SPETTRUM_PORT_KEMPSTON_MASK, SPETTRUM_PORT_KEMPSTON_MATCH,
+                    kempston_read_handler);
+    z80_map_port_out(emulator->cpu, SPETTRUM_PORT_7FFD_MASK, SPETTRUM_PORT_7FFD_MATCH, paging_port_write);
+    z80_map_port_in(emulator->cpu, SPETTRUM_PORT_ULA_MASK, SPETTRUM_PORT_ULA_MATCH, keyboard_read_handler);
+    z80_map_port_out(emulator->cpu, SPETTRUM_PORT_ULA_MASK, SPETTRUM_PORT_ULA_MATCH, ula_port_write);
 
     // Initialize tape player (will be set later if TAP file specified)
     emulator->tape_player = NULL;
     emulator->use_authentic_loading = 0;
+    emulator->flash_loading = 0;
 
     // Initialize warning buffer (initial 4KB)
     emulator->warning_buffer_size = 4096;
@@ -563,21 +939,88 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
 
     // Initialize simulated keys (will be set later if -k option is used)
     emulator->simulated_keys = NULL;
+    emulator->simulated_key_index = 0;
+
+    // Pause state, speed control and memory dumps
+    emulator->paused = 0;
+    emulator->speed_delay = 0;
+    emulator->step_mode = 0;
+    emulator->speed_percent = 100;
+    emulator->pace_start_ns = 0;
+    emulator->pace_frames = 0;
+    emulator->dump_memory = 0;
+    emulator->dump_count = 0;
 
-    // Initialize ULA interrupt timing fields
-    emulator->frame_cycle_count = 0;
+    // Debug tracking
+    memset(emulator->last_pc, 0, sizeof(emulator->last_pc));
+    memset(emulator->last_opcode, 0, sizeof(emulator->last_opcode));
+    emulator->history_index = 0;
+    emulator->total_instructions = 0;
+
+    // Anomaly tracking
+    emulator->warnings_pc_in_vram = 0;
+    emulator->warnings_sp_in_vram = 0;
+    emulator->last_warn_pc = 0;
+    emulator->last_warn_sp = 0;
+    memset(emulator->warn_pc_history, 0, sizeof(emulator->warn_pc_history));
+    emulator->warn_sp_at_fault = 0;
+    emulator->warn_pc_at_sp_fault = 0;
+
+    // No breakpoint hit yet
+    emulator->break_id = -1;
+    emulator->break_kind = 0;
+    emulator->break_addr = 0;
+
+#ifdef SPETTRUM_IO_DEBUG
+    emulator->io_read_log = NULL;
+    emulator->io_read_count = 0;
+    emulator->io_write_log = NULL;
+    emulator->io_write_count = 0;
+#endif
+
+    // Debugging: trace opened later if --disassemble is used, decode cache on first use
+    emulator->trace = NULL;
+    emulator->disasm_cache = NULL;
+    emulator->profile = NULL;
+    emulator->profile_prefix = NULL;
+    emulator->dump_profile = 0;
+
+    // Rewind history (set up later if --rewind is used)
+    emulator->rewind = NULL;
+    emulator->rewind_state = NULL;
+    emulator->rewind_state_size = 0;
+    emulator->rewind_request = 0;
+
+    // Initialize ULA interrupt timing: the first frame INT is the first scheduled event
     emulator->int_asserted = 0;
     emulator->int_asserted_time = 0;
+    emulator->frame_complete = 0;
+    emulator->frame_count = 0;
+    emulator->publish_frames = 0;
+    emulator->next_frame_cycle = SPECTRUM_FRAME_CYCLES;
+    emulator->port_fe_out = 0;
+    emulator->scheduler = scheduler_init();
+    if (!emulator->scheduler)
+    {
+        keyboard_cleanup(emulator->keyboard);
+        z80_cleanup(emulator->cpu);
+        ula_cleanup(emulator->display);
+        free(emulator->warning_buffer);
+        free(emulator);
+        return NULL;
+    }
+    scheduler_add(emulator->scheduler, SPECTRUM_FRAME_CYCLES, frame_int_event, emulator);
 
     // Initialize beeper audio (default enabled, 50% volume)
     // Note: Audio is initialized but not started yet - will be started after command-line options are parsed
-    emulator->audio_enabled = 1; // Default enabled, will be overridden by command-line option
-    emulator->beeper = beeper_init(3500000, 44100, true);
+    emulator->audio_enabled = host_audio; // Default enabled, will be overridden by command-line option
+    emulator->audio_recorder = NULL;
+    emulator->beeper = host_audio ? beeper_init(SPECTRUM_CPU_CLOCK_HZ, 44100, true) : NULL;
     if (emulator->beeper)
     {
         beeper_set_volume(emulator->beeper, 50); // 50% volume (will be overridden by -V option)
     }
-    else
+    else if (host_audio)
     {
         fprintf(stderr, "Warning: Failed to initialize beeper audio (continuing without sound)\n");
     }
@@ -588,41 +1031,77 @@ static spettrum_emulator_t *emulator_init(ula_render_mode_t render_mode)
 }
 
 /**
- * Load ROM data from file
+ * Install a ROM image and pick the machine model from its size
+ * Up to 16KB is a 48K ROM; 32KB is a 128K/+2 ROM pair (128K editor, then
+ * 48K BASIC), which turns the machine into a 128K with port 0x7FFD paging.
+ * Returns 0 if successful, -1 if the image has neither size
  */
-static int emulator_load_rom(spettrum_emulator_t *emulator, const char *filename)
+static int emulator_install_rom(spettrum_emulator_t *emulator, const uint8_t *image, size_t size)
 {
-    FILE *file = fopen(filename, "rb");
-    if (!file)
+    if (size > SPETTRUM_ROM_SIZE && size != SPETTRUM_128K_ROM_SIZE)
     {
-        fprintf(stderr, "Error: Cannot open ROM file '%s'\n", filename);
+        fprintf(stderr, "Error: ROM file has %zu bytes (48K: up to %d bytes, 128K: %d bytes)\n", size,
+                SPETTRUM_ROM_SIZE, SPETTRUM_128K_ROM_SIZE);
         return -1;
     }
 
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // The two ROMs are not adjacent in the memory layout
+    emulator->model = size == SPETTRUM_128K_ROM_SIZE ? SPETTRUM_MODEL_128K : SPETTRUM_MODEL_48K;
+    memcpy(emulator->rom_banks[0], image, size < SPETTRUM_BANK_SIZE ? size : SPETTRUM_BANK_SIZE);
+    if (emulator->model == SPETTRUM_MODEL_128K)
+        memcpy(emulator->rom_banks[1], image + SPETTRUM_BANK_SIZE, SPETTRUM_BANK_SIZE);
+    emulator_set_paging(emulator, 0);
+    return 0;
+}
 
-    // Check if ROM fits in allocated ROM space
-    if (file_size > SPETTRUM_ROM_SIZE)
+/**
+ * Load ROM data from file
+ */
+static int emulator_load_rom(spettrum_emulator_t *emulator, const char *filename)
+{
+    size_t file_size;
+    const uint8_t *image = mapfile_map(AT_FDCWD, filename, &file_size);
+    if (!image)
     {
-        fprintf(stderr, "Error: ROM file too large (%ld bytes, max %d bytes)\n", file_size, SPETTRUM_ROM_SIZE);
-        fclose(file);
+        fprintf(stderr, "Error: Cannot open ROM file '%s'\n", filename);
         return -1;
     }
 
-    // Read ROM into memory at address 0
-    size_t bytes_read = fread(emulator->memory, 1, file_size, file);
-    if (bytes_read != (size_t)file_size)
-    {
-        fprintf(stderr, "Error: Failed to read ROM file\n");
-        fclose(file);
+    // Copy ROM into its banks straight from the mapping
+    int result = emulator_install_rom(emulator, image, file_size);
+    mapfile_unmap(image, file_size);
+    if (result == 0)
+        printf("Loaded ROM: %zu bytes (%s)\n", file_size,
+               emulator->model == SPETTRUM_MODEL_128K ? "128K" : "48K");
+    return result;
+}
+
+/**
+ * Restore a .z80 snapshot into the machine's memory banks
+ * A 128K snapshot needs a 128K machine and brings its paging with it; a 48K
+ * snapshot on a 128K runs on the 48K BASIC ROM with the paging locked, as
+ * the 128K's own 48K mode does.
+ */
+static int emulator_restore_snapshot(spettrum_emulator_t *emulator, const z80_snapshot_library_t *library,
+                                     uint32_t index, const char *filename)
+{
+    z80_snapshot_memory_t target;
+    memset(&target, 0, sizeof(target));
+    target.memory = emulator->memory;
+    if (emulator->model == SPETTRUM_MODEL_128K)
+        memcpy(target.ram_banks, emulator->ram_banks, sizeof(target.ram_banks));
+
+    // A 48K snapshot's 0x4000-0xFFFF are banks 5, 2, 0 of a 128K: restore into the power-on mapping
+    emulator_set_paging(emulator, 0);
+    int result = library ? z80_snapshot_library_load(library, index, emulator->cpu, &target)
+                         : z80_snapshot_load(filename, emulator->cpu, &target);
+    if (result != 0)
         return -1;
-    }
 
-    fclose(file);
-    printf("Loaded ROM: %ld bytes\n", file_size);
+    z80_invalidate_code(emulator->cpu, 0, Z80_MAX_MEMORY);
+    if (emulator->model == SPETTRUM_MODEL_128K)
+        emulator_set_paging(emulator, target.is_128k ? target.paging : SPETTRUM_7FFD_ROM | SPETTRUM_7FFD_LOCK);
+    ula_mark_all_dirty(emulator->display);
     return 0;
 }
 
@@ -647,17 +1126,33 @@ static void emulator_cleanup(spettrum_emulator_t *emulator)
     if (!emulator)
         return;
 
-    // Cleanup keyboard (restores terminal to normal mode)
-    keyboard_cleanup();
+    // Stop the host input thread and free the keyboard
+    keyboard_cleanup(emulator->keyboard);
 
     // Close tape player if active
     if (emulator->tape_player)
         tape_player_close(emulator->tape_player);
 
-    // Stop and destroy beeper
+    rewind_destroy(emulator->rewind);
+    free(emulator->rewind_state);
+    disasm_cache_destroy(emulator->disasm_cache);
+    z80_profile_destroy(emulator->profile);
+    free(emulator->view);
+
+    // Finish the WAV output at the last emulated cycle
+    if (emulator->audio_recorder)
+    {
+        beeper_recorder_advance(emulator->audio_recorder, emulator->cpu->cyc);
+        beeper_recorder_close(emulator->audio_recorder);
+    }
+
+    // Stop and destroy beeper
     if (emulator->beeper)
         beeper_destroy(emulator->beeper);
 
+    if (emulator->scheduler)
+        scheduler_destroy(emulator->scheduler);
+
     if (emulator->cpu)
         z80_cleanup(emulator->cpu);
 
@@ -668,9 +1163,453 @@ static void emulator_cleanup(spettrum_emulator_t *emulator)
     if (emulator->warning_buffer)
         free(emulator->warning_buffer);
 
+#ifdef SPETTRUM_IO_DEBUG
+    if (emulator->io_read_log)
+        fclose(emulator->io_read_log);
+    if (emulator->io_write_log)
+        fclose(emulator->io_write_log);
+#endif
+
     free(emulator);
 }
 
+/**
+ * Get the size of the memory banks the model has (the start of memory)
+ */
+static size_t emulator_memory_size(const spettrum_emulator_t *emulator)
+{
+    return emulator->model == SPETTRUM_MODEL_128K ? SPETTRUM_128K_MEMORY : SPETTRUM_TOTAL_MEMORY;
+}
+
+/**
+ * Get the size of a save state for this machine configuration
+ */
+static size_t emulator_state_size(const spettrum_emulator_t *emulator)
+{
+    size_t tape_size = emulator->tape_player ? tape_player_state_size() : 0;
+    return sizeof(spettrum_state_header_t) + Z80_STATE_SIZE + emulator_memory_size(emulator) + tape_size;
+}
+
+/**
+ * Save the full machine state into a caller-provided buffer
+ * A handful of copies and no allocation, cheap enough to run every frame.
+ * Returns bytes written, or 0 if the buffer is too small
+ */
+static size_t emulator_save_state(spettrum_emulator_t *emulator, uint8_t *buffer, size_t buffer_size)
+{
+    size_t size = emulator_state_size(emulator);
+    if (!buffer || buffer_size < size)
+        return 0;
+
+    uint64_t now = emulator->cpu->cyc;
+    spettrum_state_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SPETTRUM_STATE_MAGIC, sizeof(header.magic));
+    header.version = SPETTRUM_STATE_VERSION;
+    header.header_size = sizeof(header);
+    header.cpu_size = Z80_STATE_SIZE;
+    header.memory_size = (uint32_t)emulator_memory_size(emulator);
+    header.tape_size = emulator->tape_player ? (uint32_t)tape_player_state_size() : 0;
+    // Events already due but not yet fired are kept due
+    uint64_t int_end = emulator->int_asserted_time + INT_PULSE_CYCLES;
+    header.frame_delta = emulator->next_frame_cycle > now ? (uint32_t)(emulator->next_frame_cycle - now) : 0;
+    header.int_asserted = emulator->int_asserted ? 1 : 0;
+    if (emulator->int_asserted && int_end > now)
+        header.int_end_delta = (uint32_t)(int_end - now);
+    header.port_fe = emulator->port_fe_out;
+    header.model = (uint8_t)emulator->model;
+    header.port_7ffd = emulator->port_7ffd;
+    header.cycle = now;
+
+    size_t offset = 0;
+    memcpy(buffer, &header, sizeof(header));
+    offset += sizeof(header);
+    offset += z80_save_state(emulator->cpu, buffer + offset, Z80_STATE_SIZE);
+    memcpy(buffer + offset, emulator->memory, header.memory_size);
+    offset += header.memory_size;
+    if (emulator->tape_player)
+        offset += tape_player_save_state(emulator->tape_player, now, buffer + offset, header.tape_size);
+
+    return offset;
+}
+
+/**
+ * Restore the machine state saved by emulator_save_state()
+ * The state is re-based onto the current CPU cycle. A tape position is only
+ * restored when a tape is loaded; the tape itself is not part of the state.
+ * Returns 0 if successful, -1 if the state is invalid (machine unchanged)
+ */
+static int emulator_load_state(spettrum_emulator_t *emulator, const uint8_t *buffer, size_t buffer_size)
+{
+    spettrum_state_header_t header;
+
+    if (!buffer || buffer_size < sizeof(header))
+    {
+        fprintf(stderr, "Error: Save state is truncated\n");
+        return -1;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, SPETTRUM_STATE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        fprintf(stderr, "Error: Not a spettrum save state\n");
+        return -1;
+    }
+    if (header.version != SPETTRUM_STATE_VERSION || header.header_size != sizeof(header) ||
+        header.cpu_size != Z80_STATE_SIZE || (header.tape_size != 0 && header.tape_size != tape_player_state_size()))
+    {
+        fprintf(stderr, "Error: Save state version %u is not supported by this build\n", header.version);
+        return -1;
+    }
+    if (header.model != emulator->model || header.memory_size != emulator_memory_size(emulator))
+    {
+        fprintf(stderr, "Error: Save state is for a %s machine (load the matching ROM)\n",
+                header.model == SPETTRUM_MODEL_128K ? "128K" : "48K");
+        return -1;
+    }
+    if (buffer_size < sizeof(header) + header.cpu_size + header.memory_size + header.tape_size)
+    {
+        fprintf(stderr, "Error: Save state is truncated\n");
+        return -1;
+    }
+
+    uint64_t now = emulator->cpu->cyc;
+    const uint8_t *cpu_state = buffer + sizeof(header);
+    const uint8_t *memory = cpu_state + header.cpu_size;
+    const uint8_t *tape_state = memory + header.memory_size;
+
+    // The tape is the only part that can still refuse the state
+    if (header.tape_size && emulator->tape_player &&
+        tape_player_load_state(emulator->tape_player, now, tape_state, header.tape_size) != 0)
+        return -1;
+
+    // CPU and memory; the cycle counter keeps running
+    z80_load_state(emulator->cpu, cpu_state, header.cpu_size);
+    emulator->cpu->cyc = now;
+    memcpy(emulator->memory, memory, header.memory_size);
+    emulator_set_paging(emulator, header.port_7ffd);
+    ula_mark_all_dirty(emulator->display);
+
+    // Port 0xFE output: border, speaker level and keyboard row
+    uint8_t value = header.port_fe;
+    emulator->port_fe_out = value;
+    ula_set_border_color(emulator->display, value & 0x07);
+    beeper_update(emulator->beeper, now, (value >> 3) & 0x01, (value >> 4) & 0x01);
+    beeper_recorder_update(emulator->audio_recorder, now, (value >> 3) & 0x01, (value >> 4) & 0x01);
+    keyboard_set_row_selector(emulator->keyboard, value);
+
+    // Frame timing
+    scheduler_remove(emulator->scheduler, frame_int_event, emulator);
+    scheduler_remove(emulator->scheduler, int_end_event, emulator);
+    emulator->next_frame_cycle = now + header.frame_delta;
+    scheduler_add(emulator->scheduler, emulator->next_frame_cycle, frame_int_event, emulator);
+    emulator->int_asserted = header.int_asserted;
+    if (header.int_asserted)
+    {
+        uint64_t int_end = now + header.int_end_delta;
+        emulator->int_asserted_time = int_end > INT_PULSE_CYCLES ? int_end - INT_PULSE_CYCLES : 0;
+        scheduler_add(emulator->scheduler, int_end, int_end_event, emulator);
+    }
+    return 0;
+}
+
+/**
+ * Write the machine state to a file (--save-state)
+ */
+static int emulator_save_state_file(spettrum_emulator_t *emulator, const char *filename)
+{
+    size_t size = emulator_state_size(emulator);
+    uint8_t *buffer = malloc(size);
+    if (!buffer)
+    {
+        fprintf(stderr, "Error: Failed to allocate save state buffer\n");
+        return -1;
+    }
+
+    size_t written = emulator_save_state(emulator, buffer, size);
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Error: Cannot create save state file '%s'\n", filename);
+        free(buffer);
+        return -1;
+    }
+
+    int result = fwrite(buffer, 1, written, file) == written ? 0 : -1;
+    if (fclose(file) != 0)
+        result = -1;
+    if (result != 0)
+        fprintf(stderr, "Error: Failed to write save state file '%s'\n", filename);
+    free(buffer);
+    return result;
+}
+
+/**
+ * Restore the machine state from a file (--load-state)
+ */
+static int emulator_load_state_file(spettrum_emulator_t *emulator, const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Error: Cannot open save state file '%s'\n", filename);
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *buffer = size > 0 ? malloc((size_t)size) : NULL;
+    if (!buffer || fread(buffer, 1, (size_t)size, file) != (size_t)size)
+    {
+        fprintf(stderr, "Error: Failed to read save state file '%s'\n", filename);
+        free(buffer);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    int result = emulator_load_state(emulator, buffer, (size_t)size);
+    free(buffer);
+    return result;
+}
+
+/**
+ * Set up the per-frame rewind history (--rewind)
+ * Must run after the tape is loaded, as the state size depends on it.
+ */
+static int emulator_enable_rewind(spettrum_emulator_t *emulator, uint32_t seconds, size_t memory_mb)
+{
+    uint32_t frames = seconds * (SPECTRUM_CPU_CLOCK_HZ / SPECTRUM_FRAME_CYCLES);
+
+    emulator->rewind_state_size = emulator_state_size(emulator);
+    emulator->rewind_state = malloc(emulator->rewind_state_size);
+    if (!emulator->rewind_state)
+    {
+        fprintf(stderr, "Error: Failed to allocate rewind state buffer\n");
+        return -1;
+    }
+
+    // Whole keyframe groups are dropped at once, so keep one extra group
+    emulator->rewind = rewind_init(emulator->rewind_state_size, memory_mb * 1024 * 1024,
+                                   frames + REWIND_KEYFRAME_INTERVAL, REWIND_KEYFRAME_INTERVAL);
+    return emulator->rewind ? 0 : -1;
+}
+
+/**
+ * Step back REWIND_STEP_FRAMES frames in the rewind history
+ */
+static void emulator_rewind(spettrum_emulator_t *emulator)
+{
+    if (!emulator->rewind)
+        return;
+
+    uint32_t frames = rewind_pop(emulator->rewind, REWIND_STEP_FRAMES, emulator->rewind_state);
+    if (frames == 0 || emulator_load_state(emulator, emulator->rewind_state, emulator->rewind_state_size) != 0)
+    {
+        printf("\033[48;1H\033[K[Rewind: no history left]\033[48;1H");
+        fflush(stdout);
+        return;
+    }
+
+    printf("\033[48;1H\033[K[Rewound %u frames - PC=0x%04X | %u frames left]\033[48;1H",
+           frames, emulator->cpu->regs.pc, rewind_frame_count(emulator->rewind));
+    fflush(stdout);
+    ula_request_redraw();
+}
+
+/**
+ * Execute instructions one at a time up to a scheduler deadline
+ * Used when per-instruction work is needed: disassembly logging, step mode,
+ * speed delay and the instruction history shown by the debugger.
+ */
+static uint64_t emulator_run_traced(spettrum_emulator_t *emulator, uint64_t deadline, uint64_t max_instructions)
+{
+    uint64_t executed = 0;
+
+    while (emulator->cpu->cyc < deadline && executed < max_instructions)
+    {
+        // Get current PC and opcode for disassembly BEFORE z80_step increments PC
+        uint16_t pc = emulator->cpu->regs.pc;
+        uint8_t opcode = emulator_peek(emulator, pc);
+        uint64_t start_cycle = emulator->cpu->cyc;
+
+        // An execute breakpoint stops the CPU before the instruction
+        if (z80_step(emulator->cpu) == 0 && emulator->cpu->break_hit)
+            break;
+        executed++;
+
+        // Record in history
+        emulator->last_pc[emulator->history_index] = pc;
+        emulator->last_opcode[emulator->history_index] = opcode;
+        emulator->history_index = (emulator->history_index + 1) % 10;
+
+        // Queue a trace record if enabled
+        if (emulator->trace)
+        {
+            z80_registers_t *regs = &emulator->cpu->regs;
+            trace_record_t record;
+            record.cycle = start_cycle;
+            record.pc = pc;
+            record.sp = regs->sp;
+            record.ix = regs->ix;
+            record.iy = regs->iy;
+            record.a = regs->a;
+            record.f = get_f(emulator->cpu);
+            record.b = regs->b;
+            record.c = regs->c;
+            record.d = regs->d;
+            record.e = regs->e;
+            record.h = regs->h;
+            record.l = regs->l;
+            record.i = regs->i;
+            record.r = regs->r;
+            record.im_iff = (uint8_t)((regs->im & 3) | (regs->iff1 ? 4 : 0) | (regs->iff2 ? 8 : 0));
+            record.reserved = 0;
+            record.bytes[0] = opcode;
+            for (int k = 1; k < 4; k++)
+                record.bytes[k] = emulator_peek(emulator, pc + k);
+            trace_write(emulator->trace, &record);
+        }
+
+        // A read or write watchpoint stops it after the instruction
+        if (emulator->cpu->break_hit)
+            break;
+
+        // In step mode, pause after each instruction and show debug info
+        if (emulator->step_mode)
+        {
+            emulator->paused = 1;
+            display_debug_info(emulator);
+            break;
+        }
+
+        // Apply speed delay if set
+        if (emulator->speed_delay > 0)
+        {
+            usleep(emulator->speed_delay);
+        }
+    }
+
+    return executed;
+}
+
+/**
+ * Get monotonic wall-clock time in nanoseconds
+ */
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Hold emulated time to speed_percent of real time
+ * Called once per emulated frame; sleeps until that frame's wall-clock
+ * deadline. If the host falls more than SPEED_MAX_LAG_FRAMES behind (or the
+ * emulator was paused), the reference point is reset instead of running
+ * flat out to catch up.
+ */
+static void emulator_throttle(spettrum_emulator_t *emulator)
+{
+    if (emulator->speed_percent <= 0)
+        return; // Turbo: unthrottled
+
+    uint64_t frame_ns = SPECTRUM_FRAME_NS * 100 / (uint64_t)emulator->speed_percent;
+    uint64_t now = monotonic_ns();
+
+    emulator->pace_frames++;
+    uint64_t target = emulator->pace_start_ns + emulator->pace_frames * frame_ns;
+
+    if (now < target)
+    {
+        uint64_t wait_ns = target - now;
+        struct timespec ts = {(time_t)(wait_ns / 1000000000ULL), (long)(wait_ns % 1000000000ULL)};
+        nanosleep(&ts, NULL);
+    }
+    else if (now - target > SPEED_MAX_LAG_FRAMES * frame_ns)
+    {
+        emulator->pace_start_ns = now;
+        emulator->pace_frames = 0;
+    }
+}
+
+/**
+ * Run the CPU up to the next 50Hz frame interrupt
+ * The CPU runs in a tight z80_run_until() loop up to the earliest scheduler
+ * deadline; due events (INT assert/release, tape edges) fire between runs.
+ * Per-frame bookkeeping happens once the frame interrupt event has fired.
+ * @return Number of instructions executed
+ */
+static uint64_t emulator_run_frame(spettrum_emulator_t *emulator, uint64_t max_instructions)
+{
+    z80_emulator_t *cpu = emulator->cpu;
+    uint64_t executed = 0;
+
+    emulator->frame_complete = 0;
+
+    while (!emulator->frame_complete && executed < max_instructions && !emulator->paused)
+    {
+        uint64_t deadline = scheduler_next_cycle(emulator->scheduler);
+
+        if (emulator->trace || emulator->step_mode || emulator->speed_delay > 0)
+            executed += emulator_run_traced(emulator, deadline, max_instructions - executed);
+        else
+            executed += z80_run_until(cpu, deadline, max_instructions - executed);
+
+        scheduler_run_due(emulator->scheduler, cpu->cyc);
+
+        // A breakpoint or watchpoint stopped the CPU
+        if (cpu->break_hit)
+            break;
+    }
+
+    emulator->total_instructions += executed;
+
+    // Stay paused where it stopped
+    if (cpu->break_hit)
+        display_break(emulator);
+
+    // Check for anomalies, record the rewind history and pace emulated time once per frame
+    if (emulator->frame_complete)
+    {
+        check_cpu_anomalies(emulator);
+        if (emulator->rewind)
+        {
+            emulator_save_state(emulator, emulator->rewind_state, emulator->rewind_state_size);
+            rewind_push(emulator->rewind, emulator->rewind_state);
+        }
+        emulator_throttle(emulator);
+    }
+
+    return executed;
+}
+
+/**
+ * Press the next simulated key once its time has come
+ * Keys start at 3 seconds of emulated time (following --speed/--turbo),
+ * spaced 500ms apart.
+ * Returns the key pressed, or 0 if none is due
+ */
+static char emulator_inject_simulated_key(spettrum_emulator_t *emulator)
+{
+    const char *keys = emulator->simulated_keys;
+    int index = emulator->simulated_key_index;
+
+    if (!keys || keys[index] == '\0')
+        return 0;
+
+    // Elapsed emulated time in milliseconds
+    uint64_t elapsed_ms = emulator->cpu->cyc / (SPECTRUM_CPU_CLOCK_HZ / 1000);
+    if (elapsed_ms < 3000 + (uint64_t)index * 500)
+        return 0;
+
+    keyboard_set_simulated_key(emulator->keyboard, keys[index]);
+    emulator->simulated_key_index++;
+    return keys[index];
+}
+
 /**
  * Main emulation loop - runs Z80 CPU in main thread while ULA renders in parallel
  */
@@ -678,20 +1617,26 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
 {
     printf("Starting emulation...\n");
     printf("Display: %dx%d\n", emulator->display->width, emulator->display->height);
-    printf("Memory: %d bytes\n", SPETTRUM_TOTAL_MEMORY);
+    printf("Memory: %d bytes (%s)\n", emulator->model == SPETTRUM_MODEL_128K ? SPETTRUM_128K_MEMORY : SPETTRUM_TOTAL_MEMORY,
+           emulator->model == SPETTRUM_MODEL_128K ? "128K" : "48K");
     printf("CPU: PC=0x%04X, SP=0x%04X\n", emulator->cpu->regs.pc, emulator->cpu->regs.sp);
     printf("\nExecuting Z80 instructions...");
     if (instructions_to_run > 0)
-        printf(" (limit: %llu instructions)", instructions_to_run);
+        printf(" (limit: %" PRIu64 " instructions)", instructions_to_run);
     else
         printf(" (unlimited)");
-    printf("\nControls: Ctrl+P=pause | [/]=speed | Ctrl+S=step | Ctrl+D=debug | Ctrl+C=stop\n\n");
+    printf("\nControls: Ctrl+P=pause | [/]=speed | Ctrl+S=step | Ctrl+D=debug | Ctrl+R=rewind | Ctrl+C=stop\n\n");
     fflush(stdout);
 
     // Initialize terminal for rendering
     ula_term_init();
 
+    // Host keys are read by their own thread from here on
+    if (keyboard_start_input(emulator->keyboard) != 0)
+        return -1;
+
     // Start ULA render thread
+    emulator->publish_frames = 1;
     pthread_t render_thread;
     if (pthread_create(&render_thread, NULL, ula_render_thread, emulator) != 0)
     {
@@ -702,17 +1647,16 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
     uint64_t instructions_executed = 0;
 
     // For simulated key timing
-    struct timespec start_time;
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    int simulated_key_index = 0;
+    emulator->pace_start_ns = monotonic_ns();
+    emulator->pace_frames = 0;
 
     // Run Z80 CPU in main thread
     while (emulator->running && (instructions_to_run == 0 || instructions_executed < instructions_to_run))
     {
-        // Check for control keys (keyboard input removed)
-        int key = -1;
+        // Control keys typed on the host (queued by the keyboard input thread)
+        int key = keyboard_get_control_key(emulator->keyboard);
 
-        if (key == 16) // Ctrl-P (ASCII 16)
+        if (key == KEYBOARD_CTRL_P)
         {
             if (emulator->step_mode)
             {
@@ -722,6 +1666,7 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
                 printf("\033[49;1H\033[K\033[50;1H\033[K\033[51;1H\033[K\033[52;1H\033[K\033[53;1H\033[K");
                 printf("\033[48;1H\033[K[Running]\033[48;1H");
                 fflush(stdout);
+                ula_request_redraw();
             }
             else
             {
@@ -736,17 +1681,18 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
                     printf("\033[49;1H\033[K\033[50;1H\033[K\033[51;1H\033[K\033[52;1H\033[K\033[53;1H\033[K");
                     printf("\033[48;1H\033[K[Running]\033[48;1H");
                     fflush(stdout);
+                    ula_request_redraw();
                 }
             }
         }
-        else if (key == 4) // Ctrl-D (ASCII 4)
+        else if (key == KEYBOARD_CTRL_D)
         {
             // Dump registers (works anytime, auto-pauses if not paused)
             if (!emulator->paused)
                 emulator->paused = 1;
             display_debug_info(emulator);
         }
-        else if (key == 19) // Ctrl-S (ASCII 19)
+        else if (key == KEYBOARD_CTRL_S)
         {
             // Toggle step mode or execute one step
             if (!emulator->step_mode)
@@ -763,6 +1709,11 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
                 emulator->paused = 0;
             }
         }
+        else if (key == KEYBOARD_CTRL_R)
+        {
+            // Step back one second (works while paused too)
+            emulator->rewind_request = 1;
+        }
         else if (key == '[')
         {
             emulator->speed_delay += 100;
@@ -780,6 +1731,12 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
             fflush(stdout);
         }
 
+        if (emulator->rewind_request)
+        {
+            emulator->rewind_request = 0;
+            emulator_rewind(emulator);
+        }
+
         // Skip execution if paused
         if (emulator->paused)
         {
@@ -788,28 +1745,12 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
         }
 
         // Handle simulated key injection (auto-replay starting at 3 seconds, spaced 500ms apart)
-        if (emulator->simulated_keys && emulator->simulated_keys[0] != '\0')
+        char key_char = emulator_inject_simulated_key(emulator);
+        if (key_char)
         {
-            struct timespec current_time;
-            clock_gettime(CLOCK_MONOTONIC, &current_time);
-
-            // Calculate elapsed time in milliseconds
-            long elapsed_ms = (current_time.tv_sec - start_time.tv_sec) * 1000 +
-                              (current_time.tv_nsec - start_time.tv_nsec) / 1000000;
-
-            // First key starts at 3000ms (3 seconds)
-            // Each subsequent key is 500ms after the previous one
-            long key_delay_ms = 3000 + (simulated_key_index * 500);
-
-            if (elapsed_ms >= key_delay_ms && simulated_key_index < (int)strlen(emulator->simulated_keys))
-            {
-                // Time to inject the next key
-                char key_char = emulator->simulated_keys[simulated_key_index];
-                keyboard_set_simulated_key(key_char);
-                printf("[Key injected: %c at %ldms]\n", key_char, elapsed_ms);
-                fflush(stdout);
-                simulated_key_index++;
-            }
+            printf("[Key injected: %c at %llums]\n", key_char,
+                   (unsigned long long)(emulator->cpu->cyc / (SPECTRUM_CPU_CLOCK_HZ / 1000)));
+            fflush(stdout);
         }
 
         // Check if memory dump was requested
@@ -819,94 +1760,436 @@ static int emulator_run(spettrum_emulator_t *emulator, uint64_t instructions_to_
             dump_memory_to_file(emulator);
         }
 
-        // Get current PC and opcode for disassembly BEFORE z80_step increments PC
-        uint16_t pc_before = emulator->cpu->regs.pc;
+        // Check if a profile dump was requested
+        if (emulator->dump_profile)
+        {
+            emulator->dump_profile = 0;
+            dump_profile_to_files(emulator);
+        }
 
-        // Execute a single instruction and accumulate cycles
-        int instruction_cycles = z80_step(emulator->cpu);
+        // Run the CPU up to the next frame interrupt (or the instruction limit)
+        uint64_t budget = instructions_to_run > 0 ? instructions_to_run - instructions_executed : UINT64_MAX;
+        instructions_executed += emulator_run_frame(emulator, budget);
+    }
 
-        // Now capture the opcode that was actually executed (from the PC position before step)
-        uint16_t pc = pc_before;
-        uint8_t opcode = emulator->memory[pc];
+    // Signal render thread to stop
+    emulator->running = 0;
 
-        // Record in history
-        emulator->last_pc[emulator->history_index] = pc;
-        emulator->last_opcode[emulator->history_index] = opcode;
-        emulator->history_index = (emulator->history_index + 1) % 10;
-        emulator->cpu->cyc += instruction_cycles;
+    // Wait for render thread to finish
+    pthread_join(render_thread, NULL);
 
-// ULA interrupt handling - trigger INT at ~50Hz (every ~70908 cycles at 3.5MHz)
-// Spectrum: ~69888 T-states minimum from vertical sync
-// Using 70908 for full frame with contention timing
-#define SPECTRUM_FRAME_CYCLES 70908 // Cycles per 50Hz frame
-#define INT_PULSE_CYCLES 32         // INT asserted for ~32 T-states
+    // Cleanup terminal rendering
+    ula_term_cleanup();
 
-        emulator->frame_cycle_count += instruction_cycles;
+    // Flush and close the trace if open
+    if (emulator->trace)
+    {
+        fprintf(stderr, "Trace: %llu instructions written\n",
+                (unsigned long long)trace_record_count(emulator->trace));
+        trace_close(emulator->trace);
+        emulator->trace = NULL;
+    }
 
-        // Check if we've completed a frame
-        if (emulator->frame_cycle_count >= SPECTRUM_FRAME_CYCLES)
-        {
-            // Reset frame counter
-            emulator->frame_cycle_count -= SPECTRUM_FRAME_CYCLES;
+    printf("\nEmulation completed.\n");
+    printf("Total instructions executed: %" PRIu64 "\n", instructions_executed);
+    printf("Total cycles: %" PRIu64 "\n", emulator->cpu->cyc);
+    printf("Final PC: 0x%04X\n", emulator->cpu->regs.pc);
+    return 0;
+}
 
-            // Assert INT signal - generates interrupt if IM1 is enabled
-            if (emulator->cpu->regs.iff1) // Check if interrupts are enabled
-            {
-                z80_gen_int(emulator->cpu, 0xFF); // Generate interrupt with data 0xFF for IM1
-                emulator->int_asserted = 1;
-                emulator->int_asserted_time = emulator->cpu->cyc;
-            }
-        }
+/**
+ * Run a machine headless until an exit condition
+ * No terminal, input thread or pacing: the machine runs flat out until the
+ * instruction limit (0 = none), max_frames frame interrupts, or HALT with
+ * interrupts disabled. Simulated keys are typed on emulated time as usual.
+ */
+static batch_exit_t emulator_run_headless(spettrum_emulator_t *emulator, uint64_t max_instructions,
+                                          uint64_t max_frames)
+{
+    z80_emulator_t *cpu = emulator->cpu;
+    uint64_t executed = 0;
 
-        // Check for anomalies every 1000 instructions
-        if (emulator->total_instructions % 1000 == 0)
-        {
-            check_cpu_anomalies(emulator);
-        }
+    emulator->speed_percent = 0;
+    while ((max_instructions == 0 || executed < max_instructions) && emulator->frame_count < max_frames)
+    {
+        if (batch_interrupted)
+            return BATCH_EXIT_INTERRUPTED;
 
-        // Log disassembly if enabled
-        if (emulator->disasm_file)
-        {
-            log_instruction_disassembly(emulator, pc, opcode);
-        }
+        emulator_inject_simulated_key(emulator);
 
-        emulator->total_instructions++;
-        instructions_executed++;
+        uint64_t budget = max_instructions > 0 ? max_instructions - executed : UINT64_MAX;
+        executed += emulator_run_frame(emulator, budget);
 
-        // In step mode, pause after each instruction and show debug info
-        if (emulator->step_mode)
+        if (cpu->halted && !cpu->regs.iff1)
+            return BATCH_EXIT_HALTED;
+    }
+    return BATCH_EXIT_LIMIT;
+}
+
+/**
+ * One image of a --batch directory
+ */
+typedef struct
+{
+    const char *name;        // File name within the directory
+    int is_tape;             // TAP/TZX file (else a .z80 snapshot)
+    uint32_t snapshot_index; // Index in the snapshot library
+} batch_job_t;
+
+/**
+ * Shared, read-only setup of a --batch run (results are per job)
+ */
+typedef struct
+{
+    const char *dirname;
+    z80_snapshot_library_t *snapshots;
+    batch_job_t *jobs;
+    size_t job_count;
+    batch_result_t *results;
+    const uint8_t *rom; // Mapped ROM image, copied into every machine
+    size_t rom_size;
+    const char *keys;   // Keys typed into every machine (-k), NULL for the default
+    int quick_load;     // Load tapes straight to memory (-q)
+    int block_engine;   // Run the CPUs on the block engine (-B)
+    uint64_t max_instructions;
+    uint64_t max_frames;
+} batch_context_t;
+
+static int batch_is_tape_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && (strcasecmp(name + len - 4, ".tap") == 0 || strcasecmp(name + len - 4, ".tzx") == 0);
+}
+
+static int batch_compare_jobs(const void *a, const void *b)
+{
+    return strcmp(((const batch_job_t *)a)->name, ((const batch_job_t *)b)->name);
+}
+
+/**
+ * FNV-1a hash of all RAM banks, to compare runs without storing memory images
+ */
+static uint32_t batch_ram_hash(const spettrum_emulator_t *emulator)
+{
+    // The 48K RAM (banks 5, 2, 0), then the 128K's other banks past ROM 1
+    size_t end = emulator->model == SPETTRUM_MODEL_128K ? SPETTRUM_128K_MEMORY : SPETTRUM_TOTAL_MEMORY;
+    uint32_t hash = 2166136261u;
+    for (size_t addr = SPETTRUM_ROM_SIZE; addr < end; addr++)
+    {
+        if (addr == SPETTRUM_TOTAL_MEMORY)
+            addr += SPETTRUM_BANK_SIZE;
+        hash = (hash ^ emulator->memory[addr]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Insert a tape image into a batch machine
+ * Tapes are flash-loaded after typing the keys (LOAD "" by default), or
+ * quick-loaded to memory with -q.
+ */
+static int batch_load_tape(spettrum_emulator_t *emulator, const batch_context_t *batch, const char *name)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/%s", batch->dirname, name) >= (int)sizeof(path))
+    {
+        fprintf(stderr, "Error: Path too long for '%s'\n", name);
+        return -1;
+    }
+
+    if (batch->quick_load)
+    {
+        z80_invalidate_code(emulator->cpu, 0, Z80_MAX_MEMORY);
+        return tap_load_to_memory(path, emulator->memory, SPETTRUM_TOTAL_MEMORY, 0x5C00);
+    }
+
+    emulator->tape_player = tape_player_init(path);
+    if (!emulator->tape_player)
+        return -1;
+    emulator->use_authentic_loading = 1;
+    emulator->flash_loading = 1;
+    z80_set_exec_trap(emulator->cpu, SPECTRUM_ROM_LD_BYTES, flash_load_trap, emulator);
+    if (!batch->keys)
+        emulator->simulated_keys = BATCH_TAPE_KEYS;
+    return 0;
+}
+
+/**
+ * Batch job: run one image on its own machine
+ */
+static void batch_run_image(void *context, size_t index, int worker)
+{
+    batch_context_t *batch = (batch_context_t *)context;
+    const batch_job_t *job = &batch->jobs[index];
+    batch_result_t *result = &batch->results[index];
+    uint64_t start_ns = monotonic_ns();
+
+    memset(result, 0, sizeof(*result));
+    result->worker = worker;
+    result->exit = BATCH_EXIT_INTERRUPTED;
+    if (batch_interrupted)
+        return;
+
+    result->exit = BATCH_EXIT_ERROR;
+    spettrum_emulator_t *emulator = emulator_init(ULA_RENDER_BLOCK2X2, false);
+    if (!emulator)
+        return;
+    if (batch->block_engine && z80_set_block_engine(emulator->cpu, true) != 0)
+    {
+        emulator_cleanup(emulator);
+        return;
+    }
+
+    emulator->simulated_keys = batch->keys;
+
+    int loaded = emulator_install_rom(emulator, batch->rom, batch->rom_size);
+    if (loaded == 0)
+        loaded = job->is_tape ? batch_load_tape(emulator, batch, job->name)
+                              : emulator_restore_snapshot(emulator, batch->snapshots, job->snapshot_index, NULL);
+    if (loaded == 0)
+    {
+        result->exit = emulator_run_headless(emulator, batch->max_instructions, batch->max_frames);
+        result->instructions = emulator->total_instructions;
+        result->cycles = emulator->cpu->cyc;
+        result->frames = emulator->frame_count;
+        result->pc = emulator->cpu->regs.pc;
+        result->ram_hash = batch_ram_hash(emulator);
+    }
+
+    emulator_cleanup(emulator);
+    result->seconds = (double)(monotonic_ns() - start_ns) / 1e9;
+}
+
+/**
+ * List the snapshots and tapes of the batch directory, sorted by name
+ * Snapshots come from the snapshot library, tapes from a second scan.
+ * Returns 0 on success, -1 on error (batch_close() frees what was listed)
+ */
+static int batch_collect_jobs(batch_context_t *batch)
+{
+    batch->snapshots = z80_snapshot_library_open(batch->dirname);
+    if (!batch->snapshots)
+        return -1;
+
+    DIR *dir = opendir(batch->dirname);
+    if (!dir)
+    {
+        fprintf(stderr, "Error: Cannot open batch directory '%s'\n", batch->dirname);
+        return -1;
+    }
+
+    uint32_t snapshot_count = z80_snapshot_library_count(batch->snapshots);
+    size_t capacity = snapshot_count + 64;
+    batch->jobs = malloc(capacity * sizeof(batch_job_t));
+    if (!batch->jobs)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for batch job list\n");
+        closedir(dir);
+        return -1;
+    }
+    for (uint32_t i = 0; i < snapshot_count; i++)
+    {
+        batch_job_t *job = &batch->jobs[batch->job_count++];
+        job->name = z80_snapshot_library_name(batch->snapshots, i);
+        job->is_tape = 0;
+        job->snapshot_index = i;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!batch_is_tape_name(entry->d_name))
+            continue;
+        if (batch->job_count == capacity)
         {
-            emulator->paused = 1;
-            display_debug_info(emulator);
+            batch_job_t *jobs = realloc(batch->jobs, capacity * 2 * sizeof(batch_job_t));
+            if (!jobs)
+                break;
+            batch->jobs = jobs;
+            capacity *= 2;
         }
+        batch_job_t *job = &batch->jobs[batch->job_count];
+        job->name = strdup(entry->d_name);
+        if (!job->name)
+            break;
+        job->is_tape = 1;
+        job->snapshot_index = 0;
+        batch->job_count++;
+    }
+    closedir(dir);
 
-        // Apply speed delay if set
-        if (emulator->speed_delay > 0)
+    if (entry != NULL)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for batch job list\n");
+        return -1;
+    }
+    if (batch->job_count == 0)
+    {
+        fprintf(stderr, "Error: No .z80, .tap or .tzx files in '%s'\n", batch->dirname);
+        return -1;
+    }
+
+    qsort(batch->jobs, batch->job_count, sizeof(batch_job_t), batch_compare_jobs);
+    return 0;
+}
+
+/**
+ * Free the job list, results and snapshot library of a batch
+ */
+static void batch_close(batch_context_t *batch)
+{
+    if (batch->jobs)
+    {
+        for (size_t i = 0; i < batch->job_count; i++)
         {
-            usleep(emulator->speed_delay);
+            if (batch->jobs[i].is_tape)
+                free((char *)batch->jobs[i].name);
         }
+        free(batch->jobs);
     }
+    free(batch->results);
+    z80_snapshot_library_close(batch->snapshots);
+}
 
-    // Signal render thread to stop
-    emulator->running = 0;
+/**
+ * Run every snapshot and tape in a directory on a pool of machines (--batch)
+ * Prints one line per image in name order, then a summary.
+ * Returns EXIT_SUCCESS if every image ran, EXIT_FAILURE otherwise
+ */
+static int run_batch(const char *dirname, const char *rom_file, int workers, const char *keys,
+                     int quick_load, int block_engine, uint64_t max_instructions)
+{
+    static const char *const exit_names[] = {"limit", "halted", "interrupted", "error"};
 
-    // Wait for render thread to finish
-    pthread_join(render_thread, NULL);
+    size_t rom_size;
+    const uint8_t *rom = mapfile_map(AT_FDCWD, rom_file, &rom_size);
+    if (!rom)
+    {
+        fprintf(stderr, "Error: Cannot open ROM file '%s'\n", rom_file);
+        return EXIT_FAILURE;
+    }
+    if (rom_size > SPETTRUM_ROM_SIZE && rom_size != SPETTRUM_128K_ROM_SIZE)
+    {
+        fprintf(stderr, "Error: ROM file has %zu bytes (48K: up to %d bytes, 128K: %d bytes)\n", rom_size,
+                SPETTRUM_ROM_SIZE, SPETTRUM_128K_ROM_SIZE);
+        mapfile_unmap(rom, rom_size);
+        return EXIT_FAILURE;
+    }
 
-    // Cleanup terminal rendering
-    ula_term_cleanup();
+    batch_context_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.dirname = dirname;
+    batch.rom = rom;
+    batch.rom_size = rom_size;
+    batch.keys = keys;
+    batch.quick_load = quick_load;
+    batch.block_engine = block_engine;
+    batch.max_instructions = max_instructions;
+    batch.max_frames = max_instructions > 0 ? UINT64_MAX : BATCH_DEFAULT_FRAMES;
+
+    if (batch_collect_jobs(&batch) == 0)
+        batch.results = calloc(batch.job_count, sizeof(batch_result_t));
+    if (!batch.results)
+    {
+        batch_close(&batch);
+        mapfile_unmap(rom, rom_size);
+        return EXIT_FAILURE;
+    }
 
-    // Close disassembly file if open
-    if (emulator->disasm_file)
+    // Run, then report in name order so results diff cleanly between runs
+    uint64_t start_ns = monotonic_ns();
+    workers = batch_run(batch.job_count, workers, batch_run_image, &batch);
+    double elapsed = (double)(monotonic_ns() - start_ns) / 1e9;
+
+    size_t counts[4] = {0, 0, 0, 0};
+    uint64_t total_instructions = 0;
+    for (size_t i = 0; i < batch.job_count; i++)
     {
-        fclose(emulator->disasm_file);
-        emulator->disasm_file = NULL;
+        const batch_result_t *result = &batch.results[i];
+        counts[result->exit]++;
+        total_instructions += result->instructions;
+        printf("%s: %s pc=0x%04X ram=0x%08X instructions=%llu cycles=%llu frames=%llu time=%.3fs worker=%d\n",
+               batch.jobs[i].name, exit_names[result->exit], result->pc, result->ram_hash,
+               (unsigned long long)result->instructions, (unsigned long long)result->cycles,
+               (unsigned long long)result->frames, result->seconds, result->worker);
     }
+    printf("Batch: %zu images (%zu halted, %zu at limit, %zu errors, %zu interrupted) on %d workers "
+           "in %.3fs, %.1f MIPS\n",
+           batch.job_count, counts[BATCH_EXIT_HALTED], counts[BATCH_EXIT_LIMIT], counts[BATCH_EXIT_ERROR],
+           counts[BATCH_EXIT_INTERRUPTED], workers, elapsed,
+           elapsed > 0 ? (double)total_instructions / elapsed / 1e6 : 0.0);
+
+    batch_close(&batch);
+    mapfile_unmap(rom, rom_size);
+    return counts[BATCH_EXIT_ERROR] == 0 && counts[BATCH_EXIT_INTERRUPTED] == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-    printf("\nEmulation completed.\n");
-    printf("Total instructions executed: %llu\n", instructions_executed);
-    printf("Total cycles: %llu\n", emulator->cpu->cyc);
-    printf("Final PC: 0x%04X\n", emulator->cpu->regs.pc);
+/**
+ * Parse a watchpoint argument into watch (fn and user_data are left unset)
+ * --break ADDR[,REG=VALUE] passes Z80_WATCH_EXEC; --watch KINDS:START[-END][,REG=VALUE]
+ * passes 0 and names the kinds with any of 'r', 'w' and 'x'.
+ * Returns 0 on success, -1 on a malformed argument
+ */
+static int parse_watchpoint(const char *text, uint8_t kinds, z80_watchpoint_t *watch)
+{
+    static const char *const reg_names[] = {"", "A", "F", "B", "C", "D", "E", "H", "L",
+                                            "AF", "BC", "DE", "HL", "IX", "IY", "SP"};
+    const char *p = text;
+
+    memset(watch, 0, sizeof(*watch));
+    if (!kinds)
+    {
+        for (; *p && *p != ':'; p++)
+        {
+            if (*p == 'r')
+                kinds |= Z80_WATCH_READ;
+            else if (*p == 'w')
+                kinds |= Z80_WATCH_WRITE;
+            else if (*p == 'x')
+                kinds |= Z80_WATCH_EXEC;
+            else
+                return -1;
+        }
+        if (*p++ != ':' || !kinds)
+            return -1;
+    }
+    watch->kinds = kinds;
+
+    // Address range
+    char *end;
+    long start = strtol(p, &end, 0);
+    long last = start;
+    if (end == p || start < 0 || start > 0xFFFF)
+        return -1;
+    if (*end == '-')
+    {
+        p = end + 1;
+        last = strtol(p, &end, 0);
+        if (end == p || last < start || last > 0xFFFF)
+            return -1;
+    }
+    watch->start = (uint16_t)start;
+    watch->end = (uint16_t)last;
+    if (*end == '\0')
+        return 0;
+
+    // Optional register condition
+    if (*end != ',')
+        return -1;
+    p = end + 1;
+    const char *equals = strchr(p, '=');
+    if (!equals)
+        return -1;
+    for (int reg = Z80_WATCH_REG_A; reg <= Z80_WATCH_REG_SP; reg++)
+    {
+        if (strlen(reg_names[reg]) == (size_t)(equals - p) && strncasecmp(p, reg_names[reg], equals - p) == 0)
+            watch->reg = (z80_watch_reg_t)reg;
+    }
+    long value = strtol(equals + 1, &end, 0);
+    if (watch->reg == Z80_WATCH_ALWAYS || end == equals + 1 || *end != '\0' || value < 0 ||
+        value > (watch->reg <= Z80_WATCH_REG_L ? 0xFF : 0xFFFF))
+        return -1;
+    watch->value = (uint16_t)value;
     return 0;
 }
 
@@ -919,13 +2202,26 @@ int main(int argc, char *argv[])
     const char *snapshot_file = NULL;
     const char *tap_file = NULL;
     const char *disk_file = NULL;
-    const char *disasm_file = NULL;
+    const char *trace_file = NULL;
+    const char *profile_prefix = NULL;              // Profile output prefix (--profile)
     const char *simulated_keys = NULL;              // Simulated key string for testing
     int use_authentic_tape_loading = 1;             // Default: use ROM loader (authentic)
+    int flash_tape_loading = 0;                     // Trap the ROM loader (--flash-load)
     uint64_t instructions_to_run = 0;               // Default: unlimited
     ula_render_mode_t render_mode = ULA_RENDER_OCR; // Default: ocr
     int audio_enabled = 1;                          // Default: audio enabled
     int audio_volume = 50;                          // Default: 50% volume
+    int speed_percent = 100;                        // Default: real time (0 = turbo)
+    int block_engine = 0;                           // Predecoded block engine (--blocks)
+    const char *audio_out_file = NULL;              // WAV output path (--audio-out)
+    const char *load_state_file = NULL;             // Save state to restore (--load-state)
+    const char *save_state_file = NULL;             // Save state to write on exit (--save-state)
+    uint32_t rewind_seconds = 0;                    // Rewind history length (0 = disabled)
+    size_t rewind_mb = REWIND_DEFAULT_MB;           // Rewind history memory cap
+    const char *batch_dir = NULL;                   // Directory of images to run (--batch)
+    int batch_workers = batch_default_workers();    // Worker threads for --batch
+    z80_watchpoint_t watchpoints[Z80_MAX_WATCHPOINTS]; // --break/--watch
+    int watchpoint_count = 0;
 
     // Command-line options
     struct option long_options[] = {
@@ -935,19 +2231,32 @@ int main(int argc, char *argv[])
         {"snapshot", required_argument, 0, 's'},
         {"tap", required_argument, 0, 't'},
         {"quick-load", no_argument, 0, 'q'},
+        {"flash-load", no_argument, 0, 'F'},
         {"disk", required_argument, 0, 'd'},
         {"instructions", required_argument, 0, 'i'},
         {"disassemble", required_argument, 0, 'D'},
+        {"profile", required_argument, 0, 'P'},
         {"render-mode", required_argument, 0, 'm'},
         {"simulate-key", required_argument, 0, 'k'},
         {"audio", required_argument, 0, 'a'},
         {"volume", required_argument, 0, 'V'},
+        {"speed", required_argument, 0, 'S'},
+        {"turbo", no_argument, 0, 'T'},
+        {"blocks", no_argument, 0, 'B'},
+        {"audio-out", required_argument, 0, 'w'},
+        {"load-state", required_argument, 0, 'l'},
+        {"save-state", required_argument, 0, 'o'},
+        {"rewind", required_argument, 0, 'R'},
+        {"batch", required_argument, 0, 'b'},
+        {"jobs", required_argument, 0, 'j'},
+        {"break", required_argument, 0, 'x'},
+        {"watch", required_argument, 0, 'W'},
         {0, 0, 0, 0}};
 
     // Parse command-line arguments
     int option_index = 0;
     int c;
-    while ((c = getopt_long(argc, argv, "hvr:s:t:qd:i:D:m:k:a:V:", long_options, &option_index)) != -1)
+    while ((c = getopt_long(argc, argv, "hvr:s:t:qFd:i:D:P:m:k:a:V:S:TBw:l:o:R:b:j:x:W:", long_options, &option_index)) != -1)
     {
         switch (c)
         {
@@ -969,6 +2278,9 @@ int main(int argc, char *argv[])
         case 'q':
             use_authentic_tape_loading = 0; // Disable authentic loading (use quick-load)
             break;
+        case 'F':
+            flash_tape_loading = 1;
+            break;
         case 'd':
             disk_file = optarg;
             break;
@@ -976,7 +2288,10 @@ int main(int argc, char *argv[])
             instructions_to_run = strtoull(optarg, NULL, 10);
             break;
         case 'D':
-            disasm_file = optarg;
+            trace_file = optarg;
+            break;
+        case 'P':
+            profile_prefix = optarg;
             break;
         case 'm':
             if (strcmp(optarg, "block") == 0 || strcmp(optarg, "2x2") == 0)
@@ -1026,6 +2341,86 @@ int main(int argc, char *argv[])
                 return EXIT_FAILURE;
             }
             break;
+        case 'S':
+        {
+            // Emulation speed in percent, optional trailing '%'
+            char *end;
+            long speed = strtol(optarg, &end, 10);
+            if (end == optarg || (*end != '\0' && strcmp(end, "%") != 0) || speed < 1 || speed > 10000)
+            {
+                fprintf(stderr, "Error: Speed must be a percentage between 1 and 10000\n");
+                return EXIT_FAILURE;
+            }
+            speed_percent = (int)speed;
+            break;
+        }
+        case 'T':
+            speed_percent = 0; // Unthrottled
+            break;
+        case 'B':
+            block_engine = 1;
+            break;
+        case 'w':
+            audio_out_file = optarg;
+            break;
+        case 'l':
+            load_state_file = optarg;
+            break;
+        case 'o':
+            save_state_file = optarg;
+            break;
+        case 'R':
+        {
+            // History length in seconds, optional memory cap in MB
+            char *end;
+            long seconds = strtol(optarg, &end, 10);
+            long mb = REWIND_DEFAULT_MB;
+            if (*end == ',')
+            {
+                char *mb_text = end + 1;
+                mb = strtol(mb_text, &end, 10);
+                if (end == mb_text)
+                    mb = 0;
+            }
+            if (end == optarg || *end != '\0' || seconds < 1 || seconds > 3600 || mb < 1 || mb > 4096)
+            {
+                fprintf(stderr, "Error: Rewind must be SECONDS[,MB] (1-3600 seconds, 1-4096 MB)\n");
+                return EXIT_FAILURE;
+            }
+            rewind_seconds = (uint32_t)seconds;
+            rewind_mb = (size_t)mb;
+            break;
+        }
+        case 'b':
+            batch_dir = optarg;
+            break;
+        case 'j':
+        {
+            char *end;
+            long workers = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || workers < 1 || workers > BATCH_MAX_WORKERS)
+            {
+                fprintf(stderr, "Error: Jobs must be between 1 and %d\n", BATCH_MAX_WORKERS);
+                return EXIT_FAILURE;
+            }
+            batch_workers = (int)workers;
+            break;
+        }
+        case 'x':
+        case 'W':
+            if (watchpoint_count == Z80_MAX_WATCHPOINTS)
+            {
+                fprintf(stderr, "Error: At most %d breakpoints and watchpoints\n", Z80_MAX_WATCHPOINTS);
+                return EXIT_FAILURE;
+            }
+            if (parse_watchpoint(optarg, c == 'x' ? Z80_WATCH_EXEC : 0, &watchpoints[watchpoint_count]) != 0)
+            {
+                fprintf(stderr, "Error: %s must be %s[,REG=VALUE]\n", c == 'x' ? "Breakpoint" : "Watchpoint",
+                        c == 'x' ? "ADDR" : "r|w|x:START[-END]");
+                return EXIT_FAILURE;
+            }
+            watchpoint_count++;
+            break;
         case '?':
             // getopt_long already printed error message
             fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
@@ -1044,16 +2439,66 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    // Batch mode: a headless machine per image, no terminal or audio
+    if (batch_dir)
+    {
+        if (!rom_file)
+        {
+            fprintf(stderr, "Error: --batch needs a ROM (-r)\n");
+            return EXIT_FAILURE;
+        }
+        if (snapshot_file || tap_file || disk_file || trace_file || profile_prefix || audio_out_file ||
+            load_state_file || save_state_file || rewind_seconds > 0 || watchpoint_count > 0)
+        {
+            fprintf(stderr, "Error: --batch only combines with -r, -i, -k, -q, -B and -j\n");
+            return EXIT_FAILURE;
+        }
+        signal(SIGINT, signal_handler);
+        signal(SIGQUIT, signal_handler);
+        return run_batch(batch_dir, rom_file, batch_workers, simulated_keys, !use_authentic_tape_loading,
+                         block_engine, instructions_to_run);
+    }
+
     // Initialize emulator
-    spettrum_emulator_t *emulator = emulator_init(render_mode);
+    spettrum_emulator_t *emulator = emulator_init(render_mode, true);
     if (!emulator)
     {
         fprintf(stderr, "Error: Failed to initialize emulator\n");
         return EXIT_FAILURE;
     }
 
-    // Initialize dump counter
-    emulator->dump_count = 0;
+    // Breakpoints and watchpoints pause the emulator when they fire
+    for (int i = 0; i < watchpoint_count; i++)
+    {
+        watchpoints[i].fn = emulator_break_hit;
+        watchpoints[i].user_data = emulator;
+        if (z80_add_watchpoint(emulator->cpu, &watchpoints[i]) < 0)
+        {
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Offline audio replaces the live device and runs at any speed
+    if (audio_out_file)
+    {
+        emulator->audio_recorder = beeper_recorder_open(audio_out_file, SPECTRUM_CPU_CLOCK_HZ,
+                                                        44100, (uint8_t)audio_volume);
+        if (!emulator->audio_recorder)
+        {
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+        audio_enabled = 0;
+    }
+
+    // Configure emulation speed; the beeper only plays in real time
+    emulator->speed_percent = speed_percent;
+    if (speed_percent != 100 && audio_enabled)
+    {
+        fprintf(stderr, "Audio muted (emulation speed is not 100%%)\n");
+        audio_enabled = 0;
+    }
 
     // Configure audio based on command-line options
     emulator->audio_enabled = audio_enabled;
@@ -1073,44 +2518,53 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Initialize pause state and speed control
-    emulator->paused = 0;
-    emulator->speed_delay = 0;
-    emulator->step_mode = 0;
-
-    // Initialize debug tracking
-    memset(emulator->last_pc, 0, sizeof(emulator->last_pc));
-    memset(emulator->last_opcode, 0, sizeof(emulator->last_opcode));
-    emulator->history_index = 0;
-    emulator->total_instructions = 0;
+    // Open binary trace if specified
+    if (trace_file)
+    {
+        emulator->trace = trace_open(trace_file);
+        if (!emulator->trace)
+        {
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Binary trace will be written to '%s' (view with spettrum-trace)\n", trace_file);
+    }
 
-    // Initialize anomaly tracking
-    emulator->warnings_pc_in_vram = 0;
-    emulator->warnings_sp_in_vram = 0;
-    emulator->last_warn_pc = 0;
-    emulator->last_warn_sp = 0;
-    memset(emulator->warn_pc_history, 0, sizeof(emulator->warn_pc_history));
-    emulator->warn_sp_at_fault = 0;
-    emulator->warn_pc_at_sp_fault = 0;
+    // Attach the profiler if specified
+    if (profile_prefix)
+    {
+        emulator->profile = z80_profile_create();
+        if (!emulator->profile)
+        {
+            fprintf(stderr, "Error: Cannot allocate profile\n");
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+        emulator->profile_prefix = profile_prefix;
+        z80_set_profile(emulator->cpu, emulator->profile);
+        fprintf(stderr, "Profile will be written to '%s.txt' and '%s.folded' (also on kill -PROF <pid>)\n",
+                profile_prefix, profile_prefix);
+    }
 
-    // Open disassembly file if specified
-    if (disasm_file)
+    // The profiler runs its own loop on the interpreter
+    if (block_engine)
     {
-        emulator->disasm_file = fopen(disasm_file, "w");
-        if (!emulator->disasm_file)
+        if (z80_set_block_engine(emulator->cpu, true) != 0)
         {
-            fprintf(stderr, "Error: Cannot open disassembly file '%s'\n", disasm_file);
             emulator_cleanup(emulator);
             return EXIT_FAILURE;
         }
-        fprintf(stderr, "Disassembly will be written to '%s'\n", disasm_file);
+        if (profile_prefix)
+            fprintf(stderr, "Block engine unused while profiling\n");
     }
 
     // Set up signal handlers for graceful shutdown
     g_emulator = emulator;
-    signal(SIGINT, signal_handler);       // Ctrl+C
-    signal(SIGQUIT, signal_handler);      // Ctrl+D (SIGQUIT)
-    signal(SIGUSR1, dump_memory_handler); // Memory dump (kill -USR1 <pid>)
+    signal(SIGINT, signal_handler);        // Ctrl+C
+    signal(SIGQUIT, signal_handler);       // Ctrl+D (SIGQUIT)
+    signal(SIGUSR1, dump_memory_handler);  // Memory dump (kill -USR1 <pid>)
+    signal(SIGUSR2, rewind_handler);       // Rewind (kill -USR2 <pid>)
+    signal(SIGPROF, dump_profile_handler); // Profile dump (kill -PROF <pid>)
 
     // Load ROM if specified
     if (rom_file)
@@ -1126,7 +2580,7 @@ int main(int argc, char *argv[])
     // Load Z80 snapshot if specified (restores CPU and memory state)
     if (snapshot_file)
     {
-        if (z80_snapshot_load(snapshot_file, emulator->cpu, emulator->memory) != 0)
+        if (emulator_restore_snapshot(emulator, NULL, 0, snapshot_file) != 0)
         {
             fprintf(stderr, "Error: Failed to load Z80 snapshot from '%s'\n", snapshot_file);
             emulator_cleanup(emulator);
@@ -1147,7 +2601,13 @@ int main(int argc, char *argv[])
                 emulator_cleanup(emulator);
                 return EXIT_FAILURE;
             }
+            tape_player_print_info(emulator->tape_player);
             emulator->use_authentic_loading = 1;
+            if (flash_tape_loading)
+            {
+                emulator->flash_loading = 1;
+                z80_set_exec_trap(emulator->cpu, SPECTRUM_ROM_LD_BYTES, flash_load_trap, emulator);
+            }
             printf("\n");
             printf("╔════════════════════════════════════════════════════════════════╗\n");
             printf("║  TAP TAPE LOADED - Authentic ROM Loading Mode                 ║\n");
@@ -1158,9 +2618,13 @@ int main(int argc, char *argv[])
             printf("║      LOAD \"\"                                                   ║\n");
             printf("║                                                                ║\n");
             printf("║  and press ENTER to start loading from tape.                  ║\n");
+#ifdef SPETTRUM_IO_DEBUG
             printf("║  Debug logs: tap.log and tap_port.log                         ║\n");
+#endif
             printf("╚════════════════════════════════════════════════════════════════╝\n");
             printf("\n");
+            if (emulator->flash_loading)
+                printf("Flash loading: ROM tape loads complete instantly\n\n");
         }
         else
         {
@@ -1172,6 +2636,7 @@ int main(int argc, char *argv[])
                 emulator_cleanup(emulator);
                 return EXIT_FAILURE;
             }
+            z80_invalidate_code(emulator->cpu, 0, Z80_MAX_MEMORY);
         }
     }
 
@@ -1186,6 +2651,29 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Restore a saved machine state on top of the loaded ROM and tape
+    if (load_state_file)
+    {
+        if (emulator_load_state_file(emulator, load_state_file) != 0)
+        {
+            fprintf(stderr, "Error: Failed to load save state from '%s'\n", load_state_file);
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+        printf("Restored machine state from '%s'\n", load_state_file);
+    }
+
+    // Start recording the rewind history from the initial state
+    if (rewind_seconds > 0)
+    {
+        if (emulator_enable_rewind(emulator, rewind_seconds, rewind_mb) != 0)
+        {
+            emulator_cleanup(emulator);
+            return EXIT_FAILURE;
+        }
+        printf("Rewind: last %u seconds (up to %zu MB)\n", rewind_seconds, rewind_mb);
+    }
+
     // Set simulated keys if provided
     if (simulated_keys && simulated_keys[0] != '\0')
     {
@@ -1196,6 +2684,13 @@ int main(int argc, char *argv[])
     // Run emulation
     int result = emulator_run(emulator, instructions_to_run);
 
+    // Write the profile of the whole run
+    dump_profile_to_files(emulator);
+
+    // Save the machine state where emulation stopped
+    if (save_state_file && emulator_save_state_file(emulator, save_state_file) != 0)
+        result = EXIT_FAILURE;
+
     // Display anomaly summary
     display_anomaly_summary(emulator);
 
@@ -15,29 +15,139 @@
 #define SPETTRUM_VRAM_START 0x4000        // Video RAM starts at 0x4000
 #define SPETTRUM_VRAM_SIZE 6912           // Video RAM is 6912 bytes (256x192 pixels + attributes)
 
+// 128K/+2 memory: two ROMs and eight RAM banks, paged through port 0x7FFD
+#define SPETTRUM_BANK_SIZE 0x4000                           // ROMs, RAM banks and address slots are 16 KB
+#define SPETTRUM_RAM_BANKS 8                                // RAM banks 0-7 (5 and 7 hold screens)
+#define SPETTRUM_128K_ROM_SIZE (2 * SPETTRUM_BANK_SIZE)     // 128K editor ROM followed by 48K BASIC ROM
+#define SPETTRUM_128K_MEMORY (10 * SPETTRUM_BANK_SIZE)      // Both ROMs and all RAM banks
+#define SPETTRUM_7FFD_RAM_MASK 0x07  // Bits 0-2: RAM bank at 0xC000
+#define SPETTRUM_7FFD_SCREEN 0x08    // Bit 3: display bank 7 instead of bank 5
+#define SPETTRUM_7FFD_ROM 0x10       // Bit 4: 48K BASIC ROM instead of the 128K editor
+#define SPETTRUM_7FFD_LOCK 0x20      // Bit 5: ignore further writes until reset
+
+// I/O port decoding (mask, match): a device answers when (port & mask) == match
+#define SPETTRUM_PORT_ULA_MASK 0x0001      // ULA: A0 low (keyboard, EAR, border, beeper)
+#define SPETTRUM_PORT_ULA_MATCH 0x0000
+#define SPETTRUM_PORT_KEMPSTON_MASK 0x00E0 // Kempston joystick: A5-A7 low (0x1F)
+#define SPETTRUM_PORT_KEMPSTON_MATCH 0x0000
+#define SPETTRUM_PORT_AY_MASK 0xC002       // AY-3-8912 (128K): A15 high, A1 low
+#define SPETTRUM_PORT_AY_REG_MATCH 0xC000  // 0xFFFD: register select / read
+#define SPETTRUM_PORT_AY_DATA_MATCH 0x8000 // 0xBFFD: data write
+#define SPETTRUM_PORT_7FFD_MASK 0x8002     // 128K memory paging: A15 and A1 low (0x7FFD)
+#define SPETTRUM_PORT_7FFD_MATCH 0x0000
+
+// ULA interrupt timing - INT at ~50Hz (every ~70908 cycles at 3.5MHz)
+// Spectrum: ~69888 T-states minimum from vertical sync
+// Using 70908 for full frame with contention timing
+#define SPECTRUM_FRAME_CYCLES 70908 // Cycles per 50Hz frame
+#define INT_PULSE_CYCLES 32         // INT asserted for ~32 T-states
+
+// Real-time pacing (--speed / --turbo)
+#define SPECTRUM_CPU_CLOCK_HZ 3500000 // Z80 clock rate
+#define SPECTRUM_FRAME_NS (SPECTRUM_FRAME_CYCLES * 1000000000ULL / SPECTRUM_CPU_CLOCK_HZ)
+#define SPEED_MAX_LAG_FRAMES 5 // Frames behind real time before pacing resyncs
+
+// 48K ROM tape loader (--flash-load)
+#define SPECTRUM_ROM_LD_BYTES 0x0556 // LD-BYTES entry: A=flag, IX=dest, DE=length, CF=load
+#define SPECTRUM_SYSVAR_BORDCR 0x5C48 // Border colour system variable (bits 3-5)
+
 #include "z80.h"
 #include "ula.h"
 #include "tap.h"
 #include "beeper.h"
+#include "scheduler.h"
+#include "rewind.h"
+#include "trace.h"
+#include "disasm.h"
+#include "keyboard.h"
+
+// Native save state format (--save-state / --load-state)
+#define SPETTRUM_STATE_MAGIC "SPST"
+#define SPETTRUM_STATE_VERSION 2
+
+// Rewind history (--rewind)
+#define REWIND_DEFAULT_MB 32   // History memory when the option gives no size
+#define REWIND_STEP_FRAMES 50  // Frames stepped back per rewind request (one second)
+
+// Batch runs (--batch)
+#define BATCH_DEFAULT_FRAMES 1500 // Emulated frames per image without -i (30 seconds)
+#define BATCH_TAPE_KEYS "j''\n"  // Typed for tapes without -k: LOAD "" ENTER
+
+/**
+ * Save state header
+ *
+ * A save state is this header followed by the z80_save_state() record
+ * (cpu_size bytes), the machine's memory (the 64KB address space of a 48K,
+ * both ROMs and all RAM banks of a 128K, in spettrum_emulator_t order), and the
+ * tape_player_save_state() record when a tape is loaded (tape_size bytes).
+ * Everything is in native byte order and struct layout; the version and
+ * section sizes reject states from an incompatible build.
+ *
+ * Deadlines are stored relative to the CPU cycle counter at save time and
+ * re-based onto the current counter on load, so emulated time never runs
+ * backwards for the audio output.
+ */
+typedef struct
+{
+    char magic[4];          // SPETTRUM_STATE_MAGIC
+    uint16_t version;       // SPETTRUM_STATE_VERSION
+    uint16_t header_size;   // sizeof(spettrum_state_header_t)
+    uint32_t cpu_size;      // Z80_STATE_SIZE
+    uint32_t memory_size;   // SPETTRUM_TOTAL_MEMORY (48K) or SPETTRUM_128K_MEMORY (128K)
+    uint32_t tape_size;     // tape_player_state_size(), 0 without a tape
+    uint32_t frame_delta;   // Cycles from the save point to the next frame INT
+    uint32_t int_end_delta; // Cycles to the INT release (while INT is asserted)
+    uint8_t int_asserted;   // Whether INT is currently asserted
+    uint8_t port_fe;        // Last value written to port 0xFE (border, MIC, beeper, row)
+    uint8_t model;          // spettrum_model_t
+    uint8_t port_7ffd;      // Last value written to port 0x7FFD (128K paging)
+    uint64_t cycle;         // CPU cycle counter at save time (informational)
+} spettrum_state_header_t;
+
+// Machine model, chosen by the size of the ROM image
+typedef enum
+{
+    SPETTRUM_MODEL_48K = 0, // 16KB ROM, 48KB RAM
+    SPETTRUM_MODEL_128K     // 128K/+2: 32KB ROM, eight 16KB RAM banks paged through port 0x7FFD
+} spettrum_model_t;
 
 // Emulator state
 typedef struct
 {
     z80_emulator_t *cpu;
     ula_t *display;
-    uint8_t memory[SPETTRUM_TOTAL_MEMORY];
+
+    // Memory banks, laid out so the first 64KB is the 48K address space (ROM,
+    // RAM banks 5, 2, 0), followed by the 128K's ROM 1 and RAM banks 1, 3, 4,
+    // 6, 7. Paging only repoints the CPU page table at another bank.
+    uint8_t memory[SPETTRUM_128K_MEMORY];
+    spettrum_model_t model;
+    uint8_t *rom_banks[2];                  // ROM 0 (48K ROM or 128K editor) and ROM 1 (48K BASIC)
+    uint8_t *ram_banks[SPETTRUM_RAM_BANKS]; // RAM banks by number
+    uint8_t *slots[4];                      // Bank paged in at 0x0000, 0x4000, 0x8000 and 0xC000
+    uint8_t *volatile screen;               // Bank the ULA displays (5, or 7 on a 128K), read by the render thread
+    uint8_t port_7ffd;                      // Last value written to port 0x7FFD
+    uint8_t *view;                          // Address space image for debugger output (on first use)
+
     volatile int running;
-    FILE *disasm_file;          // File for disassembly output
+    trace_writer_t *trace;      // Binary instruction trace (NULL if off)
+    disasm_cache_t *disasm_cache; // Decode cache for the debugger (created on first use)
     volatile int dump_memory;   // Flag to trigger memory dump
+    z80_profile_t *profile;     // Hot-path profile (--profile), NULL if off
+    const char *profile_prefix; // Output prefix of the profile files
+    volatile int dump_profile;  // Flag to trigger a profile dump (SIGPROF)
     int dump_count;             // Counter for dump filenames
     volatile int paused;        // Pause state
     volatile int speed_delay;   // Delay in microseconds (0 = full speed)
     volatile int step_mode;     // Step mode: execute one instruction at a time
+    keyboard_t *keyboard;       // Keyboard matrix (host input thread only when interactive)
     const char *simulated_keys; // Keys to simulate (injected automatically)
+    int simulated_key_index;    // Next simulated key to inject
 
     // Tape loading
     tape_player_t *tape_player; // Cassette tape player (NULL if no tape)
     int use_authentic_loading;  // Use ROM loader instead of quick-load
+    int flash_loading;          // Serve ROM LD-BYTES calls straight from the tape blocks
 
     // Debug tracking
     uint16_t last_pc[10];        // Last 10 PC values
@@ -54,19 +164,75 @@ typedef struct
     uint16_t warn_sp_at_fault;    // SP value when PC-in-VRAM occurred
     uint16_t warn_pc_at_sp_fault; // PC value when SP-in-VRAM occurred
 
+    // Breakpoints and watchpoints (--break, --watch)
+    int break_id;        // Watchpoint that stopped the CPU last
+    int break_kind;      // Its Z80_WATCH_* access
+    uint16_t break_addr; // Address accessed (the PC for execute hits)
+
     // Warning buffer for display after emulation completes
     char *warning_buffer;       // Dynamically allocated buffer for warnings
     size_t warning_buffer_size; // Total size of buffer
     size_t warning_buffer_pos;  // Current position in buffer
 
+    // Event scheduling (frame INT, INT release)
+    scheduler_t *scheduler; // Cycle-indexed event queue
+    int frame_complete;     // Set by the frame INT event, cleared per frame
+
+    // Speed control
+    int speed_percent;             // Emulated speed in percent of real time (0 = turbo)
+    uint64_t pace_start_ns;        // Wall-clock reference point for pacing
+    uint64_t pace_frames;          // Frames emulated since pace_start_ns
+    uint64_t frame_count;          // Frames emulated
+    int publish_frames;            // Publish each frame to the display (render thread running)
+
     // ULA interrupt timing
-    uint64_t frame_cycle_count; // Cycles since last interrupt
     uint64_t int_asserted_time; // Cycle count when INT was asserted
     int int_asserted;           // Whether INT is currently asserted
+    uint64_t next_frame_cycle;  // Deadline of the pending frame INT event
+    uint8_t port_fe_out;        // Last value written to port 0xFE
 
     // Audio/beeper
     beeper_state_t *beeper; // Beeper audio system
     int audio_enabled;      // Whether audio is enabled (command-line option)
+    beeper_recorder_t *audio_recorder; // Offline WAV output (--audio-out), NULL if unused
+
+    // Rewind (--rewind)
+    rewind_buffer_t *rewind;         // Per-frame state history, NULL if disabled
+    uint8_t *rewind_state;           // Capture/restore buffer of rewind_state_size bytes
+    size_t rewind_state_size;        // emulator_state_size()
+    volatile int rewind_request;     // Step back requested (Ctrl-R or SIGUSR2)
+
+#ifdef SPETTRUM_IO_DEBUG
+    // Port debug logs (make IO_DEBUG=1)
+    FILE *io_read_log;         // First ULA port reads (tap_port.log)
+    uint64_t io_read_count;    // ULA port reads so far
+    FILE *io_write_log;        // First port 0xFE writes (io_debug.log)
+    int io_write_count;        // Port 0xFE writes logged
+#endif
 } spettrum_emulator_t;
 
+// Why a headless (--batch) run stopped
+typedef enum
+{
+    BATCH_EXIT_LIMIT = 0,   // Instruction or frame limit reached
+    BATCH_EXIT_HALTED,      // HALT with interrupts disabled: the machine can never resume
+    BATCH_EXIT_INTERRUPTED, // SIGINT/SIGQUIT stopped the batch
+    BATCH_EXIT_ERROR        // The image could not be loaded
+} batch_exit_t;
+
+/**
+ * Outcome of one image of a --batch run
+ */
+typedef struct
+{
+    batch_exit_t exit;
+    uint64_t instructions; // Instructions executed
+    uint64_t cycles;       // T-states emulated
+    uint64_t frames;       // Frame interrupts emulated
+    uint16_t pc;           // PC at exit
+    uint32_t ram_hash;     // FNV-1a hash of all RAM banks at exit
+    double seconds;        // Wall-clock time of the run
+    int worker;            // Worker thread that ran it
+} batch_result_t;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+/**
+ * Read-Only File Mapping Implementation
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapfile.h"
+
+/**
+ * Map a whole file read-only
+ */
+const uint8_t *mapfile_map(int dir_fd, const char *filename, size_t *size)
+{
+    if (!filename || !size)
+        return NULL;
+
+    int fd = openat(dir_fd, filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)st.st_size;
+    return image;
+}
+
+/**
+ * Unmap a file mapped by mapfile_map()
+ */
+void mapfile_unmap(const uint8_t *image, size_t size)
+{
+    if (image)
+        munmap((void *)image, size);
+}
@@ -0,0 +1,32 @@
+/**
+ * Read-Only File Mapping for Spettrum
+ *
+ * ROMs, snapshots and tapes are parsed straight out of a private read-only
+ * mapping of the file instead of being read into heap buffers: no
+ * intermediate allocation or copy, and pages the parser never touches are
+ * never read from disk.
+ */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Map a whole file read-only
+ * @param dir_fd Directory for a relative filename (AT_FDCWD = current directory)
+ * @param filename File to map
+ * @param size Receives the file size
+ * @return Mapping, or NULL if the file cannot be opened, is empty or cannot be mapped
+ */
+const uint8_t *mapfile_map(int dir_fd, const char *filename, size_t *size);
+
+/**
+ * Unmap a file mapped by mapfile_map()
+ * @param image Mapping (NULL is ignored)
+ * @param size Size returned by mapfile_map()
+ */
+void mapfile_unmap(const uint8_t *image, size_t size);
+
+#endif
@@ -0,0 +1,324 @@
+/**
+ * Rewind History Implementation
+ *
+ * Frame records are kept in age order in a byte arena used as a ring: new
+ * records go at the head, and when a record does not fit before the end of
+ * the arena the head wraps to the start. Records ahead of the head are
+ * always the oldest ones, so making room only ever drops from the tail.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+#include "z80snapshot.h"
+
+/**
+ * Stored frame
+ */
+typedef struct
+{
+    size_t offset;    // Record offset in the arena
+    uint32_t length;  // Compressed length
+    uint8_t keyframe; // Non-zero: whole state; zero: XOR delta against the previous keyframe
+    uint64_t seq;     // Frame sequence number
+} rewind_entry_t;
+
+/**
+ * Rewind history state
+ */
+struct rewind_buffer_s
+{
+    size_t state_size;
+
+    // Compressed records
+    uint8_t *arena;
+    size_t arena_size;
+    size_t head; // Offset after the newest record
+    size_t used; // Bytes of the records kept
+
+    // Frame index, oldest first
+    rewind_entry_t *entries;
+    uint32_t max_frames;
+    uint32_t first; // Index of the oldest frame
+    uint32_t count; // Frames kept
+
+    uint32_t keyframe_interval;
+    uint32_t since_key; // Frames kept since (and including) the newest keyframe
+    uint64_t next_seq;
+
+    // Uncompressed copy of one keyframe, and work buffers
+    uint8_t *key_state;
+    uint64_t key_seq; // Keyframe in key_state, UINT64_MAX = none
+    uint8_t *delta;
+    uint8_t *packed;
+    size_t packed_size;
+};
+
+static rewind_entry_t *rewind_entry(rewind_buffer_t *rw, uint32_t age_index)
+{
+    return &rw->entries[(rw->first + age_index) % rw->max_frames];
+}
+
+/**
+ * Create a rewind history
+ */
+rewind_buffer_t *rewind_init(size_t state_size, size_t memory_cap, uint32_t max_frames, uint32_t keyframe_interval)
+{
+    if (state_size == 0 || memory_cap == 0 || max_frames == 0)
+    {
+        fprintf(stderr, "Error: Invalid rewind history size\n");
+        return NULL;
+    }
+
+    rewind_buffer_t *rw = (rewind_buffer_t *)calloc(1, sizeof(rewind_buffer_t));
+    if (!rw)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for rewind history\n");
+        return NULL;
+    }
+
+    rw->state_size = state_size;
+    rw->arena_size = memory_cap;
+    rw->max_frames = max_frames;
+    rw->keyframe_interval = keyframe_interval ? keyframe_interval : REWIND_KEYFRAME_INTERVAL;
+    rw->key_seq = UINT64_MAX;
+    rw->packed_size = 2 * state_size;
+
+    rw->arena = malloc(rw->arena_size);
+    rw->entries = malloc(max_frames * sizeof(rewind_entry_t));
+    rw->key_state = malloc(state_size);
+    rw->delta = malloc(state_size);
+    rw->packed = malloc(rw->packed_size);
+    if (!rw->arena || !rw->entries || !rw->key_state || !rw->delta || !rw->packed)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for rewind history\n");
+        rewind_destroy(rw);
+        return NULL;
+    }
+    return rw;
+}
+
+/**
+ * Destroy rewind history and free resources
+ */
+void rewind_destroy(rewind_buffer_t *rw)
+{
+    if (!rw)
+        return;
+    free(rw->arena);
+    free(rw->entries);
+    free(rw->key_state);
+    free(rw->delta);
+    free(rw->packed);
+    free(rw);
+}
+
+/**
+ * Drop the oldest keyframe and the deltas that depend on it
+ */
+static void rewind_drop_oldest(rewind_buffer_t *rw)
+{
+    do
+    {
+        rw->used -= rewind_entry(rw, 0)->length;
+        rw->first = (rw->first + 1) % rw->max_frames;
+        rw->count--;
+    } while (rw->count > 0 && !rewind_entry(rw, 0)->keyframe);
+
+    if (rw->count == 0)
+    {
+        rw->head = 0;
+        rw->since_key = 0;
+    }
+}
+
+/**
+ * Find room for a record of length bytes, dropping old frames
+ * Returns the record offset
+ */
+static size_t rewind_alloc(rewind_buffer_t *rw, size_t length)
+{
+    if (rw->count == rw->max_frames)
+        rewind_drop_oldest(rw);
+
+    size_t offset = rw->head;
+    if (offset + length > rw->arena_size)
+        offset = 0;
+
+    while (rw->count > 0)
+    {
+        const rewind_entry_t *oldest = rewind_entry(rw, 0);
+        if (oldest->offset + oldest->length <= offset || oldest->offset >= offset + length)
+            break;
+        rewind_drop_oldest(rw);
+    }
+    return offset;
+}
+
+/**
+ * out = a XOR b, a word at a time (out may be a)
+ */
+static void rewind_xor(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        x ^= y;
+        memcpy(out + i, &x, sizeof(x));
+    }
+    for (; i < size; i++)
+        out[i] = a[i] ^ b[i];
+}
+
+/**
+ * Decompress a frame record into out (deltas come out still XORed)
+ */
+static void rewind_unpack(rewind_buffer_t *rw, const rewind_entry_t *entry, uint8_t *out)
+{
+    z80_decompress_block(rw->arena + entry->offset, entry->length, out, rw->state_size);
+}
+
+/**
+ * Make sure key_state holds the keyframe of the frame at age_index
+ */
+static void rewind_load_key(rewind_buffer_t *rw, uint32_t age_index)
+{
+    while (!rewind_entry(rw, age_index)->keyframe)
+        age_index--;
+
+    const rewind_entry_t *key = rewind_entry(rw, age_index);
+    if (rw->key_seq != key->seq)
+    {
+        rewind_unpack(rw, key, rw->key_state);
+        rw->key_seq = key->seq;
+    }
+}
+
+/**
+ * Record a frame
+ */
+int rewind_push(rewind_buffer_t *rw, const uint8_t *state)
+{
+    if (!rw || !state)
+        return -1;
+
+    int keyframe = rw->count == 0 || rw->since_key >= rw->keyframe_interval;
+    for (;;)
+    {
+        int length;
+        if (keyframe)
+        {
+            length = z80_compress_block(state, rw->state_size, rw->packed, rw->packed_size);
+        }
+        else
+        {
+            rewind_load_key(rw, rw->count - 1);
+            rewind_xor(rw->delta, state, rw->key_state, rw->state_size);
+            length = z80_compress_block(rw->delta, rw->state_size, rw->packed, rw->packed_size);
+        }
+        if (length < 0 || (size_t)length > rw->arena_size)
+        {
+            fprintf(stderr, "Error: Rewind frame does not fit in the history memory\n");
+            return -1;
+        }
+
+        size_t offset = rewind_alloc(rw, (size_t)length);
+
+        // Making room dropped the keyframe this delta was taken against
+        if (!keyframe && rw->count == 0)
+        {
+            keyframe = 1;
+            continue;
+        }
+
+        memcpy(rw->arena + offset, rw->packed, (size_t)length);
+        rewind_entry_t *entry = rewind_entry(rw, rw->count);
+        entry->offset = offset;
+        entry->length = (uint32_t)length;
+        entry->keyframe = (uint8_t)keyframe;
+        entry->seq = rw->next_seq++;
+        rw->count++;
+        rw->head = offset + (size_t)length;
+        rw->used += (size_t)length;
+
+        if (keyframe)
+        {
+            memcpy(rw->key_state, state, rw->state_size);
+            rw->key_seq = entry->seq;
+            rw->since_key = 1;
+        }
+        else
+        {
+            rw->since_key++;
+        }
+        return 0;
+    }
+}
+
+/**
+ * Step back in the history
+ */
+uint32_t rewind_pop(rewind_buffer_t *rw, uint32_t frames, uint8_t *state)
+{
+    if (!rw || !state || rw->count == 0 || frames == 0)
+        return 0;
+    if (frames > rw->count)
+        frames = rw->count;
+
+    // Restore the target frame, then drop it and everything newer
+    uint32_t target = rw->count - frames;
+    const rewind_entry_t *entry = rewind_entry(rw, target);
+    if (entry->keyframe)
+    {
+        rewind_unpack(rw, entry, state);
+    }
+    else
+    {
+        rewind_load_key(rw, target);
+        rewind_unpack(rw, entry, state);
+        rewind_xor(state, state, rw->key_state, rw->state_size);
+    }
+
+    for (uint32_t i = target; i < rw->count; i++)
+        rw->used -= rewind_entry(rw, i)->length;
+    rw->count = target;
+
+    // The newest frame left becomes the head again
+    rw->since_key = 0;
+    if (rw->count > 0)
+    {
+        const rewind_entry_t *newest = rewind_entry(rw, rw->count - 1);
+        rw->head = newest->offset + newest->length;
+        for (uint32_t i = rw->count; i-- > 0;)
+        {
+            rw->since_key++;
+            if (rewind_entry(rw, i)->keyframe)
+                break;
+        }
+    }
+    else
+    {
+        rw->head = 0;
+    }
+    return frames;
+}
+
+/**
+ * Get the number of frames kept
+ */
+uint32_t rewind_frame_count(const rewind_buffer_t *rw)
+{
+    return rw ? rw->count : 0;
+}
+
+/**
+ * Get the arena bytes used by the frames kept
+ */
+size_t rewind_memory_used(const rewind_buffer_t *rw)
+{
+    return rw ? rw->used : 0;
+}
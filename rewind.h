@@ -0,0 +1,79 @@
+/**
+ * Rewind History for Spettrum
+ *
+ * Keeps the last N frames of machine state (emulator save states) so a run
+ * can be stepped back instead of restarted from boot. Every
+ * keyframe_interval-th frame is stored as a keyframe, the frames in between
+ * as deltas: the state XORed with its keyframe, which is mostly zero bytes.
+ * Both are packed with the .z80 RLE scheme (z80_compress_block()).
+ *
+ * Records live in one arena allocated up front and reused as a ring; the
+ * oldest frames are dropped when the frame or memory limit is reached (a
+ * keyframe together with the deltas that depend on it). Capturing a frame
+ * allocates nothing and costs two linear passes over the state.
+ */
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Default number of frames between keyframes (one second at 50Hz)
+#define REWIND_KEYFRAME_INTERVAL 50
+
+/**
+ * Rewind history context
+ */
+typedef struct rewind_buffer_s rewind_buffer_t;
+
+/**
+ * Create a rewind history
+ * @param state_size Size of every state pushed (fixed for the whole run)
+ * @param memory_cap Bytes available for compressed frames
+ * @param max_frames Maximum number of frames kept
+ * @param keyframe_interval Frames between keyframes (0 = REWIND_KEYFRAME_INTERVAL)
+ * @return Pointer to history, or NULL on failure
+ */
+rewind_buffer_t *rewind_init(size_t state_size, size_t memory_cap, uint32_t max_frames, uint32_t keyframe_interval);
+
+/**
+ * Destroy rewind history and free resources
+ * @param rw History to destroy
+ */
+void rewind_destroy(rewind_buffer_t *rw);
+
+/**
+ * Record a frame
+ * Drops the oldest frames if needed to make room.
+ * @param rw History
+ * @param state State of state_size bytes
+ * @return 0 on success, -1 if a single frame does not fit in memory_cap
+ */
+int rewind_push(rewind_buffer_t *rw, const uint8_t *state);
+
+/**
+ * Step back in the history
+ * Removes the newest frames and restores the oldest one removed.
+ * @param rw History
+ * @param frames Number of frames to step back (clamped to the frames kept)
+ * @param state Output buffer of state_size bytes
+ * @return Number of frames stepped back, or 0 if the history is empty
+ */
+uint32_t rewind_pop(rewind_buffer_t *rw, uint32_t frames, uint8_t *state);
+
+/**
+ * Get the number of frames kept
+ * @param rw History
+ * @return Number of frames
+ */
+uint32_t rewind_frame_count(const rewind_buffer_t *rw);
+
+/**
+ * Get the arena bytes used by the frames kept
+ * @param rw History
+ * @return Bytes used
+ */
+size_t rewind_memory_used(const rewind_buffer_t *rw);
+
+#endif
@@ -0,0 +1,141 @@
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Heap ordering: earlier cycle first, then insertion order
+static int event_before(const scheduler_event_t *a, const scheduler_event_t *b)
+{
+    if (a->cycle != b->cycle)
+        return a->cycle < b->cycle;
+    return a->sequence < b->sequence;
+}
+
+static void sift_up(scheduler_t *sched, int index)
+{
+    scheduler_event_t event = sched->events[index];
+
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (!event_before(&event, &sched->events[parent]))
+            break;
+        sched->events[index] = sched->events[parent];
+        index = parent;
+    }
+    sched->events[index] = event;
+}
+
+static void sift_down(scheduler_t *sched, int index)
+{
+    scheduler_event_t event = sched->events[index];
+
+    for (;;)
+    {
+        int child = 2 * index + 1;
+        if (child >= sched->count)
+            break;
+        if (child + 1 < sched->count && event_before(&sched->events[child + 1], &sched->events[child]))
+            child++;
+        if (!event_before(&sched->events[child], &event))
+            break;
+        sched->events[index] = sched->events[child];
+        index = child;
+    }
+    sched->events[index] = event;
+}
+
+// Remove the event at index and restore the heap property
+static void remove_at(scheduler_t *sched, int index)
+{
+    sched->count--;
+    if (index == sched->count)
+        return;
+
+    sched->events[index] = sched->events[sched->count];
+    if (index > 0 && event_before(&sched->events[index], &sched->events[(index - 1) / 2]))
+        sift_up(sched, index);
+    else
+        sift_down(sched, index);
+}
+
+scheduler_t *scheduler_init(void)
+{
+    scheduler_t *sched = calloc(1, sizeof(scheduler_t));
+    if (!sched)
+    {
+        fprintf(stderr, "Error: Failed to allocate scheduler\n");
+        return NULL;
+    }
+    return sched;
+}
+
+void scheduler_destroy(scheduler_t *sched)
+{
+    free(sched);
+}
+
+int scheduler_add(scheduler_t *sched, uint64_t cycle, scheduler_callback_t callback, void *user_data)
+{
+    if (!sched || !callback)
+        return -1;
+
+    if (sched->count >= SCHEDULER_MAX_EVENTS)
+    {
+        fprintf(stderr, "Error: Scheduler queue full (%d events)\n", SCHEDULER_MAX_EVENTS);
+        return -1;
+    }
+
+    scheduler_event_t *event = &sched->events[sched->count];
+    event->cycle = cycle;
+    event->sequence = sched->next_sequence++;
+    event->callback = callback;
+    event->user_data = user_data;
+    sift_up(sched, sched->count++);
+    return 0;
+}
+
+int scheduler_remove(scheduler_t *sched, scheduler_callback_t callback, void *user_data)
+{
+    int kept = 0;
+
+    if (!sched)
+        return 0;
+
+    // Compact the surviving events, then rebuild the heap
+    for (int i = 0; i < sched->count; i++)
+    {
+        if (sched->events[i].callback != callback || sched->events[i].user_data != user_data)
+            sched->events[kept++] = sched->events[i];
+    }
+
+    int removed = sched->count - kept;
+    sched->count = kept;
+    for (int i = kept / 2 - 1; i >= 0; i--)
+        sift_down(sched, i);
+    return removed;
+}
+
+uint64_t scheduler_next_cycle(const scheduler_t *sched)
+{
+    if (!sched || sched->count == 0)
+        return UINT64_MAX;
+    return sched->events[0].cycle;
+}
+
+int scheduler_run_due(scheduler_t *sched, uint64_t current_cycle)
+{
+    int fired = 0;
+
+    if (!sched)
+        return 0;
+
+    while (sched->count > 0 && sched->events[0].cycle <= current_cycle)
+    {
+        // Pop before calling so the callback can reschedule itself
+        scheduler_event_t event = sched->events[0];
+        remove_at(sched, 0);
+        event.callback(event.user_data, event.cycle);
+        fired++;
+    }
+    return fired;
+}
@@ -0,0 +1,99 @@
+/**
+ * Cycle-Indexed Event Scheduler for Spettrum
+ *
+ * Devices register deadlines (in Z80 T-states) instead of being polled after
+ * every instruction. The run loop executes the CPU straight up to the earliest
+ * deadline with z80_run_until(), then fires the events that are due.
+ *
+ * Events are kept in a binary min-heap ordered by cycle; events due at the
+ * same cycle fire in the order they were added.
+ *
+ * Typical users:
+ * - ULA frame interrupt (every SPECTRUM_FRAME_CYCLES)
+ * - End of the INT pulse (INT_PULSE_CYCLES after assertion)
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Maximum number of pending events
+#define SCHEDULER_MAX_EVENTS 64
+
+/**
+ * Event callback
+ * @param user_data Pointer passed to scheduler_add()
+ * @param cycle Cycle the event was scheduled for (not the current cycle)
+ */
+typedef void (*scheduler_callback_t)(void *user_data, uint64_t cycle);
+
+/**
+ * Pending event
+ */
+typedef struct
+{
+    uint64_t cycle;                // T-state at which the event fires
+    uint64_t sequence;             // Insertion order, breaks ties between equal cycles
+    scheduler_callback_t callback; // Function to call
+    void *user_data;               // Argument for callback
+} scheduler_event_t;
+
+/**
+ * Scheduler context
+ */
+typedef struct
+{
+    scheduler_event_t events[SCHEDULER_MAX_EVENTS]; // Binary min-heap
+    int count;                                      // Number of pending events
+    uint64_t next_sequence;                         // Sequence number for next event
+} scheduler_t;
+
+/**
+ * Create an empty scheduler
+ * @return Pointer to scheduler, or NULL on failure
+ */
+scheduler_t *scheduler_init(void);
+
+/**
+ * Destroy scheduler and free resources
+ * @param sched Scheduler to destroy
+ */
+void scheduler_destroy(scheduler_t *sched);
+
+/**
+ * Register an event
+ * @param sched Scheduler
+ * @param cycle T-state at which the event fires
+ * @param callback Function to call when the event is due
+ * @param user_data Argument passed to callback
+ * @return 0 on success, -1 if the queue is full
+ */
+int scheduler_add(scheduler_t *sched, uint64_t cycle, scheduler_callback_t callback, void *user_data);
+
+/**
+ * Remove every pending event with the given callback and user data
+ * @param sched Scheduler
+ * @param callback Callback of the events to remove
+ * @param user_data User data of the events to remove
+ * @return Number of events removed
+ */
+int scheduler_remove(scheduler_t *sched, scheduler_callback_t callback, void *user_data);
+
+/**
+ * Get the cycle of the earliest pending event
+ * @param sched Scheduler
+ * @return Cycle of the next event, or UINT64_MAX if none is pending
+ */
+uint64_t scheduler_next_cycle(const scheduler_t *sched);
+
+/**
+ * Fire every event due at or before current_cycle, in cycle order
+ * Callbacks may add new events; those are fired too if already due.
+ * @param sched Scheduler
+ * @param current_cycle Current CPU cycle count
+ * @return Number of events fired
+ */
+int scheduler_run_due(scheduler_t *sched, uint64_t current_cycle);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * spettrum-trace: print a binary instruction trace as disassembly
+ *
+ * Reads a trace written by spettrum --disassemble and prints one line per
+ * instruction, in the format the emulator used to log directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include "trace.h"
+#include "disasm.h"
+#include "mapfile.h"
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [OPTIONS] TRACE\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -h, --help                Show this help message\n");
+    printf("  -s, --skip N              Skip the first N instructions\n");
+    printf("  -n, --count N             Print at most N instructions\n");
+    printf("  -c, --cycles              Prefix each line with its CPU cycle\n");
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t skip = 0;
+    uint64_t limit = UINT64_MAX;
+    int show_cycles = 0;
+
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"skip", required_argument, 0, 's'},
+        {"count", required_argument, 0, 'n'},
+        {"cycles", no_argument, 0, 'c'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hs:n:c", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 's':
+            skip = strtoull(optarg, NULL, 0);
+            break;
+        case 'n':
+            limit = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            show_cycles = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *filename = argv[optind];
+    size_t size;
+    const uint8_t *image = mapfile_map(AT_FDCWD, filename, &size);
+    if (!image)
+    {
+        fprintf(stderr, "Error: Cannot map trace file '%s' (missing or empty)\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t count;
+    const trace_record_t *records = trace_records(image, size, &count);
+    if (!records)
+    {
+        fprintf(stderr, "Error: '%s' is not a spettrum trace (version %d)\n", filename, TRACE_VERSION);
+        mapfile_unmap(image, size);
+        return EXIT_FAILURE;
+    }
+
+    for (uint64_t i = skip; i < count && i - skip < limit; i++)
+    {
+        if (show_cycles)
+            printf("%12llu ", (unsigned long long)records[i].cycle);
+        disasm_print_record(stdout, &records[i]);
+    }
+
+    mapfile_unmap(image, size);
+    return EXIT_SUCCESS;
+}
@@ -3,13 +3,17 @@
  *
  * Loads Spectrum tape image files (.TAP format) into emulator memory
  * Supports both quick-load (direct memory) and authentic tape loading
- * (via port 0xFE cassette EAR simulation)
+ * (via port 0xFE cassette EAR simulation); the tape player also plays
+ * TZX images through tzx.c
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 #include "tap.h"
+#include "tzx.h"
+#include "mapfile.h"
 
 /**
  * Open TAP file and return context
@@ -105,7 +109,7 @@ int tap_read_block(tap_file_t *tap, uint8_t **data, uint16_t *length)
     }
 
     // Allocate or reallocate block buffer if needed
-    if (tap->block_data == NULL || block_length > 65535)
+    if (tap->block_data == NULL || block_length > tap->block_len)
     {
         if (tap->block_data)
             free(tap->block_data);
@@ -221,120 +225,390 @@ int tap_get_info(const char *filename, uint32_t *block_count, uint32_t *total_da
     return 0;
 }
 
+// Standard ROM loader timings (T-states at 3.5 MHz)
+#define TAPE_PILOT_LENGTH 2168        // Pilot pulse length
+#define TAPE_HEADER_PILOT_PULSES 8063 // Pilot pulses before a header block (flag < 0x80)
+#define TAPE_DATA_PILOT_PULSES 3223   // Pilot pulses before a data block
+#define TAPE_SYNC1_LENGTH 667         // First sync pulse
+#define TAPE_SYNC2_LENGTH 735         // Second sync pulse
+#define TAPE_ZERO_LENGTH 855          // Each of the two pulses of a 0 bit
+#define TAPE_ONE_LENGTH 1710          // Each of the two pulses of a 1 bit
+#define TAPE_CYCLES_PER_MS 3500       // Pause lengths are given in milliseconds
+
+// Pulse generator phases, in playback order
+enum
+{
+    TAPE_GEN_PILOT,
+    TAPE_GEN_SYNC1,
+    TAPE_GEN_SYNC2,
+    TAPE_GEN_BODY, // Data bits, pulse table or samples
+    TAPE_GEN_PAUSE,
+    TAPE_GEN_DONE
+};
+
 /**
- * AUTHENTIC TAPE LOADING
- *
- * Initialize tape player for ROM-based loading
- * The player simulates cassette playback by feeding pulses to port 0xFE
+ * Fill in a standard-speed data block
  */
-tape_player_t *tape_player_init(const char *filename)
+void tape_block_standard(tape_block_t *block, const uint8_t *data, uint32_t length, uint16_t pause_ms)
 {
-    if (!filename)
-        return NULL;
+    memset(block, 0, sizeof(*block));
+    block->type = TAPE_BLOCK_DATA;
+    block->data = data;
+    block->length = length;
+    block->pilot_length = TAPE_PILOT_LENGTH;
+    block->pilot_pulses = length > 0 && data[0] < 0x80 ? TAPE_HEADER_PILOT_PULSES : TAPE_DATA_PILOT_PULSES;
+    block->sync1_length = TAPE_SYNC1_LENGTH;
+    block->sync2_length = TAPE_SYNC2_LENGTH;
+    block->zero_length = TAPE_ZERO_LENGTH;
+    block->one_length = TAPE_ONE_LENGTH;
+    block->used_bits = 8;
+    block->pause_ms = pause_ms;
+}
 
-    tape_player_t *player = (tape_player_t *)malloc(sizeof(tape_player_t));
-    if (!player)
+/**
+ * Map the whole file read-only
+ * Pages are only read when playback reaches them.
+ */
+static int tape_player_map(tape_player_t *player, const char *filename)
+{
+    player->image = mapfile_map(AT_FDCWD, filename, &player->image_size);
+    if (!player->image)
     {
-        fprintf(stderr, "Error: Memory allocation failed for tape player\n");
-        return NULL;
+        fprintf(stderr, "Error: Cannot map tape file '%s' (missing or empty)\n", filename);
+        return -1;
     }
+    return 0;
+}
 
-    // Open TAP file
-    // Open debug log file
-    player->debug_log = fopen("tap.log", "w");
-    if (player->debug_log)
+/**
+ * Read the next block of the tape into player->block
+ * Returns 0 if successful, -1 at the end of the tape
+ */
+static int tape_player_read_block(tape_player_t *player)
+{
+    int result = -1;
+
+    if (player->tzx)
     {
-        fprintf(player->debug_log, "=== TAP Debug Log ===\n");
-        fprintf(player->debug_log, "TAP file: %s\n\n", filename);
-        fflush(player->debug_log);
+        result = tzx_next_block(player->tzx, &player->block);
     }
-
-    player->tap_file = tap_open(filename);
-    if (!player->tap_file)
+    else
     {
-        if (player->debug_log)
+        while (player->image_pos + 2 <= player->image_size)
         {
-            fprintf(player->debug_log, "ERROR: Failed to open TAP file\n");
-            fclose(player->debug_log);
+            const uint8_t *p = player->image + player->image_pos;
+            uint32_t length = p[0] | (p[1] << 8);
+
+            if (player->image_pos + 2 + length > player->image_size)
+            {
+                fprintf(stderr, "Error: Block length %u exceeds file size\n", length);
+                break;
+            }
+            player->image_pos += 2 + length;
+
+            // Empty blocks carry no pulses; TAP blocks follow each other without a pause
+            if (length == 0)
+                continue;
+            tape_block_standard(&player->block, p + 2, length, 0);
+            result = 0;
+            break;
         }
-        free(player);
-        return NULL;
     }
 
-    // Initialize playback state
-    player->current_block = 0;
-    player->block_data = NULL;
-    player->block_len = 0;
-    player->block_bit_pos = 0;
+    if (result != 0)
+        return -1;
 
-    // Start in idle state - will transition to PILOT when first block is loaded
-    player->state = TAPE_STATE_IDLE;
-    player->pulse_count = 0;
-    player->pulse_length = 0;
-    player->ear_level = 0; // Start low
-    player->cycle_count = 0;
-    player->last_edge_cycle = 0;
-    player->data_pulse_phase = 0; // Track which of the two pulses we're on for data bits
-    player->read_count = 0;
+    player->current_block++;
+    player->gen_phase = TAPE_GEN_PILOT;
+    player->gen_pos = 0;
+    player->gen_bit = 7;
 
     if (player->debug_log)
     {
-        fprintf(player->debug_log, "Initialized tape player:\n");
-        fprintf(player->debug_log, "  State: IDLE\n");
-        fprintf(player->debug_log, "  EAR level: %d\n\n", player->ear_level);
+        const tape_block_t *block = &player->block;
+        if (block->type == TAPE_BLOCK_DATA)
+            fprintf(player->debug_log, "Block %u: data, %u bytes, flag=0x%02X (%s), pause %u ms\n",
+                    player->current_block, block->length, block->data[0],
+                    block->data[0] < 0x80 ? "HEADER" : "DATA", block->pause_ms);
+        else
+            fprintf(player->debug_log, "Block %u: type %d, length %u, pause %u ms\n",
+                    player->current_block, (int)block->type, block->length, block->pause_ms);
         fflush(player->debug_log);
     }
+    return 0;
+}
+
+/**
+ * Append count (at most UINT16_MAX) pulses to the run buffer
+ * Extends the last run when the pulses continue it. The caller makes sure
+ * there is room for one more run.
+ */
+static void tape_emit(tape_player_t *player, uint32_t length, uint32_t count, uint8_t first_level, uint8_t hold)
+{
+    if (length == 0 || count == 0)
+        return;
 
-    // Set standard Spectrum ROM timings (T-states at 3.5 MHz)
-    player->pilot_length = 2168; // Pilot pulse length
-    player->pilot_count = 8063;  // Header pilot count (will adjust for data blocks)
-    player->sync1_length = 667;  // First sync pulse
-    player->sync2_length = 735;  // Second sync pulse
-    player->zero_length = 855;   // Zero bit pulse pair length
-    player->one_length = 1710;   // One bit pulse pair length
+    // A set-level block forces the level of the next toggling pulse
+    if (!hold && first_level == TAPE_LEVEL_INVERT && player->gen_level != TAPE_LEVEL_INVERT)
+    {
+        first_level = player->gen_level;
+        player->gen_level = TAPE_LEVEL_INVERT;
+    }
 
-    // Load first block
-    if (tap_read_block(player->tap_file, &player->block_data, &player->block_len) == 0)
+    if (player->run_fill > 0)
     {
-        player->state = TAPE_STATE_PILOT;
-        player->pulse_count = player->pilot_count;
-        player->pulse_length = player->pilot_length;
+        tape_pulse_run_t *last = &player->runs[player->run_fill - 1];
+        int continues = hold ? last->hold && last->first_level == first_level
+                             : !last->hold && first_level == TAPE_LEVEL_INVERT;
 
-        // Determine if header (flag=0x00) or data (flag=0xFF)
-        // If data block (flag 0xFF), use shorter pilot
-        if (player->block_data && player->block_data[0] == 0xFF)
+        if (continues && last->length == length && last->count < UINT16_MAX)
         {
-            player->pilot_count = 3223; // Data block pilot count
-            player->pulse_count = 3223;
+            uint32_t add = UINT16_MAX - last->count;
+            if (add > count)
+                add = count;
+            last->count += add;
+            count -= add;
+            if (count == 0)
+                return;
+            first_level = hold ? first_level : TAPE_LEVEL_INVERT;
         }
+    }
 
-        printf("Tape loaded: Starting playback from block %u (%u bytes)\n",
-               player->current_block, player->block_len);
+    tape_pulse_run_t *run = &player->runs[player->run_fill++];
+    run->length = length;
+    run->count = count;
+    run->first_level = first_level;
+    run->hold = hold;
+}
 
-        if (player->debug_log)
+/**
+ * Expand the current block into the run buffer from where it stopped
+ * Stops when the buffer is full or the block is done.
+ */
+static void tape_generate(tape_player_t *player)
+{
+    const tape_block_t *block = &player->block;
+
+    // Each step emits at most one new run
+    while (player->gen_phase != TAPE_GEN_DONE && player->run_fill < TAPE_RUN_BUFFER)
+    {
+        switch (player->gen_phase)
         {
-            fprintf(player->debug_log, "First block loaded:\n");
-            fprintf(player->debug_log, "  Block: %u\n", player->current_block);
-            fprintf(player->debug_log, "  Length: %u bytes\n", player->block_len);
-            fprintf(player->debug_log, "  Flag byte: 0x%02X\n", player->block_data[0]);
-            fprintf(player->debug_log, "  Type: %s\n", player->block_data[0] == 0x00 ? "HEADER" : "DATA");
-            fprintf(player->debug_log, "  State: PILOT\n");
-            fprintf(player->debug_log, "  Pilot pulses: %u\n", player->pulse_count);
-            fprintf(player->debug_log, "  Pulse length: %u T-states\n\n", player->pulse_length);
-            fflush(player->debug_log);
+        case TAPE_GEN_PILOT:
+            if (block->type == TAPE_BLOCK_LEVEL)
+            {
+                player->gen_level = block->level ? TAPE_LEVEL_HIGH : TAPE_LEVEL_LOW;
+                player->gen_phase = TAPE_GEN_DONE;
+                continue;
+            }
+            if (block->type == TAPE_BLOCK_DATA || block->type == TAPE_BLOCK_TONE)
+                tape_emit(player, block->pilot_length, block->pilot_pulses, TAPE_LEVEL_INVERT, 0);
+            player->gen_phase = TAPE_GEN_SYNC1;
+            break;
+
+        case TAPE_GEN_SYNC1:
+            if (block->type == TAPE_BLOCK_DATA)
+                tape_emit(player, block->sync1_length, 1, TAPE_LEVEL_INVERT, 0);
+            player->gen_phase = TAPE_GEN_SYNC2;
+            break;
+
+        case TAPE_GEN_SYNC2:
+            if (block->type == TAPE_BLOCK_DATA)
+                tape_emit(player, block->sync2_length, 1, TAPE_LEVEL_INVERT, 0);
+            player->gen_phase = TAPE_GEN_BODY;
+            break;
+
+        case TAPE_GEN_BODY:
+            if (block->type == TAPE_BLOCK_DATA || block->type == TAPE_BLOCK_DIRECT)
+            {
+                if (player->gen_pos >= block->length)
+                {
+                    player->gen_phase = TAPE_GEN_PAUSE;
+                    break;
+                }
+
+                // Two pulses per data bit, or one held sample per bit, MSB first
+                int bit = (block->data[player->gen_pos] >> player->gen_bit) & 1;
+                if (block->type == TAPE_BLOCK_DATA)
+                    tape_emit(player, bit ? block->one_length : block->zero_length, 2, TAPE_LEVEL_INVERT, 0);
+                else
+                    tape_emit(player, block->pilot_length, 1, (uint8_t)bit, 1);
+
+                int last_bit = player->gen_pos + 1 == block->length ? 8 - block->used_bits : 0;
+                if (player->gen_bit-- == last_bit)
+                {
+                    player->gen_bit = 7;
+                    player->gen_pos++;
+                }
+            }
+            else if (block->type == TAPE_BLOCK_PULSES && player->gen_pos < block->length)
+            {
+                const uint8_t *p = block->data + 2 * player->gen_pos++;
+                tape_emit(player, p[0] | (p[1] << 8), 1, TAPE_LEVEL_INVERT, 0);
+            }
+            else
+            {
+                player->gen_phase = TAPE_GEN_PAUSE;
+            }
+            break;
+
+        case TAPE_GEN_PAUSE:
+            // A 1 ms pulse ends the last edge cleanly, then the level stays low
+            if (block->pause_ms > 0 && player->gen_pos != UINT32_MAX)
+            {
+                tape_emit(player, TAPE_CYCLES_PER_MS, 1, TAPE_LEVEL_INVERT, 0);
+                player->gen_pos = UINT32_MAX;
+                break;
+            }
+            if (block->pause_ms > 1)
+                tape_emit(player, TAPE_CYCLES_PER_MS, block->pause_ms - 1u, TAPE_LEVEL_LOW, 1);
+            player->gen_phase = TAPE_GEN_DONE;
+            break;
         }
     }
+}
+
+/**
+ * Refill the run buffer with the next pulses of the tape
+ * The buffer only ever holds runs of one block. Returns the number of runs,
+ * 0 at the end of the tape.
+ */
+static uint32_t tape_player_fill(tape_player_t *player)
+{
+    player->run_fill = 0;
+    player->run_index = 0;
+
+    while (player->run_fill == 0)
+    {
+        if (player->gen_phase == TAPE_GEN_DONE && tape_player_read_block(player) != 0)
+            return 0;
+        tape_generate(player);
+    }
+    return player->run_fill;
+}
+
+/**
+ * Stop playback: the tape has run out
+ */
+static void tape_player_end(tape_player_t *player, uint64_t cycle)
+{
+    player->state = TAPE_STATE_END;
+    player->ear_level = 0;
+    player->next_edge = UINT64_MAX;
+    if (player->debug_log)
+    {
+        fprintf(player->debug_log, "Tape complete at cycle %llu\n", (unsigned long long)cycle);
+        fflush(player->debug_log);
+    }
+}
+
+/**
+ * Move the cursor onto the first pulse of run run_index, starting at start_cycle
+ * A held run is treated as one long pulse.
+ */
+static void tape_player_enter_run(tape_player_t *player, uint64_t start_cycle, int at_start)
+{
+    const tape_pulse_run_t *run = &player->runs[player->run_index];
+
+    if (run->first_level != TAPE_LEVEL_INVERT)
+        player->ear_level = run->first_level;
+    else if (at_start)
+        player->ear_level = 0;
     else
+        player->ear_level ^= 1;
+
+    if (run->hold)
+    {
+        player->pulse_index = run->count - 1;
+        player->next_edge = start_cycle + (uint64_t)run->length * run->count;
+    }
+    else
+    {
+        player->pulse_index = 0;
+        player->next_edge = start_cycle + run->length;
+    }
+}
+
+/**
+ * AUTHENTIC TAPE LOADING
+ *
+ * Initialize tape player for ROM-based loading
+ * The player simulates cassette playback by feeding pulses to port 0xFE
+ */
+tape_player_t *tape_player_init(const char *filename)
+{
+    if (!filename)
+        return NULL;
+
+    tape_player_t *player = (tape_player_t *)calloc(1, sizeof(tape_player_t));
+    if (!player)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for tape player\n");
+        return NULL;
+    }
+
+#ifdef SPETTRUM_IO_DEBUG
+    // Block transition log (make IO_DEBUG=1)
+    player->debug_log = fopen("tap.log", "w");
+    if (player->debug_log)
+    {
+        fprintf(player->debug_log, "=== TAP Debug Log ===\n");
+        fprintf(player->debug_log, "Tape file: %s\n\n", filename);
+        fflush(player->debug_log);
+    }
+#endif
+
+    if (tape_player_map(player, filename) != 0)
     {
-        fprintf(stderr, "Error: Failed to load first TAP block\n");
-        tap_close(player->tap_file);
-        free(player);
+        tape_player_close(player);
         return NULL;
     }
 
+    if (tzx_is_tzx(player->image, player->image_size))
+    {
+        player->tzx = tzx_open(player->image, player->image_size);
+        if (!player->tzx)
+        {
+            tape_player_close(player);
+            return NULL;
+        }
+    }
+
+    // Expand the first block so playback can start on the first EAR read
+    player->current_block = UINT32_MAX;
+    player->gen_phase = TAPE_GEN_DONE;
+    player->gen_level = TAPE_LEVEL_INVERT;
+    if (tape_player_fill(player) == 0)
+    {
+        fprintf(stderr, "Error: Failed to load first tape block\n");
+        if (player->debug_log)
+            fprintf(player->debug_log, "ERROR: No playable blocks in tape file\n");
+        tape_player_close(player);
+        return NULL;
+    }
+
+    // Motor starts on the first EAR read
+    player->state = TAPE_STATE_IDLE;
+    player->ear_level = 0; // Start low
+    player->next_edge = UINT64_MAX;
+
     return player;
 }
 
+/**
+ * Print the format and size of the loaded tape
+ */
+void tape_player_print_info(const tape_player_t *player)
+{
+    if (!player)
+        return;
+
+    if (player->tzx)
+        printf("Tape loaded: TZX, %u blocks, %zu bytes\n", tzx_block_count(player->tzx), player->image_size);
+    else
+        printf("Tape loaded: TAP, %zu bytes\n", player->image_size);
+}
+
 /**
  * Close tape player and free resources
  */
@@ -346,212 +620,251 @@ void tape_player_close(tape_player_t *player)
     if (player->debug_log)
     {
         fprintf(player->debug_log, "\n=== Tape Player Closed ===\n");
-        fprintf(player->debug_log, "Total read_ear calls: %llu\n", player->read_count);
+        fprintf(player->debug_log, "Total read_ear calls: %llu\n", (unsigned long long)player->read_count);
         fclose(player->debug_log);
     }
 
-    if (player->tap_file)
-        tap_close(player->tap_file);
-
+    tzx_close(player->tzx);
+    mapfile_unmap(player->image, player->image_size);
     free(player);
 }
 
 /**
- * Get next bit from current block data
- * Returns 0 or 1, advances bit position
+ * Move the cursor forward until current_cycle falls inside the current pulse
+ * Stays inside a run with one division; whole runs are skipped at once.
  */
-static uint8_t tape_get_next_bit(tape_player_t *player)
+static void tape_player_seek(tape_player_t *player, uint64_t current_cycle)
 {
-    if (player->block_bit_pos >= (uint32_t)(player->block_len * 8))
-        return 0; // End of block
+    while (player->state == TAPE_STATE_PLAYING && current_cycle >= player->next_edge)
+    {
+        const tape_pulse_run_t *run = &player->runs[player->run_index];
+        uint64_t left = run->count - player->pulse_index - 1; // Pulses after the current one
+        uint64_t passed = (current_cycle - player->next_edge) / run->length;
 
-    uint32_t byte_pos = player->block_bit_pos / 8;
-    uint8_t bit_pos = 7 - (player->block_bit_pos % 8); // MSB first
-    uint8_t byte_val = player->block_data[byte_pos];
-    uint8_t bit = (byte_val >> bit_pos) & 1;
+        if (passed < left)
+        {
+            player->pulse_index += (uint32_t)passed + 1;
+            player->next_edge += (passed + 1) * run->length;
+            player->ear_level ^= (passed + 1) & 1;
+            return;
+        }
 
-    player->block_bit_pos++;
-    return bit;
+        // Every remaining pulse of the run has ended; the next run begins
+        if (!run->hold)
+            player->ear_level ^= left & 1;
+        uint64_t run_end = player->next_edge + left * run->length;
+
+        if (++player->run_index == player->run_fill && tape_player_fill(player) == 0)
+        {
+            tape_player_end(player, run_end);
+            return;
+        }
+        tape_player_enter_run(player, run_end, 0);
+    }
 }
 
 /**
- * Advance tape player state machine
- * Returns current EAR bit (port 0xFE bit 6) that ROM loader reads
+ * Get current EAR bit (port 0xFE bit 6) that ROM loader reads
  *
  * The tape encodes data as a series of pulses. Each pulse has a length in T-states.
  * When the ROM loader reads port 0xFE, it measures the pulse duration to decode bits.
- *
- * State machine flow:
- * PILOT → SYNC1 → SYNC2 → DATA_BIT[0..n] → next block or END
  */
 uint8_t tape_player_read_ear(tape_player_t *player, uint64_t current_cycle)
 {
-    if (!player || player->state == TAPE_STATE_IDLE || player->state == TAPE_STATE_END)
+    if (!player || player->state == TAPE_STATE_END)
         return 0; // Tape not loaded or finished
 
     player->read_count++;
 
-    // Log first few calls and periodic updates
-    if (player->debug_log && (player->read_count <= 10 || player->read_count % 10000 == 0))
-    {
-        fprintf(player->debug_log, "read_ear call #%llu: cycle=%llu state=%d ear=%d\n",
-                player->read_count, current_cycle, player->state, player->ear_level);
-        fflush(player->debug_log);
-    }
-
-    // Initialize timing on first call
-    if (player->last_edge_cycle == 0 && player->cycle_count == 0)
+    // The motor starts with the first read
+    if (player->state == TAPE_STATE_IDLE)
     {
-        player->last_edge_cycle = current_cycle;
-        player->cycle_count = player->pulse_length;
-
+        player->state = TAPE_STATE_PLAYING;
+        tape_player_enter_run(player, current_cycle, 1);
         if (player->debug_log)
         {
-            fprintf(player->debug_log, "  First call - initialized: last_edge=%llu cycle_count=%llu\n",
-                    player->last_edge_cycle, player->cycle_count);
+            fprintf(player->debug_log, "Playback starts at cycle %llu\n", (unsigned long long)current_cycle);
             fflush(player->debug_log);
         }
     }
 
-    // Handle PILOT state - toggle at each edge
-    if (player->state == TAPE_STATE_PILOT && current_cycle >= player->last_edge_cycle + player->cycle_count)
-    {
-        // Toggle EAR at edge
-        player->ear_level = !player->ear_level;
-        player->last_edge_cycle += player->cycle_count;
-        player->pulse_count--;
+    if (current_cycle >= player->next_edge)
+        tape_player_seek(player, current_cycle);
 
-        if (player->debug_log && (player->read_count <= 20 || player->pulse_count % 1000 == 0))
-        {
-            fprintf(player->debug_log, "  PILOT edge: %u pulses remaining\n", player->pulse_count);
-            fflush(player->debug_log);
-        }
+    return player->ear_level;
+}
 
-        // Check if pilot phase is done
-        if (player->pulse_count == 0)
-        {
-            player->state = TAPE_STATE_SYNC;
-            player->pulse_count = 2;
-            player->ear_level = 0;
-            player->cycle_count = player->sync1_length;
+/**
+ * Get the number of cycles until the next EAR edge
+ * Within a held run this is the end of the run, which may not change the level.
+ */
+uint64_t tape_player_cycles_to_edge(tape_player_t *player, uint64_t current_cycle)
+{
+    if (!player || player->state != TAPE_STATE_PLAYING)
+        return UINT64_MAX;
 
-            if (player->debug_log)
-            {
-                fprintf(player->debug_log, "  PILOT -> SYNC transition\n");
-                fflush(player->debug_log);
-            }
-        }
-    }
+    if (current_cycle >= player->next_edge)
+        tape_player_seek(player, current_cycle);
+    if (player->state != TAPE_STATE_PLAYING)
+        return UINT64_MAX;
 
-    // Handle SYNC state (2 sync pulses before data)
-    if (player->state == TAPE_STATE_SYNC && current_cycle >= player->last_edge_cycle + player->cycle_count)
-    {
-        player->ear_level = !player->ear_level;
-        player->last_edge_cycle += player->cycle_count;
-        player->pulse_count--;
+    return player->next_edge - current_cycle;
+}
 
-        if (player->pulse_count == 1)
+/**
+ * Take the next data block and start the following block at current_cycle
+ */
+int tape_player_take_block(tape_player_t *player, uint64_t current_cycle, const uint8_t **data, uint32_t *length)
+{
+    if (!player || player->state == TAPE_STATE_END)
+        return -1;
+
+    while (player->block.type != TAPE_BLOCK_DATA || player->block.length == 0)
+    {
+        if (tape_player_read_block(player) != 0)
         {
-            player->cycle_count = player->sync2_length;
+            tape_player_end(player, current_cycle);
+            return -1;
         }
-        else if (player->pulse_count == 0)
-        {
-            // Sync done, transition to DATA
-            player->state = TAPE_STATE_DATA;
-            player->block_bit_pos = 0;
-            player->data_pulse_phase = 0;
-            player->ear_level = 0;
-
-            // Read first bit to set cycle_count
-            if (player->block_bit_pos < player->block_len * 8)
-            {
-                uint8_t data_bit = tape_get_next_bit(player);
-                uint16_t bit_length = (data_bit == 0) ? player->zero_length : player->one_length;
-                player->cycle_count = bit_length;
-                player->current_bit_value = data_bit;
-                player->data_pulse_phase = 1;
-            }
+    }
 
-            if (player->debug_log)
-            {
-                fprintf(player->debug_log, "  SYNC -> DATA transition at cycle %llu\n", current_cycle);
-                fprintf(player->debug_log, "  Starting data playback (%u bytes = %u bits)\n",
-                        player->block_len, player->block_len * 8);
-                fflush(player->debug_log);
-            }
-        }
+    *data = player->block.data;
+    *length = player->block.length;
+
+    if (player->debug_log)
+    {
+        fprintf(player->debug_log, "Block %u consumed by flash load at cycle %llu\n",
+                player->current_block, (unsigned long long)current_cycle);
+        fflush(player->debug_log);
     }
 
-    // Handle DATA state - each bit encoded as 2 pulses
-    if (player->state == TAPE_STATE_DATA && current_cycle >= player->last_edge_cycle + player->cycle_count)
+    // Drop the rest of the block; the next one starts from its first pulse
+    player->gen_phase = TAPE_GEN_DONE;
+    if (tape_player_fill(player) == 0)
     {
-        // Toggle EAR at edge
-        player->ear_level = !player->ear_level;
-        player->last_edge_cycle += player->cycle_count;
+        tape_player_end(player, current_cycle);
+        return 0;
+    }
+    player->state = TAPE_STATE_PLAYING;
+    tape_player_enter_run(player, current_cycle, 1);
+    return 0;
+}
 
-        // Check if we need to fetch next bit
-        if (player->data_pulse_phase == 0)
-        {
-            // Check if block complete
-            if (player->block_bit_pos >= player->block_len * 8)
-            {
-                // Load next block
-                if (tap_read_block(player->tap_file, &player->block_data, &player->block_len) == 0 &&
-                    player->block_data != NULL && player->block_len > 0)
-                {
-                    player->current_block++;
-                    player->state = TAPE_STATE_PILOT;
-                    player->pulse_count = (player->block_data[0] == 0xFF) ? 3223 : player->pilot_count;
-                    player->pulse_length = player->pilot_length;
-                    player->cycle_count = player->pilot_length;
-                    player->block_bit_pos = 0;
-                    player->data_pulse_phase = 0;
-
-                    if (player->debug_log)
-                    {
-                        fprintf(player->debug_log, "  Block %u loaded: %u bytes, flag=0x%02X\n",
-                                player->current_block, player->block_len, player->block_data[0]);
-                        fflush(player->debug_log);
-                    }
-                }
-                else
-                {
-                    player->state = TAPE_STATE_END;
-                    player->cycle_count = 1;
-                    if (player->debug_log)
-                    {
-                        fprintf(player->debug_log, "  Tape complete\n");
-                        fflush(player->debug_log);
-                    }
-                    return player->ear_level;
-                }
-            }
-            else
-            {
-                // First pulse of new bit
-                uint8_t data_bit = tape_get_next_bit(player);
-                uint16_t bit_length = (data_bit == 0) ? player->zero_length : player->one_length;
-                player->cycle_count = bit_length;
-                player->current_bit_value = data_bit;
-                player->data_pulse_phase = 1;
-
-                if (player->debug_log && (player->block_bit_pos <= 20 || player->block_bit_pos % 1000 == 0))
-                {
-                    fprintf(player->debug_log, "  DATA bit %u: %u\n", player->block_bit_pos - 1, data_bit);
-                    fflush(player->debug_log);
-                }
-            }
-        }
-        else
-        {
-            // Second pulse of same bit
-            uint16_t bit_length = (player->current_bit_value == 0) ? player->zero_length : player->one_length;
-            player->cycle_count = bit_length;
-            player->data_pulse_phase = 0;
-        }
+// Save state record: the player without its pointers; block data is stored
+// as an offset into the image
+typedef struct
+{
+    uint64_t image_size;    // Guards against restoring onto another tape
+    uint64_t image_pos;     // TAP: offset of the next block
+    uint64_t block_offset;  // Offset of block.data in the image
+    int64_t edge_delta;     // next_edge - current cycle (INT64_MAX = no edge)
+    tzx_position_t tzx;     // TZX reader position
+    tape_block_t block;     // Current block, data pointer cleared
+    uint32_t current_block;
+    uint32_t gen_pos;
+    uint32_t run_fill;
+    uint32_t run_index;
+    uint32_t pulse_index;
+    uint8_t gen_phase;
+    uint8_t gen_bit;
+    uint8_t gen_level;
+    uint8_t ear_level;
+    uint8_t state;
+    tape_pulse_run_t runs[TAPE_RUN_BUFFER];
+} tape_saved_state_t;
+
+/**
+ * Get the size of a save state record
+ */
+size_t tape_player_state_size(void)
+{
+    return sizeof(tape_saved_state_t);
+}
+
+/**
+ * Save the playback position
+ */
+size_t tape_player_save_state(const tape_player_t *player, uint64_t current_cycle, uint8_t *buffer, size_t buffer_size)
+{
+    if (!player || !buffer || buffer_size < sizeof(tape_saved_state_t))
+        return 0;
+
+    tape_saved_state_t saved;
+    tape_saved_state_t *rec = &saved;
+    memset(rec, 0, sizeof(*rec)); // Padding included, for reproducible records
+    rec->image_size = player->image_size;
+    rec->image_pos = player->image_pos;
+    rec->block_offset = player->block.data ? (uint64_t)(player->block.data - player->image) : UINT64_MAX;
+    rec->edge_delta = player->next_edge == UINT64_MAX ? INT64_MAX : (int64_t)(player->next_edge - current_cycle);
+    if (player->tzx)
+        tzx_get_position(player->tzx, &rec->tzx);
+    rec->block = player->block;
+    rec->block.data = NULL;
+    rec->current_block = player->current_block;
+    rec->gen_pos = player->gen_pos;
+    rec->run_fill = player->run_fill;
+    rec->run_index = player->run_index;
+    rec->pulse_index = player->pulse_index;
+    rec->gen_phase = player->gen_phase;
+    rec->gen_bit = player->gen_bit;
+    rec->gen_level = player->gen_level;
+    rec->ear_level = player->ear_level;
+    rec->state = (uint8_t)player->state;
+    memcpy(rec->runs, player->runs, sizeof(rec->runs));
+    memcpy(buffer, rec, sizeof(tape_saved_state_t));
+    return sizeof(tape_saved_state_t);
+}
+
+/**
+ * Restore a playback position
+ */
+int tape_player_load_state(tape_player_t *player, uint64_t current_cycle, const uint8_t *buffer, size_t buffer_size)
+{
+    if (!player || !buffer || buffer_size < sizeof(tape_saved_state_t))
+        return -1;
+
+    tape_saved_state_t saved;
+    const tape_saved_state_t *rec = &saved;
+    memcpy(&saved, buffer, sizeof(saved));
+    uint64_t block_bytes = rec->block.type == TAPE_BLOCK_PULSES ? 2 * (uint64_t)rec->block.length : rec->block.length;
+
+    // The record must describe a position inside this very tape
+    if (rec->image_size != player->image_size || rec->image_pos > player->image_size ||
+        (rec->block_offset != UINT64_MAX && rec->block_offset + block_bytes > player->image_size) ||
+        rec->run_fill > TAPE_RUN_BUFFER || rec->run_index > rec->run_fill ||
+        rec->state > TAPE_STATE_END || rec->gen_phase > TAPE_GEN_DONE)
+    {
+        fprintf(stderr, "Error: Saved tape position does not match the loaded tape\n");
+        return -1;
+    }
+    if (player->tzx && tzx_set_position(player->tzx, &rec->tzx) != 0)
+    {
+        fprintf(stderr, "Error: Saved tape position does not match the loaded tape\n");
+        return -1;
     }
 
-    return player->ear_level;
+    player->image_pos = rec->image_pos;
+    player->block = rec->block;
+    player->block.data = rec->block_offset != UINT64_MAX ? player->image + rec->block_offset : NULL;
+    player->current_block = rec->current_block;
+    player->gen_pos = rec->gen_pos;
+    player->run_fill = rec->run_fill;
+    player->run_index = rec->run_index;
+    player->pulse_index = rec->pulse_index;
+    player->gen_phase = rec->gen_phase;
+    player->gen_bit = rec->gen_bit;
+    player->gen_level = rec->gen_level;
+    player->ear_level = rec->ear_level;
+    player->state = (tape_state_t)rec->state;
+    memcpy(player->runs, rec->runs, sizeof(player->runs));
+
+    if (rec->edge_delta == INT64_MAX)
+        player->next_edge = UINT64_MAX;
+    else if (rec->edge_delta < 0 && current_cycle < (uint64_t)-rec->edge_delta)
+        player->next_edge = 0;
+    else
+        player->next_edge = current_cycle + (uint64_t)rec->edge_delta;
+    return 0;
 }
 
 /**
@@ -54,52 +54,108 @@ typedef struct
 } tap_file_t;
 
 /**
- * Tape player state machine - simulates cassette playback
+ * Tape player state - simulates cassette playback
  * Feeds pulse data to port 0xFE bit 6 (EAR input) for ROM loader
  */
 typedef enum
 {
-    TAPE_STATE_IDLE,  // No tape loaded
-    TAPE_STATE_PILOT, // Playing pilot tone
-    TAPE_STATE_SYNC,  // Playing sync pulses
-    TAPE_STATE_DATA,  // Playing data bits
-    TAPE_STATE_END    // Tape finished
+    TAPE_STATE_IDLE,    // Motor not started yet (no EAR read so far)
+    TAPE_STATE_PLAYING, // Pulses are playing
+    TAPE_STATE_END      // Tape finished
 } tape_state_t;
 
+// Pulse run levels
+#define TAPE_LEVEL_LOW 0    // First pulse of the run is low
+#define TAPE_LEVEL_HIGH 1   // First pulse of the run is high
+#define TAPE_LEVEL_INVERT 2 // First pulse inverts the previous level (an edge)
+
+/**
+ * Run of consecutive pulses of equal length
+ * Within a toggling run every pulse boundary is an edge; a held run keeps
+ * one level for all of its pulses (direct recording samples, pauses).
+ */
+typedef struct
+{
+    uint32_t length;     // Pulse length in T-states
+    uint16_t count;      // Number of pulses in the run
+    uint8_t first_level; // TAPE_LEVEL_LOW, TAPE_LEVEL_HIGH or TAPE_LEVEL_INVERT
+    uint8_t hold;        // Non-zero: no edges inside the run
+} tape_pulse_run_t;
+
+/**
+ * Kind of playable tape block
+ */
+typedef enum
+{
+    TAPE_BLOCK_DATA,   // Pilot, sync pulses, data bits, pause (TAP, TZX 0x10/0x11/0x14)
+    TAPE_BLOCK_TONE,   // Pulses of one length (TZX 0x12)
+    TAPE_BLOCK_PULSES, // Pulses of individual lengths (TZX 0x13)
+    TAPE_BLOCK_DIRECT, // One sample per bit, MSB first, 1 = high (TZX 0x15)
+    TAPE_BLOCK_PAUSE,  // Silence (TZX 0x20)
+    TAPE_BLOCK_LEVEL   // Set the level of the next pulse (TZX 0x2B)
+} tape_block_type_t;
+
+/**
+ * Playable tape block
+ * All timings are in T-states; data points into the tape image.
+ */
+typedef struct
+{
+    tape_block_type_t type;
+    const uint8_t *data;   // DATA: flag, data, checksum; PULSES: 16-bit lengths; DIRECT: samples
+    uint32_t length;       // Data length in bytes (PULSES: number of pulses)
+    uint16_t pilot_length; // DATA: pilot pulse; TONE: pulse; DIRECT: T-states per sample
+    uint16_t pilot_pulses; // DATA: pilot pulses (0 = none); TONE: pulses
+    uint16_t sync1_length; // DATA: first sync pulse (0 = none)
+    uint16_t sync2_length; // DATA: second sync pulse (0 = none)
+    uint16_t zero_length;  // DATA: each of the two pulses of a 0 bit
+    uint16_t one_length;   // DATA: each of the two pulses of a 1 bit
+    uint8_t used_bits;     // DATA/DIRECT: bits used in the last byte (1-8)
+    uint8_t level;         // LEVEL: new signal level
+    uint16_t pause_ms;     // Silence after the block in milliseconds
+} tape_block_t;
+
+// Pulse runs generated ahead of the playback cursor
+#define TAPE_RUN_BUFFER 1024
+
 /**
  * Tape player context
+ *
+ * The tape file is memory-mapped and read one block at a time (TAP, or TZX
+ * through tzx.h). Each block is expanded on demand into a small buffer of
+ * run-length pulses; playback is a cursor over that buffer: an EAR read only
+ * compares the cycle against the next edge, and catching up over a long gap
+ * skips whole runs at once. Memory use does not depend on the tape size.
  */
 typedef struct
 {
-    // File playback
-    tap_file_t *tap_file;   // Current TAP file
-    uint32_t current_block; // Current block index
-    uint8_t *block_data;    // Current block being played
-    uint16_t block_len;     // Length of current block
-    uint32_t block_bit_pos; // Current bit position within block
-
-    // Playback state
-    tape_state_t state;       // Current playback state
-    uint32_t pulse_count;     // Pulses remaining in current phase
-    uint16_t pulse_length;    // Current pulse length in T-states
-    uint8_t ear_level;        // Current EAR output level (0=low, 1=high)
-    uint64_t cycle_count;     // Z80 cycles until next edge
-    uint64_t last_edge_cycle; // Cycle count of last edge
-
-    // Data bit encoding state (each bit = 2 pulses)
-    uint8_t data_pulse_phase;  // 0 = first pulse of bit, 1 = second pulse
-    uint8_t current_bit_value; // Current bit value (0 or 1) for second pulse
-
-    // Timings (T-states)
-    uint16_t pilot_length; // Pilot pulse length (2168)
-    uint16_t pilot_count;  // Number of pilot pulses (8063 or 3223)
-    uint16_t sync1_length; // First sync pulse (667)
-    uint16_t sync2_length; // Second sync pulse (735)
-    uint16_t zero_length;  // Zero bit pulse length (855)
-    uint16_t one_length;   // One bit pulse length (1710)
+    // Tape image
+    const uint8_t *image;     // Read-only mapping of the file
+    size_t image_size;        // Size of the mapping
+    size_t image_pos;         // TAP: offset of the next block
+    struct tzx_reader_s *tzx; // TZX block reader, NULL for TAP files
+
+    // Block being expanded into pulses
+    tape_block_t block;       // Current block
+    uint32_t current_block;   // Number of blocks started so far, minus one
+    uint8_t gen_phase;        // Generator position: pilot, sync, data, pause, done
+    uint8_t gen_bit;          // Next bit within the current byte (7 = MSB)
+    uint8_t gen_level;        // Forced first level of the next run, or TAPE_LEVEL_INVERT
+    uint32_t gen_pos;         // Next byte, pulse or sample within the block
+
+    // Pulses of the current block not yet played
+    tape_pulse_run_t runs[TAPE_RUN_BUFFER];
+    uint32_t run_fill;        // Runs in the buffer
+
+    // Playback cursor
+    tape_state_t state;      // Current playback state
+    uint32_t run_index;      // Run being played
+    uint32_t pulse_index;    // Pulse within the run
+    uint64_t next_edge;      // Cycle at which the current pulse ends
+    uint8_t ear_level;       // Current EAR output level (0=low, 1=high)
 
     // Debug logging
-    FILE *debug_log;     // Debug log file handle
+    FILE *debug_log;     // Debug log file handle (block transitions only)
     uint64_t read_count; // Number of times tape_player_read_ear was called
 } tape_player_t;
 
@@ -135,12 +191,24 @@ int tap_load_to_memory(const char *filename, uint8_t *memory, size_t memory_size
 int tap_get_info(const char *filename, uint32_t *block_count, uint32_t *total_data_size);
 
 /**
- * AUTHENTIC TAPE LOADING - Initialize tape player with TAP file
+ * Fill in a standard-speed data block (ROM loader timings)
+ * The pilot tone length follows the flag byte (data[0]).
+ */
+void tape_block_standard(tape_block_t *block, const uint8_t *data, uint32_t length, uint16_t pause_ms);
+
+/**
+ * AUTHENTIC TAPE LOADING - Initialize tape player with a TAP or TZX file
  * Player will simulate cassette playback through port 0xFE
+ * The format is detected from the TZX signature
  * Returns NULL on error
  */
 tape_player_t *tape_player_init(const char *filename);
 
+/**
+ * Print the format and size of the loaded tape to stdout
+ */
+void tape_player_print_info(const tape_player_t *player);
+
 /**
  * Close tape player and free resources
  */
@@ -153,6 +221,42 @@ void tape_player_close(tape_player_t *player);
  */
 uint8_t tape_player_read_ear(tape_player_t *player, uint64_t current_cycle);
 
+/**
+ * Get the number of cycles from current_cycle until the next EAR edge
+ * Lets callers skip over polling loops that cannot see an edge sooner
+ * Returns UINT64_MAX if playback has not started or has finished
+ */
+uint64_t tape_player_cycles_to_edge(tape_player_t *player, uint64_t current_cycle);
+
+/**
+ * Take the next data block for flash loading
+ * Skips any non-data blocks at the head, returns the first data block and
+ * moves playback on to the block after it, starting at current_cycle.
+ * The data pointer stays valid until the player is closed.
+ * Returns 0 if successful, -1 if the tape has no more data blocks
+ */
+int tape_player_take_block(tape_player_t *player, uint64_t current_cycle, const uint8_t **data, uint32_t *length);
+
+/**
+ * Get the size of a tape_player_save_state() record
+ */
+size_t tape_player_state_size(void);
+
+/**
+ * Save the playback position (block, pulse generator and cursor)
+ * Cycles are stored relative to current_cycle. The record is only valid for
+ * the same tape file.
+ * Returns bytes written, or 0 if the buffer is too small
+ */
+size_t tape_player_save_state(const tape_player_t *player, uint64_t current_cycle, uint8_t *buffer, size_t buffer_size);
+
+/**
+ * Restore a playback position saved by tape_player_save_state()
+ * Relative cycles are re-based onto current_cycle.
+ * Returns 0 if successful, -1 if the record does not match this tape
+ */
+int tape_player_load_state(tape_player_t *player, uint64_t current_cycle, const uint8_t *buffer, size_t buffer_size);
+
 /**
  * Check if tape playback is complete
  * Returns 1 if tape finished, 0 if still playing
@@ -0,0 +1,739 @@
+/**
+ * Spettrum benchmark suite (make bench)
+ *
+ * Runs fixed workloads and writes the measurements as JSON:
+ * - Emulator workloads run bin/spettrum headless at turbo speed for a fixed
+ *   instruction count: ROM boot to the BASIC prompt, a beeper-heavy
+ *   snapshot rendered to a WAV on emulated time, and an authentic ROM tape
+ *   load (LOAD "" typed by --simulate-key). Wall time and peak RSS come
+ *   from the child process.
+ * - Every CPU workload runs twice, on the interpreter and on the
+ *   predecoded block engine (--blocks, z80_set_block_engine()), and each
+ *   result names its "engine".
+ * - ZEXDOC/ZEXALL run on the Z80 core directly, behind a CP/M shim: the
+ *   .COM image at 0x0100, BDOS calls 2 and 9 trapped at 0x0005 and warm
+ *   boot (JP 0) ending the run on a HALT.
+ * - Rendering times convert_vram_to_matrix() plus a full terminal frame
+ *   (forced repaint) for every ula_render_mode_t, on built-in stored screens
+ *   and any .scr files given.
+ *
+ * Workloads whose input file is missing are reported as skipped, so the
+ * suite runs (and stays comparable) with whatever images are at hand.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+// Include the Z80 core and the renderer: the CP/M shim drives the CPU
+// directly and the render benchmark needs the frame composer
+#include "../z80.c"
+#include "../ula.c"
+
+// Emulator workloads (instructions at turbo speed)
+#define BENCH_BOOT_INSTRUCTIONS 5000000ULL    // 48K ROM: past the copyright message
+#define BENCH_BEEPER_INSTRUCTIONS 20000000ULL // About 20 emulated seconds of sound
+#define BENCH_TAPE_INSTRUCTIONS 150000000ULL  // LOAD "" and a typical 48K tape
+#define BENCH_TAPE_KEYS "j''\n"                // LOAD "" ENTER in K mode
+#define BENCH_MAX_ARGS 16
+
+// CPU engines compared on every workload (index 1 = block engine)
+static const char *const bench_engines[] = {"interpreter", "blocks"};
+#define BENCH_ENGINES 2
+
+// CP/M shim
+#define CPM_TPA 0x0100              // Program load address
+#define CPM_BDOS 0x0005             // BDOS entry point
+#define CPM_BDOS_TOP 0xFE00         // Top of the TPA, read from 0x0006 by programs
+#define CPM_RUN_CYCLES 100000ULL    // Cycles between end-of-run checks
+#define CPM_OUTPUT_SIZE 65536       // Console output kept for the report
+
+// Rendering
+#define BENCH_RENDER_FRAMES 200 // Default frames per mode and screen
+#define BENCH_TERM_WIDTH 160    // Large enough for every mode and its border
+#define BENCH_TERM_HEIGHT 100
+#define BENCH_MAX_SCREENS 8
+
+/**
+ * Result of one timed workload
+ */
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t cycles;
+    double seconds;
+    long peak_rss_kb;
+} bench_result_t;
+
+/**
+ * CP/M machine state
+ */
+typedef struct
+{
+    z80_emulator_t *cpu;
+    uint8_t memory[Z80_MAX_MEMORY];
+    char output[CPM_OUTPUT_SIZE]; // Console output (truncated)
+    size_t output_len;
+} cpm_machine_t;
+
+/**
+ * A stored screen: 6144 bytes of bitmap and 768 of attributes
+ */
+typedef struct
+{
+    char name[64];
+    uint8_t data[SPECTRUM_RAM_SIZE];
+} bench_screen_t;
+
+static int json_first_item = 1; // No comma before the next array item
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int file_exists(const char *path)
+{
+    struct stat st;
+    return path && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * Write a JSON string literal
+ */
+static void json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(out, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(out, "\\u%04x", *p);
+        else
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Start an item of the current JSON array
+ */
+static void json_item(FILE *out)
+{
+    fprintf(out, json_first_item ? "\n    {" : ",\n    {");
+    json_first_item = 0;
+}
+
+static void json_skipped(FILE *out, const char *name, const char *reason, const char *path)
+{
+    json_item(out);
+    fprintf(out, "\"name\": ");
+    json_string(out, name);
+    fprintf(out, ", \"status\": \"skipped\", \"reason\": ");
+    char text[512];
+    snprintf(text, sizeof(text), "%s%s%s", reason, path ? ": " : "", path ? path : "");
+    json_string(out, text);
+    fprintf(out, "}");
+}
+
+/**
+ * Write the rates of a finished workload
+ */
+static void json_result(FILE *out, const char *name, const bench_result_t *result)
+{
+    double mhz = result->seconds > 0 ? (double)result->cycles / result->seconds / 1e6 : 0;
+    double ns_per_instruction = result->instructions ? result->seconds * 1e9 / (double)result->instructions : 0;
+
+    json_item(out);
+    fprintf(out, "\"name\": ");
+    json_string(out, name);
+    fprintf(out, ", \"status\": \"ok\", \"instructions\": %llu, \"cycles\": %llu, \"seconds\": %.6f",
+            (unsigned long long)result->instructions, (unsigned long long)result->cycles, result->seconds);
+    fprintf(out, ", \"emulated_mhz\": %.3f, \"ns_per_instruction\": %.3f, \"peak_rss_kb\": %ld",
+            mhz, ns_per_instruction, result->peak_rss_kb);
+}
+
+/**
+ * Scan one line of spettrum output for the end-of-run counters
+ */
+static void parse_emulator_line(const char *line, bench_result_t *result)
+{
+    static const char instructions_prefix[] = "Total instructions executed: ";
+    static const char cycles_prefix[] = "Total cycles: ";
+
+    if (strncmp(line, instructions_prefix, sizeof(instructions_prefix) - 1) == 0)
+        result->instructions = strtoull(line + sizeof(instructions_prefix) - 1, NULL, 10);
+    else if (strncmp(line, cycles_prefix, sizeof(cycles_prefix) - 1) == 0)
+        result->cycles = strtoull(line + sizeof(cycles_prefix) - 1, NULL, 10);
+}
+
+/**
+ * Run bin/spettrum with the given arguments and measure it
+ * The child's stdin and stderr are /dev/null; its stdout (rendered frames
+ * and the final counters) is read through a pipe.
+ * @return 0 on success, -1 if the run failed or reported no counters
+ */
+static int run_emulator(char *const argv[], bench_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        fprintf(stderr, "Error: Cannot create pipe for '%s'\n", argv[0]);
+        return -1;
+    }
+
+    uint64_t start_ns = monotonic_ns();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Error: Cannot start '%s'\n", argv[0]);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(null_fd);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+
+    // Collect output lines; frames are long escape-sequence lines and are dropped
+    char buf[65536];
+    char line[256];
+    size_t line_len = 0;
+    ssize_t nread;
+    while ((nread = read(pipe_fds[0], buf, sizeof(buf))) > 0)
+    {
+        for (ssize_t i = 0; i < nread; i++)
+        {
+            if (buf[i] == '\n')
+            {
+                line[line_len < sizeof(line) ? line_len : sizeof(line) - 1] = '\0';
+                if (line_len < sizeof(line))
+                    parse_emulator_line(line, result);
+                line_len = 0;
+            }
+            else if (line_len < sizeof(line))
+            {
+                line[line_len++] = buf[i];
+            }
+        }
+    }
+    close(pipe_fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return -1;
+    result->seconds = (double)(monotonic_ns() - start_ns) / 1e9;
+    result->peak_rss_kb = usage.ru_maxrss;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || result->instructions == 0)
+    {
+        fprintf(stderr, "Error: '%s' failed (exit status %d)\n", argv[0],
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Run one emulator workload on each engine and report it
+ * The block engine run gets --blocks right after the binary name.
+ */
+static void bench_emulator(FILE *out, const char *name, char *const argv[])
+{
+    for (int engine = 0; engine < BENCH_ENGINES; engine++)
+    {
+        char *engine_argv[BENCH_MAX_ARGS];
+        int argc = 0;
+        engine_argv[argc++] = argv[0];
+        if (engine == 1)
+            engine_argv[argc++] = "--blocks";
+        for (int i = 1; argv[i] && argc < BENCH_MAX_ARGS - 1; i++)
+            engine_argv[argc++] = argv[i];
+        engine_argv[argc] = NULL;
+
+        bench_result_t result;
+        fprintf(stderr, "bench: %s (%s)\n", name, bench_engines[engine]);
+        if (run_emulator(engine_argv, &result) != 0)
+        {
+            json_skipped(out, name, "emulator run failed", NULL);
+            continue;
+        }
+        json_result(out, name, &result);
+        fprintf(out, ", \"engine\": \"%s\"}", bench_engines[engine]);
+    }
+}
+
+/**
+ * BDOS trap: console output calls, then return to the caller
+ */
+static int cpm_bdos_trap(void *user_data, uint16_t addr)
+{
+    cpm_machine_t *machine = (cpm_machine_t *)user_data;
+    z80_emulator_t *cpu = machine->cpu;
+    (void)addr;
+
+    if (cpu->regs.c == 2) // C_WRITE: character in E
+    {
+        if (machine->output_len < CPM_OUTPUT_SIZE - 1)
+            machine->output[machine->output_len++] = (char)cpu->regs.e;
+    }
+    else if (cpu->regs.c == 9) // C_WRITESTR: '$'-terminated string at DE
+    {
+        uint16_t ptr = (uint16_t)((cpu->regs.d << 8) | cpu->regs.e);
+        for (int i = 0; i < Z80_MAX_MEMORY && machine->memory[ptr] != '$'; i++, ptr++)
+        {
+            if (machine->output_len < CPM_OUTPUT_SIZE - 1)
+                machine->output[machine->output_len++] = (char)machine->memory[ptr];
+        }
+    }
+
+    // RET
+    cpu->regs.pc = (uint16_t)(machine->memory[cpu->regs.sp] | (machine->memory[(uint16_t)(cpu->regs.sp + 1)] << 8));
+    cpu->regs.sp += 2;
+    cpu->cyc += 10;
+    return 1;
+}
+
+/**
+ * Count occurrences of a word in the console output
+ */
+static int count_word(const char *text, const char *word)
+{
+    int count = 0;
+    for (const char *p = strstr(text, word); p; p = strstr(p + 1, word))
+        count++;
+    return count;
+}
+
+/**
+ * Run a CP/M instruction exerciser (ZEXDOC, ZEXALL) on one engine and report it
+ * @param max_instructions Instruction cap (0 = run to completion)
+ * @param engine Index into bench_engines
+ */
+static void bench_zex(FILE *out, const char *name, const char *path, uint64_t max_instructions, int engine)
+{
+    if (!file_exists(path))
+    {
+        if (engine == 0)
+            json_skipped(out, name, "file not found", path);
+        return;
+    }
+
+    cpm_machine_t *machine = calloc(1, sizeof(cpm_machine_t));
+    if (!machine)
+    {
+        json_skipped(out, name, "out of memory", NULL);
+        return;
+    }
+
+    FILE *f = fopen(path, "rb");
+    size_t size = f ? fread(&machine->memory[CPM_TPA], 1, CPM_BDOS_TOP - CPM_TPA, f) : 0;
+    if (f)
+        fclose(f);
+    if (size == 0)
+    {
+        json_skipped(out, name, "cannot read", path);
+        free(machine);
+        return;
+    }
+
+    // Page zero: HALT at the warm boot vector, JP to the top of the TPA at BDOS
+    machine->memory[0x0000] = 0x76;
+    machine->memory[CPM_BDOS] = 0xC3;
+    machine->memory[CPM_BDOS + 1] = CPM_BDOS_TOP & 0xFF;
+    machine->memory[CPM_BDOS + 2] = CPM_BDOS_TOP >> 8;
+
+    machine->cpu = z80_init();
+    if (!machine->cpu)
+    {
+        json_skipped(out, name, "cannot create CPU", NULL);
+        free(machine);
+        return;
+    }
+    z80_map_pages(machine->cpu, 0x0000, Z80_MAX_MEMORY, machine->memory, Z80_PAGE_RAM);
+    z80_set_exec_trap(machine->cpu, CPM_BDOS, cpm_bdos_trap, machine);
+    machine->cpu->regs.pc = CPM_TPA;
+    machine->cpu->regs.sp = CPM_BDOS_TOP;
+    if (engine == 1 && z80_set_block_engine(machine->cpu, true) != 0)
+    {
+        json_skipped(out, name, "cannot allocate block cache", NULL);
+        z80_cleanup(machine->cpu);
+        free(machine);
+        return;
+    }
+
+    fprintf(stderr, "bench: %s (%s)\n", name, bench_engines[engine]);
+    uint64_t budget = max_instructions ? max_instructions : UINT64_MAX;
+    uint64_t executed = 0;
+    uint64_t start_ns = monotonic_ns();
+    while (!machine->cpu->halted && executed < budget)
+        executed += z80_run_until(machine->cpu, machine->cpu->cyc + CPM_RUN_CYCLES, budget - executed);
+
+    bench_result_t result;
+    result.instructions = executed;
+    result.cycles = machine->cpu->cyc;
+    result.seconds = (double)(monotonic_ns() - start_ns) / 1e9;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peak_rss_kb = usage.ru_maxrss;
+
+    machine->output[machine->output_len] = '\0';
+    json_result(out, name, &result);
+    fprintf(out, ", \"engine\": \"%s\", \"completed\": %s, \"errors\": %d}", bench_engines[engine],
+            machine->cpu->halted ? "true" : "false", count_word(machine->output, "ERROR"));
+
+    z80_cleanup(machine->cpu);
+    free(machine);
+}
+
+/**
+ * Address of a bitmap byte in Spectrum screen layout
+ */
+static int screen_offset(int y, int x_byte)
+{
+    return ((y & 0xC0) << 5) | ((y & 0x07) << 8) | ((y & 0x38) << 2) | x_byte;
+}
+
+/**
+ * Fill the built-in stored screens
+ * blank: paper only; text: the full character set; noise: random bitmap
+ * and attributes (including FLASH and BRIGHT), the worst case for colours.
+ * @return Number of screens filled
+ */
+static int builtin_screens(bench_screen_t *screens)
+{
+    bench_screen_t *blank = &screens[0];
+    strcpy(blank->name, "blank");
+    memset(blank->data, 0, SPECTRUM_VRAM_SIZE);
+    memset(blank->data + SPECTRUM_VRAM_SIZE, 0x38, SPECTRUM_ATTR_SIZE);
+
+    bench_screen_t *text = &screens[1];
+    strcpy(text->name, "text");
+    for (int row = 0; row < 24; row++)
+        for (int col = 0; col < 32; col++)
+            for (int line = 0; line < 8; line++)
+                text->data[screen_offset(row * 8 + line, col)] = sinclair_font[(row * 32 + col) % 96][line];
+    memset(text->data + SPECTRUM_VRAM_SIZE, 0x38, SPECTRUM_ATTR_SIZE);
+
+    bench_screen_t *noise = &screens[2];
+    strcpy(noise->name, "noise");
+    uint32_t seed = 0x5EED1234;
+    for (int i = 0; i < SPECTRUM_RAM_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        noise->data[i] = (uint8_t)(seed >> 16);
+    }
+
+    return 3;
+}
+
+/**
+ * Load a .scr screen dump (6912 bytes)
+ * @return 0 on success, -1 on error
+ */
+static int load_screen(const char *path, bench_screen_t *screen)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Error: Cannot open screen '%s'\n", path);
+        return -1;
+    }
+    size_t size = fread(screen->data, 1, SPECTRUM_RAM_SIZE, f);
+    fclose(f);
+    if (size != SPECTRUM_RAM_SIZE)
+    {
+        fprintf(stderr, "Error: '%s' is not a %d byte screen dump\n", path, SPECTRUM_RAM_SIZE);
+        return -1;
+    }
+
+    const char *base = strrchr(path, '/');
+    snprintf(screen->name, sizeof(screen->name), "%s", base ? base + 1 : path);
+    return 0;
+}
+
+/**
+ * Time matrix conversion plus a full frame for every mode and screen
+ * Frame output goes to /dev/null.
+ */
+static void bench_render(FILE *out, const bench_screen_t *screens, int screen_count, int frames)
+{
+    static const struct
+    {
+        ula_render_mode_t mode;
+        const char *name;
+    } modes[] = {
+        {ULA_RENDER_BLOCK2X2, "block"},
+        {ULA_RENDER_BRAILLE2X4, "braille"},
+        {ULA_RENDER_OCR, "ocr"}};
+
+    fprintf(stderr, "bench: render\n");
+
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (saved_stdout < 0 || null_fd < 0)
+    {
+        fprintf(stderr, "Error: Cannot redirect frame output\n");
+        return;
+    }
+
+    ula_t *display = ula_init(SPECTRUM_WIDTH, SPECTRUM_HEIGHT, NULL, ULA_RENDER_BLOCK2X2);
+    if (!display)
+    {
+        fprintf(stderr, "Error: Cannot create ULA display\n");
+        close(null_fd);
+        close(saved_stdout);
+        return;
+    }
+
+    for (int s = 0; s < screen_count; s++)
+    {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+        {
+            // Results may be going to stdout too: flush them before redirecting
+            fflush(stdout);
+            dup2(null_fd, STDOUT_FILENO);
+            uint64_t start_ns = monotonic_ns();
+            for (int frame = 0; frame < frames; frame++)
+            {
+                convert_vram_to_matrix(display, screens[s].data, modes[m].mode);
+                atomic_store(&term_redraw, 1);
+                compose_frame(display->matrix, BENCH_TERM_WIDTH, BENCH_TERM_HEIGHT);
+                render_flush();
+            }
+            fflush(stdout);
+            double seconds = (double)(monotonic_ns() - start_ns) / 1e9;
+            dup2(saved_stdout, STDOUT_FILENO);
+
+            json_item(out);
+            fprintf(out, "\"mode\": \"%s\", \"screen\": ", modes[m].name);
+            json_string(out, screens[s].name);
+            fprintf(out, ", \"frames\": %d, \"seconds\": %.6f, \"frames_per_second\": %.1f, \"us_per_frame\": %.2f}",
+                    frames, seconds, seconds > 0 ? frames / seconds : 0, frames ? seconds * 1e6 / frames : 0);
+        }
+    }
+
+    ula_cleanup(display);
+    close(null_fd);
+    close(saved_stdout);
+}
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [OPTIONS]\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -h, --help                Show this help message\n");
+    printf("  -b, --binary FILE         Emulator binary (default: ../bin/spettrum)\n");
+    printf("  -r, --rom FILE            48K ROM for the emulator workloads\n");
+    printf("  -s, --snapshot FILE       Beeper-heavy snapshot\n");
+    printf("  -t, --tap FILE            Tape for the authentic load\n");
+    printf("  -z, --zexdoc FILE         ZEXDOC .COM image\n");
+    printf("  -Z, --zexall FILE         ZEXALL .COM image\n");
+    printf("  -x, --zex-instructions N  Stop ZEXDOC/ZEXALL after N instructions (default: run to the end)\n");
+    printf("  -S, --screen FILE.scr     Extra stored screen for the render benchmark (repeatable)\n");
+    printf("  -f, --frames N            Frames per render mode and screen (default: %d)\n", BENCH_RENDER_FRAMES);
+    printf("  -o, --output FILE         Write the JSON results to FILE (default: stdout)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *binary = "../bin/spettrum";
+    const char *rom_file = NULL;
+    const char *snapshot_file = NULL;
+    const char *tap_file = NULL;
+    const char *zexdoc_file = NULL;
+    const char *zexall_file = NULL;
+    const char *output_file = NULL;
+    uint64_t zex_instructions = 0;
+    int frames = BENCH_RENDER_FRAMES;
+    static bench_screen_t screens[BENCH_MAX_SCREENS];
+    int screen_count = builtin_screens(screens);
+
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"binary", required_argument, 0, 'b'},
+        {"rom", required_argument, 0, 'r'},
+        {"snapshot", required_argument, 0, 's'},
+        {"tap", required_argument, 0, 't'},
+        {"zexdoc", required_argument, 0, 'z'},
+        {"zexall", required_argument, 0, 'Z'},
+        {"zex-instructions", required_argument, 0, 'x'},
+        {"screen", required_argument, 0, 'S'},
+        {"frames", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hb:r:s:t:z:Z:x:S:f:o:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'b':
+            binary = optarg;
+            break;
+        case 'r':
+            rom_file = optarg;
+            break;
+        case 's':
+            snapshot_file = optarg;
+            break;
+        case 't':
+            tap_file = optarg;
+            break;
+        case 'z':
+            zexdoc_file = optarg;
+            break;
+        case 'Z':
+            zexall_file = optarg;
+            break;
+        case 'x':
+            zex_instructions = strtoull(optarg, NULL, 0);
+            break;
+        case 'S':
+            if (screen_count >= BENCH_MAX_SCREENS)
+            {
+                fprintf(stderr, "Error: At most %d screens\n", BENCH_MAX_SCREENS);
+                return EXIT_FAILURE;
+            }
+            if (load_screen(optarg, &screens[screen_count]) != 0)
+                return EXIT_FAILURE;
+            screen_count++;
+            break;
+        case 'f':
+            frames = atoi(optarg);
+            if (frames <= 0)
+                frames = BENCH_RENDER_FRAMES;
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *out = stdout;
+    if (output_file)
+    {
+        out = fopen(output_file, "w");
+        if (!out)
+        {
+            fprintf(stderr, "Error: Cannot create '%s'\n", output_file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Header: when and where the numbers were taken
+    struct utsname host;
+    uname(&host);
+    fprintf(out, "{\n  \"timestamp\": %lld,\n  \"host\": ", (long long)time(NULL));
+    json_string(out, host.nodename);
+    fprintf(out, ",\n  \"system\": ");
+    json_string(out, host.sysname);
+    fprintf(out, ",\n  \"release\": ");
+    json_string(out, host.release);
+    fprintf(out, ",\n  \"machine\": ");
+    json_string(out, host.machine);
+    fprintf(out, ",\n  \"cpus\": %ld,", sysconf(_SC_NPROCESSORS_ONLN));
+
+    // Emulator workloads
+    char boot_count[32], beeper_count[32], tape_count[32];
+    snprintf(boot_count, sizeof(boot_count), "%llu", BENCH_BOOT_INSTRUCTIONS);
+    snprintf(beeper_count, sizeof(beeper_count), "%llu", BENCH_BEEPER_INSTRUCTIONS);
+    snprintf(tape_count, sizeof(tape_count), "%llu", BENCH_TAPE_INSTRUCTIONS);
+
+    fprintf(out, "\n  \"workloads\": [");
+    json_first_item = 1;
+    if (!file_exists(binary))
+    {
+        json_skipped(out, "rom_boot", "emulator not built", binary);
+        json_skipped(out, "beeper_snapshot", "emulator not built", binary);
+        json_skipped(out, "tape_load", "emulator not built", binary);
+    }
+    else if (!file_exists(rom_file))
+    {
+        json_skipped(out, "rom_boot", "ROM not found", rom_file);
+        json_skipped(out, "beeper_snapshot", "ROM not found", rom_file);
+        json_skipped(out, "tape_load", "ROM not found", rom_file);
+    }
+    else
+    {
+        char *boot_argv[] = {(char *)binary, "-T", "-r", (char *)rom_file, "-i", boot_count, NULL};
+        bench_emulator(out, "rom_boot", boot_argv);
+
+        if (file_exists(snapshot_file))
+        {
+            char *beeper_argv[] = {(char *)binary, "-T", "-r", (char *)rom_file, "-s", (char *)snapshot_file,
+                                   "-w", "/dev/null", "-i", beeper_count, NULL};
+            bench_emulator(out, "beeper_snapshot", beeper_argv);
+        }
+        else
+            json_skipped(out, "beeper_snapshot", "file not found", snapshot_file);
+
+        if (file_exists(tap_file))
+        {
+            char *tape_argv[] = {(char *)binary, "-T", "-r", (char *)rom_file, "-t", (char *)tap_file,
+                                 "-k", BENCH_TAPE_KEYS, "-i", tape_count, NULL};
+            bench_emulator(out, "tape_load", tape_argv);
+        }
+        else
+            json_skipped(out, "tape_load", "file not found", tap_file);
+    }
+
+    for (int engine = 0; engine < BENCH_ENGINES; engine++)
+    {
+        bench_zex(out, "zexdoc", zexdoc_file, zex_instructions, engine);
+        bench_zex(out, "zexall", zexall_file, zex_instructions, engine);
+    }
+    fprintf(out, "\n  ],");
+
+    // Rendering
+    fprintf(out, "\n  \"render\": [");
+    json_first_item = 1;
+    bench_render(out, screens, screen_count, frames);
+    fprintf(out, "\n  ],");
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(out, "\n  \"bench_peak_rss_kb\": %ld\n}\n", usage.ru_maxrss);
+
+    if (output_file)
+    {
+        fclose(out);
+        fprintf(stderr, "bench: results written to '%s'\n", output_file);
+    }
+    return EXIT_SUCCESS;
+}
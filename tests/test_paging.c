@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+// Include the emulator for testing (its main() is renamed out of the way)
+#define main spettrum_main
+#include "../main.c"
+#undef main
+
+// Test helper macros
+#define TEST_ASSERT(condition, message)                                 \
+    do                                                                  \
+    {                                                                   \
+        if (!(condition))                                               \
+        {                                                               \
+            fprintf(stderr, "FAIL: %s (line %d)\n", message, __LINE__); \
+            return 0;                                                   \
+        }                                                               \
+    } while (0)
+
+// 128K machine the tests run on (created by main)
+static spettrum_emulator_t *machine;
+
+// Runs OUT (C),A with BC = port and A = value from the 128K editor ROM
+static void out_c_a(uint16_t port, uint8_t value)
+{
+    uint8_t *rom = machine->rom_banks[0];
+    const uint8_t program[] = {
+        0x01, port & 0xFF, port >> 8, // LD BC,port
+        0x3E, value,                  // LD A,value
+        0xED, 0x79,                   // OUT (C),A
+    };
+
+    memcpy(rom, program, sizeof(program));
+    machine->cpu->regs.pc = 0x0000;
+    for (int i = 0; i < 3; i++)
+        z80_step(machine->cpu);
+}
+
+/**
+ * Test: AY register select and data writes leave the paging alone
+ */
+static int test_ay_ports_do_not_page(void)
+{
+    printf("Test: OUT to 0xFFFD and 0xBFFD...\n");
+
+    emulator_set_paging(machine, 0);
+
+    // Bank 7, screen 7, ROM 1 and the lock bit
+    out_c_a(0xFFFD, 0x3F);
+    TEST_ASSERT(machine->port_7ffd == 0, "OUT 0xFFFD should not reach the paging port");
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[0], "OUT 0xFFFD should leave bank 0 at 0xC000");
+
+    out_c_a(0xBFFD, 0x3F);
+    TEST_ASSERT(machine->port_7ffd == 0, "OUT 0xBFFD should not reach the paging port");
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[0], "OUT 0xBFFD should leave bank 0 at 0xC000");
+    TEST_ASSERT(machine->slots[0] == machine->rom_banks[0], "OUT 0xBFFD should leave ROM 0 paged in");
+
+    printf("  PASS\n");
+    return 1;
+}
+
+/**
+ * Test: OUT to 0x7FFD pages RAM, ROM and the screen
+ */
+static int test_7ffd_pages(void)
+{
+    printf("Test: OUT to 0x7FFD...\n");
+
+    emulator_set_paging(machine, 0);
+
+    out_c_a(0x7FFD, 0x03);
+    TEST_ASSERT(machine->port_7ffd == 0x03, "OUT 0x7FFD should be latched");
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[3], "Bank 3 should be paged in at 0xC000");
+    TEST_ASSERT(machine->slots[1] == machine->ram_banks[5], "Bank 5 should stay at 0x4000");
+    TEST_ASSERT(machine->slots[2] == machine->ram_banks[2], "Bank 2 should stay at 0x8000");
+
+    // ROM 1 is paged in from here on: the next program runs from it
+    out_c_a(0x7FFD, 0x18);
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[0], "Bank 0 should be paged in at 0xC000");
+    TEST_ASSERT(machine->slots[0] == machine->rom_banks[1], "ROM 1 should be paged in");
+    TEST_ASSERT(machine->screen == machine->ram_banks[7], "Screen should come from bank 7");
+
+    printf("  PASS\n");
+    return 1;
+}
+
+/**
+ * Test: The lock bit freezes the paging until reset
+ */
+static int test_7ffd_lock(void)
+{
+    printf("Test: 0x7FFD lock bit...\n");
+
+    emulator_set_paging(machine, 0);
+
+    out_c_a(0x7FFD, 0x24); // Bank 4, locked
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[4], "Bank 4 should be paged in at 0xC000");
+
+    out_c_a(0x7FFD, 0x01);
+    TEST_ASSERT(machine->slots[3] == machine->ram_banks[4], "Locked paging should ignore OUT 0x7FFD");
+
+    emulator_set_paging(machine, 0);
+    printf("  PASS\n");
+    return 1;
+}
+
+int main(void)
+{
+    printf("=== 128K Paging Tests ===\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    machine = emulator_init(ULA_RENDER_BLOCK2X2, false);
+    static uint8_t rom[SPETTRUM_128K_ROM_SIZE];
+    if (!machine || emulator_install_rom(machine, rom, sizeof(rom)) != 0)
+    {
+        fprintf(stderr, "Failed to create a 128K machine\n");
+        return 1;
+    }
+
+    total++;
+    if (test_ay_ports_do_not_page())
+        passed++;
+
+    total++;
+    if (test_7ffd_pages())
+        passed++;
+
+    total++;
+    if (test_7ffd_lock())
+        passed++;
+
+    emulator_cleanup(machine);
+
+    printf("\n=== Results ===\n");
+    printf("Passed: %d/%d\n", passed, total);
+
+    if (passed == total)
+    {
+        printf("All tests passed!\n");
+        return 0;
+    }
+    else
+    {
+        printf("Some tests failed!\n");
+        return 1;
+    }
+}
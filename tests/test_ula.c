@@ -29,6 +29,9 @@
         }                                                                                                              \
     } while (0)
 
+// Display whose matrix the tests convert into (created by main)
+static ula_t *display;
+
 // Helper to set a pixel in VRAM
 static void set_pixel(uint8_t *vram, int x, int y, int value)
 {
@@ -55,12 +58,12 @@ static int test_empty_vram(void)
     uint8_t *vram = calloc(SPECTRUM_RAM_SIZE, sizeof(uint8_t));
     TEST_ASSERT(vram != NULL, "VRAM allocation failed");
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // Check first row is all spaces
     for (int x = 0; x < 5; x++)
     {
-        TEST_ASSERT_CHAR(" ", ula_matrix.matrix[0][x], "Empty VRAM should produce spaces");
+        TEST_ASSERT_CHAR(" ", display->matrix->matrix[0][x], "Empty VRAM should produce spaces");
     }
 
     free(vram);
@@ -82,9 +85,9 @@ static int test_single_pixel_br(void)
     // This corresponds to pixel (1,1)
     set_pixel(vram, 1, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    TEST_ASSERT_CHAR("▗", ula_matrix.matrix[0][0], "BR pixel should produce ▗");
+    TEST_ASSERT_CHAR("▗", display->matrix->matrix[0][0], "BR pixel should produce ▗");
 
     free(vram);
     printf("  PASS\n");
@@ -105,10 +108,10 @@ static int test_two_pixels(void)
     set_pixel(vram, 0, 0, 1);
     set_pixel(vram, 1, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // TL=1, TR=0, BL=0, BR=1 -> pattern 1001 (9) -> ▚ (diagonal /)
-    TEST_ASSERT_CHAR("▚", ula_matrix.matrix[0][0], "TL+BR should produce ▚");
+    TEST_ASSERT_CHAR("▚", display->matrix->matrix[0][0], "TL+BR should produce ▚");
 
     free(vram);
     printf("  PASS\n");
@@ -131,9 +134,9 @@ static int test_full_block(void)
     set_pixel(vram, 0, 1, 1);
     set_pixel(vram, 1, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    TEST_ASSERT_CHAR("█", ula_matrix.matrix[0][0], "All pixels should produce █");
+    TEST_ASSERT_CHAR("█", display->matrix->matrix[0][0], "All pixels should produce █");
 
     free(vram);
     printf("  PASS\n");
@@ -154,10 +157,10 @@ static int test_top_row(void)
     set_pixel(vram, 0, 0, 1);
     set_pixel(vram, 1, 0, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // TL=1, TR=1, BL=0, BR=0 -> pattern 1100 (12) -> ▀
-    TEST_ASSERT_CHAR("▀", ula_matrix.matrix[0][0], "Top row should produce ▀");
+    TEST_ASSERT_CHAR("▀", display->matrix->matrix[0][0], "Top row should produce ▀");
 
     free(vram);
     printf("  PASS\n");
@@ -178,10 +181,10 @@ static int test_bottom_row(void)
     set_pixel(vram, 0, 1, 1);
     set_pixel(vram, 1, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // TL=0, TR=0, BL=1, BR=1 -> pattern 0011 (3) -> ▄
-    TEST_ASSERT_CHAR("▄", ula_matrix.matrix[0][0], "Bottom row should produce ▄");
+    TEST_ASSERT_CHAR("▄", display->matrix->matrix[0][0], "Bottom row should produce ▄");
 
     free(vram);
     printf("  PASS\n");
@@ -202,10 +205,10 @@ static int test_left_column(void)
     set_pixel(vram, 0, 0, 1);
     set_pixel(vram, 0, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // TL=1, TR=0, BL=1, BR=0 -> pattern 1010 (10) -> ▌
-    TEST_ASSERT_CHAR("▌", ula_matrix.matrix[0][0], "Left column should produce ▌");
+    TEST_ASSERT_CHAR("▌", display->matrix->matrix[0][0], "Left column should produce ▌");
 
     free(vram);
     printf("  PASS\n");
@@ -226,10 +229,10 @@ static int test_right_column(void)
     set_pixel(vram, 1, 0, 1);
     set_pixel(vram, 1, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // TL=0, TR=1, BL=0, BR=1 -> pattern 0101 (5) -> ▐
-    TEST_ASSERT_CHAR("▐", ula_matrix.matrix[0][0], "Right column should produce ▐");
+    TEST_ASSERT_CHAR("▐", display->matrix->matrix[0][0], "Right column should produce ▐");
 
     free(vram);
     printf("  PASS\n");
@@ -258,11 +261,11 @@ static int test_multiple_blocks(void)
     // Third block (x=2): BR only
     set_pixel(vram, 5, 1, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    TEST_ASSERT_CHAR("█", ula_matrix.matrix[0][0], "First block should be full");
-    TEST_ASSERT_CHAR(" ", ula_matrix.matrix[0][1], "Second block should be empty");
-    TEST_ASSERT_CHAR("▗", ula_matrix.matrix[0][2], "Third block should be BR");
+    TEST_ASSERT_CHAR("█", display->matrix->matrix[0][0], "First block should be full");
+    TEST_ASSERT_CHAR(" ", display->matrix->matrix[0][1], "Second block should be empty");
+    TEST_ASSERT_CHAR("▗", display->matrix->matrix[0][2], "Third block should be BR");
 
     free(vram);
     printf("  PASS\n");
@@ -287,10 +290,10 @@ static int test_different_rows(void)
     set_pixel(vram, 0, 2, 1);
     set_pixel(vram, 0, 3, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    TEST_ASSERT_CHAR("▀", ula_matrix.matrix[0][0], "First row top should be ▀");
-    TEST_ASSERT_CHAR("▌", ula_matrix.matrix[1][0], "Second row left should be ▌");
+    TEST_ASSERT_CHAR("▀", display->matrix->matrix[0][0], "First row top should be ▀");
+    TEST_ASSERT_CHAR("▌", display->matrix->matrix[1][0], "Second row left should be ▌");
 
     free(vram);
     printf("  PASS\n");
@@ -322,10 +325,10 @@ static int test_attributes_default(void)
 
     // Don't set any attribute bytes - they will be 0x00
     // In ZX Spectrum, 0x00 = black ink (0) on black paper (0)
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
     // Check the color of the first block
-    color_attr_t attr = ula_matrix.matrix_colors[0][0];
+    color_attr_t attr = display->matrix->matrix_colors[0][0];
     TEST_ASSERT(attr.ink == 0, "Default ink should be 0 (black)");
     TEST_ASSERT(attr.paper == 0, "Default paper should be 0 (black) when uninitialized");
     TEST_ASSERT(attr.bright == 0, "Default bright should be 0");
@@ -351,9 +354,9 @@ static int test_attributes_custom(void)
     // Set attribute: yellow (ink=6) on cyan (paper=5), bright
     set_attribute(vram, 0, 0, 6, 5, 1);
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    color_attr_t attr = ula_matrix.matrix_colors[0][0];
+    color_attr_t attr = display->matrix->matrix_colors[0][0];
     TEST_ASSERT(attr.ink == 6, "Ink should be 6 (yellow)");
     TEST_ASSERT(attr.paper == 5, "Paper should be 5 (cyan)");
     TEST_ASSERT(attr.bright == 1, "Bright should be 1");
@@ -381,10 +384,10 @@ static int test_attributes_multiple_blocks(void)
     set_attribute(vram, 0, 0, 2, 4, 0); // Red on magenta
     set_attribute(vram, 1, 0, 3, 1, 1); // Magenta on blue, bright
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BLOCK2X2);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BLOCK2X2);
 
-    color_attr_t attr1 = ula_matrix.matrix_colors[0][0];
-    color_attr_t attr2 = ula_matrix.matrix_colors[0][4]; // 8 pixels / 2 = 4
+    color_attr_t attr1 = display->matrix->matrix_colors[0][0];
+    color_attr_t attr2 = display->matrix->matrix_colors[0][4]; // 8 pixels / 2 = 4
 
     TEST_ASSERT(attr1.ink == 2, "First block ink should be 2");
     TEST_ASSERT(attr1.paper == 4, "First block paper should be 4");
@@ -415,9 +418,9 @@ static int test_attributes_braille(void)
     // Set attribute
     set_attribute(vram, 0, 0, 1, 3, 0); // Blue on magenta
 
-    convert_vram_to_matrix(vram, ULA_RENDER_BRAILLE2X4);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_BRAILLE2X4);
 
-    color_attr_t attr = ula_matrix.braille_colors[0][0];
+    color_attr_t attr = display->matrix->braille_colors[0][0];
     TEST_ASSERT(attr.ink == 1, "Braille block ink should be 1");
     TEST_ASSERT(attr.paper == 3, "Braille block paper should be 3");
     TEST_ASSERT(attr.bright == 0, "Braille block bright should be 0");
@@ -470,6 +473,81 @@ static int test_blink_attribute(void)
     return 1;
 }
 
+/**
+ * Test: Frame conversion only revisits changed cells
+ */
+static int test_frame_conversion(void)
+{
+    printf("Test: Frame conversion...\n");
+
+    ula_frame_t *frame = calloc(1, sizeof(ula_frame_t));
+    TEST_ASSERT(frame != NULL, "Frame allocation failed");
+
+    // First call converts the whole screen
+    ula_mark_all_dirty(display);
+    convert_frame_to_matrix(display, frame, ULA_RENDER_BLOCK2X2);
+    TEST_ASSERT_CHAR(" ", display->matrix->matrix[0][0], "Empty frame should produce spaces");
+
+    // Changed pixels are picked up
+    frame->screen[0] = 0xC0; // Top-left pixels of cell (0,0)
+    convert_frame_to_matrix(display, frame, ULA_RENDER_BLOCK2X2);
+    TEST_ASSERT_CHAR("▀", display->matrix->matrix[0][0], "Changed cell should be reconverted");
+
+    // Attribute changes reconvert the cell they colour
+    frame->screen[SPECTRUM_VRAM_SIZE + 33] = 0x47;
+    convert_frame_to_matrix(display, frame, ULA_RENDER_BLOCK2X2);
+    TEST_ASSERT(display->matrix->matrix_colors[4][4].bright == 1, "Attribute change should reconvert cell (1,1)");
+
+    // Unchanged cells are left alone
+    display->matrix->matrix[0][0] = "X";
+    convert_frame_to_matrix(display, frame, ULA_RENDER_BLOCK2X2);
+    TEST_ASSERT_CHAR("X", display->matrix->matrix[0][0], "Unchanged cell should not be reconverted");
+
+    // The frame's border colour is the one rendered
+    frame->border_color = 2;
+    convert_frame_to_matrix(display, frame, ULA_RENDER_BLOCK2X2);
+    TEST_ASSERT(display->matrix->border_color == 2, "Border should come from the frame");
+
+    free(frame);
+    printf("  PASS\n");
+    return 1;
+}
+
+/**
+ * Test: OCR exact and nearest glyph matching
+ */
+static int test_ocr_recognition(void)
+{
+    printf("Test: OCR glyph recognition...\n");
+
+    uint8_t *vram = calloc(SPECTRUM_RAM_SIZE, 1);
+    TEST_ASSERT(vram != NULL, "VRAM allocation failed");
+
+    // Character row 0: pixel line l of column c lives at offset l * 256 + c
+    for (int l = 0; l < 8; l++)
+    {
+        vram[l * 256 + 0] = sinclair_font['A' - 32][l];
+        vram[l * 256 + 1] = sinclair_font['B' - 32][l];
+        vram[l * 256 + 2] = 0xFF; // Solid block matches nothing
+    }
+    vram[3 * 256 + 1] ^= 0x01; // One pixel off: nearest match
+
+    convert_vram_to_matrix(display, vram, ULA_RENDER_OCR);
+    TEST_ASSERT(display->matrix->ocr_matrix[0][0] == 'A', "Exact glyph should be recognized");
+    TEST_ASSERT(display->matrix->ocr_matrix[0][1] == 'B', "Near glyph should match nearest character");
+    TEST_ASSERT(display->matrix->ocr_matrix[0][2] == ' ', "Unknown bitmap should become a space");
+    TEST_ASSERT(display->matrix->ocr_matrix[0][3] == ' ', "Empty cell should be a space");
+
+    // Cached cell is re-recognized once its bitmap changes
+    memset(vram, 0, SPECTRUM_VRAM_SIZE);
+    convert_vram_to_matrix(display, vram, ULA_RENDER_OCR);
+    TEST_ASSERT(display->matrix->ocr_matrix[0][0] == ' ', "Changed cell should be recognized again");
+
+    free(vram);
+    printf("  PASS\n");
+    return 1;
+}
+
 /**
  * Run all tests
  */
@@ -480,6 +558,13 @@ int main(void)
     int passed = 0;
     int total = 0;
 
+    display = ula_init(SPECTRUM_WIDTH, SPECTRUM_HEIGHT, NULL, ULA_RENDER_BLOCK2X2);
+    if (!display)
+    {
+        fprintf(stderr, "Failed to create ULA display\n");
+        return 1;
+    }
+
     total++;
     if (test_empty_vram())
         passed++;
@@ -540,6 +625,16 @@ int main(void)
     if (test_blink_attribute())
         passed++;
 
+    total++;
+    if (test_frame_conversion())
+        passed++;
+
+    total++;
+    if (test_ocr_recognition())
+        passed++;
+
+    ula_cleanup(display);
+
     printf("\n=== Results ===\n");
     printf("Passed: %d/%d\n", passed, total);
 
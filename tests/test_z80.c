@@ -46,34 +46,37 @@ typedef struct
     uint8_t io_ports[256];
     int io_read_count;
     int io_write_count;
+    uint16_t last_port; // Full 16-bit port of the last access
 } mock_io_t;
 
 // Mock memory callbacks
 static uint8_t mock_read_memory(void *user_data, uint16_t addr)
 {
-    mock_memory_t *mem = (mock_memory_t *)user_data;
+    mock_memory_t *mem = (mock_memory_t *)((z80_callback_context_t *)user_data)->memory_data;
     return mem->memory[addr];
 }
 
 static void mock_write_memory(void *user_data, uint16_t addr, uint8_t value)
 {
-    mock_memory_t *mem = (mock_memory_t *)user_data;
+    mock_memory_t *mem = (mock_memory_t *)((z80_callback_context_t *)user_data)->memory_data;
     mem->memory[addr] = value;
 }
 
 // Mock I/O callbacks
-static uint8_t mock_read_io(void *user_data, uint8_t port)
+static uint8_t mock_read_io(void *user_data, uint16_t port)
 {
     mock_io_t *io = (mock_io_t *)user_data;
     io->io_read_count++;
-    return io->io_ports[port];
+    io->last_port = port;
+    return io->io_ports[port & 0xFF];
 }
 
-static void mock_write_io(void *user_data, uint8_t port, uint8_t value)
+static void mock_write_io(void *user_data, uint16_t port, uint8_t value)
 {
     mock_io_t *io = (mock_io_t *)user_data;
     io->io_write_count++;
-    io->io_ports[port] = value;
+    io->last_port = port;
+    io->io_ports[port & 0xFF] = value;
 }
 
 /**
@@ -96,7 +99,7 @@ static int test_nop(void)
     TEST_ASSERT_EQ(0x0000, initial_pc, "Initial PC should be 0");
 
     // Execute instruction manually
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t new_pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0001, new_pc, "PC should advance by 1 after NOP");
@@ -124,7 +127,7 @@ static int test_ld_b_n(void)
     memory.memory[0x0000] = 0x06;
     memory.memory[0x0001] = 0x42;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b_reg = z80_get_register(z80, "B");
     TEST_ASSERT_EQ(0x42, b_reg, "B register should contain 0x42");
@@ -156,7 +159,7 @@ static int test_ld_bc_nn(void)
     memory.memory[0x0001] = 0x34; // C
     memory.memory[0x0002] = 0x12; // B
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b = z80_get_register(z80, "B");
     uint16_t c = z80_get_register(z80, "C");
@@ -185,7 +188,7 @@ static int test_inc_b(void)
     z80_set_register(z80, "B", 0x42);
     memory.memory[0x0000] = 0x04;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b = z80_get_register(z80, "B");
     TEST_ASSERT_EQ(0x43, b, "B should increment to 0x43");
@@ -194,7 +197,7 @@ static int test_inc_b(void)
     z80_set_register(z80, "B", 0xFF);
     memory.memory[0x0001] = 0x04;
     z80_set_pc(z80, 0x0001);
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     b = z80_get_register(z80, "B");
     uint16_t f = z80_get_register(z80, "F");
@@ -223,7 +226,7 @@ static int test_dec_b(void)
     z80_set_register(z80, "B", 0x42);
     memory.memory[0x0000] = 0x05;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b = z80_get_register(z80, "B");
     TEST_ASSERT_EQ(0x41, b, "B should decrement to 0x41");
@@ -232,7 +235,7 @@ static int test_dec_b(void)
     z80_set_register(z80, "B", 0x01);
     memory.memory[0x0001] = 0x05;
     z80_set_pc(z80, 0x0001);
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     b = z80_get_register(z80, "B");
     uint16_t f = z80_get_register(z80, "F");
@@ -261,7 +264,7 @@ static int test_ld_a_n(void)
     memory.memory[0x0000] = 0x3E;
     memory.memory[0x0001] = 0x55;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     TEST_ASSERT_EQ(0x55, a, "A should contain 0x55");
@@ -289,7 +292,7 @@ static int test_add_a_b(void)
     z80_set_register(z80, "B", 0x20);
     memory.memory[0x0000] = 0x80;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     TEST_ASSERT_EQ(0x30, a, "A should be 0x30 (0x10 + 0x20)");
@@ -299,7 +302,7 @@ static int test_add_a_b(void)
     z80_set_register(z80, "B", 0x02);
     memory.memory[0x0001] = 0x80;
     z80_set_pc(z80, 0x0001);
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     a = z80_get_register(z80, "A");
     uint16_t f = z80_get_register(z80, "F");
@@ -329,7 +332,7 @@ static int test_sub_a_b(void)
     z80_set_register(z80, "B", 0x30);
     memory.memory[0x0000] = 0x90;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     uint16_t f = z80_get_register(z80, "F");
@@ -359,7 +362,7 @@ static int test_cp_a_b(void)
     z80_set_register(z80, "B", 0x42);
     memory.memory[0x0000] = 0xB8;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     uint16_t f = z80_get_register(z80, "F");
@@ -390,7 +393,7 @@ static int test_ld_hl_a(void)
     z80_set_register(z80, "A", 0x42);
     memory.memory[0x0000] = 0x77;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t mem_value = memory.memory[0x1000];
     TEST_ASSERT_EQ(0x42, mem_value, "Memory at 0x1000 should contain 0x42");
@@ -419,7 +422,7 @@ static int test_ld_a_hl(void)
     memory.memory[0x1000] = 0x99;
     memory.memory[0x0000] = 0x7E;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     TEST_ASSERT_EQ(0x99, a, "A should contain 0x99 from memory");
@@ -448,7 +451,7 @@ static int test_ld_bc_a(void)
     z80_set_register(z80, "A", 0x77);
     memory.memory[0x0000] = 0x02;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t mem_value = memory.memory[0x2030];
     TEST_ASSERT_EQ(0x77, mem_value, "Memory at 0x2030 should contain 0x77");
@@ -476,7 +479,7 @@ static int test_inc_bc(void)
     z80_set_register(z80, "C", 0x34);
     memory.memory[0x0000] = 0x03;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b = z80_get_register(z80, "B");
     uint16_t c = z80_get_register(z80, "C");
@@ -505,7 +508,7 @@ static int test_rlca(void)
     z80_set_register(z80, "A", 0x80); // 10000000
     memory.memory[0x0000] = 0x07;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     uint16_t f = z80_get_register(z80, "F");
@@ -535,7 +538,7 @@ static int test_jp_nn(void)
     memory.memory[0x0001] = 0x34; // Low byte
     memory.memory[0x0002] = 0x12; // High byte
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x1234, pc, "PC should jump to 0x1234");
@@ -559,13 +562,15 @@ static int test_in_a_n(void)
     mock_memory_t memory = {0};
     mock_io_t io = {0};
     z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
-    z80_set_io_callbacks(z80, mock_read_io, mock_write_io, &io);
+    z80_set_io_callbacks(z80, &io);
+    z80->read_io = mock_read_io;
+    z80->write_io = mock_write_io;
 
     io.io_ports[0x50] = 0xAA;
     memory.memory[0x0000] = 0xDB;
     memory.memory[0x0001] = 0x50;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     TEST_ASSERT_EQ(0xAA, a, "A should contain value from I/O port 0x50");
@@ -590,13 +595,15 @@ static int test_out_n_a(void)
     mock_memory_t memory = {0};
     mock_io_t io = {0};
     z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
-    z80_set_io_callbacks(z80, mock_read_io, mock_write_io, &io);
+    z80_set_io_callbacks(z80, &io);
+    z80->read_io = mock_read_io;
+    z80->write_io = mock_write_io;
 
     z80_set_register(z80, "A", 0xBB);
     memory.memory[0x0000] = 0xD3;
     memory.memory[0x0001] = 0x60;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     TEST_ASSERT_EQ(0xBB, io.io_ports[0x60], "I/O port 0x60 should contain 0xBB");
     TEST_ASSERT_EQ(1, io.io_write_count, "I/O write should be called once");
@@ -673,7 +680,7 @@ static int test_jr_n(void)
     memory.memory[0x0000] = 0x18;
     memory.memory[0x0001] = 0x10; // Offset +16
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0012, pc, "PC should be 0x0012 (0x0002 + 0x10)");
@@ -683,7 +690,7 @@ static int test_jr_n(void)
     memory.memory[0x0100] = 0x18;
     memory.memory[0x0101] = 0xFE; // Offset -2 (as signed byte)
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0100, pc, "PC should be 0x0100 (0x0102 + 0xFE = 0x0102 - 2)");
@@ -712,7 +719,7 @@ static int test_jr_nz(void)
     memory.memory[0x0000] = 0x20;
     memory.memory[0x0001] = 0x20; // Offset +32
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0022, pc, "PC should jump to 0x0022 when Z flag not set");
@@ -723,7 +730,7 @@ static int test_jr_nz(void)
     memory.memory[0x0100] = 0x20;
     memory.memory[0x0101] = 0x20;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0102, pc, "PC should not jump when Z flag is set");
@@ -752,7 +759,7 @@ static int test_jr_z(void)
     memory.memory[0x0000] = 0x28;
     memory.memory[0x0001] = 0x15; // Offset +21
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0017, pc, "PC should jump to 0x0017 when Z flag is set");
@@ -781,7 +788,7 @@ static int test_jr_nc(void)
     memory.memory[0x0000] = 0x30;
     memory.memory[0x0001] = 0x08;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x000A, pc, "PC should jump when C flag not set");
@@ -810,7 +817,7 @@ static int test_jr_c(void)
     memory.memory[0x0000] = 0x38;
     memory.memory[0x0001] = 0x10;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x0012, pc, "PC should jump when C flag is set");
@@ -837,7 +844,7 @@ static int test_ld_c_n(void)
     memory.memory[0x0000] = 0x0E;
     memory.memory[0x0001] = 0xCC;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t c = z80_get_register(z80, "C");
     TEST_ASSERT_EQ(0xCC, c, "C should contain 0xCC");
@@ -864,7 +871,7 @@ static int test_ld_d_n(void)
     memory.memory[0x0000] = 0x16;
     memory.memory[0x0001] = 0xDD;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t d = z80_get_register(z80, "D");
     TEST_ASSERT_EQ(0xDD, d, "D should contain 0xDD");
@@ -891,7 +898,7 @@ static int test_ld_e_n(void)
     memory.memory[0x0000] = 0x1E;
     memory.memory[0x0001] = 0xEE;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t e = z80_get_register(z80, "E");
     TEST_ASSERT_EQ(0xEE, e, "E should contain 0xEE");
@@ -918,7 +925,7 @@ static int test_ld_h_n(void)
     memory.memory[0x0000] = 0x26;
     memory.memory[0x0001] = 0x44;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t h = z80_get_register(z80, "H");
     TEST_ASSERT_EQ(0x44, h, "H should contain 0x44");
@@ -945,7 +952,7 @@ static int test_ld_l_n(void)
     memory.memory[0x0000] = 0x2E;
     memory.memory[0x0001] = 0x88;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t l = z80_get_register(z80, "L");
     TEST_ASSERT_EQ(0x88, l, "L should contain 0x88");
@@ -975,7 +982,7 @@ static int test_jp_nz_nn(void)
     memory.memory[0x0001] = 0x00;
     memory.memory[0x0002] = 0x30;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x3000, pc, "PC should jump to 0x3000 when Z flag not set");
@@ -1005,7 +1012,7 @@ static int test_jp_z_nn(void)
     memory.memory[0x0001] = 0x50;
     memory.memory[0x0002] = 0x40;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x4050, pc, "PC should jump to 0x4050 when Z flag is set");
@@ -1035,7 +1042,7 @@ static int test_jp_nc_nn(void)
     memory.memory[0x0001] = 0x22;
     memory.memory[0x0002] = 0x11;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x1122, pc, "PC should jump when C flag not set");
@@ -1065,7 +1072,7 @@ static int test_jp_c_nn(void)
     memory.memory[0x0001] = 0x77;
     memory.memory[0x0002] = 0x88;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     TEST_ASSERT_EQ(0x8877, pc, "PC should jump when C flag is set");
@@ -1094,7 +1101,7 @@ static int test_call_nn(void)
     memory.memory[0x0001] = 0x34;
     memory.memory[0x0002] = 0x12;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     uint16_t sp = z80_get_register(z80, "SP");
@@ -1132,7 +1139,7 @@ static int test_ret(void)
     memory.memory[0x7FFF] = 0x20; // Return address high byte
     memory.memory[0x0000] = 0xC9;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t pc = z80_get_pc(z80);
     uint16_t sp = z80_get_register(z80, "SP");
@@ -1163,7 +1170,7 @@ static int test_di(void)
     z80->regs.iff2 = 1;
     memory.memory[0x0000] = 0xF3;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     TEST_ASSERT_EQ(0, z80->regs.iff1, "IFF1 should be disabled");
     TEST_ASSERT_EQ(0, z80->regs.iff2, "IFF2 should be disabled");
@@ -1191,7 +1198,7 @@ static int test_ei(void)
     z80->regs.iff2 = 0;
     memory.memory[0x0000] = 0xFB;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     TEST_ASSERT_EQ(1, z80->regs.iff1, "IFF1 should be enabled");
     TEST_ASSERT_EQ(1, z80->regs.iff2, "IFF2 should be enabled");
@@ -1218,7 +1225,7 @@ static int test_ld_a_b(void)
     z80_set_register(z80, "B", 0x55);
     memory.memory[0x0000] = 0x78;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t a = z80_get_register(z80, "A");
     TEST_ASSERT_EQ(0x55, a, "A should contain 0x55 from B");
@@ -1245,7 +1252,7 @@ static int test_ld_b_a(void)
     z80_set_register(z80, "A", 0x66);
     memory.memory[0x0000] = 0x47;
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t b = z80_get_register(z80, "B");
     TEST_ASSERT_EQ(0x66, b, "B should contain 0x66 from A");
@@ -1273,7 +1280,7 @@ static int test_ld_de_nn(void)
     memory.memory[0x0001] = 0x56; // E
     memory.memory[0x0002] = 0x34; // D
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t d = z80_get_register(z80, "D");
     uint16_t e = z80_get_register(z80, "E");
@@ -1303,7 +1310,7 @@ static int test_ld_hl_nn(void)
     memory.memory[0x0001] = 0x78; // L
     memory.memory[0x0002] = 0x56; // H
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint16_t h = z80_get_register(z80, "H");
     uint16_t l = z80_get_register(z80, "L");
@@ -1334,7 +1341,7 @@ static int test_cb_rlc_b(void)
     memory.memory[0x0000] = 0xCB;
     memory.memory[0x0001] = 0x00; // RLC B
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t b = z80_get_register(z80, "B");
     uint8_t flags = z80_get_register(z80, "F");
@@ -1365,7 +1372,7 @@ static int test_cb_bit_d(void)
     memory.memory[0x0000] = 0xCB;
     memory.memory[0x0001] = 0x5A; // BIT 3,D (01011010)
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t flags = z80_get_register(z80, "F");
     TEST_ASSERT(!(flags & Z80_FLAG_Z), "Zero flag should NOT be set (bit 3 is set)");
@@ -1394,7 +1401,7 @@ static int test_cb_res_e(void)
     memory.memory[0x0000] = 0xCB;
     memory.memory[0x0001] = 0x93; // RES 2,E (10010011)
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t e = z80_get_register(z80, "E");
     TEST_ASSERT_EQ(0x00, e, "E should be 0x00 after RES 2,E");
@@ -1423,7 +1430,7 @@ static int test_cb_set_l(void)
     memory.memory[0x0000] = 0xCB;
     memory.memory[0x0001] = 0xED; // SET 5,L
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t l = z80_get_register(z80, "L");
     TEST_ASSERT_EQ(0x20, l, "L should be 0x20 after SET 5,L");
@@ -1447,7 +1454,9 @@ static int test_ed_in_b_c(void)
     mock_memory_t memory = {0};
     mock_io_t io = {0};
     z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
-    z80_set_io_callbacks(z80, mock_read_io, mock_write_io, &io);
+    z80_set_io_callbacks(z80, &io);
+    z80->read_io = mock_read_io;
+    z80->write_io = mock_write_io;
 
     z80_set_register(z80, "C", 0x50); // Port address
     io.io_ports[0x50] = 0xAB;         // Data on port
@@ -1455,7 +1464,7 @@ static int test_ed_in_b_c(void)
     memory.memory[0x0000] = 0xED;
     memory.memory[0x0001] = 0x40; // IN B,(C)
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t b = z80_get_register(z80, "B");
     TEST_ASSERT_EQ(0xAB, b, "B should be 0xAB after IN B,(C)");
@@ -1472,7 +1481,7 @@ static int test_ed_in_b_c(void)
  */
 static int test_ed_out_c_a(void)
 {
-    printf("Test 46: ED OUT (C),A (0xED 0x4F)...\n");
+    printf("Test 46: ED OUT (C),A (0xED 0x79)...\n");
 
     z80_emulator_t *z80 = z80_init();
     TEST_ASSERT(z80 != NULL, "Z80 initialization failed");
@@ -1480,17 +1489,21 @@ static int test_ed_out_c_a(void)
     mock_memory_t memory = {0};
     mock_io_t io = {0};
     z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
-    z80_set_io_callbacks(z80, mock_read_io, mock_write_io, &io);
+    z80_set_io_callbacks(z80, &io);
+    z80->read_io = mock_read_io;
+    z80->write_io = mock_write_io;
 
     z80_set_register(z80, "A", 0x42);
+    z80_set_register(z80, "B", 0x12); // Port address high byte
     z80_set_register(z80, "C", 0x60); // Port address
 
     memory.memory[0x0000] = 0xED;
-    memory.memory[0x0001] = 0x4F; // OUT (C),A
+    memory.memory[0x0001] = 0x79; // OUT (C),A
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     TEST_ASSERT_EQ(0x42, io.io_ports[0x60], "Port 0x60 should contain 0x42");
+    TEST_ASSERT_EQ(0x1260, io.last_port, "OUT (C) should put BC on the address bus");
     TEST_ASSERT_EQ(1, io.io_write_count, "IO write should have occurred");
 
     z80_cleanup(z80);
@@ -1513,7 +1526,7 @@ static int test_ed_rrd(void)
     z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
 
     // A = 0xAB, (HL) = 0xCD
-    // After RRD: A = 0xAD, (HL) = 0xCB
+    // After RRD: A = 0xAD, (HL) = 0xBC
     z80_set_register(z80, "A", 0xAB);
     z80_set_register(z80, "H", 0x00);
     z80_set_register(z80, "L", 0x20);
@@ -1522,12 +1535,12 @@ static int test_ed_rrd(void)
     memory.memory[0x0000] = 0xED;
     memory.memory[0x0001] = 0x67; // RRD
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t a = z80_get_register(z80, "A");
     uint8_t mem_val = memory.memory[0x0020];
     TEST_ASSERT_EQ(0xAD, a, "A should be 0xAD after RRD");
-    TEST_ASSERT_EQ(0xCB, mem_val, "(HL) should be 0xCB after RRD");
+    TEST_ASSERT_EQ(0xBC, mem_val, "(HL) should be 0xBC after RRD");
 
     z80_cleanup(z80);
     test_count_passed++;
@@ -1558,7 +1571,7 @@ static int test_ed_rld(void)
     memory.memory[0x0000] = 0xED;
     memory.memory[0x0001] = 0x6F; // RLD
 
-    z80_execute_instruction(z80);
+    z80_step(z80);
 
     uint8_t a = z80_get_register(z80, "A");
     uint8_t mem_val = memory.memory[0x0020];
@@ -1571,6 +1584,172 @@ static int test_ed_rld(void)
     return 1;
 }
 
+/**
+ * Test 49: Block engine - code written through a second mapping of its bank
+ * (a 128K bank paged in at 0x4000 and 0xC000) must be redecoded
+ */
+static int test_block_bank_alias(void)
+{
+    printf("Test 49: Block engine with an aliased bank...\n");
+
+    z80_emulator_t *z80 = z80_init();
+    TEST_ASSERT(z80 != NULL, "Z80 initialization failed");
+
+    mock_memory_t memory = {0};
+    static uint8_t bank[0x4000];
+    memset(bank, 0, sizeof(bank));
+    z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
+    TEST_ASSERT(z80_map_pages(z80, 0x4000, sizeof(bank), bank, Z80_PAGE_RAM) == 0, "Mapping 0x4000 failed");
+    TEST_ASSERT(z80_map_pages(z80, 0xC000, sizeof(bank), bank, Z80_PAGE_RAM) == 0, "Mapping 0xC000 failed");
+    TEST_ASSERT(z80_set_block_engine(z80, true) == 0, "Block engine failed to start");
+
+    bank[0x0000] = 0x06; // 0x4000: LD B,0x11
+    bank[0x0001] = 0x11;
+    bank[0x0002] = 0xC9; // RET
+
+    const uint8_t program[] = {
+        0xCD, 0x00, 0x40, // CALL 0x4000
+        0x3E, 0x22,       // LD A,0x22
+        0x32, 0x01, 0xC0, // LD (0xC001),A - patches the LD B operand
+        0xCD, 0x00, 0x40, // CALL 0x4000
+        0x76,             // HALT
+    };
+    memcpy(memory.memory, program, sizeof(program));
+    z80_set_register(z80, "SP", 0x4000); // Stack below the bank
+
+    z80_run_until(z80, 1000, 100);
+
+    TEST_ASSERT_EQ(0x22, z80_get_register(z80, "B"), "B should come from the patched code");
+    TEST_ASSERT_EQ(0x000C, z80_get_pc(z80), "CPU should halt after the second call");
+
+    z80_cleanup(z80);
+    test_count_passed++;
+    printf("  PASS\n");
+    return 1;
+}
+
+// Port devices of the overlap test: each records the last value it saw
+static uint8_t port_even_value, port_7ffd_value;
+
+static void port_even_write(void *user_data, uint16_t port, uint8_t value)
+{
+    (void)user_data;
+    (void)port;
+    port_even_value = value;
+}
+
+static void port_7ffd_write(void *user_data, uint16_t port, uint8_t value)
+{
+    (void)user_data;
+    (void)port;
+    port_7ffd_value = value;
+}
+
+static uint8_t port_low_read(void *user_data, uint16_t port)
+{
+    (void)user_data;
+    (void)port;
+    return 0x11;
+}
+
+static uint8_t port_even_read(void *user_data, uint16_t port)
+{
+    (void)user_data;
+    (void)port;
+    return 0x22;
+}
+
+/**
+ * Test 50: Overlapping port decoding - every OUT device decoding a port
+ * sees the write, the last IN device mapped answers
+ */
+static int test_port_overlap(void)
+{
+    printf("Test 50: Overlapping port devices...\n");
+
+    z80_emulator_t *z80 = z80_init();
+    TEST_ASSERT(z80 != NULL, "Z80 initialization failed");
+
+    mock_memory_t memory = {0};
+    z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
+    TEST_ASSERT(z80_map_port_out(z80, 0x8002, 0x0000, port_7ffd_write) == 0, "Mapping 0x7FFD failed");
+    TEST_ASSERT(z80_map_port_out(z80, 0x0001, 0x0000, port_even_write) == 0, "Mapping even OUT failed");
+    TEST_ASSERT(z80_map_port_in(z80, 0x00E0, 0x0000, port_low_read) == 0, "Mapping low IN failed");
+    TEST_ASSERT(z80_map_port_in(z80, 0x0001, 0x0000, port_even_read) == 0, "Mapping even IN failed");
+
+    const uint8_t program[] = {
+        0x01, 0xFC, 0x7F, // LD BC,0x7FFC
+        0x3E, 0x07,       // LD A,0x07
+        0xED, 0x79,       // OUT (C),A - both devices decode 0x7FFC
+        0x01, 0xFE, 0x00, // LD BC,0x00FE
+        0x3E, 0x05,       // LD A,0x05
+        0xED, 0x79,       // OUT (C),A - even device only
+        0x01, 0x1E, 0x00, // LD BC,0x001E
+        0xED, 0x78,       // IN A,(C) - both devices decode 0x001E
+        0xED, 0x50,       // LD D,A
+        0x01, 0x1F, 0x00, // LD BC,0x001F
+        0xED, 0x78,       // IN A,(C) - low device only
+    };
+    memcpy(memory.memory, program, sizeof(program));
+    for (int i = 0; i < 11; i++)
+        z80_step(z80);
+
+    TEST_ASSERT_EQ(0x05, port_even_value, "Even device should see OUT 0x7FFC and 0x00FE");
+    TEST_ASSERT_EQ(0x07, port_7ffd_value, "0x7FFD device should see OUT 0x7FFC");
+    TEST_ASSERT_EQ(0x22, z80_get_register(z80, "D"), "Last mapped device should answer IN 0x001E");
+    TEST_ASSERT_EQ(0x11, z80_get_register(z80, "A"), "Low device should answer IN 0x001F");
+
+    z80_cleanup(z80);
+    test_count_passed++;
+    printf("  PASS\n");
+    return 1;
+}
+
+// AY data port device of the OUT (C) test (A15 high, A1 low)
+static uint16_t port_ay_port;
+static uint8_t port_ay_value;
+
+static void port_ay_write(void *user_data, uint16_t port, uint8_t value)
+{
+    (void)user_data;
+    port_ay_port = port;
+    port_ay_value = value;
+}
+
+/**
+ * Test 51: OUT (C),A puts B on the high address lines
+ */
+static int test_out_c_full_port(void)
+{
+    printf("Test 51: OUT (C),A with a 16-bit port...\n");
+
+    z80_emulator_t *z80 = z80_init();
+    TEST_ASSERT(z80 != NULL, "Z80 initialization failed");
+
+    mock_memory_t memory = {0};
+    z80_set_memory_callbacks(z80, mock_read_memory, mock_write_memory, &memory);
+    TEST_ASSERT(z80_map_port_out(z80, 0x8002, 0x8000, port_ay_write) == 0, "Mapping 0xBFFD failed");
+    TEST_ASSERT(z80_map_port_out(z80, 0x8002, 0x0000, port_7ffd_write) == 0, "Mapping 0x7FFD failed");
+    port_7ffd_value = 0;
+
+    z80_set_register(z80, "B", 0xBF);
+    z80_set_register(z80, "C", 0xFD);
+    z80_set_register(z80, "A", 0x0E);
+    memory.memory[0x0000] = 0xED;
+    memory.memory[0x0001] = 0x79; // OUT (C),A
+
+    z80_step(z80);
+
+    TEST_ASSERT_EQ(0xBFFD, port_ay_port, "Device should see port 0xBFFD");
+    TEST_ASSERT_EQ(0x0E, port_ay_value, "Device should see the value of A");
+    TEST_ASSERT_EQ(0x00, port_7ffd_value, "0x7FFD device should not see OUT 0xBFFD");
+
+    z80_cleanup(z80);
+    test_count_passed++;
+    printf("  PASS\n");
+    return 1;
+}
+
 /**
  * Main test runner
  */
@@ -1626,6 +1805,9 @@ int main(void)
     test_ed_out_c_a();
     test_ed_rrd();
     test_ed_rld();
+    test_block_bank_alias();
+    test_port_overlap();
+    test_out_c_full_port();
 
     printf("\n=== Test Results ===\n");
     printf("Passed: %d\n", test_count_passed);
@@ -0,0 +1,203 @@
+/**
+ * Binary Instruction Trace Implementation
+ *
+ * The emulation thread is the only producer and the writer thread the only
+ * consumer of the ring, so head and tail need no lock: each side owns one
+ * index and publishes it with release ordering.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "trace.h"
+
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+// Writer thread sleep when the ring is empty
+#define TRACE_IDLE_US 1000
+
+/**
+ * Trace writer state
+ */
+struct trace_writer_s
+{
+    FILE *file;
+    pthread_t thread;
+    atomic_bool stop;   // Drain what is left and exit
+    atomic_bool failed; // A write failed; records are dropped from then on
+
+    // Lock-free ring from the emulation thread to the writer thread
+    trace_record_t *records;
+    atomic_uint_fast32_t head; // Write index (emulation thread)
+    atomic_uint_fast32_t tail; // Read index (writer thread)
+
+    uint64_t count; // Records queued (emulation thread)
+};
+
+/**
+ * Write one batch of queued records
+ * Returns the number of records taken from the ring
+ */
+static uint32_t trace_drain(trace_writer_t *trace)
+{
+    uint32_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    if (head == tail)
+        return 0;
+
+    // Contiguous part up to the end of the ring
+    uint32_t batch = head > tail ? head - tail : TRACE_RING_SIZE - tail;
+    if (batch > TRACE_BATCH_RECORDS)
+        batch = TRACE_BATCH_RECORDS;
+
+    if (!atomic_load_explicit(&trace->failed, memory_order_relaxed) &&
+        fwrite(trace->records + tail, sizeof(trace_record_t), batch, trace->file) != batch)
+        atomic_store_explicit(&trace->failed, true, memory_order_relaxed);
+
+    atomic_store_explicit(&trace->tail, (tail + batch) & TRACE_RING_MASK, memory_order_release);
+    return batch;
+}
+
+/**
+ * Writer thread: drain the ring until stopped and empty
+ */
+static void *trace_writer_thread(void *arg)
+{
+    trace_writer_t *trace = (trace_writer_t *)arg;
+
+    for (;;)
+    {
+        bool stopping = atomic_load_explicit(&trace->stop, memory_order_acquire);
+        if (trace_drain(trace) > 0)
+            continue;
+        if (stopping)
+            break;
+        usleep(TRACE_IDLE_US);
+    }
+    return NULL;
+}
+
+/**
+ * Create a trace file and start its writer thread
+ */
+trace_writer_t *trace_open(const char *filename)
+{
+    if (!filename)
+        return NULL;
+
+    trace_writer_t *trace = (trace_writer_t *)calloc(1, sizeof(trace_writer_t));
+    if (!trace)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for trace writer\n");
+        return NULL;
+    }
+
+    trace->records = malloc(TRACE_RING_SIZE * sizeof(trace_record_t));
+    if (!trace->records)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for trace buffer\n");
+        free(trace);
+        return NULL;
+    }
+
+    trace->file = fopen(filename, "wb");
+    if (!trace->file)
+    {
+        fprintf(stderr, "Error: Cannot create trace file '%s'\n", filename);
+        free(trace->records);
+        free(trace);
+        return NULL;
+    }
+
+    trace_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    if (fwrite(&header, sizeof(header), 1, trace->file) != 1)
+        atomic_store(&trace->failed, true);
+
+    atomic_init(&trace->stop, false);
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->tail, 0);
+    if (pthread_create(&trace->thread, NULL, trace_writer_thread, trace) != 0)
+    {
+        fprintf(stderr, "Error: Failed to create trace writer thread\n");
+        fclose(trace->file);
+        free(trace->records);
+        free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+/**
+ * Queue a record (emulation thread only)
+ */
+void trace_write(trace_writer_t *trace, const trace_record_t *record)
+{
+    uint32_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    uint32_t next_head = (head + 1) & TRACE_RING_MASK;
+
+    // Full: let the writer catch up rather than drop the record
+    while (next_head == atomic_load_explicit(&trace->tail, memory_order_acquire))
+        sched_yield();
+
+    trace->records[head] = *record;
+    atomic_store_explicit(&trace->head, next_head, memory_order_release);
+    trace->count++;
+}
+
+/**
+ * Flush everything queued, stop the writer thread and close the file
+ */
+int trace_close(trace_writer_t *trace)
+{
+    if (!trace)
+        return 0;
+
+    atomic_store_explicit(&trace->stop, true, memory_order_release);
+    pthread_join(trace->thread, NULL);
+
+    int result = atomic_load(&trace->failed) ? -1 : 0;
+    if (fclose(trace->file) != 0)
+        result = -1;
+    if (result != 0)
+        fprintf(stderr, "Error: Failed to write trace file\n");
+
+    free(trace->records);
+    free(trace);
+    return result;
+}
+
+/**
+ * Get the number of records queued so far
+ */
+uint64_t trace_record_count(const trace_writer_t *trace)
+{
+    return trace ? trace->count : 0;
+}
+
+/**
+ * Validate a trace image and find its records
+ */
+const trace_record_t *trace_records(const uint8_t *image, size_t size, uint64_t *count)
+{
+    trace_file_header_t header;
+
+    if (!image || size < sizeof(header))
+        return NULL;
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.record_size != sizeof(trace_record_t))
+        return NULL;
+
+    if (count)
+        *count = (size - sizeof(header)) / sizeof(trace_record_t);
+    return (const trace_record_t *)(image + sizeof(header));
+}
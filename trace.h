@@ -0,0 +1,102 @@
+/**
+ * Binary Instruction Trace for Spettrum (--disassemble)
+ *
+ * Each executed instruction becomes one fixed-size record: PC, the opcode
+ * bytes, the registers after the instruction and the cycle it started at.
+ * The emulation thread only copies the record into a lock-free
+ * single-producer/single-consumer ring (the same scheme as the beeper's event
+ * ring); a background writer thread drains the ring to disk in large
+ * batches. Nothing is formatted while emulating: the spettrum-trace tool
+ * turns a trace back into disassembly text offline.
+ *
+ * File layout: trace_file_header_t, then records until the end of the file.
+ * Everything is in host byte order.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Trace file format
+#define TRACE_MAGIC "SPTR"
+#define TRACE_VERSION 1
+
+// Records buffered between the emulation and writer threads (power of 2)
+#define TRACE_RING_SIZE 65536
+
+// Records written to disk per batch at most
+#define TRACE_BATCH_RECORDS 8192
+
+/**
+ * Trace file header
+ */
+typedef struct
+{
+    char magic[4];        // TRACE_MAGIC
+    uint16_t version;     // TRACE_VERSION
+    uint16_t record_size; // sizeof(trace_record_t)
+} trace_file_header_t;
+
+/**
+ * One executed instruction (32 bytes)
+ * Registers are the values after the instruction executed.
+ */
+typedef struct
+{
+    uint64_t cycle;      // CPU cycle at which the instruction started
+    uint16_t pc;         // Address of the instruction
+    uint16_t sp, ix, iy; // Special purpose registers
+    uint8_t a, f, b, c;  // Main registers
+    uint8_t d, e, h, l;
+    uint8_t i, r;        // Interrupt vector, memory refresh
+    uint8_t im_iff;      // Bits 0-1: interrupt mode, bit 2: IFF1, bit 3: IFF2
+    uint8_t reserved;
+    uint8_t bytes[4];    // Memory at pc..pc+3 (opcode and operands)
+} trace_record_t;
+
+/**
+ * Trace writer context
+ */
+typedef struct trace_writer_s trace_writer_t;
+
+/**
+ * Create a trace file and start its writer thread
+ * @param filename File to create
+ * @return Writer, or NULL on error
+ */
+trace_writer_t *trace_open(const char *filename);
+
+/**
+ * Queue a record (emulation thread only)
+ * Waits for the writer thread if the ring is full, so no record is lost.
+ * @param trace Writer
+ * @param record Record to queue
+ */
+void trace_write(trace_writer_t *trace, const trace_record_t *record);
+
+/**
+ * Flush everything queued, stop the writer thread and close the file
+ * @param trace Writer (NULL is ignored)
+ * @return 0 on success, -1 if writing failed
+ */
+int trace_close(trace_writer_t *trace);
+
+/**
+ * Get the number of records queued so far
+ * @param trace Writer
+ * @return Record count
+ */
+uint64_t trace_record_count(const trace_writer_t *trace);
+
+/**
+ * Validate a trace image and find its records
+ * @param image Trace file contents
+ * @param size Size of the image
+ * @param count Receives the number of complete records
+ * @return First record, or NULL if the image is not a trace of this version
+ */
+const trace_record_t *trace_records(const uint8_t *image, size_t size, uint64_t *count);
+
+#endif
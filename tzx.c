@@ -0,0 +1,378 @@
+/**
+ * TZX File Reader Implementation
+ *
+ * Walks the blocks of a TZX image in playback order and describes each
+ * playable one as a tape_block_t for the tape player in tap.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tzx.h"
+
+static const uint8_t tzx_signature[8] = {'Z', 'X', 'T', 'a', 'p', 'e', '!', 0x1A};
+
+/**
+ * TZX reader state
+ */
+struct tzx_reader_s
+{
+    const uint8_t *image;  // TZX image
+    size_t size;           // Image size
+    uint32_t *offsets;     // Offset of each block's ID byte
+    uint32_t block_count;  // Number of blocks
+
+    // Playback position, including loop (0x24/0x25) and call (0x26/0x27) state;
+    // neither nests
+    tzx_position_t pos;
+};
+
+static uint16_t read16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t read24(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Get the size of a block body (everything after the ID byte)
+ * Returns 0 if successful, -1 if the body does not fit in the avail bytes
+ */
+static int tzx_body_size(uint8_t id, const uint8_t *p, size_t avail, size_t *body)
+{
+    size_t fixed; // Bytes needed before the length field can be read
+    size_t size;
+
+    switch (id)
+    {
+    case 0x10: fixed = 0x04; break;
+    case 0x11: fixed = 0x12; break;
+    case 0x12: fixed = 0x04; break;
+    case 0x13: fixed = 0x01; break;
+    case 0x14: fixed = 0x0A; break;
+    case 0x15: fixed = 0x08; break;
+    case 0x20: case 0x23: case 0x24: fixed = 0x02; break;
+    case 0x21: case 0x30: fixed = 0x01; break;
+    case 0x22: case 0x25: case 0x27: fixed = 0x00; break;
+    case 0x26: case 0x28: case 0x32: fixed = 0x02; break;
+    case 0x31: fixed = 0x02; break;
+    case 0x33: fixed = 0x01; break;
+    case 0x34: fixed = 0x08; break;
+    case 0x35: fixed = 0x14; break;
+    case 0x40: fixed = 0x04; break;
+    case 0x5A: fixed = 0x09; break;
+    default: fixed = 0x04; break; // 0x18, 0x19, 0x2A, 0x2B and unknown IDs: 32-bit length first
+    }
+    if (fixed > avail)
+        return -1;
+
+    switch (id)
+    {
+    case 0x10: size = fixed + read16(p + 0x02); break;
+    case 0x11: size = fixed + read24(p + 0x0F); break;
+    case 0x13: size = fixed + 2 * (size_t)p[0]; break;
+    case 0x14: size = fixed + read24(p + 0x07); break;
+    case 0x15: size = fixed + read24(p + 0x05); break;
+    case 0x21: case 0x30: size = fixed + p[0]; break;
+    case 0x26: size = fixed + 2 * (size_t)read16(p); break;
+    case 0x28: case 0x32: size = fixed + read16(p); break;
+    case 0x31: size = fixed + p[1]; break;
+    case 0x33: size = fixed + 3 * (size_t)p[0]; break;
+    case 0x35: size = fixed + read32(p + 0x10); break;
+    case 0x40: size = fixed + read24(p + 0x01); break;
+    case 0x12: case 0x20: case 0x22: case 0x23: case 0x24:
+    case 0x25: case 0x27: case 0x34: case 0x5A: size = fixed; break;
+    default: size = fixed + read32(p); break;
+    }
+    if (size > avail)
+        return -1;
+    *body = size;
+    return 0;
+}
+
+/**
+ * Check whether an image starts with the TZX signature
+ */
+int tzx_is_tzx(const uint8_t *image, size_t size)
+{
+    return image && size >= TZX_HEADER_SIZE && memcmp(image, tzx_signature, sizeof(tzx_signature)) == 0;
+}
+
+/**
+ * Open a reader over a TZX image
+ */
+tzx_reader_t *tzx_open(const uint8_t *image, size_t size)
+{
+    if (!tzx_is_tzx(image, size))
+    {
+        fprintf(stderr, "Error: Not a TZX file\n");
+        return NULL;
+    }
+
+    tzx_reader_t *tzx = (tzx_reader_t *)calloc(1, sizeof(tzx_reader_t));
+    if (!tzx)
+    {
+        fprintf(stderr, "Error: Memory allocation failed for TZX reader\n");
+        return NULL;
+    }
+    tzx->image = image;
+    tzx->size = size;
+    tzx->pos.call_block = UINT32_MAX;
+
+    // Index the blocks; only the headers are touched
+    uint32_t capacity = 0;
+    size_t pos = TZX_HEADER_SIZE;
+    while (pos < size)
+    {
+        size_t body;
+        if (tzx_body_size(image[pos], image + pos + 1, size - pos - 1, &body) != 0)
+        {
+            fprintf(stderr, "Warning: TZX block %u (ID 0x%02X) is truncated, ignoring the rest of the file\n",
+                    tzx->block_count, image[pos]);
+            break;
+        }
+
+        if (tzx->block_count == capacity)
+        {
+            uint32_t new_capacity = capacity ? capacity * 2 : 64;
+            uint32_t *offsets = realloc(tzx->offsets, new_capacity * sizeof(uint32_t));
+            if (!offsets)
+            {
+                fprintf(stderr, "Error: Memory allocation failed for TZX block index\n");
+                tzx_close(tzx);
+                return NULL;
+            }
+            tzx->offsets = offsets;
+            capacity = new_capacity;
+        }
+        tzx->offsets[tzx->block_count++] = (uint32_t)pos;
+        pos += 1 + body;
+    }
+
+    if (tzx->block_count == 0)
+    {
+        fprintf(stderr, "Error: TZX file has no blocks\n");
+        tzx_close(tzx);
+        return NULL;
+    }
+    return tzx;
+}
+
+/**
+ * Close reader and free resources
+ */
+void tzx_close(tzx_reader_t *tzx)
+{
+    if (!tzx)
+        return;
+    free(tzx->offsets);
+    free(tzx);
+}
+
+/**
+ * Get the number of blocks in the file
+ */
+uint32_t tzx_block_count(const tzx_reader_t *tzx)
+{
+    return tzx ? tzx->block_count : 0;
+}
+
+/**
+ * Move to the block at a signed offset from index (offset 0 is invalid; treated as 1)
+ */
+static void tzx_jump(tzx_reader_t *tzx, uint32_t index, int16_t offset)
+{
+    int64_t target = (int64_t)index + (offset ? offset : 1);
+    tzx->pos.next = target < 0 ? 0 : (uint32_t)target;
+}
+
+/**
+ * Read the next playable block in playback order
+ */
+int tzx_next_block(tzx_reader_t *tzx, tape_block_t *block)
+{
+    if (!tzx || !block)
+        return -1;
+
+    // Bad jumps could cycle through control blocks forever
+    uint32_t control_budget = 4 * tzx->block_count + 16;
+
+    while (tzx->pos.next < tzx->block_count)
+    {
+        uint32_t index = tzx->pos.next++;
+        const uint8_t *p = tzx->image + tzx->offsets[index] + 1;
+        uint8_t id = p[-1];
+
+        memset(block, 0, sizeof(*block));
+        switch (id)
+        {
+        case 0x10: // Standard speed data
+            tape_block_standard(block, p + 0x04, read16(p + 0x02), read16(p));
+            if (block->length > 0)
+                return 0;
+            break;
+
+        case 0x11: // Turbo speed data
+            block->type = TAPE_BLOCK_DATA;
+            block->pilot_length = read16(p);
+            block->sync1_length = read16(p + 0x02);
+            block->sync2_length = read16(p + 0x04);
+            block->zero_length = read16(p + 0x06);
+            block->one_length = read16(p + 0x08);
+            block->pilot_pulses = read16(p + 0x0A);
+            block->used_bits = p[0x0C];
+            block->pause_ms = read16(p + 0x0D);
+            block->length = read24(p + 0x0F);
+            block->data = p + 0x12;
+            if (block->used_bits == 0 || block->used_bits > 8)
+                block->used_bits = 8;
+            if (block->length > 0 || block->pilot_pulses > 0)
+                return 0;
+            break;
+
+        case 0x12: // Pure tone
+            block->type = TAPE_BLOCK_TONE;
+            block->pilot_length = read16(p);
+            block->pilot_pulses = read16(p + 0x02);
+            return 0;
+
+        case 0x13: // Pulse sequence
+            block->type = TAPE_BLOCK_PULSES;
+            block->length = p[0];
+            block->data = p + 0x01;
+            return 0;
+
+        case 0x14: // Pure data
+            block->type = TAPE_BLOCK_DATA;
+            block->zero_length = read16(p);
+            block->one_length = read16(p + 0x02);
+            block->used_bits = p[0x04];
+            block->pause_ms = read16(p + 0x05);
+            block->length = read24(p + 0x07);
+            block->data = p + 0x0A;
+            if (block->used_bits == 0 || block->used_bits > 8)
+                block->used_bits = 8;
+            if (block->length > 0)
+                return 0;
+            break;
+
+        case 0x15: // Direct recording
+            block->type = TAPE_BLOCK_DIRECT;
+            block->pilot_length = read16(p);
+            block->pause_ms = read16(p + 0x02);
+            block->used_bits = p[0x04];
+            block->length = read24(p + 0x05);
+            block->data = p + 0x08;
+            if (block->used_bits == 0 || block->used_bits > 8)
+                block->used_bits = 8;
+            if (block->length > 0)
+                return 0;
+            break;
+
+        case 0x20: // Pause; 0 means "stop the tape", which plays on here as there is no tape UI
+            block->type = TAPE_BLOCK_PAUSE;
+            block->pause_ms = read16(p);
+            return 0;
+
+        case 0x2B: // Set signal level
+            block->type = TAPE_BLOCK_LEVEL;
+            block->level = read32(p) >= 1 && p[0x04] ? 1 : 0;
+            return 0;
+
+        case 0x23: // Jump to block
+            tzx_jump(tzx, index, (int16_t)read16(p));
+            break;
+
+        case 0x24: // Loop start
+            tzx->pos.loop_start = tzx->pos.next;
+            tzx->pos.loop_left = read16(p);
+            break;
+
+        case 0x25: // Loop end
+            if (tzx->pos.loop_left > 1)
+            {
+                tzx->pos.loop_left--;
+                tzx->pos.next = tzx->pos.loop_start;
+            }
+            else
+            {
+                tzx->pos.loop_left = 0;
+            }
+            break;
+
+        case 0x26: // Call sequence
+            if (read16(p) > 0)
+            {
+                tzx->pos.call_block = index;
+                tzx->pos.call_pos = 0;
+                tzx_jump(tzx, index, (int16_t)read16(p + 0x02));
+            }
+            break;
+
+        case 0x27: // Return from sequence
+            if (tzx->pos.call_block != UINT32_MAX)
+            {
+                const uint8_t *call = tzx->image + tzx->offsets[tzx->pos.call_block] + 1;
+                if (++tzx->pos.call_pos < read16(call))
+                {
+                    tzx_jump(tzx, tzx->pos.call_block, (int16_t)read16(call + 0x02 + 2 * tzx->pos.call_pos));
+                }
+                else
+                {
+                    tzx->pos.next = tzx->pos.call_block + 1;
+                    tzx->pos.call_block = UINT32_MAX;
+                }
+            }
+            break;
+
+        case 0x18: // CSW recording
+        case 0x19: // Generalized data
+            fprintf(stderr, "Warning: TZX block %u (ID 0x%02X) is not supported, skipping\n", index, id);
+            break;
+
+        default: // Information, groups, "stop if 48K" (played on) and unknown blocks
+            break;
+        }
+
+        if (id >= 0x23 && id <= 0x27 && control_budget-- == 0)
+        {
+            fprintf(stderr, "Error: TZX jumps do not lead anywhere, stopping the tape\n");
+            tzx->pos.next = tzx->block_count;
+            break;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Get the playback position
+ */
+void tzx_get_position(const tzx_reader_t *tzx, tzx_position_t *pos)
+{
+    if (tzx && pos)
+        *pos = tzx->pos;
+}
+
+/**
+ * Restore a playback position
+ */
+int tzx_set_position(tzx_reader_t *tzx, const tzx_position_t *pos)
+{
+    if (!tzx || !pos)
+        return -1;
+    if (pos->next > tzx->block_count || pos->loop_start > tzx->block_count ||
+        (pos->call_block != UINT32_MAX &&
+         (pos->call_block >= tzx->block_count || tzx->image[tzx->offsets[pos->call_block]] != 0x26)))
+        return -1;
+
+    tzx->pos = *pos;
+    return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * TZX File Format Support for Spettrum Z80 Emulator
+ *
+ * A TZX file is the signature "ZXTape!" 0x1A, a two-byte version, then a
+ * sequence of blocks, each introduced by an ID byte. Besides standard-speed
+ * data (as in TAP) it describes custom pulse timings directly:
+ * - 0x10 Standard speed data (ROM timings, pause after)
+ * - 0x11 Turbo speed data (all pilot, sync and bit timings given)
+ * - 0x12 Pure tone (N pulses of one length)
+ * - 0x13 Pulse sequence (up to 255 pulses of individual lengths)
+ * - 0x14 Pure data (bits only, no pilot or sync)
+ * - 0x15 Direct recording (one bit per sample at a fixed sample period)
+ * - 0x20 Pause, 0x2B Set signal level
+ * - 0x23 Jump, 0x24/0x25 Loop, 0x26/0x27 Call sequence
+ * Information blocks (text, archive info, groups, ...) are skipped.
+ *
+ * The reader works on a read-only image of the file (memory-mapped by the
+ * tape player) and hands out one playable block at a time; block data is
+ * referenced in place, never copied.
+ */
+
+#ifndef TZX_H
+#define TZX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tap.h"
+
+// Length of the TZX header (signature and version)
+#define TZX_HEADER_SIZE 10
+
+/**
+ * TZX block reader context
+ */
+typedef struct tzx_reader_s tzx_reader_t;
+
+/**
+ * Playback position of a reader (for save states)
+ */
+typedef struct
+{
+    uint32_t next;       // Index of the next block to read
+    uint32_t loop_start; // Block after the loop start
+    uint32_t call_block; // Index of the call sequence block (UINT32_MAX = none)
+    uint16_t loop_left;  // Loop repetitions left (0 = not in a loop)
+    uint16_t call_pos;   // Entry of the call sequence being played
+} tzx_position_t;
+
+/**
+ * Check whether an image starts with the TZX signature
+ * Returns 1 if it does, 0 otherwise
+ */
+int tzx_is_tzx(const uint8_t *image, size_t size);
+
+/**
+ * Open a reader over a TZX image
+ * Indexes the block offsets (needed for jumps, loops and calls); the image
+ * must stay mapped until tzx_close().
+ * Returns NULL on error
+ */
+tzx_reader_t *tzx_open(const uint8_t *image, size_t size);
+
+/**
+ * Close reader and free resources
+ */
+void tzx_close(tzx_reader_t *tzx);
+
+/**
+ * Get the number of blocks in the file (all IDs, including info blocks)
+ */
+uint32_t tzx_block_count(const tzx_reader_t *tzx);
+
+/**
+ * Read the next playable block in playback order
+ * Control blocks (jumps, loops, calls) are followed and information blocks
+ * skipped. The block's data points into the image.
+ * Returns 0 if successful, -1 at the end of the tape
+ */
+int tzx_next_block(tzx_reader_t *tzx, tape_block_t *block);
+
+/**
+ * Get the playback position
+ */
+void tzx_get_position(const tzx_reader_t *tzx, tzx_position_t *pos);
+
+/**
+ * Restore a playback position taken with tzx_get_position() on the same file
+ * Returns 0 if successful, -1 if the position does not fit this file
+ */
+int tzx_set_position(tzx_reader_t *tzx, const tzx_position_t *pos);
+
+#endif
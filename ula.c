@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <stdatomic.h>
 #include "ula.h"
 
 // ZX Spectrum video RAM dimensions
@@ -185,8 +186,8 @@ static const uint8_t sinclair_font[96][8] = {
     {0x3C, 0x42, 0x99, 0xA1, 0xA1, 0x99, 0x42, 0x3C}  /* ASCII 127 (© - Copyright symbol) */
 };
 
-// Thread-safe output matrix
-typedef struct
+// Output matrix of one display, with the cells awaiting conversion
+struct ula_matrix_s
 {
     const char *matrix[OUTPUT_HEIGHT][OUTPUT_WIDTH];
     color_attr_t matrix_colors[OUTPUT_HEIGHT][OUTPUT_WIDTH];
@@ -195,16 +196,20 @@ typedef struct
     char ocr_matrix[OCR_OUTPUT_HEIGHT][OCR_OUTPUT_WIDTH + 1]; // OCR text + null terminator per row
     color_attr_t ocr_colors[OCR_OUTPUT_HEIGHT][OCR_OUTPUT_WIDTH];
     ula_render_mode_t render_mode;
-    uint8_t border_color;
+    uint8_t border_color;   // Border of the converted frame
     uint32_t frame_counter; // Frame counter for blink timing (0-31, cycles every 32 frames)
     pthread_mutex_t lock;
-} ula_matrix_t;
 
-static ula_matrix_t ula_matrix = {
-    .render_mode = ULA_RENDER_BRAILLE2X4,
-    .border_color = 0,
-    .frame_counter = 0,
-    .lock = PTHREAD_MUTEX_INITIALIZER};
+    atomic_int dirty_all;         // Whole screen needs converting
+    ula_render_mode_t dirty_mode; // Mode of the last frame conversion
+
+    // Screen of the last frame converted by convert_frame_to_matrix()
+    uint8_t shown[SPECTRUM_RAM_SIZE];
+
+    // Per-cell OCR cache: recognition is skipped while a cell's bitmap is unchanged
+    uint64_t ocr_cell_bitmap[OCR_OUTPUT_HEIGHT][OCR_OUTPUT_WIDTH];
+    uint8_t ocr_cell_valid[OCR_OUTPUT_HEIGHT][OCR_OUTPUT_WIDTH];
+};
 
 /**
  * Get attribute byte from video RAM
@@ -236,62 +241,133 @@ static color_attr_t get_attribute(const uint8_t *vram, int x, int y)
     return attr;
 }
 
-/**
- * Get pixel value from video RAM at (x, y)
- * ZX Spectrum memory layout is NOT continuous - it's split into thirds
- * Formula: address = ((y / 8) * 2048) + ((y % 8) * 256) + (x / 8)
- * Each byte stores 8 horizontal pixels: MSB is leftmost pixel
- */
-static int get_pixel(const uint8_t *vram, int x, int y)
+// Conversion lookup tables, built once by init_conversion_tables()
+static pthread_once_t conversion_tables_once = PTHREAD_ONCE_INIT;
+
+// VRAM offset of each of the 192 scanlines
+// ZX Spectrum memory layout is NOT continuous - it's split into thirds:
+// offset = (section * 2048) + (pixel_row * 256) + (char_row * 32)
+static uint16_t scanline_offset[SPECTRUM_HEIGHT];
+
+// Block patterns for the 4 output cells covered by one pixel byte, 4 bits
+// per cell (cell k at bits 4k..4k+3). OR the top and bottom entries of a
+// 2-line pair to get the TL TR BL BR pattern of all four cells at once.
+static uint16_t block_top_bits[256];
+static uint16_t block_bottom_bits[256];
+
+// Braille dots for the 4 output cells covered by one pixel byte on each of
+// the 4 lines of a braille row, 8 bits per cell (cell k at bits 8k..8k+7).
+// OR the four line entries to get all four braille patterns at once.
+static uint32_t braille_line_bits[4][256];
+
+// OCR glyph index: the font packed one glyph per 64-bit word (top row in
+// the high byte) and an open-addressing hash of it for exact matches
+#define GLYPH_HASH_SIZE 256 // Power of two, > 2x the 96 glyphs
+static uint64_t font_packed[96];
+static int8_t glyph_hash_index[GLYPH_HASH_SIZE]; // Font index, -1 = empty slot
+
+static uint32_t glyph_hash(uint64_t bitmap)
 {
-    // Spectrum video RAM layout:
-    // The 192 lines are divided into 3 sections of 64 lines each
-    // Within each section, lines are stored in a special pattern
-    int section = y / 64;                // Which third (0, 1, or 2)
-    int line_in_section = y % 64;        // Line within that third
-    int char_row = line_in_section / 8;  // Character row (0-7)
-    int pixel_row = line_in_section % 8; // Pixel within character (0-7)
-    int char_col = x / 8;                // Character column (0-31)
-
-    // Calculate address - ZX Spectrum's interleaved scanline layout
-    // Address = (section * 2048) + (pixel_row * 256) + (char_row * 32) + char_col
-    int address = (section * 2048) + (pixel_row * 256) + (char_row * 32) + char_col;
+    return (uint32_t)((bitmap * 0x9E3779B97F4A7C15ULL) >> 56) & (GLYPH_HASH_SIZE - 1);
+}
 
-    // Ensure we don't read beyond VRAM
-    if (address >= SPECTRUM_VRAM_SIZE)
-        return 0;
+static void init_conversion_tables(void)
+{
+    for (int y = 0; y < SPECTRUM_HEIGHT; y++)
+    {
+        int section = y / 64;                // Which third (0, 1, or 2)
+        int char_row = (y % 64) / 8;         // Character row (0-7)
+        int pixel_row = y % 8;               // Pixel within character (0-7)
+        scanline_offset[y] = (section * 2048) + (pixel_row * 256) + (char_row * 32);
+    }
 
-    uint8_t byte = vram[address];
-    int bit_index = 7 - (x % 8); // MSB is leftmost pixel
-    return (byte >> bit_index) & 1;
+    // Braille dots: 0,1,2,6 (left column) and 3,4,5,7 (right column)
+    static const uint8_t left_dot[4] = {0x01, 0x02, 0x04, 0x40};
+    static const uint8_t right_dot[4] = {0x08, 0x10, 0x20, 0x80};
+
+    for (int byte = 0; byte < 256; byte++)
+    {
+        block_top_bits[byte] = 0;
+        block_bottom_bits[byte] = 0;
+        for (int line = 0; line < 4; line++)
+            braille_line_bits[line][byte] = 0;
+
+        // Cell k covers pixels 2k (left, MSB side) and 2k+1 (right)
+        for (int k = 0; k < 4; k++)
+        {
+            int pair = (byte >> (6 - 2 * k)) & 3; // bit 1 = left pixel, bit 0 = right pixel
+
+            block_top_bits[byte] |= (uint16_t)((pair << 2) << (4 * k));
+            block_bottom_bits[byte] |= (uint16_t)(pair << (4 * k));
+
+            for (int line = 0; line < 4; line++)
+            {
+                uint32_t dots = ((pair & 2) ? left_dot[line] : 0) | ((pair & 1) ? right_dot[line] : 0);
+                braille_line_bits[line][byte] |= dots << (8 * k);
+            }
+        }
+    }
+
+    // Pack the font and index it; duplicate glyphs keep the lowest code
+    memset(glyph_hash_index, -1, sizeof(glyph_hash_index));
+    for (int i = 0; i < 96; i++)
+    {
+        uint64_t packed = 0;
+        for (int row = 0; row < 8; row++)
+            packed = (packed << 8) | sinclair_font[i][row];
+        font_packed[i] = packed;
+
+        uint32_t slot = glyph_hash(packed);
+        while (glyph_hash_index[slot] >= 0 && font_packed[glyph_hash_index[slot]] != packed)
+            slot = (slot + 1) & (GLYPH_HASH_SIZE - 1);
+        if (glyph_hash_index[slot] < 0)
+            glyph_hash_index[slot] = (int8_t)i;
+    }
 }
 
 /**
- * Convert 2x2 pixel block to block character with color information
- * Pattern: TL TR BL BR (top-left, top-right, bottom-left, bottom-right)
+ * Encode braille pattern (U+2800 + pattern) as UTF-8 (3 bytes + NUL)
  */
-static const char *get_block_char(const uint8_t *vram, int x, int y, color_attr_t *out_color)
+static void encode_braille(int pattern, char *out)
 {
-    int pixel_x = x * 2;
-    int pixel_y = y * 2;
-
-    // Get the 4 pixels in 2x2 block
-    int tl = get_pixel(vram, pixel_x, pixel_y);
-    int tr = get_pixel(vram, pixel_x + 1, pixel_y);
-    int bl = get_pixel(vram, pixel_x, pixel_y + 1);
-    int br = get_pixel(vram, pixel_x + 1, pixel_y + 1);
+    // U+2800 = 0xE2 0xA0 0x80
+    // U+28FF = 0xE2 0xA3 0xBF
+    // The pattern bits are distributed across bytes 1 and 2:
+    //   Byte 1: 0xA0 + (bits 7-6 of pattern)
+    //   Byte 2: 0x80 + (bits 5-0 of pattern)
+    out[0] = 0xE2;
+    out[1] = 0xA0 + (pattern >> 6);
+    out[2] = 0x80 + (pattern & 0x3F);
+    out[3] = '\0';
+}
 
-    // Combine into pattern index (0-15)
-    int pattern = (tl << 3) | (tr << 2) | (bl << 1) | br;
+/**
+ * Convert the 4x4 block characters covering one 8x8 character cell
+ * Each pair of scanlines is read as two whole bytes; the tables yield the
+ * TL TR BL BR pattern of all four block characters on that line pair.
+ */
+static void convert_block_cell(ula_matrix_t *screen, const uint8_t *vram, int char_col, int char_row)
+{
+    color_attr_t attr = get_attribute(vram, char_col * 8, char_row * 8);
 
-    // Get attribute for this block (based on top-left pixel position)
-    *out_color = get_attribute(vram, pixel_x, pixel_y);
+    for (int pair = 0; pair < 4; pair++)
+    {
+        int y = char_row * 8 + pair * 2;
+        uint16_t patterns = block_top_bits[vram[scanline_offset[y] + char_col]] |
+                            block_bottom_bits[vram[scanline_offset[y + 1] + char_col]];
 
-    return block_chars[pattern];
+        int out_y = char_row * 4 + pair;
+        for (int k = 0; k < 4; k++)
+        {
+            int out_x = char_col * 4 + k;
+            screen->matrix[out_y][out_x] = block_chars[(patterns >> (4 * k)) & 0x0F];
+            screen->matrix_colors[out_y][out_x] = attr;
+        }
+    }
 }
 
 /**
- * Get braille character for 2x4 pixel block with color information
+ * Convert the 4x2 braille characters covering one 8x8 character cell
  * Braille Unicode: U+2800 + pattern
  *
  * Pixel layout (2 cols x 4 rows):    Braille dot positions:
@@ -313,125 +389,73 @@ static const char *get_block_char(const uint8_t *vram, int x, int y, color_attr_
  *   ⠸⠇  <- bottom 4 pixels (rows 4-7)
  * This is inherent to braille character design (meant for tactile reading, not graphics).
  */
-static void get_braille_char(const uint8_t *vram, int x, int y, char *out, color_attr_t *out_color)
+static void convert_braille_cell(ula_matrix_t *screen, const uint8_t *vram, int char_col, int char_row)
 {
-    int pixel_x = x * 2;
-    int pixel_y = y * 4;
-
-    // Read 2x4 pixel block
-    // Left column (col 0): rows 0,1,2,3
-    int left_col_row0 = get_pixel(vram, pixel_x, pixel_y);
-    int left_col_row1 = get_pixel(vram, pixel_x, pixel_y + 1);
-    int left_col_row2 = get_pixel(vram, pixel_x, pixel_y + 2);
-    int left_col_row3 = get_pixel(vram, pixel_x, pixel_y + 3);
-
-    // Right column (col 1): rows 0,1,2,3
-    int right_col_row0 = get_pixel(vram, pixel_x + 1, pixel_y);
-    int right_col_row1 = get_pixel(vram, pixel_x + 1, pixel_y + 1);
-    int right_col_row2 = get_pixel(vram, pixel_x + 1, pixel_y + 2);
-    int right_col_row3 = get_pixel(vram, pixel_x + 1, pixel_y + 3);
-
-    // Build braille pattern (each pixel maps to one bit)
-    // Braille dots: 0,1,2,6 (left column) and 3,4,5,7 (right column)
-    int pattern = 0;
-    if (left_col_row0)
-        pattern |= 0x01; // dot 0 (bit 0)
-    if (left_col_row1)
-        pattern |= 0x02; // dot 1 (bit 1)
-    if (left_col_row2)
-        pattern |= 0x04; // dot 2 (bit 2)
-    if (right_col_row0)
-        pattern |= 0x08; // dot 3 (bit 3)
-    if (right_col_row1)
-        pattern |= 0x10; // dot 4 (bit 4)
-    if (right_col_row2)
-        pattern |= 0x20; // dot 5 (bit 5)
-    if (left_col_row3)
-        pattern |= 0x40; // dot 6 (bit 6)
-    if (right_col_row3)
-        pattern |= 0x80; // dot 7 (bit 7)
-
-    // Encode braille codepoint (U+2800 + pattern) as UTF-8 (3 bytes)
-    // U+2800 = 0xE2 0xA0 0x80
-    // U+28FF = 0xE2 0xA3 0xBF
-    // The pattern bits are distributed across bytes 1 and 2:
-    //   Byte 1: 0xA0 + (bits 7-6 of pattern)
-    //   Byte 2: 0x80 + (bits 5-0 of pattern)
-    out[0] = 0xE2;
-    out[1] = 0xA0 + (pattern >> 6);
-    out[2] = 0x80 + (pattern & 0x3F);
-    out[3] = '\0';
-
-    // Get attribute for this block (based on top-left pixel position)
-    *out_color = get_attribute(vram, pixel_x, pixel_y);
-}
+    color_attr_t attr = get_attribute(vram, char_col * 8, char_row * 8);
 
-/**
- * Compare two 8x8 bitmaps for similarity using Hamming distance
- * Returns: number of differing pixels (0-64), lower is more similar
- */
-static int bitmap_distance(const uint8_t bitmap1[8], const uint8_t bitmap2[8])
-{
-    int distance = 0;
-    for (int i = 0; i < 8; i++)
+    for (int half = 0; half < 2; half++)
     {
-        uint8_t xor = bitmap1[i] ^ bitmap2[i];
-        // Count number of 1 bits in xor (Hamming weight)
-        while (xor)
+        int y = char_row * 8 + half * 4;
+        uint32_t patterns = braille_line_bits[0][vram[scanline_offset[y] + char_col]] |
+                            braille_line_bits[1][vram[scanline_offset[y + 1] + char_col]] |
+                            braille_line_bits[2][vram[scanline_offset[y + 2] + char_col]] |
+                            braille_line_bits[3][vram[scanline_offset[y + 3] + char_col]];
+
+        int out_y = char_row * 2 + half;
+        for (int k = 0; k < 4; k++)
         {
-            distance += xor & 1;
-            xor >>= 1;
+            int out_x = char_col * 4 + k;
+            encode_braille((patterns >> (8 * k)) & 0xFF, &screen->braille_matrix[out_y][out_x * 4]);
+            screen->braille_colors[out_y][out_x] = attr;
         }
     }
-    return distance;
 }
 
 /**
  * Extract 8x8 bitmap for character block from VRAM
  * char_col and char_row are 0-31 and 0-23 (character grid positions)
+ * Pixel bytes are MSB-leftmost, so each bitmap row is one VRAM byte; the
+ * rows are packed top row first into the high byte of a 64-bit word.
  */
-static void extract_char_bitmap(const uint8_t *vram, int char_col, int char_row, uint8_t bitmap[8])
+static uint64_t extract_char_bitmap(const uint8_t *vram, int char_col, int char_row)
 {
-    int pixel_x = char_col * 8;
-    int pixel_y = char_row * 8;
+    const uint16_t *lines = &scanline_offset[char_row * 8];
+    uint64_t bitmap = 0;
 
     for (int row = 0; row < 8; row++)
-    {
-        uint8_t byte = 0;
-        for (int col = 0; col < 8; col++)
-        {
-            if (get_pixel(vram, pixel_x + col, pixel_y + row))
-            {
-                byte |= (0x80 >> col); // Set bit from MSB to LSB
-            }
-        }
-        bitmap[row] = byte;
-    }
+        bitmap = (bitmap << 8) | vram[lines[row] + char_col];
+    return bitmap;
 }
 
 /**
  * Recognize character from 8x8 bitmap using font matching
+ * Exact matches (ROM text) are a single hash probe; anything else falls
+ * back to a nearest-neighbour search by Hamming distance.
  * Returns: ASCII character (32-126) or space (32) if not recognized
  */
-static char recognize_character(const uint8_t bitmap[8])
+static char recognize_character(uint64_t bitmap)
 {
+    // Exact match: probe the glyph hash table
+    for (uint32_t slot = glyph_hash(bitmap);; slot = (slot + 1) & (GLYPH_HASH_SIZE - 1))
+    {
+        if (glyph_hash_index[slot] < 0)
+            break;
+        if (font_packed[glyph_hash_index[slot]] == bitmap)
+            return (char)(32 + glyph_hash_index[slot]);
+    }
+
     int best_distance = 999;
     int best_char = 0; // Space character
 
     // Compare against all printable ASCII characters (32-126)
+    // Ties keep the lowest character code
     for (int i = 0; i < 96; i++)
     {
-        int distance = bitmap_distance(bitmap, sinclair_font[i]);
-
-        // Found a perfect or near-perfect match
+        int distance = __builtin_popcountll(bitmap ^ font_packed[i]);
         if (distance < best_distance)
         {
             best_distance = distance;
             best_char = i;
-
-            // If exact match found, stop searching
-            if (distance == 0)
-                break;
         }
     }
 
@@ -443,56 +467,146 @@ static char recognize_character(const uint8_t bitmap[8])
 }
 
 /**
- * Convert entire video RAM to matrix with colors
- * This is the core ULA conversion function
+ * Convert one 8x8 character cell to the output matrix
+ * Each cell covers 4x4 block characters, 4x2 braille characters or one OCR
+ * character, so cells can be converted independently.
  */
-void convert_vram_to_matrix(const uint8_t *vram, ula_render_mode_t render_mode)
+static void convert_char_cell(ula_matrix_t *screen, const uint8_t *vram, ula_render_mode_t render_mode,
+                              int char_col, int char_row)
 {
-    ula_matrix.render_mode = render_mode;
-
     if (render_mode == ULA_RENDER_BRAILLE2X4)
     {
         // Braille mode: 2x4 pixels per character
-        for (int y = 0; y < BRAILLE_OUTPUT_HEIGHT; y++)
-        {
-            for (int x = 0; x < BRAILLE_OUTPUT_WIDTH; x++)
-            {
-                get_braille_char(vram, x, y, &ula_matrix.braille_matrix[y][x * 4], &ula_matrix.braille_colors[y][x]);
-            }
-        }
+        convert_braille_cell(screen, vram, char_col, char_row);
     }
     else if (render_mode == ULA_RENDER_OCR)
     {
-        // OCR mode: 32x24 character matrix with text recognition
-        uint8_t bitmap[8];
-        for (int char_row = 0; char_row < OCR_OUTPUT_HEIGHT; char_row++)
+        // OCR mode: extract 8x8 bitmap and recognize character from it,
+        // unless the cell still holds the bitmap it was last recognized from
+        uint64_t bitmap = extract_char_bitmap(vram, char_col, char_row);
+        if (!screen->ocr_cell_valid[char_row][char_col] || screen->ocr_cell_bitmap[char_row][char_col] != bitmap)
         {
-            for (int char_col = 0; char_col < OCR_OUTPUT_WIDTH; char_col++)
-            {
-                // Extract 8x8 bitmap for this character position
-                extract_char_bitmap(vram, char_col, char_row, bitmap);
+            screen->ocr_matrix[char_row][char_col] = recognize_character(bitmap);
+            screen->ocr_cell_bitmap[char_row][char_col] = bitmap;
+            screen->ocr_cell_valid[char_row][char_col] = 1;
+        }
+
+        // Get attribute color for this character
+        screen->ocr_colors[char_row][char_col] = get_attribute(vram, char_col * 8, char_row * 8);
+    }
+    else
+    {
+        // Block mode (default): 2x2 pixels per character
+        convert_block_cell(screen, vram, char_col, char_row);
+    }
+}
 
-                // Recognize character from bitmap
-                ula_matrix.ocr_matrix[char_row][char_col] = recognize_character(bitmap);
+/**
+ * Convert entire video RAM to matrix with colors
+ * This is the core ULA conversion function
+ */
+void convert_vram_to_matrix(ula_t *ula, const uint8_t *vram, ula_render_mode_t render_mode)
+{
+    ula_matrix_t *screen = ula->matrix;
 
-                // Get attribute color for this character
-                ula_matrix.ocr_colors[char_row][char_col] = get_attribute(vram, char_col * 8, char_row * 8);
-            }
-            // Null-terminate each row for string operations
-            ula_matrix.ocr_matrix[char_row][OCR_OUTPUT_WIDTH] = '\0';
+    pthread_once(&conversion_tables_once, init_conversion_tables);
+    screen->render_mode = render_mode;
+
+    for (int char_row = 0; char_row < SPECTRUM_ATTR_ROWS; char_row++)
+    {
+        for (int char_col = 0; char_col < SPECTRUM_ATTR_COLS; char_col++)
+        {
+            convert_char_cell(screen, vram, render_mode, char_col, char_row);
         }
+
+        // Null-terminate each OCR row for string operations
+        screen->ocr_matrix[char_row][OCR_OUTPUT_WIDTH] = '\0';
+    }
+}
+
+/**
+ * Force the next frame conversion to revisit the whole screen
+ */
+void ula_mark_all_dirty(ula_t *ula)
+{
+    atomic_store(&ula->matrix->dirty_all, 1);
+}
+
+// Frame slot index bits of ula_t.frame_ready, and the not-yet-taken flag
+#define ULA_FRAME_SLOT_MASK 0x03
+#define ULA_FRAME_FRESH 0x04
+
+/**
+ * Publish a completed frame into the producer's slot
+ */
+void ula_publish_frame(ula_t *ula, const uint8_t *screen, uint64_t frame)
+{
+    ula_frame_t *slot = &ula->frames[ula->frame_back];
+
+    memcpy(slot->screen, screen, SPECTRUM_RAM_SIZE);
+    slot->border_color = atomic_load_explicit(&ula->border_color, memory_order_relaxed);
+    slot->frame = frame;
+
+    // Release: the slot contents are visible before the consumer can take it
+    int previous = atomic_exchange_explicit(&ula->frame_ready, ula->frame_back | ULA_FRAME_FRESH,
+                                            memory_order_acq_rel);
+    ula->frame_back = previous & ULA_FRAME_SLOT_MASK;
+}
+
+/**
+ * Take the newest published frame, returning the consumer's slot in exchange
+ */
+const ula_frame_t *ula_take_frame(ula_t *ula)
+{
+    if (!(atomic_load_explicit(&ula->frame_ready, memory_order_relaxed) & ULA_FRAME_FRESH))
+        return NULL;
+
+    int ready = atomic_exchange_explicit(&ula->frame_ready, ula->frame_front, memory_order_acq_rel);
+    ula->frame_front = ready & ULA_FRAME_SLOT_MASK;
+    return &ula->frames[ula->frame_front];
+}
+
+/**
+ * Convert the cells of a frame that changed since the last converted frame
+ * Falls back to a full conversion on the first call, after
+ * ula_mark_all_dirty() and when the render mode changes.
+ */
+void convert_frame_to_matrix(ula_t *ula, const ula_frame_t *frame, ula_render_mode_t render_mode)
+{
+    ula_matrix_t *screen = ula->matrix;
+    const uint8_t *vram = frame->screen;
+
+    pthread_once(&conversion_tables_once, init_conversion_tables);
+
+    if (atomic_exchange(&screen->dirty_all, 0) || render_mode != screen->dirty_mode)
+    {
+        screen->dirty_mode = render_mode;
+        convert_vram_to_matrix(ula, vram, render_mode);
     }
     else
     {
-        // Block mode (default): 2x2 pixels per character
-        for (int y = 0; y < OUTPUT_HEIGHT; y++)
+        screen->render_mode = render_mode;
+
+        // A cell changed if any of its 8 pixel bytes or its attribute did
+        for (int char_row = 0; char_row < SPECTRUM_ATTR_ROWS; char_row++)
         {
-            for (int x = 0; x < OUTPUT_WIDTH; x++)
+            for (int char_col = 0; char_col < SPECTRUM_ATTR_COLS; char_col++)
             {
-                ula_matrix.matrix[y][x] = get_block_char(vram, x, y, &ula_matrix.matrix_colors[y][x]);
+                int attr = SPECTRUM_VRAM_SIZE + char_row * SPECTRUM_ATTR_COLS + char_col;
+                int changed = vram[attr] != screen->shown[attr];
+                for (int y = 0; y < 8 && !changed; y++)
+                {
+                    int offset = scanline_offset[char_row * 8 + y] + char_col;
+                    changed = vram[offset] != screen->shown[offset];
+                }
+                if (changed)
+                    convert_char_cell(screen, vram, render_mode, char_col, char_row);
             }
         }
     }
+
+    memcpy(screen->shown, vram, SPECTRUM_RAM_SIZE);
+    screen->border_color = frame->border_color & 0x07;
 }
 
 /**
@@ -514,35 +628,188 @@ static void get_terminal_size(int *width, int *height)
     }
 }
 
+#ifndef DISABLE_RENDERING
+// Terminal frame limits for the front/back cell buffers
+#define TERM_MAX_ROWS 128
+#define TERM_MAX_COLS 512
+#define RENDER_BUFFER_SIZE 65536 // Output is flushed whenever the buffer fills
+#define RUN_MERGE_GAP 4          // Unchanged cells rewritten rather than repositioning the cursor
+
+// One rendered terminal cell: UTF-8 glyph plus SGR colour codes
+typedef struct
+{
+    char glyph[4]; // UTF-8 glyph, NUL-terminated (1-3 bytes); empty = unknown
+    uint8_t fg;    // SGR foreground (30-37, 90-97 bright, 39 default)
+    uint8_t bg;    // SGR background (40-47)
+} term_cell_t;
+
+static term_cell_t term_front[TERM_MAX_ROWS][TERM_MAX_COLS]; // What the terminal currently shows
+static term_cell_t term_back[TERM_MAX_ROWS][TERM_MAX_COLS];  // Frame being composed
+static int term_rows = 0, term_cols = 0;                     // Layout of the front buffer
+static ula_render_mode_t term_mode = ULA_RENDER_BLOCK2X2;    // Render mode of the front buffer
+static atomic_int term_redraw = 1;                           // Front buffer no longer matches terminal
+
+static char render_buffer[RENDER_BUFFER_SIZE]; // Pre-allocated output buffer
+static int render_pos = 0;
+
+static void render_flush(void)
+{
+    if (render_pos > 0)
+    {
+        fwrite(render_buffer, 1, render_pos, stdout);
+        render_pos = 0;
+    }
+}
+
+static void render_bytes(const char *data, int len)
+{
+    if (render_pos + len > RENDER_BUFFER_SIZE)
+        render_flush();
+    memcpy(render_buffer + render_pos, data, len);
+    render_pos += len;
+}
+
+static void render_printf(const char *format, int a, int b)
+{
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), format, a, b);
+    render_bytes(tmp, len);
+}
+
 /**
- * Render the matrix to terminal with minimal flickering
- * Uses pre-rendered buffer and atomic screen updates for 50Hz
- * Includes border rendering with centering if screen size allows
+ * Place a cell in the back buffer (clipped to the frame)
  */
-void ula_render_to_terminal(void)
+static void compose_cell(int row, int col, const char *glyph, uint8_t fg, uint8_t bg)
 {
-#ifndef DISABLE_RENDERING
-    // 50Hz = 20ms per frame
-    const long FRAME_TIME_NS = 20000000; // 20ms in nanoseconds
-    static char render_buffer[65536];    // Pre-allocated render buffer (64KB for UTF-8 with borders)
-    static int first_frame = 1;
+    if (row < 0 || row >= term_rows || col < 0 || col >= term_cols)
+        return;
 
-    struct timespec frame_start, frame_end;
-    long elapsed_ns;
+    term_cell_t *cell = &term_back[row][col];
+    int i = 0;
+    while (i < 3 && glyph[i])
+    {
+        cell->glyph[i] = glyph[i];
+        i++;
+    }
+    cell->glyph[i] = '\0';
+    cell->fg = fg;
+    cell->bg = bg;
+}
 
-    // Get terminal dimensions for centering
-    int term_width, term_height;
-    get_terminal_size(&term_width, &term_height);
+/**
+ * Convert a Spectrum attribute to SGR codes, applying the blink phase
+ */
+static void attr_to_sgr(color_attr_t attr, int blink_phase, uint8_t *fg, uint8_t *bg)
+{
+    uint8_t ink = attr.ink;
+    uint8_t paper = attr.paper;
+
+    // Apply blink: swap ink/paper when blink is set and we're in inverted phase
+    if (attr.blink && blink_phase == 1)
+    {
+        ink = attr.paper;
+        paper = attr.ink;
+    }
 
+    // Foreground 30-37 (90-97 when bright), background 40-47
+    *fg = 30 + spectrum_to_ansi[ink & 7] + (attr.bright ? 60 : 0);
+    *bg = 40 + spectrum_to_ansi[paper & 7];
+}
+
+static int cells_equal(const term_cell_t *a, const term_cell_t *b)
+{
+    return a->fg == b->fg && a->bg == b->bg && strcmp(a->glyph, b->glyph) == 0;
+}
+
+/**
+ * Emit the cells that differ between back and front buffers
+ * Changed cells are written as runs after a single cursor move; short gaps
+ * of unchanged cells are bridged, and SGR codes are only emitted when the
+ * colours differ from the previous cell written.
+ */
+static void emit_frame_diff(void)
+{
+    int pen_fg = -1, pen_bg = -1; // Terminal colour state unknown at frame start
+
+    for (int row = 0; row < term_rows; row++)
+    {
+        int col = 0;
+        while (col < term_cols)
+        {
+            if (cells_equal(&term_back[row][col], &term_front[row][col]))
+            {
+                col++;
+                continue;
+            }
+
+            // Extend the run while the next change is within RUN_MERGE_GAP cells
+            int last = col;
+            for (int next = col + 1; next < term_cols && next - last <= RUN_MERGE_GAP; next++)
+            {
+                if (!cells_equal(&term_back[row][next], &term_front[row][next]))
+                    last = next;
+            }
+
+            render_printf("\033[%d;%dH", row + 1, col + 1);
+            for (; col <= last; col++)
+            {
+                term_cell_t *cell = &term_back[row][col];
+
+                // A space only shows its background, so its ink is never switched
+                int fg_changed = cell->fg != pen_fg && strcmp(cell->glyph, " ") != 0;
+                int bg_changed = cell->bg != pen_bg;
+
+                if (fg_changed && bg_changed)
+                    render_printf("\033[%d;%dm", cell->fg, cell->bg);
+                else if (fg_changed)
+                    render_printf("\033[%dm", cell->fg, 0);
+                else if (bg_changed)
+                    render_printf("\033[%dm", cell->bg, 0);
+                if (fg_changed)
+                    pen_fg = cell->fg;
+                pen_bg = cell->bg;
+
+                render_bytes(cell->glyph, (int)strlen(cell->glyph));
+                term_front[row][col] = *cell;
+            }
+        }
+    }
+
+    // Leave the terminal with default colours for any other output
+    if (pen_bg != -1)
+        render_bytes("\033[0m", 4);
+}
+#endif
+
+/**
+ * Force the next frame to repaint the whole terminal
+ * Call after other output has overwritten part of the screen.
+ */
+void ula_request_redraw(void)
+{
+#ifndef DISABLE_RENDERING
+    atomic_store(&term_redraw, 1);
+#endif
+}
+
+#ifndef DISABLE_RENDERING
+/**
+ * Compose the current matrix into a terminal frame
+ * Lays the content out (with border and centering) for a terminal of the
+ * given size and queues the cells that differ from the previous frame in
+ * the render buffer.
+ */
+static void compose_frame(ula_matrix_t *screen, int term_width, int term_height)
+{
     // Calculate content dimensions based on render mode
     int content_height;
     int content_width;
-    if (ula_matrix.render_mode == ULA_RENDER_BRAILLE2X4)
+    if (screen->render_mode == ULA_RENDER_BRAILLE2X4)
     {
         content_height = BRAILLE_OUTPUT_HEIGHT;
         content_width = BRAILLE_OUTPUT_WIDTH;
     }
-    else if (ula_matrix.render_mode == ULA_RENDER_OCR)
+    else if (screen->render_mode == ULA_RENDER_OCR)
     {
         content_height = OCR_OUTPUT_HEIGHT;
         content_width = OCR_OUTPUT_WIDTH;
@@ -556,7 +823,7 @@ void ula_render_to_terminal(void)
     // Calculate border and padding sizes
     // For OCR mode, use fixed 10-character borders; for others, center
     int left_padding, right_padding;
-    if (ula_matrix.render_mode == ULA_RENDER_OCR)
+    if (screen->render_mode == ULA_RENDER_OCR)
     {
         left_padding = 10;
         right_padding = 10;
@@ -570,320 +837,139 @@ void ula_render_to_terminal(void)
     // Always try to render at least 1 line of border top/bottom if there's room
     int border_height = (term_height > content_height + 2) ? 1 : 0;
 
-    // Start frame timer BEFORE any I/O
-    clock_gettime(CLOCK_MONOTONIC, &frame_start);
+    // Frame layout, clipped to the terminal
+    int rows = content_height + 2 * border_height;
+    int cols = left_padding + content_width + right_padding;
+    if (rows > term_height)
+        rows = term_height;
+    if (cols > term_width)
+        cols = term_width;
+    if (rows > TERM_MAX_ROWS)
+        rows = TERM_MAX_ROWS;
+    if (cols > TERM_MAX_COLS)
+        cols = TERM_MAX_COLS;
+
+    // Repaint everything when the layout changed or the screen was disturbed
+    if (atomic_exchange(&term_redraw, 0) || rows != term_rows || cols != term_cols ||
+        screen->render_mode != term_mode)
+    {
+        render_bytes("\033[0m\033[2J", 8);
+        for (int r = 0; r < TERM_MAX_ROWS; r++)
+            for (int c = 0; c < TERM_MAX_COLS; c++)
+                term_front[r][c].glyph[0] = '\0';
+        term_rows = rows;
+        term_cols = cols;
+        term_mode = screen->render_mode;
+    }
 
     // Lock matrix for reading
-    pthread_mutex_lock(&ula_matrix.lock);
+    pthread_mutex_lock(&screen->lock);
 
     // Increment frame counter for blink timing (cycles 0-31)
-    ula_matrix.frame_counter = (ula_matrix.frame_counter + 1) % 32;
+    screen->frame_counter = (screen->frame_counter + 1) % 32;
 
     // Calculate blink phase: 0 = normal (frames 0-15), 1 = inverted (frames 16-31)
-    int blink_phase = (ula_matrix.frame_counter / 16) % 2;
-
-    // Build entire frame in buffer (avoids multiple printf calls)
-    int buffer_pos = 0;
-
-    // Move cursor to home only on first frame, then use relative positioning
-    if (first_frame)
-    {
-        // Use alternate screen buffer and clear it
-        buffer_pos += sprintf(render_buffer + buffer_pos, "\033[?1049h\033[2J\033[H\033[?25l");
-        first_frame = 0;
-    }
-    else
-    {
-        // Move cursor back to top-left for subsequent frames
-        buffer_pos += sprintf(render_buffer + buffer_pos, "\033[H");
-    }
+    int blink_phase = (screen->frame_counter / 16) % 2;
 
     // Get border color and convert to ANSI
-    uint8_t border_color = ula_matrix.border_color & 0x07;
+    uint8_t border_color = screen->border_color;
     int ansi_border_color = spectrum_to_ansi[border_color];
     // Background colors: 40-47 for standard, 100-107 for bright
-    int border_bg_code = 40 + ansi_border_color;
+    uint8_t border_bg_code = 40 + ansi_border_color;
 
-    // Render top border if space available
-    if (border_height > 0)
-    {
-        for (int b = 0; b < border_height; b++)
-        {
-            buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-            // Left padding
-            for (int i = 0; i < left_padding && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Content width
-            for (int i = 0; i < content_width && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Right padding
-            for (int i = 0; i < right_padding && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Reset and newline
-            buffer_pos += sprintf(render_buffer + buffer_pos, "\033[0m\n");
-        }
-    }
+    // Compose border: fill the whole frame, content is drawn over it
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+            compose_cell(r, c, " ", 39, border_bg_code);
 
-    // Render based on mode
-    if (ula_matrix.render_mode == ULA_RENDER_BRAILLE2X4)
+    // Compose content based on mode
+    for (int y = 0; y < content_height; y++)
     {
-        // Braille mode rendering with colors and border
-        color_attr_t current_attr = {0, 0, 0, 0}; // Track last color to minimize escape codes
-        for (int y = 0; y < BRAILLE_OUTPUT_HEIGHT; y++)
+        int row = border_height + y;
+        if (row >= rows)
+            break;
+
+        for (int x = 0; x < content_width; x++)
         {
-            // Left padding with border color
-            if (left_padding > 0)
+            color_attr_t attr;
+            char ocr_glyph[2] = {0, 0};
+            const char *glyph;
+
+            if (screen->render_mode == ULA_RENDER_BRAILLE2X4)
             {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < left_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
+                attr = screen->braille_colors[y][x];
+                glyph = &screen->braille_matrix[y][x * 4];
             }
-
-            current_attr.ink = 0xFF; // Force initial color code
-            for (int x = 0; x < BRAILLE_OUTPUT_WIDTH; x++)
+            else if (screen->render_mode == ULA_RENDER_OCR)
             {
-                color_attr_t attr = ula_matrix.braille_colors[y][x];
-
-                // Apply blink: swap ink/paper when blink is set and we're in inverted phase
-                uint8_t display_ink = attr.ink;
-                uint8_t display_paper = attr.paper;
-                if (attr.blink && blink_phase == 1)
+                attr = screen->ocr_colors[y][x];
+                char ch = screen->ocr_matrix[y][x];
+
+                // Handle ZX Spectrum non-standard ASCII characters with UTF-8
+                if (ch == 96)
+                    glyph = "\xC2\xA3"; // £ (pound symbol)
+                else if (ch == 127)
+                    glyph = "\xC2\xA9"; // © (copyright symbol)
+                else
                 {
-                    display_ink = attr.paper;
-                    display_paper = attr.ink;
-                }
-
-                // Emit color code only if color changed
-                if (display_ink != current_attr.ink || display_paper != current_attr.paper || attr.bright != current_attr.bright)
-                {
-                    current_attr.ink = display_ink;
-                    current_attr.paper = display_paper;
-                    current_attr.bright = attr.bright;
-                    // Convert Spectrum colors to ANSI colors
-                    int ansi_ink = spectrum_to_ansi[display_ink & 7];
-                    int ansi_paper = spectrum_to_ansi[display_paper & 7];
-
-                    // Apply foreground color: 30-37 for normal, 90-97 for bright
-                    int fg_code = 30 + ansi_ink;
-                    if (attr.bright)
-                        fg_code += 60; // Convert to bright colors (90-97)
-
-                    // Apply background color: 40-47
-                    int bg_code = 40 + ansi_paper;
-
-                    buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%d;%dm", fg_code, bg_code);
-                }
-
-                const char *ch = &ula_matrix.braille_matrix[y][x * 4];
-                // Copy UTF-8 character (3 bytes)
-                for (int i = 0; i < 3 && ch[i] && buffer_pos < 65520; i++)
-                {
-                    render_buffer[buffer_pos++] = ch[i];
+                    ocr_glyph[0] = ch ? ch : ' ';
+                    glyph = ocr_glyph;
                 }
             }
-            // Right padding with border color
-            if (right_padding > 0)
+            else
             {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < right_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
+                attr = screen->matrix_colors[y][x];
+                glyph = screen->matrix[y][x] ? screen->matrix[y][x] : " ";
             }
-            // Reset colors before newline
-            if (buffer_pos < 65530)
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[0m");
-            if (buffer_pos < 65534)
-                render_buffer[buffer_pos++] = '\n';
+
+            uint8_t fg, bg;
+            attr_to_sgr(attr, blink_phase, &fg, &bg);
+            compose_cell(row, left_padding + x, glyph, fg, bg);
         }
     }
-    else if (ula_matrix.render_mode == ULA_RENDER_OCR)
-    {
-        // OCR mode rendering - text-based output with colors
-        color_attr_t current_attr = {0, 0, 0, 0}; // Track last color to minimize escape codes
-        for (int y = 0; y < OCR_OUTPUT_HEIGHT; y++)
-        {
-            // Left padding with border color
-            if (left_padding > 0)
-            {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < left_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
-            }
-
-            current_attr.ink = 0xFF; // Force initial color code
-            for (int x = 0; x < OCR_OUTPUT_WIDTH; x++)
-            {
-                color_attr_t attr = ula_matrix.ocr_colors[y][x];
-
-                // Apply blink: swap ink/paper when blink is set and we're in inverted phase
-                uint8_t display_ink = attr.ink;
-                uint8_t display_paper = attr.paper;
-                if (attr.blink && blink_phase == 1)
-                {
-                    display_ink = attr.paper;
-                    display_paper = attr.ink;
-                }
 
-                // Emit color code only if color changed
-                if (display_ink != current_attr.ink || display_paper != current_attr.paper || attr.bright != current_attr.bright)
-                {
-                    current_attr.ink = display_ink;
-                    current_attr.paper = display_paper;
-                    current_attr.bright = attr.bright;
-                    // Convert Spectrum colors to ANSI colors
-                    int ansi_ink = spectrum_to_ansi[display_ink & 7];
-                    int ansi_paper = spectrum_to_ansi[display_paper & 7];
-
-                    // Apply foreground color: 30-37 for normal, 90-97 for bright
-                    int fg_code = 30 + ansi_ink;
-                    if (attr.bright)
-                        fg_code += 60; // Convert to bright colors (90-97)
-
-                    // Apply background color: 40-47
-                    int bg_code = 40 + ansi_paper;
-
-                    buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%d;%dm", fg_code, bg_code);
-                }
+    pthread_mutex_unlock(&screen->lock);
 
-                // Render recognized character
-                char ch = ula_matrix.ocr_matrix[y][x];
-                if (ch && buffer_pos < 65520)
-                {
-                    // Handle ZX Spectrum non-standard ASCII characters with UTF-8
-                    if (ch == 96) // £ (pound symbol) - UTF-8: 0xC2 0xA3
-                    {
-                        if (buffer_pos + 1 < 65520)
-                        {
-                            render_buffer[buffer_pos++] = 0xC2;
-                            render_buffer[buffer_pos++] = 0xA3;
-                        }
-                    }
-                    else if (ch == 127) // © (copyright symbol) - UTF-8: 0xC2 0xA9
-                    {
-                        if (buffer_pos + 1 < 65520)
-                        {
-                            render_buffer[buffer_pos++] = 0xC2;
-                            render_buffer[buffer_pos++] = 0xA9;
-                        }
-                    }
-                    else
-                    {
-                        render_buffer[buffer_pos++] = ch;
-                    }
-                }
-            }
-            // Right padding with border color
-            if (right_padding > 0)
-            {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < right_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
-            }
-            // Reset colors before newline
-            if (buffer_pos < 65530)
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[0m");
-            if (buffer_pos < 65534)
-                render_buffer[buffer_pos++] = '\n';
-        }
-    }
-    else
-    {
-        // Block mode rendering with colors and border
-        color_attr_t current_attr = {0, 0, 0, 0}; // Track last color to minimize escape codes
-        for (int y = 0; y < OUTPUT_HEIGHT; y++)
-        {
-            // Left padding with border color
-            if (left_padding > 0)
-            {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < left_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
-            }
+    // Queue only what changed since the previous frame
+    emit_frame_diff();
+}
+#endif
 
-            current_attr.ink = 0xFF; // Force initial color code
-            for (int x = 0; x < OUTPUT_WIDTH; x++)
-            {
-                color_attr_t attr = ula_matrix.matrix_colors[y][x];
+/**
+ * Render the matrix to terminal with minimal flickering
+ * Composes the frame (border and content) into a back buffer of cells and
+ * writes only the cells that differ from what the terminal already shows
+ * Includes border rendering with centering if screen size allows
+ */
+void ula_render_to_terminal(ula_t *ula)
+{
+#ifndef DISABLE_RENDERING
+    // 50Hz = 20ms per frame
+    const long FRAME_TIME_NS = 20000000; // 20ms in nanoseconds
+    static int first_frame = 1;
 
-                // Apply blink: swap ink/paper when blink is set and we're in inverted phase
-                uint8_t display_ink = attr.ink;
-                uint8_t display_paper = attr.paper;
-                if (attr.blink && blink_phase == 1)
-                {
-                    display_ink = attr.paper;
-                    display_paper = attr.ink;
-                }
+    struct timespec frame_start, frame_end;
+    long elapsed_ns;
 
-                // Emit color code only if color changed
-                if (display_ink != current_attr.ink || display_paper != current_attr.paper || attr.bright != current_attr.bright)
-                {
-                    current_attr.ink = display_ink;
-                    current_attr.paper = display_paper;
-                    current_attr.bright = attr.bright;
-                    // Convert Spectrum colors to ANSI colors
-                    int ansi_ink = spectrum_to_ansi[display_ink & 7];
-                    int ansi_paper = spectrum_to_ansi[display_paper & 7];
-
-                    // Apply foreground color: 30-37 for normal, 90-97 for bright
-                    int fg_code = 30 + ansi_ink;
-                    if (attr.bright)
-                        fg_code += 60; // Convert to bright colors (90-97)
-
-                    // Apply background color: 40-47
-                    int bg_code = 40 + ansi_paper;
-
-                    buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%d;%dm", fg_code, bg_code);
-                }
+    // Get terminal dimensions for centering
+    int term_width, term_height;
+    get_terminal_size(&term_width, &term_height);
 
-                const char *ch = ula_matrix.matrix[y][x];
-                // Handle UTF-8 multi-byte characters
-                while (*ch && buffer_pos < 65520)
-                {
-                    render_buffer[buffer_pos++] = *ch++;
-                }
-            }
-            // Right padding with border color
-            if (right_padding > 0)
-            {
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-                for (int p = 0; p < right_padding && buffer_pos < 65520; p++)
-                    render_buffer[buffer_pos++] = ' ';
-            }
-            // Reset colors before newline
-            if (buffer_pos < 65530)
-                buffer_pos += sprintf(render_buffer + buffer_pos, "\033[0m");
-            if (buffer_pos < 65534)
-                render_buffer[buffer_pos++] = '\n';
-        }
-    }
+    // Start frame timer BEFORE any I/O
+    clock_gettime(CLOCK_MONOTONIC, &frame_start);
 
-    // Render bottom border if space available
-    if (border_height > 0)
+    // Use alternate screen buffer on the first frame
+    if (first_frame)
     {
-        for (int b = 0; b < border_height; b++)
-        {
-            buffer_pos += sprintf(render_buffer + buffer_pos, "\033[%dm", border_bg_code);
-            // Left padding
-            for (int i = 0; i < left_padding && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Content width
-            for (int i = 0; i < content_width && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Right padding
-            for (int i = 0; i < right_padding && buffer_pos < 65520; i++)
-                render_buffer[buffer_pos++] = ' ';
-            // Reset and newline
-            buffer_pos += sprintf(render_buffer + buffer_pos, "\033[0m\n");
-        }
+        render_bytes("\033[?1049h\033[?25l", 14);
+        first_frame = 0;
     }
 
-    pthread_mutex_unlock(&ula_matrix.lock);
+    compose_frame(ula->matrix, term_width, term_height);
 
-    // Write entire buffer at once (atomic write)
-    if (buffer_pos > 0 && buffer_pos < 65536)
-    {
-        fwrite(render_buffer, 1, buffer_pos, stdout);
-        fflush(stdout);
-    }
+    // Write the frame
+    render_flush();
+    fflush(stdout);
 
     // End frame timer AFTER I/O completes
     clock_gettime(CLOCK_MONOTONIC, &frame_end);
@@ -900,6 +986,7 @@ void ula_render_to_terminal(void)
     }
 #else
     // DISABLE_RENDERING: Skip terminal output, but maintain 50Hz frame timing
+    (void)ula;
     const long FRAME_TIME_NS = 20000000; // 20ms in nanoseconds
     struct timespec frame_start, frame_end;
     long elapsed_ns;
@@ -995,10 +1082,36 @@ ula_t *ula_init(int width, int height, uint8_t *vram, ula_render_mode_t render_m
     ula->width = width;
     ula->height = height;
     ula->vram = vram;
-    ula->border_color = 0;
+    atomic_init(&ula->border_color, 0);
     ula->render_mode = render_mode;
     pthread_mutex_init(&ula->lock, NULL);
 
+    // Output matrix: empty until the first conversion, which covers the whole screen
+    ula->matrix = calloc(1, sizeof(ula_matrix_t));
+    if (!ula->matrix)
+    {
+        pthread_mutex_destroy(&ula->lock);
+        free(ula);
+        return NULL;
+    }
+    ula->matrix->render_mode = render_mode;
+    ula->matrix->dirty_mode = render_mode;
+    atomic_init(&ula->matrix->dirty_all, 1);
+
+    // Frame handoff: nothing published yet
+    ula->frames = calloc(ULA_FRAME_SLOTS, sizeof(ula_frame_t));
+    if (!ula->frames)
+    {
+        free(ula->matrix);
+        pthread_mutex_destroy(&ula->lock);
+        free(ula);
+        return NULL;
+    }
+    ula->frame_back = 0;
+    atomic_init(&ula->frame_ready, 1);
+    ula->frame_front = 2;
+    pthread_mutex_init(&ula->matrix->lock, NULL);
+
     return ula;
 }
 
@@ -1010,6 +1123,9 @@ void ula_cleanup(ula_t *ula)
     if (!ula)
         return;
 
+    pthread_mutex_destroy(&ula->matrix->lock);
+    free(ula->matrix);
+    free(ula->frames);
     pthread_mutex_destroy(&ula->lock);
     free(ula);
 }
@@ -1024,14 +1140,11 @@ void ula_set_border_color(ula_t *ula, uint8_t color)
 
     uint8_t color_val = color & 0x07;
 
-    pthread_mutex_lock(&ula->lock);
-    ula->border_color = color_val;
-    pthread_mutex_unlock(&ula->lock);
-
-    // Also update the global matrix border color for rendering
-    pthread_mutex_lock(&ula_matrix.lock);
-    ula_matrix.border_color = color_val;
-    pthread_mutex_unlock(&ula_matrix.lock);
+    // Called for every OUT to the ULA: only store a change, and never lock.
+    // The renderer gets the colour with each published frame.
+    if (atomic_load_explicit(&ula->border_color, memory_order_relaxed) == color_val)
+        return;
+    atomic_store_explicit(&ula->border_color, color_val, memory_order_relaxed);
 }
 
 /**
@@ -1041,5 +1154,5 @@ uint8_t ula_get_border_color(const ula_t *ula)
 {
     if (!ula)
         return 0;
-    return ula->border_color;
+    return atomic_load_explicit(&ula->border_color, memory_order_relaxed);
 }
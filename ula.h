@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 // ZX Spectrum video RAM dimensions
 #define SPECTRUM_WIDTH 256
@@ -34,15 +35,43 @@ typedef enum
 #define OCR_OUTPUT_WIDTH 32
 #define OCR_OUTPUT_HEIGHT 24
 
+// Character matrix converted from video RAM (private to ula.c)
+typedef struct ula_matrix_s ula_matrix_t;
+
+// Frame handoff slots: one being written, one ready, one being shown
+#define ULA_FRAME_SLOTS 3
+
+/**
+ * Completed frame as the ULA showed it at the interrupt that ended it
+ */
+typedef struct
+{
+    uint8_t screen[SPECTRUM_RAM_SIZE]; // Pixels and attributes
+    uint8_t border_color;
+    uint64_t frame; // Emulated frame number
+} ula_frame_t;
+
 // ULA display structure
+// Each display owns its matrix and frame slots, so any number of machines
+// can convert at once. The terminal itself is process-wide: only one
+// display should be rendered with ula_render_to_terminal().
 typedef struct
 {
     int width;
     int height;
     uint8_t *vram;
-    uint8_t border_color;
+    _Atomic uint8_t border_color; // Set lock-free by the CPU thread
     ula_render_mode_t render_mode;
     pthread_mutex_t lock;
+    ula_matrix_t *matrix; // Converted output of this display
+
+    // Triple-buffered frame handoff, see ula_publish_frame(). The producer
+    // owns frames[frame_back], the consumer frames[frame_front]; frame_ready
+    // holds the newest published slot, plus ULA_FRAME_FRESH until taken.
+    ula_frame_t *frames;
+    int frame_back;
+    atomic_int frame_ready;
+    int frame_front;
 } ula_t;
 
 /**
@@ -94,10 +123,50 @@ uint8_t ula_read_vram(const ula_t *ula, uint16_t addr);
 /**
  * Convert entire video RAM to matrix
  * This is the core ULA conversion function
+ * @param ula ULA structure whose matrix is written
  * @param vram Pointer to video RAM
  * @param render_mode Rendering mode to use
  */
-void convert_vram_to_matrix(const uint8_t *vram, ula_render_mode_t render_mode);
+void convert_vram_to_matrix(ula_t *ula, const uint8_t *vram, ula_render_mode_t render_mode);
+
+/**
+ * Mark the whole screen as changed (e.g. after loading a snapshot)
+ * @param ula ULA structure
+ */
+void ula_mark_all_dirty(ula_t *ula);
+
+/**
+ * Publish a completed frame (producer side, e.g. the CPU thread at INT)
+ * Copies the screen and the current border colour into the producer's slot
+ * and swaps it in as the newest frame with one atomic exchange; a frame the
+ * consumer has not taken yet is simply replaced. Never blocks.
+ * @param ula ULA structure
+ * @param screen Screen memory to copy (SPECTRUM_RAM_SIZE bytes)
+ * @param frame Frame number
+ */
+void ula_publish_frame(ula_t *ula, const uint8_t *screen, uint64_t frame);
+
+/**
+ * Take the newest published frame (consumer side, e.g. the render thread)
+ * The frame stays valid, and unchanged, until the next successful call.
+ * @param ula ULA structure
+ * @return Newest frame, or NULL if nothing was published since the last call
+ */
+const ula_frame_t *ula_take_frame(ula_t *ula);
+
+/**
+ * Convert a published frame to the matrix
+ * Cells are reconverted where the frame differs from the previously
+ * converted one; the whole screen is converted on the first call, after
+ * ula_mark_all_dirty() and when render_mode changes. Blink needs no
+ * revisit: it is applied when the matrix is written to the terminal. The
+ * frame's border colour is the one rendered, so every terminal frame shows
+ * one emulated frame.
+ * @param ula ULA structure whose matrix is written
+ * @param frame Frame from ula_take_frame()
+ * @param render_mode Rendering mode to use
+ */
+void convert_frame_to_matrix(ula_t *ula, const ula_frame_t *frame, ula_render_mode_t render_mode);
 
 /**
  * ULA thread function
@@ -118,9 +187,16 @@ void ula_free_matrix(char **matrix);
 
 /**
  * Render the matrix to terminal at 50Hz
- * Moves cursor to top-left, renders all lines, handles frame timing
+ * Emits only the cells that changed since the previous frame, handles frame timing
+ * @param ula ULA structure to show
+ */
+void ula_render_to_terminal(ula_t *ula);
+
+/**
+ * Force the next ula_render_to_terminal() call to repaint the whole screen
+ * Call after other output has overwritten part of the display.
  */
-void ula_render_to_terminal(void);
+void ula_request_redraw(void);
 
 /**
  * Render loop function - continuously renders at 50Hz
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
@@ -22,6 +23,22 @@
 
 #define GET_BIT(n, val) (((val) >> (n)) & 1)
 
+// Opcode dispatch: with Z80_FAST_DISPATCH (make FAST_DISPATCH=1) on GCC/Clang,
+// each opcode case also gets a label and the dispatchers jump through a
+// 256-entry labels-as-values table. The switch is the portable fallback.
+#if defined(Z80_FAST_DISPATCH) && defined(__GNUC__)
+#define Z80_COMPUTED_GOTO 1
+#define OP(n) \
+    case n:   \
+    op_##n
+#define OP_DEFAULT \
+    default:       \
+    op_default
+#else
+#define OP(n) case n
+#define OP_DEFAULT default
+#endif
+
 static const uint8_t cyc_00[256] = {4, 10, 7, 6, 4, 4, 7, 4, 4, 11, 7, 6, 4, 4,
                                     7, 4, 8, 10, 7, 6, 4, 4, 7, 4, 12, 11, 7, 6, 4, 4, 7, 4, 7, 10, 16, 6, 4, 4,
                                     7, 4, 7, 11, 16, 6, 4, 4, 7, 4, 7, 10, 13, 6, 11, 11, 10, 4, 7, 11, 13, 6,
@@ -66,6 +83,36 @@ static int exec_opcode_cb(z80_emulator_t *const z, uint8_t opcode);
 static int exec_opcode_dcb(z80_emulator_t *const z, const uint8_t opcode, const uint16_t addr);
 static int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode);
 static int exec_opcode_ddfd(z80_emulator_t *const z, uint8_t opcode, uint16_t *const iz);
+static void watch_fire(z80_emulator_t *const z, int kind, uint16_t addr);
+
+// One predecoded instruction of a block. The handler returns non-zero when
+// it left the straight line (taken branch, or an instruction it handed to
+// the interpreter), ending the block.
+typedef struct z80_block_op_s z80_block_op_t;
+typedef int (*z80_block_fn_t)(z80_emulator_t *const z, const z80_block_op_t *op);
+
+struct z80_block_op_s
+{
+    z80_block_fn_t fn;
+    uint16_t nn;        // Immediate operand, address or branch target
+    uint8_t dst, dst_lo; // Destination register (offsets into z80_registers_t)
+    uint8_t src, src_lo; // Source register
+    uint8_t length;     // Instruction bytes
+    uint8_t cycles;     // Base T-states (cyc_00)
+    uint8_t opcode;
+    uint8_t cc;         // Condition code of conditional branches
+};
+
+struct z80_block_s
+{
+    uint16_t pc;          // Address of the first instruction
+    uint8_t count;        // Instructions (0 = empty slot)
+    uint8_t loop_ops;     // Instructions up to a branch back to pc (0 = none)
+    uint8_t pages[2];     // First and last page holding the block's bytes
+    uint32_t *gens[2];    // Their write generation counters when decoded
+    uint32_t gen[2];      // and the counts
+    z80_block_op_t ops[Z80_BLOCK_MAX_OPS];
+};
 
 /**
  * Internal I/O read with callback support
@@ -73,13 +120,12 @@ static int exec_opcode_ddfd(z80_emulator_t *const z, uint8_t opcode, uint16_t *c
  */
 static uint8_t z80_read_io_internal(z80_emulator_t *z80, uint16_t port)
 {
-    uint8_t port_low = port & 0xFF; // Use low byte for port callback lookup
-
-    // Check for port-specific callback first
-    if (z80->port_callbacks[port_low].read_fn)
+    // Check for a mapped device first
+    uint8_t device = z80->port_in_map[port];
+    if (device)
     {
         // Pass the full user_data context, not just io_data
-        return z80->port_callbacks[port_low].read_fn(z80->user_data, port);
+        return z80->port_in_devices[device](z80->user_data, port);
     }
 
     // Fall back to generic I/O callback
@@ -102,13 +148,17 @@ static uint8_t z80_read_io_internal(z80_emulator_t *z80, uint16_t port)
  */
 static void z80_write_io_internal(z80_emulator_t *z80, uint16_t port, uint8_t value)
 {
-    uint8_t port_low = port & 0xFF; // Use low byte for port callback lookup
-
-    // Check for port-specific callback first
-    if (z80->port_callbacks[port_low].write_fn)
+    // Check for mapped devices first: every one decoding the port sees the
+    // write, in mapping order
+    uint16_t devices = z80->port_out_map[port];
+    if (devices)
     {
-        // Pass the full user_data context, not just io_data
-        z80->port_callbacks[port_low].write_fn(z80->user_data, port, value);
+        while (devices)
+        {
+            // Pass the full user_data context, not just io_data
+            z80->port_out_devices[__builtin_ctz(devices)](z80->user_data, port, value);
+            devices &= devices - 1;
+        }
         return;
     }
 
@@ -125,26 +175,64 @@ static void z80_write_io_internal(z80_emulator_t *z80, uint16_t port, uint8_t va
     }
 }
 
-static inline uint8_t rb(z80_emulator_t *const z, uint16_t addr)
+// reads from a page outside the fast path: watched or callback-backed
+static uint8_t rb_slow(z80_emulator_t *const z, uint16_t addr)
 {
+    if (z->watch_map[addr] & Z80_WATCH_READ)
+        watch_fire(z, Z80_WATCH_READ, addr);
+
+    const uint8_t *page = z->mapped_read[addr >> Z80_PAGE_SHIFT];
+    if (page)
+        return page[addr & Z80_PAGE_MASK];
     return z->read_memory(z->user_data, addr);
 }
 
-static inline void wb(z80_emulator_t *const z, uint16_t addr, uint8_t val)
+// writes to a page outside the fast path: watched, watch-mapped or callback-backed
+static void wb_slow(z80_emulator_t *const z, uint16_t addr, uint8_t val)
 {
+    if (z->watch_map[addr] & Z80_WATCH_WRITE)
+        watch_fire(z, Z80_WATCH_WRITE, addr);
+
+    uint8_t *page = z->mapped_write[addr >> Z80_PAGE_SHIFT];
+    if (page)
+    {
+        page[addr & Z80_PAGE_MASK] = val;
+        return;
+    }
     z->write_memory(z->user_data, addr, val);
 }
 
+static inline uint8_t rb(z80_emulator_t *const z, uint16_t addr)
+{
+    const uint8_t *page = z->read_pages[addr >> Z80_PAGE_SHIFT];
+    if (page)
+        return page[addr & Z80_PAGE_MASK];
+    return rb_slow(z, addr);
+}
+
+static inline void wb(z80_emulator_t *const z, uint16_t addr, uint8_t val)
+{
+    // Predecoded blocks covering this page are stale from now on
+    (*z->page_gen[addr >> Z80_PAGE_SHIFT])++;
+
+    uint8_t *page = z->write_pages[addr >> Z80_PAGE_SHIFT];
+    if (page)
+    {
+        page[addr & Z80_PAGE_MASK] = val;
+        return;
+    }
+    wb_slow(z, addr, val);
+}
+
 static inline uint16_t rw(z80_emulator_t *const z, uint16_t addr)
 {
-    return (z->read_memory(z->user_data, addr + 1) << 8) |
-           z->read_memory(z->user_data, addr);
+    return (rb(z, addr + 1) << 8) | rb(z, addr);
 }
 
 static inline void ww(z80_emulator_t *const z, uint16_t addr, uint16_t val)
 {
-    z->write_memory(z->user_data, addr, val & 0xFF);
-    z->write_memory(z->user_data, addr + 1, val >> 8);
+    wb(z, addr, val & 0xFF);
+    wb(z, addr + 1, val >> 8);
 }
 
 static inline void pushw(z80_emulator_t *const z, uint16_t val)
@@ -203,57 +291,146 @@ static inline void set_hl(z80_emulator_t *const z, uint16_t val)
     z->regs.l = val & 0xFF;
 }
 
-inline uint8_t get_f(z80_emulator_t *const z)
+// MARK: flags
+// Flags are evaluated lazily. The 8-bit arithmetic helpers only record the
+// operation, its operands and its 9-bit result in regs.flag_*; the F byte is
+// rebuilt from them (and cached in regs.f) the first time something reads it.
+enum
 {
-    uint8_t val = 0;
-    val |= z->regs.cf << 0;
-    val |= z->regs.nf << 1;
-    val |= z->regs.pf << 2;
-    val |= z->regs.xf << 3;
-    val |= z->regs.hf << 4;
-    val |= z->regs.yf << 5;
-    val |= z->regs.zf << 6;
-    val |= z->regs.sf << 7;
-    return val;
+    LAZY_NONE = 0, // regs.f is up to date
+    LAZY_ADD,      // ADD/ADC: flag_res = a + b + carry
+    LAZY_SUB,      // SUB/SBC: flag_res = a - b - carry
+    LAZY_CP,       // CP: like SUB, but X/Y come from the operand
+    LAZY_INC,      // INC: flag_b holds the preserved carry
+    LAZY_DEC       // DEC: flag_b holds the preserved carry
+};
+
+#define Z80_FLAGS_XY (Z80_FLAG_X | Z80_FLAG_Y)
+#define Z80_FLAGS_SZP (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)
+
+static uint8_t sz53_table[256];  // S, Z, Y and X flags of a byte result
+static uint8_t sz53p_table[256]; // as sz53_table, plus P for even parity
+static pthread_once_t flag_tables_once = PTHREAD_ONCE_INIT;
+
+static void init_flag_tables(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t bits = 0;
+        for (int b = 0; b < 8; b++)
+            bits += (i >> b) & 1;
+
+        sz53_table[i] = (i & (Z80_FLAG_S | Z80_FLAGS_XY)) | (i == 0 ? Z80_FLAG_Z : 0);
+        sz53p_table[i] = sz53_table[i] | ((bits & 1) == 0 ? Z80_FLAG_PV : 0);
+    }
 }
 
-inline void set_f(z80_emulator_t *const z, uint8_t val)
+// folds the pending lazy operation into regs.f
+static uint8_t eval_flags(z80_emulator_t *const z)
+{
+    const uint8_t a = z->regs.flag_a;
+    const uint8_t b = z->regs.flag_b;
+    const uint16_t res = z->regs.flag_res;
+    const uint8_t r = res & 0xFF;
+    uint8_t f = 0;
+
+    switch (z->regs.flag_op)
+    {
+    case LAZY_ADD:
+        f = sz53_table[r] | ((res >> 8) & Z80_FLAG_C) | ((a ^ b ^ r) & Z80_FLAG_H);
+        if ((a ^ r) & (b ^ r) & 0x80)
+            f |= Z80_FLAG_PV;
+        break;
+
+    case LAZY_SUB:
+    case LAZY_CP:
+        f = sz53_table[r] | Z80_FLAG_N | ((res >> 8) & Z80_FLAG_C) | ((a ^ b ^ r) & Z80_FLAG_H);
+        if ((a ^ b) & (a ^ r) & 0x80)
+            f |= Z80_FLAG_PV;
+        if (z->regs.flag_op == LAZY_CP)
+            f = (f & ~Z80_FLAGS_XY) | (b & Z80_FLAGS_XY);
+        break;
+
+    case LAZY_INC:
+        f = sz53_table[r] | (b & Z80_FLAG_C);
+        if ((r & 0x0F) == 0x00)
+            f |= Z80_FLAG_H;
+        if (r == 0x80)
+            f |= Z80_FLAG_PV;
+        break;
+
+    case LAZY_DEC:
+        f = sz53_table[r] | Z80_FLAG_N | (b & Z80_FLAG_C);
+        if ((r & 0x0F) == 0x0F)
+            f |= Z80_FLAG_H;
+        if (r == 0x7F)
+            f |= Z80_FLAG_PV;
+        break;
+
+    default:
+        f = z->regs.f;
+        break;
+    }
+
+    z->regs.f = f;
+    z->regs.flag_op = LAZY_NONE;
+    return f;
+}
+
+// returns the F register, evaluating pending lazy flags
+static inline uint8_t flags(z80_emulator_t *const z)
 {
-    z->regs.cf = (val >> 0) & 1;
-    z->regs.nf = (val >> 1) & 1;
-    z->regs.pf = (val >> 2) & 1;
-    z->regs.xf = (val >> 3) & 1;
-    z->regs.hf = (val >> 4) & 1;
-    z->regs.yf = (val >> 5) & 1;
-    z->regs.zf = (val >> 6) & 1;
-    z->regs.sf = (val >> 7) & 1;
+    return z->regs.flag_op == LAZY_NONE ? z->regs.f : eval_flags(z);
 }
 
-// increments R, keeping the highest byte intact
-static inline void inc_r(z80_emulator_t *const z)
+static inline void set_flags(z80_emulator_t *const z, uint8_t val)
 {
-    z->regs.r = (z->regs.r & 0x80) | ((z->regs.r + 1) & 0x7f);
+    z->regs.f = val;
+    z->regs.flag_op = LAZY_NONE;
 }
 
-// returns if there was a carry between bit "bit_no" and "bit_no - 1" when
-// executing "a + b + cy"
-static inline bool carry(int bit_no, uint16_t a, uint16_t b, bool cy)
+// zero and carry are read by most conditional instructions and can be
+// answered without evaluating the whole F register
+static inline bool flag_z(z80_emulator_t *const z)
 {
-    int32_t result = a + b + cy;
-    int32_t carry = result ^ a ^ b;
-    return carry & (1 << bit_no);
+    if (z->regs.flag_op == LAZY_NONE)
+        return z->regs.f & Z80_FLAG_Z;
+    return (z->regs.flag_res & 0xFF) == 0;
 }
 
-// returns the parity of byte: 0 if number of 1 bits in `val` is odd, else 1
-static inline bool parity(uint8_t val)
+static inline bool flag_c(z80_emulator_t *const z)
 {
-    uint8_t nb_one_bits = 0;
-    for (int i = 0; i < 8; i++)
+    switch (z->regs.flag_op)
     {
-        nb_one_bits += ((val >> i) & 1);
+    case LAZY_NONE:
+        return z->regs.f & Z80_FLAG_C;
+    case LAZY_INC:
+    case LAZY_DEC:
+        return z->regs.flag_b & Z80_FLAG_C;
+    default:
+        return (z->regs.flag_res >> 8) & 1;
     }
+}
+
+static inline bool flag(z80_emulator_t *const z, uint8_t mask)
+{
+    return flags(z) & mask;
+}
+
+inline uint8_t get_f(z80_emulator_t *const z)
+{
+    return flags(z);
+}
+
+inline void set_f(z80_emulator_t *const z, uint8_t val)
+{
+    set_flags(z, val);
+}
 
-    return (nb_one_bits & 1) == 0;
+// increments R, keeping the highest byte intact
+static inline void inc_r(z80_emulator_t *const z)
+{
+    z->regs.r = (z->regs.r & 0x80) | ((z->regs.r + 1) & 0x7f);
 }
 
 // function to call when an NMI is to be serviced
@@ -337,48 +514,33 @@ static inline void cond_jr(z80_emulator_t *const z, bool condition)
 // ADD Byte: adds two bytes together
 static inline uint8_t addb(z80_emulator_t *const z, uint8_t a, uint8_t b, bool cy)
 {
-    const uint8_t result = a + b + cy;
-    z->regs.sf = result >> 7;
-    z->regs.zf = result == 0;
-    z->regs.hf = carry(4, a, b, cy);
-    z->regs.pf = carry(7, a, b, cy) != carry(8, a, b, cy);
-    z->regs.cf = carry(8, a, b, cy);
-    z->regs.nf = 0;
-    z->regs.xf = GET_BIT(3, result);
-    z->regs.yf = GET_BIT(5, result);
-    return result;
+    const uint16_t result = a + b + cy;
+    z->regs.flag_op = LAZY_ADD;
+    z->regs.flag_a = a;
+    z->regs.flag_b = b;
+    z->regs.flag_res = result;
+    return result & 0xFF;
 }
 
 // SUBstract Byte: substracts two bytes (with optional carry)
 static inline uint8_t subb(z80_emulator_t *const z, uint8_t a, uint8_t b, bool cy)
 {
-    uint8_t val = addb(z, a, ~b, !cy);
-    z->regs.cf = !z->regs.cf;
-    z->regs.hf = !z->regs.hf;
-    z->regs.nf = 1;
-    return val;
+    const uint16_t result = a - b - cy;
+    z->regs.flag_op = LAZY_SUB;
+    z->regs.flag_a = a;
+    z->regs.flag_b = b;
+    z->regs.flag_res = result;
+    return result & 0xFF;
 }
 
-// ADD Word: adds two words together
+// ADD Word: adds two words together, setting H, N, C, X and Y
 static inline uint16_t addw(z80_emulator_t *const z, uint16_t a, uint16_t b, bool cy)
 {
-    uint8_t lsb = addb(z, a, b, cy);
-    uint8_t msb = addb(z, a >> 8, b >> 8, z->regs.cf);
-
-    uint16_t result = (msb << 8) | lsb;
-    z->regs.zf = result == 0;
-    z->regs.mem_ptr = a + 1;
-    return result;
-}
-
-// SUBstract Word: substracts two words (with optional carry)
-static inline uint16_t subw(z80_emulator_t *const z, uint16_t a, uint16_t b, bool cy)
-{
-    uint8_t lsb = subb(z, a, b, cy);
-    uint8_t msb = subb(z, a >> 8, b >> 8, z->regs.cf);
-
-    uint16_t result = (msb << 8) | lsb;
-    z->regs.zf = result == 0;
+    const uint32_t result = a + b + cy;
+    uint8_t f = flags(z) & Z80_FLAGS_SZP;
+    f |= ((result >> 16) & Z80_FLAG_C) | (((a ^ b ^ result) >> 8) & Z80_FLAG_H);
+    f |= (result >> 8) & Z80_FLAGS_XY;
+    set_flags(z, f);
     z->regs.mem_ptr = a + 1;
     return result;
 }
@@ -386,62 +548,66 @@ static inline uint16_t subw(z80_emulator_t *const z, uint16_t a, uint16_t b, boo
 // adds a word to HL
 static inline void addhl(z80_emulator_t *const z, uint16_t val)
 {
-    bool sf = z->regs.sf;
-    bool zf = z->regs.zf;
-    bool pf = z->regs.pf;
-    uint16_t result = addw(z, get_hl(z), val, 0);
-    set_hl(z, result);
-    z->regs.sf = sf;
-    z->regs.zf = zf;
-    z->regs.pf = pf;
+    set_hl(z, addw(z, get_hl(z), val, 0));
 }
 
 // adds a word to IX or IY
 static inline void addiz(z80_emulator_t *const z, uint16_t *reg, uint16_t val)
 {
-    bool sf = z->regs.sf;
-    bool zf = z->regs.zf;
-    bool pf = z->regs.pf;
-    uint16_t result = addw(z, *reg, val, 0);
-    *reg = result;
-    z->regs.sf = sf;
-    z->regs.zf = zf;
-    z->regs.pf = pf;
+    *reg = addw(z, *reg, val, 0);
 }
 
 // adds a word (+ carry) to HL
 static inline void adchl(z80_emulator_t *const z, uint16_t val)
 {
-    uint16_t result = addw(z, get_hl(z), val, z->regs.cf);
-    z->regs.sf = result >> 15;
-    z->regs.zf = result == 0;
+    const uint16_t hl = get_hl(z);
+    const uint16_t result = addw(z, hl, val, flag_c(z));
+    uint8_t f = z->regs.f & ~Z80_FLAGS_SZP;
+    f |= (result >> 8) & Z80_FLAG_S;
+    if (result == 0)
+        f |= Z80_FLAG_Z;
+    if ((hl ^ result) & (val ^ result) & 0x8000)
+        f |= Z80_FLAG_PV;
+    set_flags(z, f);
     set_hl(z, result);
 }
 
 // substracts a word (+ carry) to HL
 static inline void sbchl(z80_emulator_t *const z, uint16_t val)
 {
-    const uint16_t result = subw(z, get_hl(z), val, z->regs.cf);
-    z->regs.sf = result >> 15;
-    z->regs.zf = result == 0;
-    set_hl(z, result);
+    const uint16_t hl = get_hl(z);
+    const uint32_t result = hl - val - flag_c(z);
+    const uint16_t result16 = result & 0xFFFF;
+    uint8_t f = Z80_FLAG_N | ((result >> 16) & Z80_FLAG_C) | (((hl ^ val ^ result) >> 8) & Z80_FLAG_H);
+    f |= (result16 >> 8) & (Z80_FLAG_S | Z80_FLAGS_XY);
+    if (result16 == 0)
+        f |= Z80_FLAG_Z;
+    if ((hl ^ val) & (hl ^ result16) & 0x8000)
+        f |= Z80_FLAG_PV;
+    set_flags(z, f);
+    z->regs.mem_ptr = hl + 1;
+    set_hl(z, result16);
 }
 
 // increments a byte value
 static inline uint8_t inc(z80_emulator_t *const z, uint8_t a)
 {
-    bool cf = z->regs.cf;
-    uint8_t result = addb(z, a, 1, 0);
-    z->regs.cf = cf;
+    const uint8_t result = a + 1;
+    z->regs.flag_b = flag_c(z);
+    z->regs.flag_op = LAZY_INC;
+    z->regs.flag_a = a;
+    z->regs.flag_res = result;
     return result;
 }
 
 // decrements a byte value
 static inline uint8_t dec(z80_emulator_t *const z, uint8_t a)
 {
-    bool cf = z->regs.cf;
-    uint8_t result = subb(z, a, 1, 0);
-    z->regs.cf = cf;
+    const uint8_t result = a - 1;
+    z->regs.flag_b = flag_c(z);
+    z->regs.flag_op = LAZY_DEC;
+    z->regs.flag_a = a;
+    z->regs.flag_res = result;
     return result;
 }
 
@@ -451,48 +617,24 @@ static inline uint8_t dec(z80_emulator_t *const z, uint8_t a)
 // result in register A
 static inline void land(z80_emulator_t *const z, uint8_t val)
 {
-    const uint8_t result = z->regs.a & val;
-    z->regs.sf = result >> 7;
-    z->regs.zf = result == 0;
-    z->regs.hf = 1;
-    z->regs.pf = parity(result);
-    z->regs.nf = 0;
-    z->regs.cf = 0;
-    z->regs.xf = GET_BIT(3, result);
-    z->regs.yf = GET_BIT(5, result);
-    z->regs.a = result;
+    z->regs.a &= val;
+    set_flags(z, sz53p_table[z->regs.a] | Z80_FLAG_H);
 }
 
 // executes a logic "xor" between register A and a byte, then stores the
 // result in register A
 static inline void lxor(z80_emulator_t *const z, const uint8_t val)
 {
-    const uint8_t result = z->regs.a ^ val;
-    z->regs.sf = result >> 7;
-    z->regs.zf = result == 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(result);
-    z->regs.nf = 0;
-    z->regs.cf = 0;
-    z->regs.xf = GET_BIT(3, result);
-    z->regs.yf = GET_BIT(5, result);
-    z->regs.a = result;
+    z->regs.a ^= val;
+    set_flags(z, sz53p_table[z->regs.a]);
 }
 
 // executes a logic "or" between register A and a byte, then stores the
 // result in register A
 static inline void lor(z80_emulator_t *const z, const uint8_t val)
 {
-    const uint8_t result = z->regs.a | val;
-    z->regs.sf = result >> 7;
-    z->regs.zf = result == 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(result);
-    z->regs.nf = 0;
-    z->regs.cf = 0;
-    z->regs.xf = GET_BIT(3, result);
-    z->regs.yf = GET_BIT(5, result);
-    z->regs.a = result;
+    z->regs.a |= val;
+    set_flags(z, sz53p_table[z->regs.a]);
 }
 
 // compares a value with register A
@@ -503,8 +645,7 @@ static inline void cp(z80_emulator_t *const z, const uint8_t val)
     // the only difference between cp and sub is that
     // the xf/yf are taken from the value to be substracted,
     // not the result
-    z->regs.yf = GET_BIT(5, val);
-    z->regs.xf = GET_BIT(3, val);
+    z->regs.flag_op = LAZY_CP;
 }
 
 // 0xCB opcodes
@@ -513,14 +654,7 @@ static inline uint8_t cb_rlc(z80_emulator_t *const z, uint8_t val)
 {
     const bool old = val >> 7;
     val = (val << 1) | old;
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.pf = parity(val);
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.cf = old;
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
@@ -529,107 +663,64 @@ static inline uint8_t cb_rrc(z80_emulator_t *const z, uint8_t val)
 {
     const bool old = val & 1;
     val = (val >> 1) | (old << 7);
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.cf = old;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // rotate left (simple)
 static inline uint8_t cb_rl(z80_emulator_t *const z, uint8_t val)
 {
-    const bool cf = z->regs.cf;
-    z->regs.cf = val >> 7;
+    const bool cf = flag_c(z);
+    const bool old = val >> 7;
     val = (val << 1) | cf;
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // rotate right (simple)
 static inline uint8_t cb_rr(z80_emulator_t *const z, uint8_t val)
 {
-    const bool c = z->regs.cf;
-    z->regs.cf = val & 1;
+    const bool c = flag_c(z);
+    const bool old = val & 1;
     val = (val >> 1) | (c << 7);
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // shift left preserving sign
 static inline uint8_t cb_sla(z80_emulator_t *const z, uint8_t val)
 {
-    z->regs.cf = val >> 7;
+    const bool old = val >> 7;
     val <<= 1;
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // SLL (exactly like SLA, but sets the first bit to 1)
 static inline uint8_t cb_sll(z80_emulator_t *const z, uint8_t val)
 {
-    z->regs.cf = val >> 7;
+    const bool old = val >> 7;
     val <<= 1;
     val |= 1;
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // shift right preserving sign
 static inline uint8_t cb_sra(z80_emulator_t *const z, uint8_t val)
 {
-    z->regs.cf = val & 1;
+    const bool old = val & 1;
     val = (val >> 1) | (val & 0x80); // 0b10000000
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
 // shift register right
 static inline uint8_t cb_srl(z80_emulator_t *const z, uint8_t val)
 {
-    z->regs.cf = val & 1;
+    const bool old = val & 1;
     val >>= 1;
-    z->regs.sf = val >> 7;
-    z->regs.zf = val == 0;
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = parity(val);
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.yf = GET_BIT(5, val);
+    set_flags(z, sz53p_table[val] | old);
     return val;
 }
 
@@ -637,16 +728,19 @@ static inline uint8_t cb_srl(z80_emulator_t *const z, uint8_t val)
 static inline uint8_t cb_bit(z80_emulator_t *const z, uint8_t val, uint8_t n)
 {
     const uint8_t result = val & (1 << n);
-    z->regs.sf = result >> 7;
-    z->regs.zf = result == 0;
-    z->regs.yf = GET_BIT(5, val);
-    z->regs.hf = 1;
-    z->regs.xf = GET_BIT(3, val);
-    z->regs.pf = z->regs.zf;
-    z->regs.nf = 0;
+    uint8_t f = (flags(z) & Z80_FLAG_C) | Z80_FLAG_H | (result & Z80_FLAG_S) | (val & Z80_FLAGS_XY);
+    if (result == 0)
+        f |= Z80_FLAG_Z | Z80_FLAG_PV;
+    set_flags(z, f);
     return result;
 }
 
+// replaces the undocumented X/Y flags (used by BIT n,(HL) and BIT n,(IZ+d))
+static inline void set_flags_xy(z80_emulator_t *const z, uint8_t val)
+{
+    set_flags(z, (flags(z) & ~Z80_FLAGS_XY) | (val & Z80_FLAGS_XY));
+}
+
 static inline void ldi(z80_emulator_t *const z)
 {
     const uint16_t de = get_de(z);
@@ -662,12 +756,11 @@ static inline void ldi(z80_emulator_t *const z)
     // see https://wikiti.brandonw.net/index.php?title=Z80_Instruction_Set
     // for the calculation of xf/yf on LDI
     const uint8_t result = val + z->regs.a;
-    z->regs.xf = GET_BIT(3, result);
-    z->regs.yf = GET_BIT(1, result);
-
-    z->regs.nf = 0;
-    z->regs.hf = 0;
-    z->regs.pf = get_bc(z) > 0;
+    uint8_t f = flags(z) & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_C);
+    f |= (result & Z80_FLAG_X) | ((result << 4) & Z80_FLAG_Y);
+    if (get_bc(z) > 0)
+        f |= Z80_FLAG_PV;
+    set_flags(z, f);
 }
 
 static inline void ldd(z80_emulator_t *const z)
@@ -680,14 +773,19 @@ static inline void ldd(z80_emulator_t *const z)
 
 static inline void cpi(z80_emulator_t *const z)
 {
-    bool cf = z->regs.cf;
-    const uint8_t result = subb(z, z->regs.a, rb(z, get_hl(z)), 0);
+    const uint8_t cf = flags(z) & Z80_FLAG_C;
+    const uint8_t val = rb(z, get_hl(z));
+    const uint8_t result = z->regs.a - val;
+    const uint8_t hf = (z->regs.a ^ val ^ result) & Z80_FLAG_H;
+    const uint8_t n = result - (hf >> 4);
     set_hl(z, get_hl(z) + 1);
     set_bc(z, get_bc(z) - 1);
-    z->regs.xf = GET_BIT(3, result - z->regs.hf);
-    z->regs.yf = GET_BIT(1, result - z->regs.hf);
-    z->regs.pf = get_bc(z) != 0;
-    z->regs.cf = cf;
+
+    uint8_t f = cf | hf | Z80_FLAG_N | (sz53_table[result] & (Z80_FLAG_S | Z80_FLAG_Z));
+    f |= (n & Z80_FLAG_X) | ((n << 4) & Z80_FLAG_Y);
+    if (get_bc(z) != 0)
+        f |= Z80_FLAG_PV;
+    set_flags(z, f);
     z->regs.mem_ptr += 1;
 }
 
@@ -704,11 +802,17 @@ static void in_r_c(z80_emulator_t *const z, uint8_t *r)
     // Full 16-bit port address: high byte = B, low byte = C
     uint16_t port = ((uint16_t)z->regs.b << 8) | z->regs.c;
     *r = z80_read_io_internal(z, port);
-    z->regs.zf = *r == 0;
-    z->regs.sf = *r >> 7;
-    z->regs.pf = parity(*r);
-    z->regs.nf = 0;
-    z->regs.hf = 0;
+    set_flags(z, (flags(z) & (Z80_FLAG_C | Z80_FLAGS_XY)) |
+                     (sz53p_table[*r] & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)));
+}
+
+// sets Z from B and N after a block I/O step, preserving the other flags
+static inline void set_flags_block_io(z80_emulator_t *const z)
+{
+    uint8_t f = (flags(z) & ~Z80_FLAG_Z) | Z80_FLAG_N;
+    if (z->regs.b == 0)
+        f |= Z80_FLAG_Z;
+    set_flags(z, f);
 }
 
 static void ini(z80_emulator_t *const z)
@@ -719,8 +823,7 @@ static void ini(z80_emulator_t *const z)
     wb(z, get_hl(z), val);
     set_hl(z, get_hl(z) + 1);
     z->regs.b -= 1;
-    z->regs.zf = z->regs.b == 0;
-    z->regs.nf = 1;
+    set_flags_block_io(z);
     z->regs.mem_ptr = get_bc(z) + 1;
 }
 
@@ -738,8 +841,7 @@ static void outi(z80_emulator_t *const z)
     z80_write_io_internal(z, port, rb(z, get_hl(z)));
     set_hl(z, get_hl(z) + 1);
     z->regs.b -= 1;
-    z->regs.zf = z->regs.b == 0;
-    z->regs.nf = 1;
+    set_flags_block_io(z);
     z->regs.mem_ptr = get_bc(z) + 1;
 }
 
@@ -760,36 +862,35 @@ static void daa(z80_emulator_t *const z)
     // checked. If this more significant digit also happens to be greater
     // than 9 or the C flag is set, then $60 is added."
     // > http://z80-heaven.wikidot.com/instructions-set:daa
+    const uint8_t f = flags(z);
     uint8_t correction = 0;
+    uint8_t cf = f & Z80_FLAG_C;
+    bool hf = f & Z80_FLAG_H;
 
-    if ((z->regs.a & 0x0F) > 0x09 || z->regs.hf)
+    if ((z->regs.a & 0x0F) > 0x09 || hf)
     {
         correction += 0x06;
     }
 
-    if (z->regs.a > 0x99 || z->regs.cf)
+    if (z->regs.a > 0x99 || cf)
     {
         correction += 0x60;
-        z->regs.cf = 1;
+        cf = Z80_FLAG_C;
     }
 
-    const bool substraction = z->regs.nf;
+    const bool substraction = f & Z80_FLAG_N;
     if (substraction)
     {
-        z->regs.hf = z->regs.hf && (z->regs.a & 0x0F) < 0x06;
+        hf = hf && (z->regs.a & 0x0F) < 0x06;
         z->regs.a -= correction;
     }
     else
     {
-        z->regs.hf = (z->regs.a & 0x0F) > 0x09;
+        hf = (z->regs.a & 0x0F) > 0x09;
         z->regs.a += correction;
     }
 
-    z->regs.sf = z->regs.a >> 7;
-    z->regs.zf = z->regs.a == 0;
-    z->regs.pf = parity(z->regs.a);
-    z->regs.xf = GET_BIT(3, z->regs.a);
-    z->regs.yf = GET_BIT(5, z->regs.a);
+    set_flags(z, sz53p_table[z->regs.a] | cf | (hf ? Z80_FLAG_H : 0) | (f & Z80_FLAG_N));
 }
 
 static inline uint16_t displace(z80_emulator_t *const z, uint16_t base_addr, int8_t displacement)
@@ -846,227 +947,1447 @@ static inline void process_interrupts(z80_emulator_t *const z)
             call(z, 0x38);
             break;
 
-        case 2:
-            z->cyc += 19;
-            call(z, rw(z, (z->regs.i << 8) | z->int_data));
-            break;
+        case 2:
+            z->cyc += 19;
+            call(z, rw(z, (z->regs.i << 8) | z->int_data));
+            break;
+
+        default:
+            fprintf(stderr, "unsupported interrupt mode %d\n", z->regs.im);
+            break;
+        }
+
+        return;
+    }
+}
+
+/**
+ * Initialize Z80 emulator
+ * Returns pointer to emulator context
+ */
+z80_emulator_t *z80_init(void)
+{
+    z80_emulator_t *z80 = malloc(sizeof(z80_emulator_t));
+    if (!z80)
+        return NULL;
+
+    pthread_once(&flag_tables_once, init_flag_tables);
+
+    // Initialize registers
+    memset(&z80->regs, 0, sizeof(z80_registers_t));
+    z80->regs.pc = 0x0000;
+    z80->regs.sp = 0xFFFF;
+    z80->regs.im = 0;
+
+    z80->regs.a = 0xFF;
+    z80->regs.b = 0;
+    z80->regs.c = 0;
+    z80->regs.d = 0;
+    z80->regs.e = 0;
+    z80->regs.h = 0;
+    z80->regs.l = 0;
+
+    z80->regs.a_ = 0;
+    z80->regs.b_ = 0;
+    z80->regs.c_ = 0;
+    z80->regs.d_ = 0;
+    z80->regs.e_ = 0;
+    z80->regs.h_ = 0;
+    z80->regs.l_ = 0;
+    z80->regs.f_ = 0;
+    z80->regs.i = 0;
+    z80->regs.r = 0;
+
+    set_f(z80, 0xFF);
+
+    // Initialize state
+    z80->thread = 0; // No CPU thread until z80_start()
+    z80->running = 0;
+    z80->paused = 0;
+    z80->halted = 0;
+    z80->stepping = 0;
+    z80->int_pending = 0;
+    z80->nmi_pending = 0;
+    z80->int_data = 0;
+    z80->cyc = 0;
+
+    // Initialize synchronization primitives
+    pthread_mutex_init(&z80->state_lock, NULL);
+    pthread_cond_init(&z80->state_cond, NULL);
+
+    // Initialize callbacks to NULL
+    z80->read_io = NULL;
+    z80->write_io = NULL;
+    z80->read_memory = NULL;
+    z80->write_memory = NULL;
+    z80->user_data = NULL;
+
+    // No execution trap until z80_set_exec_trap() is called
+    z80->exec_trap = NULL;
+    z80->exec_trap_data = NULL;
+    z80->exec_trap_addr = 0;
+
+    // Not profiling until z80_set_profile() is called
+    z80->profile = NULL;
+
+    // Interpreter only until z80_set_block_engine() is called
+    z80->blocks = NULL;
+    memset(z80->gen_hosts, 0, sizeof(z80->gen_hosts));
+    memset(z80->gen_counts, 0, sizeof(z80->gen_counts));
+    memset(z80->gen_refs, 0, sizeof(z80->gen_refs));
+    z80->unmapped_gen = 0;
+    for (int page = 0; page < Z80_NUM_PAGES; page++)
+        z80->page_gen[page] = &z80->unmapped_gen;
+
+    // No directly mapped pages until z80_map_pages() is called
+    memset(z80->read_pages, 0, sizeof(z80->read_pages));
+    memset(z80->write_pages, 0, sizeof(z80->write_pages));
+    memset(z80->mapped_read, 0, sizeof(z80->mapped_read));
+    memset(z80->mapped_write, 0, sizeof(z80->mapped_write));
+
+    // No watchpoints until z80_add_watchpoint() is called
+    memset(z80->watchpoints, 0, sizeof(z80->watchpoints));
+    memset(z80->watch_map, 0, sizeof(z80->watch_map));
+    memset(z80->watch_pages, 0, sizeof(z80->watch_pages));
+    z80->watch_kinds = 0;
+    z80->break_hit = false;
+    z80->break_resume = false;
+    z80->break_pc = 0;
+
+    // No port devices until z80_map_port_in()/z80_map_port_out() (index 0 = none)
+    memset(z80->port_in_map, 0, sizeof(z80->port_in_map));
+    memset(z80->port_out_map, 0, sizeof(z80->port_out_map));
+    memset(z80->port_in_devices, 0, sizeof(z80->port_in_devices));
+    memset(z80->port_out_devices, 0, sizeof(z80->port_out_devices));
+    z80->port_in_device_count = 1;
+    z80->port_out_device_count = 1;
+
+    return z80;
+}
+
+/**
+ * Clean up Z80 emulator
+ * Note: Memory management is external; this only cleans up the emulator structure
+ */
+void z80_cleanup(z80_emulator_t *z80)
+{
+    if (!z80)
+        return;
+
+    z80->running = 0;
+
+    if (z80->thread)
+    {
+        pthread_join(z80->thread, NULL);
+    }
+
+    pthread_mutex_destroy(&z80->state_lock);
+    pthread_cond_destroy(&z80->state_cond);
+
+    free(z80->blocks);
+
+    // Free context if it exists
+    if (z80->user_data)
+    {
+        free(z80->user_data);
+    }
+
+    free(z80);
+}
+
+/**
+ * Set memory callbacks for pluggable RAM/ROM
+ */
+void z80_set_memory_callbacks(z80_emulator_t *z80,
+                              z80_read_memory_t read_memory,
+                              z80_write_memory_t write_memory,
+                              void *user_data)
+{
+    if (!z80)
+        return;
+
+    // If no context exists yet, create one
+    if (!z80->user_data)
+    {
+        z80_callback_context_t *ctx = malloc(sizeof(z80_callback_context_t));
+        if (!ctx)
+            return;
+        ctx->memory_data = user_data;
+        ctx->io_data = NULL;
+        z80->user_data = ctx;
+    }
+    else
+    {
+        // Update existing context
+        z80_callback_context_t *ctx = (z80_callback_context_t *)z80->user_data;
+        ctx->memory_data = user_data;
+    }
+
+    z80->read_memory = read_memory;
+    z80->write_memory = write_memory;
+}
+
+// points the fast-path page tables at a page's mapping, unless
+// watchpoints on the page need its reads or writes to take the slow path
+static void apply_page(z80_emulator_t *z80, int page)
+{
+    uint8_t watched = z80->watch_pages[page];
+
+    z80->read_pages[page] = (watched & Z80_WATCH_READ) ? NULL : z80->mapped_read[page];
+    z80->write_pages[page] = (watched & Z80_WATCH_WRITE) ? NULL : z80->mapped_write[page];
+}
+
+// points page at the write generation counter of host page (NULL = not
+// mapped), shared with any other page mapping it, and bumps that counter so
+// code decoded from the old mapping is not reused
+static void bind_page_gen(z80_emulator_t *z80, int page, const uint8_t *host)
+{
+    uint32_t *old = z80->page_gen[page];
+    if (old != &z80->unmapped_gen)
+        z80->gen_refs[old - z80->gen_counts]--;
+
+    uint32_t *gen = &z80->unmapped_gen;
+    if (host)
+    {
+        // Each page holds at most one reference, so a free counter is
+        // always left when the host page has none yet
+        int slot = -1;
+        for (int i = 0; i < Z80_NUM_PAGES; i++)
+        {
+            if (z80->gen_refs[i] && z80->gen_hosts[i] == host)
+            {
+                slot = i;
+                break;
+            }
+            if (slot < 0 && !z80->gen_refs[i])
+                slot = i;
+        }
+        z80->gen_hosts[slot] = host;
+        z80->gen_refs[slot]++;
+        gen = &z80->gen_counts[slot];
+    }
+
+    z80->page_gen[page] = gen;
+    (*gen)++;
+}
+
+/**
+ * Map host memory directly into the Z80 address space
+ */
+int z80_map_pages(z80_emulator_t *z80,
+                  uint16_t start,
+                  uint32_t length,
+                  uint8_t *host,
+                  z80_page_type_t type)
+{
+    if (!z80)
+        return -1;
+
+    if ((start & Z80_PAGE_MASK) || (length & Z80_PAGE_MASK) ||
+        start + length > Z80_MAX_MEMORY)
+    {
+        fprintf(stderr, "Error: Page mapping 0x%04X+0x%X is not page aligned\n", start, length);
+        return -1;
+    }
+
+    if (type != Z80_PAGE_TRAP && !host)
+        return -1;
+
+    for (uint32_t offset = 0; offset < length; offset += Z80_PAGE_SIZE)
+    {
+        int page = (start + offset) >> Z80_PAGE_SHIFT;
+
+        switch (type)
+        {
+        case Z80_PAGE_RAM:
+            z80->mapped_read[page] = host + offset;
+            z80->mapped_write[page] = host + offset;
+            break;
+
+        case Z80_PAGE_ROM:
+            z80->mapped_read[page] = host + offset;
+            z80->mapped_write[page] = z80->rom_sink;
+            break;
+
+        default:
+            z80->mapped_read[page] = NULL;
+            z80->mapped_write[page] = NULL;
+            break;
+        }
+        bind_page_gen(z80, page, z80->mapped_read[page]);
+        apply_page(z80, page);
+    }
+
+    return 0;
+}
+
+/**
+ * Point every port the decoding matches at a handler slot
+ */
+static void z80_port_map_fill(uint8_t *map, uint16_t mask, uint16_t match, uint8_t slot)
+{
+    for (uint32_t port = 0; port < Z80_IO_PORTS; port++)
+        if ((port & mask) == (match & mask))
+            map[port] = slot;
+}
+
+/**
+ * Add a handler slot to the OUT devices of every port the decoding matches
+ */
+static void z80_port_map_add(uint16_t *map, uint16_t mask, uint16_t match, uint8_t slot)
+{
+    for (uint32_t port = 0; port < Z80_IO_PORTS; port++)
+        if ((port & mask) == (match & mask))
+            map[port] |= (uint16_t)(1u << slot);
+}
+
+/**
+ * Map an IN device by partial address decoding
+ */
+int z80_map_port_in(z80_emulator_t *z80, uint16_t mask, uint16_t match, z80_read_io_t read_fn)
+{
+    if (!z80 || !read_fn)
+        return -1;
+
+    // Reuse the slot of a handler mapped before (slot 0 means no device)
+    uint8_t slot = 1;
+    while (slot < z80->port_in_device_count && z80->port_in_devices[slot] != read_fn)
+        slot++;
+    if (slot == z80->port_in_device_count)
+    {
+        if (slot >= Z80_MAX_PORT_DEVICES)
+            return -1;
+        z80->port_in_devices[slot] = read_fn;
+        z80->port_in_device_count++;
+    }
+
+    z80_port_map_fill(z80->port_in_map, mask, match, slot);
+    return 0;
+}
+
+/**
+ * Map an OUT device by partial address decoding
+ */
+int z80_map_port_out(z80_emulator_t *z80, uint16_t mask, uint16_t match, z80_write_io_t write_fn)
+{
+    if (!z80 || !write_fn)
+        return -1;
+
+    // Reuse the slot of a handler mapped before (slot 0 means no device)
+    uint8_t slot = 1;
+    while (slot < z80->port_out_device_count && z80->port_out_devices[slot] != write_fn)
+        slot++;
+    if (slot == z80->port_out_device_count)
+    {
+        if (slot >= Z80_MAX_PORT_DEVICES)
+            return -1;
+        z80->port_out_devices[slot] = write_fn;
+        z80->port_out_device_count++;
+    }
+
+    z80_port_map_add(z80->port_out_map, mask, match, slot);
+    return 0;
+}
+
+/**
+ * Register port-specific IN callback
+ */
+void z80_register_port_in(z80_emulator_t *z80,
+                          uint8_t port,
+                          z80_read_io_t read_fn)
+{
+    z80_map_port_in(z80, 0x00FF, port, read_fn);
+}
+
+/**
+ * Register port-specific OUT callback
+ */
+void z80_register_port_out(z80_emulator_t *z80,
+                           uint8_t port,
+                           z80_write_io_t write_fn)
+{
+    z80_map_port_out(z80, 0x00FF, port, write_fn);
+}
+
+/**
+ * Set I/O callback context data
+ */
+void z80_set_io_callbacks(z80_emulator_t *z80, void *io_data)
+{
+    if (!z80)
+        return;
+
+    // Create context if it doesn't exist
+    if (!z80->user_data)
+    {
+        z80_callback_context_t *ctx = malloc(sizeof(z80_callback_context_t));
+        if (!ctx)
+            return;
+        ctx->memory_data = NULL;
+        ctx->io_data = io_data;
+        z80->user_data = ctx;
+    }
+    else
+    {
+        // Update existing context
+        z80_callback_context_t *ctx = (z80_callback_context_t *)z80->user_data;
+        ctx->io_data = io_data;
+    }
+}
+
+/**
+ * Set or clear the execution trap
+ */
+void z80_set_exec_trap(z80_emulator_t *z80, uint16_t addr, z80_exec_trap_t callback, void *user_data)
+{
+    if (!z80)
+        return;
+
+    z80->exec_trap_addr = addr;
+    z80->exec_trap_data = user_data;
+    z80->exec_trap = callback;
+
+    // Blocks are cut at the trap address: redecode them around the new one
+    if (z80->blocks)
+        memset(z80->blocks, 0, sizeof(z80_block_t) * Z80_BLOCK_CACHE_SIZE);
+}
+
+// MARK: watchpoints
+// Each watchpoint ORs its kinds into watch_map for the addresses it covers
+// and into watch_pages for their pages. Read and write kinds drop the page
+// out of read_pages/write_pages, so rb()/wb() only look at watch_map on the
+// slow path; execute kinds are tested per instruction by the run loops
+// that honour them (page flag first, then the map), and cut predecoded
+// blocks so every watched instruction is interpreted.
+
+// value of a watchpoint condition register
+static uint16_t watch_reg(z80_emulator_t *const z, z80_watch_reg_t reg)
+{
+    switch (reg)
+    {
+    case Z80_WATCH_REG_A:
+        return z->regs.a;
+    case Z80_WATCH_REG_F:
+        return get_f(z);
+    case Z80_WATCH_REG_B:
+        return z->regs.b;
+    case Z80_WATCH_REG_C:
+        return z->regs.c;
+    case Z80_WATCH_REG_D:
+        return z->regs.d;
+    case Z80_WATCH_REG_E:
+        return z->regs.e;
+    case Z80_WATCH_REG_H:
+        return z->regs.h;
+    case Z80_WATCH_REG_L:
+        return z->regs.l;
+    case Z80_WATCH_REG_AF:
+        return (uint16_t)((z->regs.a << 8) | get_f(z));
+    case Z80_WATCH_REG_BC:
+        return get_bc(z);
+    case Z80_WATCH_REG_DE:
+        return get_de(z);
+    case Z80_WATCH_REG_HL:
+        return get_hl(z);
+    case Z80_WATCH_REG_IX:
+        return z->regs.ix;
+    case Z80_WATCH_REG_IY:
+        return z->regs.iy;
+    case Z80_WATCH_REG_SP:
+        return z->regs.sp;
+    default:
+        return 0;
+    }
+}
+
+// calls the watchpoints of kind covering addr whose condition holds;
+// sets break_hit if one of them asks to stop
+static void watch_fire(z80_emulator_t *const z, int kind, uint16_t addr)
+{
+    for (int id = 0; id < Z80_MAX_WATCHPOINTS; id++)
+    {
+        const z80_watchpoint_t *watch = &z->watchpoints[id];
+        if (!(watch->kinds & kind) || addr < watch->start || addr > watch->end)
+            continue;
+        if (watch->reg != Z80_WATCH_ALWAYS && watch_reg(z, watch->reg) != watch->value)
+            continue;
+        if (watch->fn(watch->user_data, id, kind, addr))
+            z->break_hit = true;
+    }
+}
+
+// whether an execute watchpoint covers addr
+static inline bool watch_exec_at(const z80_emulator_t *const z, uint16_t addr)
+{
+    return (z->watch_pages[addr >> Z80_PAGE_SHIFT] & Z80_WATCH_EXEC) && (z->watch_map[addr] & Z80_WATCH_EXEC);
+}
+
+// starts a run: clears the last stop and returns whether it was before an
+// instruction that must now execute without firing again
+static inline bool watch_resume(z80_emulator_t *const z)
+{
+    bool resume = z->break_resume;
+    z->break_hit = false;
+    z->break_resume = false;
+    return resume;
+}
+
+// fires the execute watchpoints of the instruction at PC; returns true if
+// one stopped the CPU before it
+static inline bool watch_exec(z80_emulator_t *const z, bool resume)
+{
+    uint16_t pc = z->regs.pc;
+
+    if (z->halted || !watch_exec_at(z, pc) || (resume && pc == z->break_pc))
+        return false;
+
+    watch_fire(z, Z80_WATCH_EXEC, pc);
+    if (!z->break_hit)
+        return false;
+    z->break_pc = pc;
+    z->break_resume = true;
+    return true;
+}
+
+// recomputes the watch map and page flags from the watchpoints
+static void watch_rebuild(z80_emulator_t *z80)
+{
+    memset(z80->watch_map, 0, sizeof(z80->watch_map));
+    memset(z80->watch_pages, 0, sizeof(z80->watch_pages));
+    z80->watch_kinds = 0;
+
+    for (int id = 0; id < Z80_MAX_WATCHPOINTS; id++)
+    {
+        const z80_watchpoint_t *watch = &z80->watchpoints[id];
+        for (uint32_t addr = watch->start; watch->kinds && addr <= watch->end; addr++)
+        {
+            z80->watch_map[addr] |= watch->kinds;
+            z80->watch_pages[addr >> Z80_PAGE_SHIFT] |= watch->kinds;
+        }
+        z80->watch_kinds |= watch->kinds;
+    }
+
+    for (int page = 0; page < Z80_NUM_PAGES; page++)
+        apply_page(z80, page);
+
+    // Blocks are cut at execute watchpoints: redecode them around the new set
+    if (z80->blocks)
+        memset(z80->blocks, 0, sizeof(z80_block_t) * Z80_BLOCK_CACHE_SIZE);
+}
+
+/**
+ * Add a breakpoint or watchpoint
+ */
+int z80_add_watchpoint(z80_emulator_t *z80, const z80_watchpoint_t *watch)
+{
+    uint8_t kinds = Z80_WATCH_EXEC | Z80_WATCH_READ | Z80_WATCH_WRITE;
+
+    if (!z80 || !watch || !watch->fn || !watch->kinds || (watch->kinds & ~kinds) ||
+        watch->start > watch->end || watch->reg > Z80_WATCH_REG_SP)
+    {
+        fprintf(stderr, "Error: Invalid watchpoint\n");
+        return -1;
+    }
+
+    for (int id = 0; id < Z80_MAX_WATCHPOINTS; id++)
+    {
+        if (z80->watchpoints[id].kinds)
+            continue;
+        z80->watchpoints[id] = *watch;
+        watch_rebuild(z80);
+        return id;
+    }
+
+    fprintf(stderr, "Error: All %d watchpoints are in use\n", Z80_MAX_WATCHPOINTS);
+    return -1;
+}
+
+/**
+ * Remove a watchpoint
+ */
+int z80_remove_watchpoint(z80_emulator_t *z80, int id)
+{
+    if (!z80 || id < 0 || id >= Z80_MAX_WATCHPOINTS || !z80->watchpoints[id].kinds)
+        return -1;
+
+    memset(&z80->watchpoints[id], 0, sizeof(z80->watchpoints[id]));
+    watch_rebuild(z80);
+    return 0;
+}
+
+// function to call when an INT is to be serviced
+void z80_gen_int(z80_emulator_t *const z, uint8_t data)
+{
+    z->int_pending = 1;
+    z->int_data = data;
+}
+
+// function to call when the INT line is released before being serviced
+void z80_clear_int(z80_emulator_t *const z)
+{
+    z->int_pending = 0;
+}
+
+// a halted CPU executes NOPs until it accepts an interrupt: while none can
+// be accepted, the NOPs up to target_cycle (4 T-states and one R increment
+// each) are skipped at once. Returns the number of NOPs skipped.
+static inline uint64_t skip_halt(z80_emulator_t *const z, uint64_t target_cycle, uint64_t budget)
+{
+    if (z->regs.iff_delay || z->nmi_pending || (z->int_pending && z->regs.iff1) || z->cyc >= target_cycle)
+        return 0;
+
+    uint64_t nops = (target_cycle - z->cyc + 3) / 4;
+    if (nops > budget)
+        nops = budget;
+    z->cyc += nops * 4;
+    z->regs.r = (z->regs.r & 0x80) | ((z->regs.r + nops) & 0x7f);
+    return nops;
+}
+
+// executes the next instruction in memory
+static inline int step_instruction(z80_emulator_t *const z)
+{
+    if (z->halted)
+        return exec_opcode(z, 0x00);
+
+    if (z->regs.pc == z->exec_trap_addr && z->exec_trap &&
+        z->exec_trap(z->exec_trap_data, z->regs.pc))
+    {
+        // The trap emulated the instruction and moved PC itself
+        return 0;
+    }
+
+    const uint8_t opcode = nextb(z);
+    return exec_opcode(z, opcode);
+}
+
+// executes the next instruction in memory + handles interrupts
+static inline int step(z80_emulator_t *const z)
+{
+    int cyc = step_instruction(z);
+    process_interrupts(z);
+    return cyc;
+}
+
+// step() reporting the instruction and any accepted interrupt to the profiler
+static int step_profiled(z80_emulator_t *const z)
+{
+    uint16_t pc = z->regs.pc;
+    uint16_t sp = z->regs.sp;
+    uint64_t start = z->cyc;
+    uint8_t bytes[4] = {0, 0, 0, 0}; // A halted CPU executes NOPs
+
+    if (!z->halted)
+    {
+        for (int i = 0; i < 4; i++)
+            bytes[i] = rb(z, (uint16_t)(pc + i));
+    }
+
+    int cyc = step_instruction(z);
+    z80_profile_instruction(z->profile, pc, z->regs.pc, bytes, sp, z->regs.sp, (uint32_t)(z->cyc - start));
+
+    // An accepted interrupt or NMI adds its response time
+    uint64_t before_interrupt = z->cyc;
+    process_interrupts(z);
+    if (z->cyc != before_interrupt)
+        z80_profile_interrupt(z->profile, z->regs.pc, z->regs.sp, (uint32_t)(z->cyc - before_interrupt));
+
+    return cyc;
+}
+
+int z80_step(z80_emulator_t *const z)
+{
+    if (z->watch_kinds && watch_exec(z, watch_resume(z)))
+        return 0;
+    if (z->profile)
+        return step_profiled(z);
+    return step(z);
+}
+
+// MARK: block engine
+// Straight-line runs are decoded once into z80_block_op_t records (handler,
+// operands and register offsets) and replayed from a direct-mapped cache.
+// Handlers exist for instructions that read memory at most; the first
+// instruction without one (stores, prefixes, I/O, EI, HALT, CALL...) ends
+// the block and runs through exec_opcode(). A block is reused while the
+// write generations of its pages are unchanged, so self-modifying code and
+// loaders see their new bytes.
+
+#define BLOCK_REG(z, offset) (((uint8_t *)&(z)->regs)[offset])
+#define BLOCK_NO_REG 0xFF
+
+// Offsets of the registers of the 3-bit operand field (6 = (HL))
+static const uint8_t block_regs[8] = {
+    offsetof(z80_registers_t, b), offsetof(z80_registers_t, c), offsetof(z80_registers_t, d),
+    offsetof(z80_registers_t, e), offsetof(z80_registers_t, h), offsetof(z80_registers_t, l),
+    BLOCK_NO_REG, offsetof(z80_registers_t, a)};
+
+// Offsets of the BC, DE and HL pairs (high byte; the low byte follows)
+static const uint8_t block_pairs[3] = {
+    offsetof(z80_registers_t, b), offsetof(z80_registers_t, d), offsetof(z80_registers_t, h)};
+
+// fetch-side effects of every instruction: T-states, R and the PC
+static inline void block_begin(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    z->cyc += op->cycles;
+    inc_r(z);
+    z->regs.pc += op->length;
+}
+
+// evaluates condition code cc (NZ, Z, NC, C, PO, PE, P, M)
+static inline bool block_condition(z80_emulator_t *const z, uint8_t cc)
+{
+    switch (cc)
+    {
+    case 0:
+        return !flag_z(z);
+    case 1:
+        return flag_z(z);
+    case 2:
+        return !flag_c(z);
+    case 3:
+        return flag_c(z);
+    case 4:
+        return !flag(z, Z80_FLAG_PV);
+    case 5:
+        return flag(z, Z80_FLAG_PV);
+    case 6:
+        return !flag(z, Z80_FLAG_S);
+    default:
+        return flag(z, Z80_FLAG_S);
+    }
+}
+
+static int blk_nop(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    return 0;
+}
+
+static int blk_ld_r_r(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = BLOCK_REG(z, op->src);
+    return 0;
+}
+
+static int blk_ld_r_n(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = (uint8_t)op->nn;
+    return 0;
+}
+
+static int blk_ld_r_hl(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = rb(z, get_hl(z));
+    return 0;
+}
+
+static int blk_ld_rr_nn(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = op->nn >> 8;
+    BLOCK_REG(z, op->dst_lo) = op->nn & 0xFF;
+    return 0;
+}
+
+static int blk_ld_sp_nn(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.sp = op->nn;
+    return 0;
+}
+
+static int blk_ld_a_rr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    const uint16_t addr = (BLOCK_REG(z, op->src) << 8) | BLOCK_REG(z, op->src_lo);
+    z->regs.a = rb(z, addr);
+    z->regs.mem_ptr = addr + 1;
+    return 0;
+}
+
+static int blk_ld_a_nn(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.a = rb(z, op->nn);
+    z->regs.mem_ptr = op->nn + 1;
+    return 0;
+}
+
+static int blk_ld_hl_nn(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    set_hl(z, rw(z, op->nn));
+    z->regs.mem_ptr = op->nn + 1;
+    return 0;
+}
+
+static int blk_inc_r(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = inc(z, BLOCK_REG(z, op->dst));
+    return 0;
+}
+
+static int blk_dec_r(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    BLOCK_REG(z, op->dst) = dec(z, BLOCK_REG(z, op->dst));
+    return 0;
+}
+
+static int blk_inc_rr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    const uint16_t val = ((BLOCK_REG(z, op->dst) << 8) | BLOCK_REG(z, op->dst_lo)) + 1;
+    BLOCK_REG(z, op->dst) = val >> 8;
+    BLOCK_REG(z, op->dst_lo) = val & 0xFF;
+    return 0;
+}
+
+static int blk_dec_rr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    const uint16_t val = ((BLOCK_REG(z, op->dst) << 8) | BLOCK_REG(z, op->dst_lo)) - 1;
+    BLOCK_REG(z, op->dst) = val >> 8;
+    BLOCK_REG(z, op->dst_lo) = val & 0xFF;
+    return 0;
+}
+
+static int blk_inc_sp(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.sp++;
+    return 0;
+}
+
+static int blk_dec_sp(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.sp--;
+    return 0;
+}
+
+static int blk_add_hl_rr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    addhl(z, (BLOCK_REG(z, op->src) << 8) | BLOCK_REG(z, op->src_lo));
+    return 0;
+}
+
+static int blk_add_hl_sp(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    addhl(z, z->regs.sp);
+    return 0;
+}
+
+static int blk_pop_rr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    const uint16_t val = popw(z);
+    BLOCK_REG(z, op->dst) = val >> 8;
+    BLOCK_REG(z, op->dst_lo) = val & 0xFF;
+    return 0;
+}
+
+static int blk_pop_af(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    const uint16_t val = popw(z);
+    z->regs.a = val >> 8;
+    set_f(z, val & 0xFF);
+    return 0;
+}
+
+// 8-bit ALU with a register, immediate and (HL) operand
+#define BLOCK_ALU(name, apply)                                                     \
+    static int blk_##name##_r(z80_emulator_t *const z, const z80_block_op_t *op)  \
+    {                                                                              \
+        block_begin(z, op);                                                        \
+        const uint8_t val = BLOCK_REG(z, op->src);                                 \
+        apply;                                                                     \
+        return 0;                                                                  \
+    }                                                                              \
+    static int blk_##name##_n(z80_emulator_t *const z, const z80_block_op_t *op)  \
+    {                                                                              \
+        block_begin(z, op);                                                        \
+        const uint8_t val = (uint8_t)op->nn;                                       \
+        apply;                                                                     \
+        return 0;                                                                  \
+    }                                                                              \
+    static int blk_##name##_hl(z80_emulator_t *const z, const z80_block_op_t *op) \
+    {                                                                              \
+        block_begin(z, op);                                                        \
+        const uint8_t val = rb(z, get_hl(z));                                      \
+        apply;                                                                     \
+        return 0;                                                                  \
+    }
+
+BLOCK_ALU(add, z->regs.a = addb(z, z->regs.a, val, 0))
+BLOCK_ALU(adc, z->regs.a = addb(z, z->regs.a, val, flag_c(z)))
+BLOCK_ALU(sub, z->regs.a = subb(z, z->regs.a, val, 0))
+BLOCK_ALU(sbc, z->regs.a = subb(z, z->regs.a, val, flag_c(z)))
+BLOCK_ALU(and, land(z, val))
+BLOCK_ALU(xor, lxor(z, val))
+BLOCK_ALU(or, lor(z, val))
+BLOCK_ALU(cp, cp(z, val))
+
+// handlers of the ALU operation field (ADD, ADC, SUB, SBC, AND, XOR, OR, CP)
+static const z80_block_fn_t block_alu_r[8] = {blk_add_r, blk_adc_r, blk_sub_r, blk_sbc_r,
+                                              blk_and_r, blk_xor_r, blk_or_r, blk_cp_r};
+static const z80_block_fn_t block_alu_n[8] = {blk_add_n, blk_adc_n, blk_sub_n, blk_sbc_n,
+                                              blk_and_n, blk_xor_n, blk_or_n, blk_cp_n};
+static const z80_block_fn_t block_alu_hl[8] = {blk_add_hl, blk_adc_hl, blk_sub_hl, blk_sbc_hl,
+                                               blk_and_hl, blk_xor_hl, blk_or_hl, blk_cp_hl};
+
+static int blk_jp(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    jump(z, op->nn);
+    return 1;
+}
+
+static int blk_jp_cc(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.mem_ptr = op->nn;
+    if (!block_condition(z, op->cc))
+        return 0;
+    z->regs.pc = op->nn;
+    return 1;
+}
+
+static int blk_jp_hl(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.pc = get_hl(z);
+    return 1;
+}
+
+static int blk_jr(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    z->regs.pc = op->nn;
+    return 1;
+}
+
+static int blk_jr_cc(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    if (!block_condition(z, op->cc))
+        return 0;
+    z->regs.pc = op->nn;
+    z->regs.mem_ptr = op->nn;
+    z->cyc += 5;
+    return 1;
+}
 
-        default:
-            fprintf(stderr, "unsupported interrupt mode %d\n", z->regs.im);
-            break;
-        }
+static int blk_djnz(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    if (--z->regs.b == 0)
+        return 0;
+    z->regs.pc = op->nn;
+    z->regs.mem_ptr = op->nn;
+    z->cyc += 5;
+    return 1;
+}
 
-        return;
-    }
+static int blk_ret(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    block_begin(z, op);
+    ret(z);
+    return 1;
 }
 
-/**
- * Initialize Z80 emulator
- * Returns pointer to emulator context
- */
-z80_emulator_t *z80_init(void)
+static int blk_ret_cc(z80_emulator_t *const z, const z80_block_op_t *op)
 {
-    z80_emulator_t *z80 = malloc(sizeof(z80_emulator_t));
-    if (!z80)
-        return NULL;
+    block_begin(z, op);
+    if (!block_condition(z, op->cc))
+        return 0;
+    ret(z);
+    z->cyc += 6;
+    return 1;
+}
 
-    // Initialize registers
-    memset(&z80->regs, 0, sizeof(z80_registers_t));
-    z80->regs.pc = 0x0000;
-    z80->regs.sp = 0xFFFF;
-    z80->regs.im = 0;
+// single-byte instruction without stores or control flow, interpreted
+static int blk_exec(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    z->regs.pc++;
+    exec_opcode(z, op->opcode);
+    return 0;
+}
 
-    z80->regs.a = 0xFF;
-    z80->regs.b = 0;
-    z80->regs.c = 0;
-    z80->regs.d = 0;
-    z80->regs.e = 0;
-    z80->regs.h = 0;
-    z80->regs.l = 0;
+// any other instruction, interpreted as the last one of its block
+static int blk_exec_last(z80_emulator_t *const z, const z80_block_op_t *op)
+{
+    z->regs.pc++;
+    exec_opcode(z, op->opcode);
+    return 1;
+}
 
-    z80->regs.a_ = 0;
-    z80->regs.b_ = 0;
-    z80->regs.c_ = 0;
-    z80->regs.d_ = 0;
-    z80->regs.e_ = 0;
-    z80->regs.h_ = 0;
-    z80->regs.l_ = 0;
-    z80->regs.f_ = 0;
-    z80->regs.i = 0;
-    z80->regs.r = 0;
+// decodes the instruction at addr; returns 1 if decoding may continue after
+// it, 0 if it ends the block
+static int block_decode(z80_emulator_t *const z, uint16_t addr, z80_block_op_t *op)
+{
+    const uint8_t opcode = rb(z, addr);
+    const uint8_t n = rb(z, (uint16_t)(addr + 1));
+    const uint16_t nn = n | (rb(z, (uint16_t)(addr + 2)) << 8);
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t r = opcode & 7;
+
+    memset(op, 0, sizeof(*op));
+    op->opcode = opcode;
+    op->cycles = cyc_00[opcode];
+    op->length = 1;
+    op->fn = blk_exec_last;
+
+    if (opcode >= 0x40 && opcode < 0x80)
+    {
+        // LD r,r' and LD r,(HL); HALT and LD (HL),r are left to exec_opcode
+        if (y == 6)
+            return 0;
+        op->dst = block_regs[y];
+        op->src = block_regs[r];
+        op->fn = r == 6 ? blk_ld_r_hl : blk_ld_r_r;
+        return 1;
+    }
 
-    z80->regs.sf = 1;
-    z80->regs.zf = 1;
-    z80->regs.yf = 1;
-    z80->regs.hf = 1;
-    z80->regs.xf = 1;
-    z80->regs.pf = 1;
-    z80->regs.nf = 1;
-    z80->regs.cf = 1;
+    if (opcode >= 0x80 && opcode < 0xC0)
+    {
+        op->src = block_regs[r];
+        op->fn = r == 6 ? block_alu_hl[y] : block_alu_r[y];
+        return 1;
+    }
 
-    // Initialize state
-    z80->running = 0;
-    z80->paused = 0;
-    z80->halted = 0;
-    z80->cyc = 0;
+    switch (opcode & 0xC7)
+    {
+    case 0x04: // inc r
+    case 0x05: // dec r
+        if (y == 6)
+            return 0;
+        op->dst = block_regs[y];
+        op->fn = r == 4 ? blk_inc_r : blk_dec_r;
+        return 1;
+    case 0x06: // ld r,*
+        if (y == 6)
+            return 0;
+        op->dst = block_regs[y];
+        op->nn = n;
+        op->length = 2;
+        op->fn = blk_ld_r_n;
+        return 1;
+    case 0xC6: // alu a,*
+        op->nn = n;
+        op->length = 2;
+        op->fn = block_alu_n[y];
+        return 1;
+    case 0xC2: // jp cc,**
+        op->nn = nn;
+        op->cc = y;
+        op->length = 3;
+        op->fn = blk_jp_cc;
+        return 1;
+    case 0xC0: // ret cc
+        op->cc = y;
+        op->fn = blk_ret_cc;
+        return 1;
+    default:
+        break;
+    }
 
-    // Initialize synchronization primitives
-    pthread_mutex_init(&z80->state_lock, NULL);
-    pthread_cond_init(&z80->state_cond, NULL);
+    switch (opcode)
+    {
+    case 0x00: // nop
+        op->fn = blk_nop;
+        return 1;
+    case 0x01: // ld bc,**
+    case 0x11: // ld de,**
+    case 0x21: // ld hl,**
+        op->dst = block_pairs[opcode >> 4];
+        op->dst_lo = op->dst + 1;
+        op->nn = nn;
+        op->length = 3;
+        op->fn = blk_ld_rr_nn;
+        return 1;
+    case 0x31: // ld sp,**
+        op->nn = nn;
+        op->length = 3;
+        op->fn = blk_ld_sp_nn;
+        return 1;
+    case 0x03: // inc bc
+    case 0x13: // inc de
+    case 0x23: // inc hl
+    case 0x0B: // dec bc
+    case 0x1B: // dec de
+    case 0x2B: // dec hl
+        op->dst = block_pairs[opcode >> 4];
+        op->dst_lo = op->dst + 1;
+        op->fn = opcode & 0x08 ? blk_dec_rr : blk_inc_rr;
+        return 1;
+    case 0x33: // inc sp
+        op->fn = blk_inc_sp;
+        return 1;
+    case 0x3B: // dec sp
+        op->fn = blk_dec_sp;
+        return 1;
+    case 0x09: // add hl,bc
+    case 0x19: // add hl,de
+    case 0x29: // add hl,hl
+        op->src = block_pairs[opcode >> 4];
+        op->src_lo = op->src + 1;
+        op->fn = blk_add_hl_rr;
+        return 1;
+    case 0x39: // add hl,sp
+        op->fn = blk_add_hl_sp;
+        return 1;
+    case 0x0A: // ld a,(bc)
+    case 0x1A: // ld a,(de)
+        op->src = block_pairs[opcode >> 4];
+        op->src_lo = op->src + 1;
+        op->fn = blk_ld_a_rr;
+        return 1;
+    case 0x3A: // ld a,(**)
+        op->nn = nn;
+        op->length = 3;
+        op->fn = blk_ld_a_nn;
+        return 1;
+    case 0x2A: // ld hl,(**)
+        op->nn = nn;
+        op->length = 3;
+        op->fn = blk_ld_hl_nn;
+        return 1;
+    case 0xC1: // pop bc
+    case 0xD1: // pop de
+    case 0xE1: // pop hl
+        op->dst = block_pairs[(opcode >> 4) - 0x0C];
+        op->dst_lo = op->dst + 1;
+        op->fn = blk_pop_rr;
+        return 1;
+    case 0xF1: // pop af
+        op->fn = blk_pop_af;
+        return 1;
+    case 0x07: // rlca
+    case 0x0F: // rrca
+    case 0x17: // rla
+    case 0x1F: // rra
+    case 0x27: // daa
+    case 0x2F: // cpl
+    case 0x37: // scf
+    case 0x3F: // ccf
+    case 0x08: // ex af,af'
+    case 0xD9: // exx
+    case 0xEB: // ex de,hl
+    case 0xF9: // ld sp,hl
+    case 0xF3: // di
+        op->fn = blk_exec;
+        return 1;
+    case 0xC3: // jp **
+        op->nn = nn;
+        op->length = 3;
+        op->fn = blk_jp;
+        return 0;
+    case 0xE9: // jp (hl)
+        op->fn = blk_jp_hl;
+        return 0;
+    case 0x18: // jr *
+        op->nn = (uint16_t)(addr + 2 + (int8_t)n);
+        op->length = 2;
+        op->fn = blk_jr;
+        return 0;
+    case 0x20: // jr nz,*
+    case 0x28: // jr z,*
+    case 0x30: // jr nc,*
+    case 0x38: // jr c,*
+        op->nn = (uint16_t)(addr + 2 + (int8_t)n);
+        op->cc = y - 4;
+        op->length = 2;
+        op->fn = blk_jr_cc;
+        return 1;
+    case 0x10: // djnz *
+        op->nn = (uint16_t)(addr + 2 + (int8_t)n);
+        op->length = 2;
+        op->fn = blk_djnz;
+        return 1;
+    case 0xC9: // ret
+        op->fn = blk_ret;
+        return 0;
+    default:
+        return 0;
+    }
+}
 
-    // Initialize callbacks to NULL
-    z80->read_io = NULL;
-    z80->write_io = NULL;
-    z80->read_memory = NULL;
-    z80->write_memory = NULL;
-    z80->user_data = NULL;
+// decodes a block starting at pc into slot; returns 0 if there is none to
+// build (pc is not in directly mapped memory)
+static int block_build(z80_emulator_t *const z, z80_block_t *block, uint16_t pc)
+{
+    uint16_t addr = pc;
+    uint16_t end = pc;
+    int count = 0;
 
-    // Initialize port-specific callbacks
-    for (int i = 0; i < Z80_IO_PORTS; i++)
+    block->loop_ops = 0;
+    while (count < Z80_BLOCK_MAX_OPS)
     {
-        z80->port_callbacks[i].read_fn = NULL;
-        z80->port_callbacks[i].write_fn = NULL;
+        // Every byte the instruction might use must be plain host memory,
+        // and the trap address and execute watchpoints must be reached
+        // through the interpreter
+        if (!z->read_pages[addr >> Z80_PAGE_SHIFT] ||
+            !z->read_pages[(uint16_t)(addr + 2) >> Z80_PAGE_SHIFT] ||
+            (count > 0 && z->exec_trap && addr == z->exec_trap_addr) ||
+            (count > 0 && watch_exec_at(z, addr)))
+            break;
+
+        z80_block_op_t *op = &block->ops[count++];
+        int more = block_decode(z, addr, op);
+        if (!block->loop_ops && op->nn == pc &&
+            (op->fn == blk_jr || op->fn == blk_jr_cc || op->fn == blk_jp || op->fn == blk_jp_cc))
+            block->loop_ops = count;
+        end = addr + (op->fn == blk_exec_last ? 0 : op->length - 1);
+        addr += op->length;
+        if (!more)
+            break;
     }
 
-    return z80;
+    block->count = count;
+    if (count == 0)
+        return 0;
+
+    block->pc = pc;
+    block->pages[0] = pc >> Z80_PAGE_SHIFT;
+    block->pages[1] = end >> Z80_PAGE_SHIFT;
+    block->gens[0] = z->page_gen[block->pages[0]];
+    block->gens[1] = z->page_gen[block->pages[1]];
+    block->gen[0] = *block->gens[0];
+    block->gen[1] = *block->gens[1];
+    return 1;
 }
 
-/**
- * Clean up Z80 emulator
- * Note: Memory management is external; this only cleans up the emulator structure
- */
-void z80_cleanup(z80_emulator_t *z80)
+// finds the block starting at pc, decoding it if the cached one is stale
+static inline const z80_block_t *block_lookup(z80_emulator_t *const z, uint16_t pc)
 {
-    if (!z80)
-        return;
+    z80_block_t *block = &z->blocks[(pc ^ (pc >> 12)) & (Z80_BLOCK_CACHE_SIZE - 1)];
 
-    z80->running = 0;
+    if (block->count && block->pc == pc &&
+        block->gens[0] == z->page_gen[block->pages[0]] && block->gen[0] == *block->gens[0] &&
+        block->gens[1] == z->page_gen[block->pages[1]] && block->gen[1] == *block->gens[1])
+        return block;
 
-    if (z80->thread)
-    {
-        pthread_join(z80->thread, NULL);
-    }
+    if ((z->exec_trap && pc == z->exec_trap_addr) || watch_exec_at(z, pc))
+        return NULL;
+    return block_build(z, block, pc) ? block : NULL;
+}
 
-    pthread_mutex_destroy(&z80->state_lock);
-    pthread_cond_destroy(&z80->state_cond);
+// an idle loop iteration (block start back to block start, memory reads
+// only) that left every register but R as it found them repeats exactly
+// until an interrupt: skips the iterations that would still start before
+// target_cycle. Returns the number of instructions skipped.
+static uint64_t skip_idle_loop(z80_emulator_t *const z, z80_registers_t *before, uint64_t cycles,
+                               uint64_t instructions, uint64_t target_cycle, uint64_t budget)
+{
+    before->r = z->regs.r;
+    if (cycles == 0 || z->cyc >= target_cycle || memcmp(before, &z->regs, sizeof(*before)) != 0)
+        return 0;
 
-    // Free context if it exists
-    if (z80->user_data)
+    uint64_t iterations = (target_cycle - z->cyc - 1) / cycles;
+    if (iterations > budget / instructions)
+        iterations = budget / instructions;
+    z->cyc += iterations * cycles;
+    z->regs.r = (z->regs.r & 0x80) | ((z->regs.r + iterations * instructions) & 0x7f);
+    return iterations * instructions;
+}
+
+// z80_run_until() on the block engine
+static uint64_t run_blocks(z80_emulator_t *const z, uint64_t target_cycle, uint64_t max_instructions)
+{
+    uint64_t executed = 0;
+    bool resume = watch_resume(z);
+
+    while (z->cyc < target_cycle && executed < max_instructions)
     {
-        free(z80->user_data);
+        // HALT, EI delays and interrupts waiting to be taken are interpreted
+        const z80_block_t *block = NULL;
+        if (!z->regs.iff_delay && !z->nmi_pending && !(z->int_pending && z->regs.iff1))
+        {
+            if (!z->halted)
+                block = block_lookup(z, z->regs.pc);
+            else
+            {
+                uint64_t skipped = skip_halt(z, target_cycle, max_instructions - executed);
+                executed += skipped;
+                if (skipped)
+                    continue;
+            }
+        }
+
+        // Execute watchpoints are never inside blocks
+        if (!block)
+        {
+            if (z->watch_kinds && watch_exec(z, resume))
+                break;
+            resume = false;
+            step(z);
+            executed++;
+            continue;
+        }
+        resume = false;
+
+        // Blocks that may loop to themselves are watched for idle loops
+        z80_registers_t before;
+        uint64_t cycles_before = z->cyc;
+        uint64_t executed_before = executed;
+        if (block->loop_ops)
+            memcpy(&before, &z->regs, sizeof(before));
+
+        // Handlers don't touch the interrupt state, so only the instruction
+        // that ends the block needs process_interrupts() after it
+        for (int i = 0; i < block->count; i++)
+        {
+            if (i > 0 && (z->cyc >= target_cycle || executed >= max_instructions))
+                break;
+            const z80_block_op_t *op = &block->ops[i];
+            executed++;
+            if (op->fn(z, op))
+            {
+                process_interrupts(z);
+                if (i + 1 == block->loop_ops && z->regs.pc == block->pc)
+                    executed += skip_idle_loop(z, &before, z->cyc - cycles_before, executed - executed_before,
+                                               target_cycle, max_instructions - executed);
+                break;
+            }
+        }
     }
 
-    free(z80);
+    return executed;
 }
 
 /**
- * Set memory callbacks for pluggable RAM/ROM
+ * Enable or disable the predecoded block engine
  */
-void z80_set_memory_callbacks(z80_emulator_t *z80,
-                              z80_read_memory_t read_memory,
-                              z80_write_memory_t write_memory,
-                              void *user_data)
+int z80_set_block_engine(z80_emulator_t *z80, bool enabled)
 {
-    if (!z80)
-        return;
-
-    // If no context exists yet, create one
-    if (!z80->user_data)
+    if (!enabled)
     {
-        z80_callback_context_t *ctx = malloc(sizeof(z80_callback_context_t));
-        if (!ctx)
-            return;
-        ctx->memory_data = user_data;
-        ctx->io_data = NULL;
-        z80->user_data = ctx;
+        free(z80->blocks);
+        z80->blocks = NULL;
+        return 0;
     }
-    else
+
+    if (z80->blocks)
+        return 0;
+
+    z80->blocks = calloc(Z80_BLOCK_CACHE_SIZE, sizeof(z80_block_t));
+    if (!z80->blocks)
     {
-        // Update existing context
-        z80_callback_context_t *ctx = (z80_callback_context_t *)z80->user_data;
-        ctx->memory_data = user_data;
+        fprintf(stderr, "Error: Failed to allocate block cache\n");
+        return -1;
     }
-
-    z80->read_memory = read_memory;
-    z80->write_memory = write_memory;
+    return 0;
 }
 
 /**
- * Register port-specific IN callback
+ * Drop predecoded code for a range written by the host
  */
-void z80_register_port_in(z80_emulator_t *z80,
-                          uint8_t port,
-                          z80_read_io_t read_fn)
+void z80_invalidate_code(z80_emulator_t *z80, uint16_t start, uint32_t length)
 {
-    if (!z80 || !read_fn)
+    if (length == 0)
         return;
+    if (length > Z80_MAX_MEMORY)
+        length = Z80_MAX_MEMORY;
 
-    z80->port_callbacks[port].read_fn = read_fn;
+    uint32_t first = start >> Z80_PAGE_SHIFT;
+    uint32_t last = (start + length - 1) >> Z80_PAGE_SHIFT;
+    for (uint32_t page = first; page <= last; page++)
+        (*z80->page_gen[page % Z80_NUM_PAGES])++;
 }
 
-/**
- * Register port-specific OUT callback
- */
-void z80_register_port_out(z80_emulator_t *z80,
-                           uint8_t port,
-                           z80_write_io_t write_fn)
+// z80_run_until() on the interpreter while watchpoints are set: checks the
+// execute watchpoints of each instruction and stops after any hit
+static uint64_t run_watched(z80_emulator_t *const z, uint64_t target_cycle, uint64_t max_instructions)
 {
-    if (!z80 || !write_fn)
-        return;
+    uint64_t executed = 0;
+    bool resume = watch_resume(z);
+
+    while (z->cyc < target_cycle && executed < max_instructions)
+    {
+        // The profiler sees every NOP of a HALT
+        if (z->halted && !z->profile)
+        {
+            uint64_t skipped = skip_halt(z, target_cycle, max_instructions - executed);
+            if (skipped)
+            {
+                executed += skipped;
+                continue;
+            }
+        }
+        if (watch_exec(z, resume))
+            break;
+        resume = false;
+
+        if (z->profile)
+            step_profiled(z);
+        else
+            step(z);
+        executed++;
+        if (z->break_hit)
+            break;
+    }
 
-    z80->port_callbacks[port].write_fn = write_fn;
+    return executed;
 }
 
 /**
- * Set I/O callback context data
+ * Run instructions until the cycle counter reaches target_cycle
  */
-void z80_set_io_callbacks(z80_emulator_t *z80, void *io_data)
+uint64_t z80_run_until(z80_emulator_t *const z, uint64_t target_cycle, uint64_t max_instructions)
 {
-    if (!z80)
-        return;
+    uint64_t executed = 0;
 
-    // Create context if it doesn't exist
-    if (!z80->user_data)
+    // The block engine handles execute watchpoints itself; anything else
+    // watched needs the checking loop
+    if (z->watch_kinds && (z->profile || !z->blocks || z->watch_kinds != Z80_WATCH_EXEC))
+        return run_watched(z, target_cycle, max_instructions);
+
+    if (z->profile)
     {
-        z80_callback_context_t *ctx = malloc(sizeof(z80_callback_context_t));
-        if (!ctx)
-            return;
-        ctx->memory_data = NULL;
-        ctx->io_data = io_data;
-        z80->user_data = ctx;
+        while (z->cyc < target_cycle && executed < max_instructions)
+        {
+            step_profiled(z);
+            executed++;
+        }
+        return executed;
     }
-    else
+
+    if (z->blocks)
+        return run_blocks(z, target_cycle, max_instructions);
+
+    while (z->cyc < target_cycle && executed < max_instructions)
     {
-        // Update existing context
-        z80_callback_context_t *ctx = (z80_callback_context_t *)z80->user_data;
-        ctx->io_data = io_data;
+        if (z->halted)
+        {
+            uint64_t skipped = skip_halt(z, target_cycle, max_instructions - executed);
+            if (skipped)
+            {
+                executed += skipped;
+                continue;
+            }
+        }
+        step(z);
+        executed++;
     }
-}
 
-// function to call when an INT is to be serviced
-void z80_gen_int(z80_emulator_t *const z, uint8_t data)
-{
-    z->int_pending = 1;
-    z->int_data = data;
+    return executed;
 }
 
-// executes the next instruction in memory + handles interrupts
-int z80_step(z80_emulator_t *const z)
+/**
+ * Attach or detach a profiler
+ */
+void z80_set_profile(z80_emulator_t *z80, z80_profile_t *profile)
 {
-    int cyc;
-
-    if (z->halted)
-    {
-        cyc = exec_opcode(z, 0x00);
-    }
-    else
-    {
-        const uint8_t opcode = nextb(z);
-        cyc = exec_opcode(z, opcode);
-    }
-
-    process_interrupts(z);
-    return cyc;
+    z80->profile = profile;
 }
 
 // executes a non-prefixed opcode
@@ -1076,240 +2397,278 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     z->cyc += cyc_00[opcode];
     inc_r(z);
 
+#ifdef Z80_COMPUTED_GOTO
+    static const void *const dispatch_00[256] = {
+        &&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03, &&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07,
+        &&op_0x08, &&op_0x09, &&op_0x0A, &&op_0x0B, &&op_0x0C, &&op_0x0D, &&op_0x0E, &&op_0x0F,
+        &&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13, &&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17,
+        &&op_0x18, &&op_0x19, &&op_0x1A, &&op_0x1B, &&op_0x1C, &&op_0x1D, &&op_0x1E, &&op_0x1F,
+        &&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23, &&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27,
+        &&op_0x28, &&op_0x29, &&op_0x2A, &&op_0x2B, &&op_0x2C, &&op_0x2D, &&op_0x2E, &&op_0x2F,
+        &&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33, &&op_0x34, &&op_0x35, &&op_0x36, &&op_0x37,
+        &&op_0x38, &&op_0x39, &&op_0x3A, &&op_0x3B, &&op_0x3C, &&op_0x3D, &&op_0x3E, &&op_0x3F,
+        &&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43, &&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47,
+        &&op_0x48, &&op_0x49, &&op_0x4A, &&op_0x4B, &&op_0x4C, &&op_0x4D, &&op_0x4E, &&op_0x4F,
+        &&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53, &&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57,
+        &&op_0x58, &&op_0x59, &&op_0x5A, &&op_0x5B, &&op_0x5C, &&op_0x5D, &&op_0x5E, &&op_0x5F,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67,
+        &&op_0x68, &&op_0x69, &&op_0x6A, &&op_0x6B, &&op_0x6C, &&op_0x6D, &&op_0x6E, &&op_0x6F,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77,
+        &&op_0x78, &&op_0x79, &&op_0x7A, &&op_0x7B, &&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_0x7F,
+        &&op_0x80, &&op_0x81, &&op_0x82, &&op_0x83, &&op_0x84, &&op_0x85, &&op_0x86, &&op_0x87,
+        &&op_0x88, &&op_0x89, &&op_0x8A, &&op_0x8B, &&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_0x8F,
+        &&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93, &&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97,
+        &&op_0x98, &&op_0x99, &&op_0x9A, &&op_0x9B, &&op_0x9C, &&op_0x9D, &&op_0x9E, &&op_0x9F,
+        &&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_0xA3, &&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_0xA7,
+        &&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_0xAB, &&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_0xAF,
+        &&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_0xB3, &&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_0xB7,
+        &&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_0xBB, &&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_0xBF,
+        &&op_0xC0, &&op_0xC1, &&op_0xC2, &&op_0xC3, &&op_0xC4, &&op_0xC5, &&op_0xC6, &&op_0xC7,
+        &&op_0xC8, &&op_0xC9, &&op_0xCA, &&op_0xCB, &&op_0xCC, &&op_0xCD, &&op_0xCE, &&op_0xCF,
+        &&op_0xD0, &&op_0xD1, &&op_0xD2, &&op_0xD3, &&op_0xD4, &&op_0xD5, &&op_0xD6, &&op_0xD7,
+        &&op_0xD8, &&op_0xD9, &&op_0xDA, &&op_0xDB, &&op_0xDC, &&op_0xDD, &&op_0xDE, &&op_0xDF,
+        &&op_0xE0, &&op_0xE1, &&op_0xE2, &&op_0xE3, &&op_0xE4, &&op_0xE5, &&op_0xE6, &&op_0xE7,
+        &&op_0xE8, &&op_0xE9, &&op_0xEA, &&op_0xEB, &&op_0xEC, &&op_0xED, &&op_0xEE, &&op_0xEF,
+        &&op_0xF0, &&op_0xF1, &&op_0xF2, &&op_0xF3, &&op_0xF4, &&op_0xF5, &&op_0xF6, &&op_0xF7,
+        &&op_0xF8, &&op_0xF9, &&op_0xFA, &&op_0xFB, &&op_0xFC, &&op_0xFD, &&op_0xFE, &&op_0xFF
+    };
+    goto *dispatch_00[opcode];
+#endif
+
     switch (opcode)
     {
-    case 0x7F:
+    OP(0x7F):
         z->regs.a = z->regs.a;
         break; // ld a,a
-    case 0x78:
+    OP(0x78):
         z->regs.a = z->regs.b;
         break; // ld a,b
-    case 0x79:
+    OP(0x79):
         z->regs.a = z->regs.c;
         break; // ld a,c
-    case 0x7A:
+    OP(0x7A):
         z->regs.a = z->regs.d;
         break; // ld a,d
-    case 0x7B:
+    OP(0x7B):
         z->regs.a = z->regs.e;
         break; // ld a,e
-    case 0x7C:
+    OP(0x7C):
         z->regs.a = z->regs.h;
         break; // ld a,h
-    case 0x7D:
+    OP(0x7D):
         z->regs.a = z->regs.l;
         break; // ld a,l
 
-    case 0x47:
+    OP(0x47):
         z->regs.b = z->regs.a;
         break; // ld b,a
-    case 0x40:
+    OP(0x40):
         z->regs.b = z->regs.b;
         break; // ld b,b
-    case 0x41:
+    OP(0x41):
         z->regs.b = z->regs.c;
         break; // ld b,c
-    case 0x42:
+    OP(0x42):
         z->regs.b = z->regs.d;
         break; // ld b,d
-    case 0x43:
+    OP(0x43):
         z->regs.b = z->regs.e;
         break; // ld b,e
-    case 0x44:
+    OP(0x44):
         z->regs.b = z->regs.h;
         break; // ld b,h
-    case 0x45:
+    OP(0x45):
         z->regs.b = z->regs.l;
         break; // ld b,l
 
-    case 0x4F:
+    OP(0x4F):
         z->regs.c = z->regs.a;
         break; // ld c,a
-    case 0x48:
+    OP(0x48):
         z->regs.c = z->regs.b;
         break; // ld c,b
-    case 0x49:
+    OP(0x49):
         z->regs.c = z->regs.c;
         break; // ld c,c
-    case 0x4A:
+    OP(0x4A):
         z->regs.c = z->regs.d;
         break; // ld c,d
-    case 0x4B:
+    OP(0x4B):
         z->regs.c = z->regs.e;
         break; // ld c,e
-    case 0x4C:
+    OP(0x4C):
         z->regs.c = z->regs.h;
         break; // ld c,h
-    case 0x4D:
+    OP(0x4D):
         z->regs.c = z->regs.l;
         break; // ld c,l
 
-    case 0x57:
+    OP(0x57):
         z->regs.d = z->regs.a;
         break; // ld d,a
-    case 0x50:
+    OP(0x50):
         z->regs.d = z->regs.b;
         break; // ld d,b
-    case 0x51:
+    OP(0x51):
         z->regs.d = z->regs.c;
         break; // ld d,c
-    case 0x52:
+    OP(0x52):
         z->regs.d = z->regs.d;
         break; // ld d,d
-    case 0x53:
+    OP(0x53):
         z->regs.d = z->regs.e;
         break; // ld d,e
-    case 0x54:
+    OP(0x54):
         z->regs.d = z->regs.h;
         break; // ld d,h
-    case 0x55:
+    OP(0x55):
         z->regs.d = z->regs.l;
         break; // ld d,l
 
-    case 0x5F:
+    OP(0x5F):
         z->regs.e = z->regs.a;
         break; // ld e,a
-    case 0x58:
+    OP(0x58):
         z->regs.e = z->regs.b;
         break; // ld e,b
-    case 0x59:
+    OP(0x59):
         z->regs.e = z->regs.c;
         break; // ld e,c
-    case 0x5A:
+    OP(0x5A):
         z->regs.e = z->regs.d;
         break; // ld e,d
-    case 0x5B:
+    OP(0x5B):
         z->regs.e = z->regs.e;
         break; // ld e,e
-    case 0x5C:
+    OP(0x5C):
         z->regs.e = z->regs.h;
         break; // ld e,h
-    case 0x5D:
+    OP(0x5D):
         z->regs.e = z->regs.l;
         break; // ld e,l
 
-    case 0x67:
+    OP(0x67):
         z->regs.h = z->regs.a;
         break; // ld h,a
-    case 0x60:
+    OP(0x60):
         z->regs.h = z->regs.b;
         break; // ld h,b
-    case 0x61:
+    OP(0x61):
         z->regs.h = z->regs.c;
         break; // ld h,c
-    case 0x62:
+    OP(0x62):
         z->regs.h = z->regs.d;
         break; // ld h,d
-    case 0x63:
+    OP(0x63):
         z->regs.h = z->regs.e;
         break; // ld h,e
-    case 0x64:
+    OP(0x64):
         z->regs.h = z->regs.h;
         break; // ld h,h
-    case 0x65:
+    OP(0x65):
         z->regs.h = z->regs.l;
         break; // ld h,l
 
-    case 0x6F:
+    OP(0x6F):
         z->regs.l = z->regs.a;
         break; // ld l,a
-    case 0x68:
+    OP(0x68):
         z->regs.l = z->regs.b;
         break; // ld l,b
-    case 0x69:
+    OP(0x69):
         z->regs.l = z->regs.c;
         break; // ld l,c
-    case 0x6A:
+    OP(0x6A):
         z->regs.l = z->regs.d;
         break; // ld l,d
-    case 0x6B:
+    OP(0x6B):
         z->regs.l = z->regs.e;
         break; // ld l,e
-    case 0x6C:
+    OP(0x6C):
         z->regs.l = z->regs.h;
         break; // ld l,h
-    case 0x6D:
+    OP(0x6D):
         z->regs.l = z->regs.l;
         break; // ld l,l
 
-    case 0x7E:
+    OP(0x7E):
         z->regs.a = rb(z, get_hl(z));
         break; // ld a,(hl)
-    case 0x46:
+    OP(0x46):
         z->regs.b = rb(z, get_hl(z));
         break; // ld b,(hl)
-    case 0x4E:
+    OP(0x4E):
         z->regs.c = rb(z, get_hl(z));
         break; // ld c,(hl)
-    case 0x56:
+    OP(0x56):
         z->regs.d = rb(z, get_hl(z));
         break; // ld d,(hl)
-    case 0x5E:
+    OP(0x5E):
         z->regs.e = rb(z, get_hl(z));
         break; // ld e,(hl)
-    case 0x66:
+    OP(0x66):
         z->regs.h = rb(z, get_hl(z));
         break; // ld h,(hl)
-    case 0x6E:
+    OP(0x6E):
         z->regs.l = rb(z, get_hl(z));
         break; // ld l,(hl)
 
-    case 0x77:
+    OP(0x77):
         wb(z, get_hl(z), z->regs.a);
         break; // ld (hl),a
-    case 0x70:
+    OP(0x70):
         wb(z, get_hl(z), z->regs.b);
         break; // ld (hl),b
-    case 0x71:
+    OP(0x71):
         wb(z, get_hl(z), z->regs.c);
         break; // ld (hl),c
-    case 0x72:
+    OP(0x72):
         wb(z, get_hl(z), z->regs.d);
         break; // ld (hl),d
-    case 0x73:
+    OP(0x73):
         wb(z, get_hl(z), z->regs.e);
         break; // ld (hl),e
-    case 0x74:
+    OP(0x74):
         wb(z, get_hl(z), z->regs.h);
         break; // ld (hl),h
-    case 0x75:
+    OP(0x75):
         wb(z, get_hl(z), z->regs.l);
         break; // ld (hl),l
 
-    case 0x3E:
+    OP(0x3E):
         z->regs.a = nextb(z);
         break; // ld a,*
-    case 0x06:
+    OP(0x06):
         z->regs.b = nextb(z);
         break; // ld b,*
-    case 0x0E:
+    OP(0x0E):
         z->regs.c = nextb(z);
         break; // ld c,*
-    case 0x16:
+    OP(0x16):
         z->regs.d = nextb(z);
         break; // ld d,*
-    case 0x1E:
+    OP(0x1E):
         z->regs.e = nextb(z);
         break; // ld e,*
-    case 0x26:
+    OP(0x26):
         z->regs.h = nextb(z);
         break; // ld h,*
-    case 0x2E:
+    OP(0x2E):
         z->regs.l = nextb(z);
         break; // ld l,*
-    case 0x36:
+    OP(0x36):
         wb(z, get_hl(z), nextb(z));
         break; // ld (hl),*
 
-    case 0x0A:
+    OP(0x0A):
         z->regs.a = rb(z, get_bc(z));
         z->regs.mem_ptr = get_bc(z) + 1;
         break; // ld a,(bc)
-    case 0x1A:
+    OP(0x1A):
         z->regs.a = rb(z, get_de(z));
         z->regs.mem_ptr = get_de(z) + 1;
         break; // ld a,(de)
-    case 0x3A:
+    OP(0x3A):
     {
         const uint16_t addr = nextw(z);
         z->regs.a = rb(z, addr);
@@ -1317,17 +2676,17 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld a,(**)
 
-    case 0x02:
+    OP(0x02):
         wb(z, get_bc(z), z->regs.a);
         z->regs.mem_ptr = (z->regs.a << 8) | ((get_bc(z) + 1) & 0xFF);
         break; // ld (bc),a
 
-    case 0x12:
+    OP(0x12):
         wb(z, get_de(z), z->regs.a);
         z->regs.mem_ptr = (z->regs.a << 8) | ((get_de(z) + 1) & 0xFF);
         break; // ld (de),a
 
-    case 0x32:
+    OP(0x32):
     {
         const uint16_t addr = nextw(z);
         wb(z, addr, z->regs.a);
@@ -1335,20 +2694,20 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**),a
 
-    case 0x01:
+    OP(0x01):
         set_bc(z, nextw(z));
         break; // ld bc,**
-    case 0x11:
+    OP(0x11):
         set_de(z, nextw(z));
         break; // ld de,**
-    case 0x21:
+    OP(0x21):
         set_hl(z, nextw(z));
         break; // ld hl,**
-    case 0x31:
+    OP(0x31):
         z->regs.sp = nextw(z);
         break; // ld sp,**
 
-    case 0x2A:
+    OP(0x2A):
     {
         const uint16_t addr = nextw(z);
         set_hl(z, rw(z, addr));
@@ -1356,7 +2715,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld hl,(**)
 
-    case 0x22:
+    OP(0x22):
     {
         const uint16_t addr = nextw(z);
         ww(z, addr, get_hl(z));
@@ -1364,11 +2723,11 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**),hl
 
-    case 0xF9:
+    OP(0xF9):
         z->regs.sp = get_hl(z);
         break; // ld sp,hl
 
-    case 0xEB:
+    OP(0xEB):
     {
         const uint16_t de = get_de(z);
         set_de(z, get_hl(z));
@@ -1376,7 +2735,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ex de,hl
 
-    case 0xE3:
+    OP(0xE3):
     {
         const uint16_t val = rw(z, z->regs.sp);
         ww(z, z->regs.sp, get_hl(z));
@@ -1385,566 +2744,548 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ex (sp),hl
 
-    case 0x87:
+    OP(0x87):
         z->regs.a = addb(z, z->regs.a, z->regs.a, 0);
         break; // add a,a
-    case 0x80:
+    OP(0x80):
         z->regs.a = addb(z, z->regs.a, z->regs.b, 0);
         break; // add a,b
-    case 0x81:
+    OP(0x81):
         z->regs.a = addb(z, z->regs.a, z->regs.c, 0);
         break; // add a,c
-    case 0x82:
+    OP(0x82):
         z->regs.a = addb(z, z->regs.a, z->regs.d, 0);
         break; // add a,d
-    case 0x83:
+    OP(0x83):
         z->regs.a = addb(z, z->regs.a, z->regs.e, 0);
         break; // add a,e
-    case 0x84:
+    OP(0x84):
         z->regs.a = addb(z, z->regs.a, z->regs.h, 0);
         break; // add a,h
-    case 0x85:
+    OP(0x85):
         z->regs.a = addb(z, z->regs.a, z->regs.l, 0);
         break; // add a,l
-    case 0x86:
+    OP(0x86):
         z->regs.a = addb(z, z->regs.a, rb(z, get_hl(z)), 0);
         break; // add a,(hl)
-    case 0xC6:
+    OP(0xC6):
         z->regs.a = addb(z, z->regs.a, nextb(z), 0);
         break; // add a,*
 
-    case 0x8F:
-        z->regs.a = addb(z, z->regs.a, z->regs.a, z->regs.cf);
+    OP(0x8F):
+        z->regs.a = addb(z, z->regs.a, z->regs.a, flag_c(z));
         break; // adc a,a
-    case 0x88:
-        z->regs.a = addb(z, z->regs.a, z->regs.b, z->regs.cf);
+    OP(0x88):
+        z->regs.a = addb(z, z->regs.a, z->regs.b, flag_c(z));
         break; // adc a,b
-    case 0x89:
-        z->regs.a = addb(z, z->regs.a, z->regs.c, z->regs.cf);
+    OP(0x89):
+        z->regs.a = addb(z, z->regs.a, z->regs.c, flag_c(z));
         break; // adc a,c
-    case 0x8A:
-        z->regs.a = addb(z, z->regs.a, z->regs.d, z->regs.cf);
+    OP(0x8A):
+        z->regs.a = addb(z, z->regs.a, z->regs.d, flag_c(z));
         break; // adc a,d
-    case 0x8B:
-        z->regs.a = addb(z, z->regs.a, z->regs.e, z->regs.cf);
+    OP(0x8B):
+        z->regs.a = addb(z, z->regs.a, z->regs.e, flag_c(z));
         break; // adc a,e
-    case 0x8C:
-        z->regs.a = addb(z, z->regs.a, z->regs.h, z->regs.cf);
+    OP(0x8C):
+        z->regs.a = addb(z, z->regs.a, z->regs.h, flag_c(z));
         break; // adc a,h
-    case 0x8D:
-        z->regs.a = addb(z, z->regs.a, z->regs.l, z->regs.cf);
+    OP(0x8D):
+        z->regs.a = addb(z, z->regs.a, z->regs.l, flag_c(z));
         break; // adc a,l
-    case 0x8E:
-        z->regs.a = addb(z, z->regs.a, rb(z, get_hl(z)), z->regs.cf);
+    OP(0x8E):
+        z->regs.a = addb(z, z->regs.a, rb(z, get_hl(z)), flag_c(z));
         break; // adc a,(hl)
-    case 0xCE:
-        z->regs.a = addb(z, z->regs.a, nextb(z), z->regs.cf);
+    OP(0xCE):
+        z->regs.a = addb(z, z->regs.a, nextb(z), flag_c(z));
         break; // adc a,*
 
-    case 0x97:
+    OP(0x97):
         z->regs.a = subb(z, z->regs.a, z->regs.a, 0);
         break; // sub a,a
-    case 0x90:
+    OP(0x90):
         z->regs.a = subb(z, z->regs.a, z->regs.b, 0);
         break; // sub a,b
-    case 0x91:
+    OP(0x91):
         z->regs.a = subb(z, z->regs.a, z->regs.c, 0);
         break; // sub a,c
-    case 0x92:
+    OP(0x92):
         z->regs.a = subb(z, z->regs.a, z->regs.d, 0);
         break; // sub a,d
-    case 0x93:
+    OP(0x93):
         z->regs.a = subb(z, z->regs.a, z->regs.e, 0);
         break; // sub a,e
-    case 0x94:
+    OP(0x94):
         z->regs.a = subb(z, z->regs.a, z->regs.h, 0);
         break; // sub a,h
-    case 0x95:
+    OP(0x95):
         z->regs.a = subb(z, z->regs.a, z->regs.l, 0);
         break; // sub a,l
-    case 0x96:
+    OP(0x96):
         z->regs.a = subb(z, z->regs.a, rb(z, get_hl(z)), 0);
         break; // sub a,(hl)
-    case 0xD6:
+    OP(0xD6):
         z->regs.a = subb(z, z->regs.a, nextb(z), 0);
         break; // sub a,*
 
-    case 0x9F:
-        z->regs.a = subb(z, z->regs.a, z->regs.a, z->regs.cf);
+    OP(0x9F):
+        z->regs.a = subb(z, z->regs.a, z->regs.a, flag_c(z));
         break; // sbc a,a
-    case 0x98:
-        z->regs.a = subb(z, z->regs.a, z->regs.b, z->regs.cf);
+    OP(0x98):
+        z->regs.a = subb(z, z->regs.a, z->regs.b, flag_c(z));
         break; // sbc a,b
-    case 0x99:
-        z->regs.a = subb(z, z->regs.a, z->regs.c, z->regs.cf);
+    OP(0x99):
+        z->regs.a = subb(z, z->regs.a, z->regs.c, flag_c(z));
         break; // sbc a,c
-    case 0x9A:
-        z->regs.a = subb(z, z->regs.a, z->regs.d, z->regs.cf);
+    OP(0x9A):
+        z->regs.a = subb(z, z->regs.a, z->regs.d, flag_c(z));
         break; // sbc a,d
-    case 0x9B:
-        z->regs.a = subb(z, z->regs.a, z->regs.e, z->regs.cf);
+    OP(0x9B):
+        z->regs.a = subb(z, z->regs.a, z->regs.e, flag_c(z));
         break; // sbc a,e
-    case 0x9C:
-        z->regs.a = subb(z, z->regs.a, z->regs.h, z->regs.cf);
+    OP(0x9C):
+        z->regs.a = subb(z, z->regs.a, z->regs.h, flag_c(z));
         break; // sbc a,h
-    case 0x9D:
-        z->regs.a = subb(z, z->regs.a, z->regs.l, z->regs.cf);
+    OP(0x9D):
+        z->regs.a = subb(z, z->regs.a, z->regs.l, flag_c(z));
         break; // sbc a,l
-    case 0x9E:
-        z->regs.a = subb(z, z->regs.a, rb(z, get_hl(z)), z->regs.cf);
+    OP(0x9E):
+        z->regs.a = subb(z, z->regs.a, rb(z, get_hl(z)), flag_c(z));
         break; // sbc a,(hl)
-    case 0xDE:
-        z->regs.a = subb(z, z->regs.a, nextb(z), z->regs.cf);
+    OP(0xDE):
+        z->regs.a = subb(z, z->regs.a, nextb(z), flag_c(z));
         break; // sbc a,*
 
-    case 0x09:
+    OP(0x09):
         addhl(z, get_bc(z));
         break; // add hl,bc
-    case 0x19:
+    OP(0x19):
         addhl(z, get_de(z));
         break; // add hl,de
-    case 0x29:
+    OP(0x29):
         addhl(z, get_hl(z));
         break; // add hl,hl
-    case 0x39:
+    OP(0x39):
         addhl(z, z->regs.sp);
         break; // add hl,sp
 
-    case 0xF3:
+    OP(0xF3):
         z->regs.iff1 = 0;
         z->regs.iff2 = 0;
         break; // di
-    case 0xFB:
+    OP(0xFB):
         z->regs.iff_delay = 1;
         break; // ei
-    case 0x00:
+    OP(0x00):
         break; // nop
-    case 0x76:
+    OP(0x76):
         z->halted = 1;
         break; // halt
 
-    case 0x3C:
+    OP(0x3C):
         z->regs.a = inc(z, z->regs.a);
         break; // inc a
-    case 0x04:
+    OP(0x04):
         z->regs.b = inc(z, z->regs.b);
         break; // inc b
-    case 0x0C:
+    OP(0x0C):
         z->regs.c = inc(z, z->regs.c);
         break; // inc c
-    case 0x14:
+    OP(0x14):
         z->regs.d = inc(z, z->regs.d);
         break; // inc d
-    case 0x1C:
+    OP(0x1C):
         z->regs.e = inc(z, z->regs.e);
         break; // inc e
-    case 0x24:
+    OP(0x24):
         z->regs.h = inc(z, z->regs.h);
         break; // inc h
-    case 0x2C:
+    OP(0x2C):
         z->regs.l = inc(z, z->regs.l);
         break; // inc l
-    case 0x34:
+    OP(0x34):
     {
         uint8_t result = inc(z, rb(z, get_hl(z)));
         wb(z, get_hl(z), result);
     }
     break; // inc (hl)
 
-    case 0x3D:
+    OP(0x3D):
         z->regs.a = dec(z, z->regs.a);
         break; // dec a
-    case 0x05:
+    OP(0x05):
         z->regs.b = dec(z, z->regs.b);
         break; // dec b
-    case 0x0D:
+    OP(0x0D):
         z->regs.c = dec(z, z->regs.c);
         break; // dec c
-    case 0x15:
+    OP(0x15):
         z->regs.d = dec(z, z->regs.d);
         break; // dec d
-    case 0x1D:
+    OP(0x1D):
         z->regs.e = dec(z, z->regs.e);
         break; // dec e
-    case 0x25:
+    OP(0x25):
         z->regs.h = dec(z, z->regs.h);
         break; // dec h
-    case 0x2D:
+    OP(0x2D):
         z->regs.l = dec(z, z->regs.l);
         break; // dec l
-    case 0x35:
+    OP(0x35):
     {
         uint8_t result = dec(z, rb(z, get_hl(z)));
         wb(z, get_hl(z), result);
     }
     break; // dec (hl)
 
-    case 0x03:
+    OP(0x03):
         set_bc(z, get_bc(z) + 1);
         break; // inc bc
-    case 0x13:
+    OP(0x13):
         set_de(z, get_de(z) + 1);
         break; // inc de
-    case 0x23:
+    OP(0x23):
         set_hl(z, get_hl(z) + 1);
         break; // inc hl
-    case 0x33:
+    OP(0x33):
         z->regs.sp = z->regs.sp + 1;
         break; // inc sp
-    case 0x0B:
+    OP(0x0B):
         set_bc(z, get_bc(z) - 1);
         break; // dec bc
-    case 0x1B:
+    OP(0x1B):
         set_de(z, get_de(z) - 1);
         break; // dec de
-    case 0x2B:
+    OP(0x2B):
         set_hl(z, get_hl(z) - 1);
         break; // dec hl
-    case 0x3B:
+    OP(0x3B):
         z->regs.sp = z->regs.sp - 1;
         break; // dec sp
 
-    case 0x27:
+    OP(0x27):
         daa(z);
         break; // daa
 
-    case 0x2F:
+    OP(0x2F):
         z->regs.a = ~z->regs.a;
-        z->regs.nf = 1;
-        z->regs.hf = 1;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+        set_flags(z, (flags(z) & (Z80_FLAGS_SZP | Z80_FLAG_C)) | Z80_FLAG_N | Z80_FLAG_H |
+                         (z->regs.a & Z80_FLAGS_XY));
         break; // cpl
 
-    case 0x37:
-        z->regs.cf = 1;
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+    OP(0x37):
+        set_flags(z, (flags(z) & Z80_FLAGS_SZP) | Z80_FLAG_C | (z->regs.a & Z80_FLAGS_XY));
         break; // scf
 
-    case 0x3F:
-        z->regs.hf = z->regs.cf;
-        z->regs.cf = !z->regs.cf;
-        z->regs.nf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
-        break; // ccf
+    OP(0x3F):
+    {
+        const uint8_t f = flags(z);
+        set_flags(z, (f & Z80_FLAGS_SZP) | ((f & Z80_FLAG_C) ? Z80_FLAG_H : Z80_FLAG_C) |
+                         (z->regs.a & Z80_FLAGS_XY));
+    }
+    break; // ccf
 
-    case 0x07:
+    OP(0x07):
     {
-        z->regs.cf = z->regs.a >> 7;
-        z->regs.a = (z->regs.a << 1) | z->regs.cf;
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+        const uint8_t cf = z->regs.a >> 7;
+        z->regs.a = (z->regs.a << 1) | cf;
+        set_flags(z, (flags(z) & Z80_FLAGS_SZP) | cf | (z->regs.a & Z80_FLAGS_XY));
     }
     break; // rlca (rotate left)
 
-    case 0x0F:
+    OP(0x0F):
     {
-        z->regs.cf = z->regs.a & 1;
-        z->regs.a = (z->regs.a >> 1) | (z->regs.cf << 7);
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+        const uint8_t cf = z->regs.a & 1;
+        z->regs.a = (z->regs.a >> 1) | (cf << 7);
+        set_flags(z, (flags(z) & Z80_FLAGS_SZP) | cf | (z->regs.a & Z80_FLAGS_XY));
     }
     break; // rrca (rotate right)
 
-    case 0x17:
+    OP(0x17):
     {
-        const bool cy = z->regs.cf;
-        z->regs.cf = z->regs.a >> 7;
+        const bool cy = flag_c(z);
+        const uint8_t cf = z->regs.a >> 7;
         z->regs.a = (z->regs.a << 1) | cy;
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+        set_flags(z, (flags(z) & Z80_FLAGS_SZP) | cf | (z->regs.a & Z80_FLAGS_XY));
     }
     break; // rla
 
-    case 0x1F:
+    OP(0x1F):
     {
-        const bool cy = z->regs.cf;
-        z->regs.cf = z->regs.a & 1;
+        const bool cy = flag_c(z);
+        const uint8_t cf = z->regs.a & 1;
         z->regs.a = (z->regs.a >> 1) | (cy << 7);
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
+        set_flags(z, (flags(z) & Z80_FLAGS_SZP) | cf | (z->regs.a & Z80_FLAGS_XY));
     }
     break; // rra
 
-    case 0xA7:
+    OP(0xA7):
         land(z, z->regs.a);
         break; // and a
-    case 0xA0:
+    OP(0xA0):
         land(z, z->regs.b);
         break; // and b
-    case 0xA1:
+    OP(0xA1):
         land(z, z->regs.c);
         break; // and c
-    case 0xA2:
+    OP(0xA2):
         land(z, z->regs.d);
         break; // and d
-    case 0xA3:
+    OP(0xA3):
         land(z, z->regs.e);
         break; // and e
-    case 0xA4:
+    OP(0xA4):
         land(z, z->regs.h);
         break; // and h
-    case 0xA5:
+    OP(0xA5):
         land(z, z->regs.l);
         break; // and l
-    case 0xA6:
+    OP(0xA6):
         land(z, rb(z, get_hl(z)));
         break; // and (hl)
-    case 0xE6:
+    OP(0xE6):
         land(z, nextb(z));
         break; // and *
 
-    case 0xAF:
+    OP(0xAF):
         lxor(z, z->regs.a);
         break; // xor a
-    case 0xA8:
+    OP(0xA8):
         lxor(z, z->regs.b);
         break; // xor b
-    case 0xA9:
+    OP(0xA9):
         lxor(z, z->regs.c);
         break; // xor c
-    case 0xAA:
+    OP(0xAA):
         lxor(z, z->regs.d);
         break; // xor d
-    case 0xAB:
+    OP(0xAB):
         lxor(z, z->regs.e);
         break; // xor e
-    case 0xAC:
+    OP(0xAC):
         lxor(z, z->regs.h);
         break; // xor h
-    case 0xAD:
+    OP(0xAD):
         lxor(z, z->regs.l);
         break; // xor l
-    case 0xAE:
+    OP(0xAE):
         lxor(z, rb(z, get_hl(z)));
         break; // xor (hl)
-    case 0xEE:
+    OP(0xEE):
         lxor(z, nextb(z));
         break; // xor *
 
-    case 0xB7:
+    OP(0xB7):
         lor(z, z->regs.a);
         break; // or a
-    case 0xB0:
+    OP(0xB0):
         lor(z, z->regs.b);
         break; // or b
-    case 0xB1:
+    OP(0xB1):
         lor(z, z->regs.c);
         break; // or c
-    case 0xB2:
+    OP(0xB2):
         lor(z, z->regs.d);
         break; // or d
-    case 0xB3:
+    OP(0xB3):
         lor(z, z->regs.e);
         break; // or e
-    case 0xB4:
+    OP(0xB4):
         lor(z, z->regs.h);
         break; // or h
-    case 0xB5:
+    OP(0xB5):
         lor(z, z->regs.l);
         break; // or l
-    case 0xB6:
+    OP(0xB6):
         lor(z, rb(z, get_hl(z)));
         break; // or (hl)
-    case 0xF6:
+    OP(0xF6):
         lor(z, nextb(z));
         break; // or *
 
-    case 0xBF:
+    OP(0xBF):
         cp(z, z->regs.a);
         break; // cp a
-    case 0xB8:
+    OP(0xB8):
         cp(z, z->regs.b);
         break; // cp b
-    case 0xB9:
+    OP(0xB9):
         cp(z, z->regs.c);
         break; // cp c
-    case 0xBA:
+    OP(0xBA):
         cp(z, z->regs.d);
         break; // cp d
-    case 0xBB:
+    OP(0xBB):
         cp(z, z->regs.e);
         break; // cp e
-    case 0xBC:
+    OP(0xBC):
         cp(z, z->regs.h);
         break; // cp h
-    case 0xBD:
+    OP(0xBD):
         cp(z, z->regs.l);
         break; // cp l
-    case 0xBE:
+    OP(0xBE):
         cp(z, rb(z, get_hl(z)));
         break; // cp (hl)
-    case 0xFE:
+    OP(0xFE):
         cp(z, nextb(z));
         break; // cp *
 
-    case 0xC3:
+    OP(0xC3):
         jump(z, nextw(z));
         break; // jm **
-    case 0xC2:
-        cond_jump(z, z->regs.zf == 0);
+    OP(0xC2):
+        cond_jump(z, !flag_z(z));
         break; // jp nz, **
-    case 0xCA:
-        cond_jump(z, z->regs.zf == 1);
+    OP(0xCA):
+        cond_jump(z, flag_z(z));
         break; // jp z, **
-    case 0xD2:
-        cond_jump(z, z->regs.cf == 0);
+    OP(0xD2):
+        cond_jump(z, !flag_c(z));
         break; // jp nc, **
-    case 0xDA:
-        cond_jump(z, z->regs.cf == 1);
+    OP(0xDA):
+        cond_jump(z, flag_c(z));
         break; // jp c, **
-    case 0xE2:
-        cond_jump(z, z->regs.pf == 0);
+    OP(0xE2):
+        cond_jump(z, !flag(z, Z80_FLAG_PV));
         break; // jp po, **
-    case 0xEA:
-        cond_jump(z, z->regs.pf == 1);
+    OP(0xEA):
+        cond_jump(z, flag(z, Z80_FLAG_PV));
         break; // jp pe, **
-    case 0xF2:
-        cond_jump(z, z->regs.sf == 0);
+    OP(0xF2):
+        cond_jump(z, !flag(z, Z80_FLAG_S));
         break; // jp p, **
-    case 0xFA:
-        cond_jump(z, z->regs.sf == 1);
+    OP(0xFA):
+        cond_jump(z, flag(z, Z80_FLAG_S));
         break; // jp m, **
 
-    case 0x10:
+    OP(0x10):
         cond_jr(z, --z->regs.b != 0);
         break; // djnz *
-    case 0x18:
+    OP(0x18):
         z->regs.pc += (int8_t)nextb(z);
         break; // jr *
-    case 0x20:
-        cond_jr(z, z->regs.zf == 0);
+    OP(0x20):
+        cond_jr(z, !flag_z(z));
         break; // jr nz, *
-    case 0x28:
-        cond_jr(z, z->regs.zf == 1);
+    OP(0x28):
+        cond_jr(z, flag_z(z));
         break; // jr z, *
-    case 0x30:
-        cond_jr(z, z->regs.cf == 0);
+    OP(0x30):
+        cond_jr(z, !flag_c(z));
         break; // jr nc, *
-    case 0x38:
-        cond_jr(z, z->regs.cf == 1);
+    OP(0x38):
+        cond_jr(z, flag_c(z));
         break; // jr c, *
 
-    case 0xE9:
+    OP(0xE9):
         z->regs.pc = get_hl(z);
         break; // jp (hl)
-    case 0xCD:
+    OP(0xCD):
         call(z, nextw(z));
         break; // call
 
-    case 0xC4:
-        cond_call(z, z->regs.zf == 0);
+    OP(0xC4):
+        cond_call(z, !flag_z(z));
         break; // cnz
-    case 0xCC:
-        cond_call(z, z->regs.zf == 1);
+    OP(0xCC):
+        cond_call(z, flag_z(z));
         break; // cz
-    case 0xD4:
-        cond_call(z, z->regs.cf == 0);
+    OP(0xD4):
+        cond_call(z, !flag_c(z));
         break; // cnc
-    case 0xDC:
-        cond_call(z, z->regs.cf == 1);
+    OP(0xDC):
+        cond_call(z, flag_c(z));
         break; // cc
-    case 0xE4:
-        cond_call(z, z->regs.pf == 0);
+    OP(0xE4):
+        cond_call(z, !flag(z, Z80_FLAG_PV));
         break; // cpo
-    case 0xEC:
-        cond_call(z, z->regs.pf == 1);
+    OP(0xEC):
+        cond_call(z, flag(z, Z80_FLAG_PV));
         break; // cpe
-    case 0xF4:
-        cond_call(z, z->regs.sf == 0);
+    OP(0xF4):
+        cond_call(z, !flag(z, Z80_FLAG_S));
         break; // cp
-    case 0xFC:
-        cond_call(z, z->regs.sf == 1);
+    OP(0xFC):
+        cond_call(z, flag(z, Z80_FLAG_S));
         break; // cm
 
-    case 0xC9:
+    OP(0xC9):
         ret(z);
         break; // ret
-    case 0xC0:
-        cond_ret(z, z->regs.zf == 0);
+    OP(0xC0):
+        cond_ret(z, !flag_z(z));
         break; // ret nz
-    case 0xC8:
-        cond_ret(z, z->regs.zf == 1);
+    OP(0xC8):
+        cond_ret(z, flag_z(z));
         break; // ret z
-    case 0xD0:
-        cond_ret(z, z->regs.cf == 0);
+    OP(0xD0):
+        cond_ret(z, !flag_c(z));
         break; // ret nc
-    case 0xD8:
-        cond_ret(z, z->regs.cf == 1);
+    OP(0xD8):
+        cond_ret(z, flag_c(z));
         break; // ret c
-    case 0xE0:
-        cond_ret(z, z->regs.pf == 0);
+    OP(0xE0):
+        cond_ret(z, !flag(z, Z80_FLAG_PV));
         break; // ret po
-    case 0xE8:
-        cond_ret(z, z->regs.pf == 1);
+    OP(0xE8):
+        cond_ret(z, flag(z, Z80_FLAG_PV));
         break; // ret pe
-    case 0xF0:
-        cond_ret(z, z->regs.sf == 0);
+    OP(0xF0):
+        cond_ret(z, !flag(z, Z80_FLAG_S));
         break; // ret p
-    case 0xF8:
-        cond_ret(z, z->regs.sf == 1);
+    OP(0xF8):
+        cond_ret(z, flag(z, Z80_FLAG_S));
         break; // ret m
 
-    case 0xC7:
+    OP(0xC7):
         call(z, 0x00);
         break; // rst 0
-    case 0xCF:
+    OP(0xCF):
         call(z, 0x08);
         break; // rst 1
-    case 0xD7:
+    OP(0xD7):
         call(z, 0x10);
         break; // rst 2
-    case 0xDF:
+    OP(0xDF):
         call(z, 0x18);
         break; // rst 3
-    case 0xE7:
+    OP(0xE7):
         call(z, 0x20);
         break; // rst 4
-    case 0xEF:
+    OP(0xEF):
         call(z, 0x28);
         break; // rst 5
-    case 0xF7:
+    OP(0xF7):
         call(z, 0x30);
         break; // rst 6
-    case 0xFF:
+    OP(0xFF):
         call(z, 0x38);
         break; // rst 7
 
-    case 0xC5:
+    OP(0xC5):
         pushw(z, get_bc(z));
         break; // push bc
-    case 0xD5:
+    OP(0xD5):
         pushw(z, get_de(z));
         break; // push de
-    case 0xE5:
+    OP(0xE5):
         pushw(z, get_hl(z));
         break; // push hl
-    case 0xF5:
+    OP(0xF5):
         pushw(z, (z->regs.a << 8) | get_f(z));
         break; // push af
 
-    case 0xC1:
+    OP(0xC1):
         set_bc(z, popw(z));
         break; // pop bc
-    case 0xD1:
+    OP(0xD1):
         set_de(z, popw(z));
         break; // pop de
-    case 0xE1:
+    OP(0xE1):
         set_hl(z, popw(z));
         break; // pop hl
-    case 0xF1:
+    OP(0xF1):
     {
         uint16_t val = popw(z);
         z->regs.a = val >> 8;
@@ -1952,7 +3293,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // pop af
 
-    case 0xDB:
+    OP(0xDB):
     {
         const uint8_t port_low = nextb(z);
         const uint8_t a = z->regs.a;
@@ -1963,7 +3304,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // in a,(n)
 
-    case 0xD3:
+    OP(0xD3):
     {
         const uint8_t port_low = nextb(z);
         // Full 16-bit port address: high byte = A, low byte = immediate operand
@@ -1973,7 +3314,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // out (n), a
 
-    case 0x08:
+    OP(0x08):
     {
         uint8_t a = z->regs.a;
         uint8_t f = get_f(z);
@@ -1985,7 +3326,7 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
         z->regs.f_ = f;
     }
     break; // ex af,af'
-    case 0xD9:
+    OP(0xD9):
     {
         uint8_t b = z->regs.b, c = z->regs.c, d = z->regs.d, e = z->regs.e, h = z->regs.h, l = z->regs.l;
 
@@ -2005,16 +3346,16 @@ int exec_opcode(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // exx
 
-    case 0xCB:
+    OP(0xCB):
         exec_opcode_cb(z, nextb(z));
         break;
-    case 0xED:
+    OP(0xED):
         exec_opcode_ed(z, nextb(z));
         break;
-    case 0xDD:
+    OP(0xDD):
         exec_opcode_ddfd(z, nextb(z), &z->regs.ix);
         break;
-    case 0xFD:
+    OP(0xFD):
         exec_opcode_ddfd(z, nextb(z), &z->regs.iy);
         break;
 
@@ -2037,290 +3378,328 @@ int exec_opcode_ddfd(z80_emulator_t *const z, uint8_t opcode, uint16_t *const iz
 #define IZH (*iz >> 8)
 #define IZL (*iz & 0xFF)
 
+#ifdef Z80_COMPUTED_GOTO
+    static const void *const dispatch_ddfd[256] = {
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_0x09, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_0x19, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_0x21, &&op_0x22, &&op_0x23, &&op_0x24, &&op_0x25, &&op_0x26, &&op_default,
+        &&op_default, &&op_0x29, &&op_0x2A, &&op_0x2B, &&op_0x2C, &&op_0x2D, &&op_0x2E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x34, &&op_0x35, &&op_0x36, &&op_default,
+        &&op_default, &&op_0x39, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x44, &&op_0x45, &&op_0x46, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x4C, &&op_0x4D, &&op_0x4E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x54, &&op_0x55, &&op_0x56, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x5C, &&op_0x5D, &&op_0x5E, &&op_default,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67,
+        &&op_0x68, &&op_0x69, &&op_0x6A, &&op_0x6B, &&op_0x6C, &&op_0x6D, &&op_0x6E, &&op_0x6F,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_default, &&op_0x77,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x84, &&op_0x85, &&op_0x86, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x94, &&op_0x95, &&op_0x96, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0x9C, &&op_0x9D, &&op_0x9E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_0xCB, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_0xE1, &&op_default, &&op_0xE3, &&op_default, &&op_0xE5, &&op_default, &&op_default,
+        &&op_default, &&op_0xE9, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_0xF9, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default
+    };
+    goto *dispatch_ddfd[opcode];
+#endif
+
     switch (opcode)
     {
-    case 0xE1:
+    OP(0xE1):
         *iz = popw(z);
         break; // pop iz
-    case 0xE5:
+    OP(0xE5):
         pushw(z, *iz);
         break; // push iz
 
-    case 0xE9:
+    OP(0xE9):
         jump(z, *iz);
         break; // jp iz
 
-    case 0x09:
+    OP(0x09):
         addiz(z, iz, get_bc(z));
         break; // add iz,bc
-    case 0x19:
+    OP(0x19):
         addiz(z, iz, get_de(z));
         break; // add iz,de
-    case 0x29:
+    OP(0x29):
         addiz(z, iz, *iz);
         break; // add iz,iz
-    case 0x39:
+    OP(0x39):
         addiz(z, iz, z->regs.sp);
         break; // add iz,sp
 
-    case 0x84:
+    OP(0x84):
         z->regs.a = addb(z, z->regs.a, IZH, 0);
         break; // add a,izh
-    case 0x85:
+    OP(0x85):
         z->regs.a = addb(z, z->regs.a, *iz & 0xFF, 0);
         break; // add a,izl
-    case 0x8C:
-        z->regs.a = addb(z, z->regs.a, IZH, z->regs.cf);
+    OP(0x8C):
+        z->regs.a = addb(z, z->regs.a, IZH, flag_c(z));
         break; // adc a,izh
-    case 0x8D:
-        z->regs.a = addb(z, z->regs.a, *iz & 0xFF, z->regs.cf);
+    OP(0x8D):
+        z->regs.a = addb(z, z->regs.a, *iz & 0xFF, flag_c(z));
         break; // adc a,izl
 
-    case 0x86:
+    OP(0x86):
         z->regs.a = addb(z, z->regs.a, rb(z, IZD), 0);
         break; // add a,(iz+*)
-    case 0x8E:
-        z->regs.a = addb(z, z->regs.a, rb(z, IZD), z->regs.cf);
+    OP(0x8E):
+        z->regs.a = addb(z, z->regs.a, rb(z, IZD), flag_c(z));
         break; // adc a,(iz+*)
-    case 0x96:
+    OP(0x96):
         z->regs.a = subb(z, z->regs.a, rb(z, IZD), 0);
         break; // sub (iz+*)
-    case 0x9E:
-        z->regs.a = subb(z, z->regs.a, rb(z, IZD), z->regs.cf);
+    OP(0x9E):
+        z->regs.a = subb(z, z->regs.a, rb(z, IZD), flag_c(z));
         break; // sbc (iz+*)
 
-    case 0x94:
+    OP(0x94):
         z->regs.a = subb(z, z->regs.a, IZH, 0);
         break; // sub izh
-    case 0x95:
+    OP(0x95):
         z->regs.a = subb(z, z->regs.a, *iz & 0xFF, 0);
         break; // sub izl
-    case 0x9C:
-        z->regs.a = subb(z, z->regs.a, IZH, z->regs.cf);
+    OP(0x9C):
+        z->regs.a = subb(z, z->regs.a, IZH, flag_c(z));
         break; // sbc izh
-    case 0x9D:
-        z->regs.a = subb(z, z->regs.a, *iz & 0xFF, z->regs.cf);
+    OP(0x9D):
+        z->regs.a = subb(z, z->regs.a, *iz & 0xFF, flag_c(z));
         break; // sbc izl
 
-    case 0xA6:
+    OP(0xA6):
         land(z, rb(z, IZD));
         break; // and (iz+*)
-    case 0xA4:
+    OP(0xA4):
         land(z, IZH);
         break; // and izh
-    case 0xA5:
+    OP(0xA5):
         land(z, *iz & 0xFF);
         break; // and izl
 
-    case 0xAE:
+    OP(0xAE):
         lxor(z, rb(z, IZD));
         break; // xor (iz+*)
-    case 0xAC:
+    OP(0xAC):
         lxor(z, IZH);
         break; // xor izh
-    case 0xAD:
+    OP(0xAD):
         lxor(z, *iz & 0xFF);
         break; // xor izl
 
-    case 0xB6:
+    OP(0xB6):
         lor(z, rb(z, IZD));
         break; // or (iz+*)
-    case 0xB4:
+    OP(0xB4):
         lor(z, IZH);
         break; // or izh
-    case 0xB5:
+    OP(0xB5):
         lor(z, *iz & 0xFF);
         break; // or izl
 
-    case 0xBE:
+    OP(0xBE):
         cp(z, rb(z, IZD));
         break; // cp (iz+*)
-    case 0xBC:
+    OP(0xBC):
         cp(z, IZH);
         break; // cp izh
-    case 0xBD:
+    OP(0xBD):
         cp(z, *iz & 0xFF);
         break; // cp izl
 
-    case 0x23:
+    OP(0x23):
         *iz += 1;
         break; // inc iz
-    case 0x2B:
+    OP(0x2B):
         *iz -= 1;
         break; // dec iz
 
-    case 0x34:
+    OP(0x34):
     {
         uint16_t addr = IZD;
         wb(z, addr, inc(z, rb(z, addr)));
     }
     break; // inc (iz+*)
 
-    case 0x35:
+    OP(0x35):
     {
         uint16_t addr = IZD;
         wb(z, addr, dec(z, rb(z, addr)));
     }
     break; // dec (iz+*)
 
-    case 0x24:
+    OP(0x24):
         *iz = IZL | ((inc(z, IZH)) << 8);
         break; // inc izh
-    case 0x25:
+    OP(0x25):
         *iz = IZL | ((dec(z, IZH)) << 8);
         break; // dec izh
-    case 0x2C:
+    OP(0x2C):
         *iz = (IZH << 8) | inc(z, IZL);
         break; // inc izl
-    case 0x2D:
+    OP(0x2D):
         *iz = (IZH << 8) | dec(z, IZL);
         break; // dec izl
 
-    case 0x2A:
+    OP(0x2A):
         *iz = rw(z, nextw(z));
         break; // ld iz,(**)
-    case 0x22:
+    OP(0x22):
         ww(z, nextw(z), *iz);
         break; // ld (**),iz
-    case 0x21:
+    OP(0x21):
         *iz = nextw(z);
         break; // ld iz,**
 
-    case 0x36:
+    OP(0x36):
     {
         uint16_t addr = IZD;
         wb(z, addr, nextb(z));
     }
     break; // ld (iz+*),*
 
-    case 0x70:
+    OP(0x70):
         wb(z, IZD, z->regs.b);
         break; // ld (iz+*),b
-    case 0x71:
+    OP(0x71):
         wb(z, IZD, z->regs.c);
         break; // ld (iz+*),c
-    case 0x72:
+    OP(0x72):
         wb(z, IZD, z->regs.d);
         break; // ld (iz+*),d
-    case 0x73:
+    OP(0x73):
         wb(z, IZD, z->regs.e);
         break; // ld (iz+*),e
-    case 0x74:
+    OP(0x74):
         wb(z, IZD, z->regs.h);
         break; // ld (iz+*),h
-    case 0x75:
+    OP(0x75):
         wb(z, IZD, z->regs.l);
         break; // ld (iz+*),l
-    case 0x77:
+    OP(0x77):
         wb(z, IZD, z->regs.a);
         break; // ld (iz+*),a
 
-    case 0x46:
+    OP(0x46):
         z->regs.b = rb(z, IZD);
         break; // ld b,(iz+*)
-    case 0x4E:
+    OP(0x4E):
         z->regs.c = rb(z, IZD);
         break; // ld c,(iz+*)
-    case 0x56:
+    OP(0x56):
         z->regs.d = rb(z, IZD);
         break; // ld d,(iz+*)
-    case 0x5E:
+    OP(0x5E):
         z->regs.e = rb(z, IZD);
         break; // ld e,(iz+*)
-    case 0x66:
+    OP(0x66):
         z->regs.h = rb(z, IZD);
         break; // ld h,(iz+*)
-    case 0x6E:
+    OP(0x6E):
         z->regs.l = rb(z, IZD);
         break; // ld l,(iz+*)
-    case 0x7E:
+    OP(0x7E):
         z->regs.a = rb(z, IZD);
         break; // ld a,(iz+*)
 
-    case 0x44:
+    OP(0x44):
         z->regs.b = IZH;
         break; // ld b,izh
-    case 0x4C:
+    OP(0x4C):
         z->regs.c = IZH;
         break; // ld c,izh
-    case 0x54:
+    OP(0x54):
         z->regs.d = IZH;
         break; // ld d,izh
-    case 0x5C:
+    OP(0x5C):
         z->regs.e = IZH;
         break; // ld e,izh
-    case 0x7C:
+    OP(0x7C):
         z->regs.a = IZH;
         break; // ld a,izh
-    case 0x45:
+    OP(0x45):
         z->regs.b = IZL;
         break; // ld b,izl
-    case 0x4D:
+    OP(0x4D):
         z->regs.c = IZL;
         break; // ld c,izl
-    case 0x55:
+    OP(0x55):
         z->regs.d = IZL;
         break; // ld d,izl
-    case 0x5D:
+    OP(0x5D):
         z->regs.e = IZL;
         break; // ld e,izl
-    case 0x7D:
+    OP(0x7D):
         z->regs.a = IZL;
         break; // ld a,izl
 
-    case 0x60:
+    OP(0x60):
         *iz = IZL | (z->regs.b << 8);
         break; // ld izh,b
-    case 0x61:
+    OP(0x61):
         *iz = IZL | (z->regs.c << 8);
         break; // ld izh,c
-    case 0x62:
+    OP(0x62):
         *iz = IZL | (z->regs.d << 8);
         break; // ld izh,d
-    case 0x63:
+    OP(0x63):
         *iz = IZL | (z->regs.e << 8);
         break; // ld izh,e
-    case 0x64:
+    OP(0x64):
         break; // ld izh,izh
-    case 0x65:
+    OP(0x65):
         *iz = (IZL << 8) | IZL;
         break; // ld izh,izl
-    case 0x67:
+    OP(0x67):
         *iz = IZL | (z->regs.a << 8);
         break; // ld izh,a
-    case 0x26:
+    OP(0x26):
         *iz = IZL | (nextb(z) << 8);
         break; // ld izh,*
 
-    case 0x68:
+    OP(0x68):
         *iz = (IZH << 8) | z->regs.b;
         break; // ld izl,b
-    case 0x69:
+    OP(0x69):
         *iz = (IZH << 8) | z->regs.c;
         break; // ld izl,c
-    case 0x6A:
+    OP(0x6A):
         *iz = (IZH << 8) | z->regs.d;
         break; // ld izl,d
-    case 0x6B:
+    OP(0x6B):
         *iz = (IZH << 8) | z->regs.e;
         break; // ld izl,e
-    case 0x6C:
+    OP(0x6C):
         *iz = (IZH << 8) | IZH;
         break; // ld izl,izh
-    case 0x6D:
+    OP(0x6D):
         break; // ld izl,izl
-    case 0x6F:
+    OP(0x6F):
         *iz = (IZH << 8) | z->regs.a;
         break; // ld izl,a
-    case 0x2E:
+    OP(0x2E):
         *iz = (IZH << 8) | nextb(z);
         break; // ld izl,*
 
-    case 0xF9:
+    OP(0xF9):
         z->regs.sp = *iz;
         break; // ld sp,iz
 
-    case 0xE3:
+    OP(0xE3):
     {
         const uint16_t val = rw(z, z->regs.sp);
         ww(z, z->regs.sp, *iz);
@@ -2329,7 +3708,7 @@ int exec_opcode_ddfd(z80_emulator_t *const z, uint8_t opcode, uint16_t *const iz
     }
     break; // ex (sp),iz
 
-    case 0xCB:
+    OP(0xCB):
     {
         uint16_t addr = IZD;
         uint8_t op = nextb(z);
@@ -2337,7 +3716,7 @@ int exec_opcode_ddfd(z80_emulator_t *const z, uint8_t opcode, uint16_t *const iz
     }
     break;
 
-    default:
+    OP_DEFAULT:
     {
         // any other FD/DD opcode behaves as a non-prefixed opcode:
         exec_opcode(z, opcode);
@@ -2437,8 +3816,7 @@ int exec_opcode_cb(z80_emulator_t *const z, uint8_t opcode)
         // in bit (hl), x/y flags are handled differently:
         if (z_ == 6)
         {
-            z->regs.yf = GET_BIT(5, z->regs.mem_ptr >> 8);
-            z->regs.xf = GET_BIT(3, z->regs.mem_ptr >> 8);
+            set_flags_xy(z, z->regs.mem_ptr >> 8);
             z->cyc += 4;
         }
     }
@@ -2513,8 +3891,7 @@ int exec_opcode_dcb(z80_emulator_t *const z, uint8_t opcode, uint16_t addr)
     case 1:
     {
         result = cb_bit(z, val, y_);
-        z->regs.yf = GET_BIT(5, addr >> 8);
-        z->regs.xf = GET_BIT(3, addr >> 8);
+        set_flags_xy(z, addr >> 8);
     }
     break; // bit y,(iz+d)
     case 2:
@@ -2583,51 +3960,83 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     uint64_t cyc_before = z->cyc;
     z->cyc += cyc_ed[opcode];
     inc_r(z);
+#ifdef Z80_COMPUTED_GOTO
+    static const void *const dispatch_ed[256] = {
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43, &&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47,
+        &&op_0x48, &&op_0x49, &&op_0x4A, &&op_0x4B, &&op_0x4C, &&op_0x4D, &&op_default, &&op_0x4F,
+        &&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53, &&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57,
+        &&op_0x58, &&op_0x59, &&op_0x5A, &&op_0x5B, &&op_0x5C, &&op_0x5D, &&op_0x5E, &&op_0x5F,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67,
+        &&op_0x68, &&op_0x69, &&op_0x6A, &&op_0x6B, &&op_0x6C, &&op_0x6D, &&op_default, &&op_0x6F,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_default,
+        &&op_0x78, &&op_0x79, &&op_0x7A, &&op_0x7B, &&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_0xA3, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_0xAB, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_0xB3, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_0xBB, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+        &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default
+    };
+    goto *dispatch_ed[opcode];
+#endif
+
     switch (opcode)
     {
-    case 0x47:
+    OP(0x47):
         z->regs.i = z->regs.a;
         break; // ld i,a
-    case 0x4F:
+    OP(0x4F):
         z->regs.r = z->regs.a;
         break; // ld r,a
 
-    case 0x57:
+    OP(0x57):
         z->regs.a = z->regs.i;
-        z->regs.sf = z->regs.a >> 7;
-        z->regs.zf = z->regs.a == 0;
-        z->regs.hf = 0;
-        z->regs.nf = 0;
-        z->regs.pf = z->regs.iff2;
+        set_flags(z, (flags(z) & (Z80_FLAG_C | Z80_FLAGS_XY)) | (sz53_table[z->regs.a] & (Z80_FLAG_S | Z80_FLAG_Z)) |
+                         (z->regs.iff2 ? Z80_FLAG_PV : 0));
         break; // ld a,i
 
-    case 0x5F:
+    OP(0x5F):
         z->regs.a = z->regs.r;
-        z->regs.sf = z->regs.a >> 7;
-        z->regs.zf = z->regs.a == 0;
-        z->regs.hf = 0;
-        z->regs.nf = 0;
-        z->regs.pf = z->regs.iff2;
+        set_flags(z, (flags(z) & (Z80_FLAG_C | Z80_FLAGS_XY)) | (sz53_table[z->regs.a] & (Z80_FLAG_S | Z80_FLAG_Z)) |
+                         (z->regs.iff2 ? Z80_FLAG_PV : 0));
         break; // ld a,r
 
-    case 0x45:
-    case 0x55:
-    case 0x5D:
-    case 0x65:
-    case 0x6D:
-    case 0x75:
-    case 0x7D:
+    OP(0x45):
+    OP(0x55):
+    OP(0x5D):
+    OP(0x65):
+    OP(0x6D):
+    OP(0x75):
+    OP(0x7D):
         z->regs.iff1 = z->regs.iff2;
         ret(z);
         break; // retn
-    case 0x4D:
+    OP(0x4D):
         ret(z);
         break; // reti
 
-    case 0xA0:
+    OP(0xA0):
         ldi(z);
         break; // ldi
-    case 0xB0:
+    OP(0xB0):
     {
         ldi(z);
 
@@ -2640,10 +4049,10 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ldir
 
-    case 0xA8:
+    OP(0xA8):
         ldd(z);
         break; // ldd
-    case 0xB8:
+    OP(0xB8):
     {
         ldd(z);
 
@@ -2656,16 +4065,16 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // lddr
 
-    case 0xA1:
+    OP(0xA1):
         cpi(z);
         break; // cpi
-    case 0xA9:
+    OP(0xA9):
         cpd(z);
         break; // cpd
-    case 0xB1:
+    OP(0xB1):
     {
         cpi(z);
-        if (get_bc(z) != 0 && !z->regs.zf)
+        if (get_bc(z) != 0 && !flag_z(z))
         {
             z->regs.pc -= 2;
             z->cyc += 5;
@@ -2677,10 +4086,10 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
         }
     }
     break; // cpir
-    case 0xB9:
+    OP(0xB9):
     {
         cpd(z);
-        if (get_bc(z) != 0 && !z->regs.zf)
+        if (get_bc(z) != 0 && !flag_z(z))
         {
             z->regs.pc -= 2;
             z->cyc += 5;
@@ -2692,39 +4101,39 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // cpdr
 
-    case 0x40:
+    OP(0x40):
         in_r_c(z, &z->regs.b);
         break; // in b, (c)
-    case 0x48:
+    OP(0x48):
         in_r_c(z, &z->regs.c);
         break; // in c, (c)
-    case 0x50:
+    OP(0x50):
         in_r_c(z, &z->regs.d);
         break; // in d, (c)
-    case 0x58:
+    OP(0x58):
         in_r_c(z, &z->regs.e);
         break; // in e, (c)
-    case 0x60:
+    OP(0x60):
         in_r_c(z, &z->regs.h);
         break; // in h, (c)
-    case 0x68:
+    OP(0x68):
         in_r_c(z, &z->regs.l);
         break; // in l, (c)
-    case 0x70:
+    OP(0x70):
     {
         uint8_t val;
         in_r_c(z, &val);
     }
     break; // in (c)
-    case 0x78:
+    OP(0x78):
         in_r_c(z, &z->regs.a);
         z->regs.mem_ptr = get_bc(z) + 1;
         break; // in a, (c)
 
-    case 0xA2:
+    OP(0xA2):
         ini(z);
         break; // ini
-    case 0xB2:
+    OP(0xB2):
         ini(z);
         if (z->regs.b > 0)
         {
@@ -2732,10 +4141,10 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
             z->cyc += 5;
         }
         break; // inir
-    case 0xAA:
+    OP(0xAA):
         ind(z);
         break; // ind
-    case 0xBA:
+    OP(0xBA):
         ind(z);
         if (z->regs.b > 0)
         {
@@ -2744,36 +4153,36 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
         }
         break; // indr
 
-    case 0x41:
-        z80_write_io_internal(z, z->regs.c, z->regs.b);
+    OP(0x41):
+        z80_write_io_internal(z, get_bc(z), z->regs.b);
         break; // out (c), b
-    case 0x49:
-        z80_write_io_internal(z, z->regs.c, z->regs.c);
+    OP(0x49):
+        z80_write_io_internal(z, get_bc(z), z->regs.c);
         break; // out (c), c
-    case 0x51:
-        z80_write_io_internal(z, z->regs.c, z->regs.d);
+    OP(0x51):
+        z80_write_io_internal(z, get_bc(z), z->regs.d);
         break; // out (c), d
-    case 0x59:
-        z80_write_io_internal(z, z->regs.c, z->regs.e);
+    OP(0x59):
+        z80_write_io_internal(z, get_bc(z), z->regs.e);
         break; // out (c), e
-    case 0x61:
-        z80_write_io_internal(z, z->regs.c, z->regs.h);
+    OP(0x61):
+        z80_write_io_internal(z, get_bc(z), z->regs.h);
         break; // out (c), h
-    case 0x69:
-        z80_write_io_internal(z, z->regs.c, z->regs.l);
+    OP(0x69):
+        z80_write_io_internal(z, get_bc(z), z->regs.l);
         break; // out (c), l
-    case 0x71:
-        z80_write_io_internal(z, z->regs.c, 0);
+    OP(0x71):
+        z80_write_io_internal(z, get_bc(z), 0);
         break; // out (c), 0
-    case 0x79:
-        z80_write_io_internal(z, z->regs.c, z->regs.a);
+    OP(0x79):
+        z80_write_io_internal(z, get_bc(z), z->regs.a);
         z->regs.mem_ptr = get_bc(z) + 1;
         break; // out (c), a
 
-    case 0xA3:
+    OP(0xA3):
         outi(z);
         break; // outi
-    case 0xB3:
+    OP(0xB3):
     {
         outi(z);
         if (z->regs.b > 0)
@@ -2783,10 +4192,10 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
         }
     }
     break; // otir
-    case 0xAB:
+    OP(0xAB):
         outd(z);
         break; // outd
-    case 0xBB:
+    OP(0xBB):
     {
         outd(z);
         if (z->regs.b > 0)
@@ -2796,33 +4205,33 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // otdr
 
-    case 0x42:
+    OP(0x42):
         sbchl(z, get_bc(z));
         break; // sbc hl,bc
-    case 0x52:
+    OP(0x52):
         sbchl(z, get_de(z));
         break; // sbc hl,de
-    case 0x62:
+    OP(0x62):
         sbchl(z, get_hl(z));
         break; // sbc hl,hl
-    case 0x72:
+    OP(0x72):
         sbchl(z, z->regs.sp);
         break; // sbc hl,sp
 
-    case 0x4A:
+    OP(0x4A):
         adchl(z, get_bc(z));
         break; // adc hl,bc
-    case 0x5A:
+    OP(0x5A):
         adchl(z, get_de(z));
         break; // adc hl,de
-    case 0x6A:
+    OP(0x6A):
         adchl(z, get_hl(z));
         break; // adc hl,hl
-    case 0x7A:
+    OP(0x7A):
         adchl(z, z->regs.sp);
         break; // adc hl,sp
 
-    case 0x43:
+    OP(0x43):
     {
         const uint16_t addr = nextw(z);
         ww(z, addr, get_bc(z));
@@ -2830,7 +4239,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**), bc
 
-    case 0x53:
+    OP(0x53):
     {
         const uint16_t addr = nextw(z);
         ww(z, addr, get_de(z));
@@ -2838,7 +4247,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**), de
 
-    case 0x63:
+    OP(0x63):
     {
         const uint16_t addr = nextw(z);
         ww(z, addr, get_hl(z));
@@ -2846,7 +4255,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**), hl
 
-    case 0x73:
+    OP(0x73):
     {
         const uint16_t addr = nextw(z);
         ww(z, addr, z->regs.sp);
@@ -2854,7 +4263,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld (**),sp
 
-    case 0x4B:
+    OP(0x4B):
     {
         const uint16_t addr = nextw(z);
         set_bc(z, rw(z, addr));
@@ -2862,7 +4271,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld bc, (**)
 
-    case 0x5B:
+    OP(0x5B):
     {
         const uint16_t addr = nextw(z);
         set_de(z, rw(z, addr));
@@ -2870,7 +4279,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld de, (**)
 
-    case 0x6B:
+    OP(0x6B):
     {
         const uint16_t addr = nextw(z);
         set_hl(z, rw(z, addr));
@@ -2878,7 +4287,7 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld hl, (**)
 
-    case 0x7B:
+    OP(0x7B):
     {
         const uint16_t addr = nextw(z);
         z->regs.sp = rw(z, addr);
@@ -2886,66 +4295,54 @@ int exec_opcode_ed(z80_emulator_t *const z, uint8_t opcode)
     }
     break; // ld sp,(**)
 
-    case 0x44:
-    case 0x54:
-    case 0x64:
-    case 0x74:
-    case 0x4C:
-    case 0x5C:
-    case 0x6C:
-    case 0x7C:
+    OP(0x44):
+    OP(0x54):
+    OP(0x64):
+    OP(0x74):
+    OP(0x4C):
+    OP(0x5C):
+    OP(0x6C):
+    OP(0x7C):
         z->regs.a = subb(z, 0, z->regs.a, 0);
         break; // neg
 
-    case 0x46:
-    case 0x66:
+    OP(0x46):
+    OP(0x66):
         z->regs.im = 0;
         break; // im 0
-    case 0x56:
-    case 0x76:
+    OP(0x56):
+    OP(0x76):
         z->regs.im = 1;
         break; // im 1
-    case 0x5E:
-    case 0x7E:
+    OP(0x5E):
+    OP(0x7E):
         z->regs.im = 2;
         break; // im 2
-    case 0x67:
+    OP(0x67):
     {
         uint8_t a = z->regs.a;
         uint8_t val = rb(z, get_hl(z));
         z->regs.a = (a & 0xF0) | (val & 0xF);
         wb(z, get_hl(z), (val >> 4) | (a << 4));
 
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
-        z->regs.zf = z->regs.a == 0;
-        z->regs.sf = z->regs.a >> 7;
-        z->regs.pf = parity(z->regs.a);
+        set_flags(z, (flags(z) & Z80_FLAG_C) | sz53p_table[z->regs.a]);
         z->regs.mem_ptr = get_hl(z) + 1;
     }
     break; // rrd
 
-    case 0x6F:
+    OP(0x6F):
     {
         uint8_t a = z->regs.a;
         uint8_t val = rb(z, get_hl(z));
         z->regs.a = (a & 0xF0) | (val >> 4);
         wb(z, get_hl(z), (val << 4) | (a & 0xF));
 
-        z->regs.nf = 0;
-        z->regs.hf = 0;
-        z->regs.xf = GET_BIT(3, z->regs.a);
-        z->regs.yf = GET_BIT(5, z->regs.a);
-        z->regs.zf = z->regs.a == 0;
-        z->regs.sf = z->regs.a >> 7;
-        z->regs.pf = parity(z->regs.a);
+        set_flags(z, (flags(z) & Z80_FLAG_C) | sz53p_table[z->regs.a]);
         z->regs.mem_ptr = get_hl(z) + 1;
     }
     break; // rld
 
-    default:
+    OP_DEFAULT:
         fprintf(stderr, "unknown ED opcode: %02X\n", opcode);
         break;
     }
@@ -2975,10 +4372,13 @@ static void *z80_thread_func(void *arg)
             pthread_cond_wait(&z80->state_cond, &z80->state_lock);
         }
 
-        pthread_mutex_unlock(&z80->state_lock);
-
         if (!z80->running)
+        {
+            pthread_mutex_unlock(&z80->state_lock);
             break;
+        }
+        z80->stepping = 1;
+        pthread_mutex_unlock(&z80->state_lock);
 
         // Get cycle start time
         clock_gettime(CLOCK_MONOTONIC, &cycle_start);
@@ -2989,6 +4389,8 @@ static void *z80_thread_func(void *arg)
 
         pthread_mutex_lock(&z80->state_lock);
         z80->cyc += instruction_cycles;
+        z80->stepping = 0;
+        pthread_cond_broadcast(&z80->state_cond); // Wake a z80_pause() waiting for this instruction
         pthread_mutex_unlock(&z80->state_lock);
 
         // Get cycle end time
@@ -3048,6 +4450,7 @@ void z80_stop(z80_emulator_t *z80)
 
 /**
  * Pause Z80 emulation
+ * Waits for the instruction in flight, so the state is stable on return
  */
 void z80_pause(z80_emulator_t *z80)
 {
@@ -3056,6 +4459,8 @@ void z80_pause(z80_emulator_t *z80)
 
     pthread_mutex_lock(&z80->state_lock);
     z80->paused = 1;
+    while (z80->stepping)
+        pthread_cond_wait(&z80->state_cond, &z80->state_lock);
     pthread_mutex_unlock(&z80->state_lock);
 }
 
@@ -3075,11 +4480,10 @@ void z80_resume(z80_emulator_t *z80)
 
 /**
  * Save Z80 state to buffer
- * Saves only register state and cycle counter
+ * Saves registers (including pending lazy flags), the cycle counter and the
+ * halt and interrupt lines
  * Memory is managed externally and not saved here
  */
-#define Z80_STATE_SIZE (sizeof(z80_registers_t) + sizeof(uint64_t))
-
 size_t z80_save_state(z80_emulator_t *z80, uint8_t *buffer, size_t buffer_size)
 {
     if (!z80 || !buffer)
@@ -3099,6 +4503,12 @@ size_t z80_save_state(z80_emulator_t *z80, uint8_t *buffer, size_t buffer_size)
     memcpy(buffer + offset, &z80->cyc, sizeof(uint64_t));
     offset += sizeof(uint64_t);
 
+    // Save HALT state and interrupt lines
+    buffer[offset++] = z80->halted;
+    buffer[offset++] = z80->int_pending;
+    buffer[offset++] = z80->nmi_pending;
+    buffer[offset++] = z80->int_data;
+
     pthread_mutex_unlock(&z80->state_lock);
 
     return offset;
@@ -3106,7 +4516,7 @@ size_t z80_save_state(z80_emulator_t *z80, uint8_t *buffer, size_t buffer_size)
 
 /**
  * Load Z80 state from buffer
- * Restores only register state and cycle counter
+ * Restores everything z80_save_state() saved
  * Memory is managed externally and not restored here
  */
 int z80_load_state(z80_emulator_t *z80, const uint8_t *buffer, size_t buffer_size)
@@ -3116,11 +4526,10 @@ int z80_load_state(z80_emulator_t *z80, const uint8_t *buffer, size_t buffer_siz
     if (buffer_size < Z80_STATE_SIZE)
         return -1;
 
-    // Pause CPU while loading state
+    // Pause CPU while loading state (returns once no instruction is in flight)
     int was_running = z80->running;
     if (was_running)
         z80_pause(z80);
-    usleep(10000); // Give thread time to pause
 
     pthread_mutex_lock(&z80->state_lock);
 
@@ -3134,6 +4543,12 @@ int z80_load_state(z80_emulator_t *z80, const uint8_t *buffer, size_t buffer_siz
     memcpy(&z80->cyc, buffer + offset, sizeof(uint64_t));
     offset += sizeof(uint64_t);
 
+    // Load HALT state and interrupt lines
+    z80->halted = buffer[offset++] != 0;
+    z80->int_pending = buffer[offset++] != 0;
+    z80->nmi_pending = buffer[offset++] != 0;
+    z80->int_data = buffer[offset++];
+
     pthread_mutex_unlock(&z80->state_lock);
 
     // Resume if it was running
@@ -3221,6 +4636,33 @@ void z80_set_register(z80_emulator_t *z80, const char *reg_name, uint16_t value)
     pthread_mutex_unlock(&z80->state_lock);
 }
 
+/**
+ * Get program counter
+ */
+uint16_t z80_get_pc(z80_emulator_t *z80)
+{
+    if (!z80)
+        return 0;
+
+    pthread_mutex_lock(&z80->state_lock);
+    uint16_t pc = z80->regs.pc;
+    pthread_mutex_unlock(&z80->state_lock);
+    return pc;
+}
+
+/**
+ * Set program counter
+ */
+void z80_set_pc(z80_emulator_t *z80, uint16_t pc)
+{
+    if (!z80)
+        return;
+
+    pthread_mutex_lock(&z80->state_lock);
+    z80->regs.pc = pc;
+    pthread_mutex_unlock(&z80->state_lock);
+}
+
 /**
  * Get current CPU cycle count
  */
@@ -12,11 +12,29 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include "z80profile.h"
 
 // Z80 Configuration
 #define Z80_CLOCK_FREQ 3500000 // 3.5 MHz
 #define Z80_MAX_MEMORY 65536   // 64KB address space
-#define Z80_IO_PORTS 256       // Number of I/O ports
+#define Z80_IO_PORTS 65536     // Number of I/O ports (full 16-bit port address)
+#define Z80_MAX_PORT_DEVICES 16 // Port handlers per direction (at most 16: OUT uses a bit each), see z80_map_port_in()
+
+// Direct memory page table (1KB pages)
+#define Z80_PAGE_SHIFT 10
+#define Z80_PAGE_SIZE (1 << Z80_PAGE_SHIFT)
+#define Z80_PAGE_MASK (Z80_PAGE_SIZE - 1)
+#define Z80_NUM_PAGES (Z80_MAX_MEMORY >> Z80_PAGE_SHIFT)
+
+// Predecoded block cache, see z80_set_block_engine()
+#define Z80_BLOCK_CACHE_SIZE 4096 // Blocks, direct-mapped by start address
+#define Z80_BLOCK_MAX_OPS 16      // Instructions per block
+
+// Watchpoints, see z80_add_watchpoint()
+#define Z80_MAX_WATCHPOINTS 32
+#define Z80_WATCH_EXEC 0x01  // The instruction at the address is about to execute
+#define Z80_WATCH_READ 0x02  // Memory read (instruction fetches included)
+#define Z80_WATCH_WRITE 0x04 // Memory write
 
 // Z80 Register file
 typedef struct
@@ -27,8 +45,13 @@ typedef struct
     uint8_t a_, b_, c_, d_, e_, h_, l_, f_; // alternate registers
     uint8_t i, r;                           // interrupt vector, memory refresh
 
-    // flags: sign, zero, yf, half-carry, xf, parity/overflow, negative, carry
-    bool sf : 1, zf : 1, yf : 1, hf : 1, xf : 1, pf : 1, nf : 1, cf : 1;
+    // flags: F as a byte, evaluated lazily. While flag_op is non-zero the
+    // flags of the last 8-bit ALU operation are still pending and are
+    // computed from its operands/result on demand; use get_f()/set_f().
+    uint8_t f;
+    uint8_t flag_op;          // pending lazy flag operation (0 = f is valid)
+    uint8_t flag_a, flag_b;   // operands of the pending operation
+    uint16_t flag_res;        // 9-bit result of the pending operation
 
     // Interrupt/control
     uint8_t im;         // Interrupt mode (0, 1, or 2)
@@ -47,6 +70,11 @@ typedef void (*z80_write_io_t)(void *user_data, uint16_t port, uint8_t value);
 typedef uint8_t (*z80_read_memory_t)(void *user_data, uint16_t addr);
 typedef void (*z80_write_memory_t)(void *user_data, uint16_t addr, uint8_t value);
 
+// Execution trap callback: called instead of fetching the instruction at the
+// trap address. Return non-zero if the trap handled it (and set PC), or zero
+// to execute the instruction normally.
+typedef int (*z80_exec_trap_t)(void *user_data, uint16_t addr);
+
 // Context holder for both memory and I/O callbacks
 typedef struct
 {
@@ -54,12 +82,57 @@ typedef struct
     void *io_data;
 } z80_callback_context_t;
 
-// Port-specific I/O callback structure
+// Page mapping types for z80_map_pages()
+typedef enum
+{
+    Z80_PAGE_TRAP = 0, // Reads and writes go through memory callbacks
+    Z80_PAGE_RAM,      // Reads and writes go directly to host memory
+    Z80_PAGE_ROM       // Reads go directly to host memory, writes are discarded
+} z80_page_type_t;
+
+// Predecoded straight-line run of instructions (internal to z80.c)
+typedef struct z80_block_s z80_block_t;
+
+// Register a conditional watchpoint compares, see z80_watchpoint_t
+typedef enum
+{
+    Z80_WATCH_ALWAYS = 0, // No condition
+    Z80_WATCH_REG_A,
+    Z80_WATCH_REG_F,
+    Z80_WATCH_REG_B,
+    Z80_WATCH_REG_C,
+    Z80_WATCH_REG_D,
+    Z80_WATCH_REG_E,
+    Z80_WATCH_REG_H,
+    Z80_WATCH_REG_L,
+    Z80_WATCH_REG_AF,
+    Z80_WATCH_REG_BC,
+    Z80_WATCH_REG_DE,
+    Z80_WATCH_REG_HL,
+    Z80_WATCH_REG_IX,
+    Z80_WATCH_REG_IY,
+    Z80_WATCH_REG_SP
+} z80_watch_reg_t;
+
+// Watchpoint callback: kind is the Z80_WATCH_* access that fired and addr
+// its address (the PC for Z80_WATCH_EXEC). Return non-zero to stop the CPU,
+// or zero to carry on (e.g. to only count or log hits).
+typedef int (*z80_watch_fn_t)(void *user_data, int id, int kind, uint16_t addr);
+
+/**
+ * Breakpoint or watchpoint on an address range
+ * A PC breakpoint is a Z80_WATCH_EXEC watchpoint on a single address.
+ */
 typedef struct
 {
-    z80_read_io_t read_fn;   // Callback for IN instruction
-    z80_write_io_t write_fn; // Callback for OUT instruction
-} z80_port_callback_t;
+    uint16_t start;      // First address watched
+    uint16_t end;        // Last address watched (inclusive)
+    uint8_t kinds;       // Z80_WATCH_* mask (0 = free slot)
+    z80_watch_reg_t reg; // Fire only while this register...
+    uint16_t value;      // ...holds this value
+    z80_watch_fn_t fn;   // Hit callback
+    void *user_data;     // Passed to fn
+} z80_watchpoint_t;
 
 // Z80 Emulator state
 typedef struct
@@ -71,6 +144,7 @@ typedef struct
     volatile bool running;
     volatile bool paused;
     volatile bool halted;
+    volatile bool stepping; // CPU thread is executing an instruction
     volatile bool int_pending : 1, nmi_pending : 1;
     uint8_t int_data;
     pthread_mutex_t state_lock;
@@ -87,15 +161,68 @@ typedef struct
     z80_write_memory_t write_memory;
     void *user_data;
 
-    // Port-specific I/O callbacks
-    z80_port_callback_t port_callbacks[Z80_IO_PORTS];
+    // Direct memory page table: each entry points at the host byte backing
+    // the start of that 1KB page. NULL entries fall back to the callbacks.
+    uint8_t *read_pages[Z80_NUM_PAGES];
+    uint8_t *write_pages[Z80_NUM_PAGES];
+    uint8_t rom_sink[Z80_PAGE_SIZE]; // Write target for Z80_PAGE_ROM pages
+
+    // Write generations, counted per host page so that every Z80 page
+    // mapping the same host memory (e.g. a 128K bank paged in twice) shares
+    // one counter: page_gen points each Z80 page at its host page's counter
+    // in gen_counts, or at unmapped_gen. Bumped by each CPU write and remap,
+    // and by z80_invalidate_code(). A predecoded block is only reused while
+    // the generations of the pages holding its bytes are unchanged.
+    uint32_t *page_gen[Z80_NUM_PAGES];
+    const uint8_t *gen_hosts[Z80_NUM_PAGES]; // Host page owning each counter
+    uint32_t gen_counts[Z80_NUM_PAGES];
+    uint8_t gen_refs[Z80_NUM_PAGES];         // Z80 pages sharing each counter
+    uint32_t unmapped_gen;
+
+    // Port device map, resolved from the partial address decoding when a
+    // device is mapped: the handler index answering an IN of every 16-bit
+    // port (0 = no device, use read_io), and a bit per handler receiving an
+    // OUT to it (0 = no device, use write_io)
+    uint8_t port_in_map[Z80_IO_PORTS];
+    uint16_t port_out_map[Z80_IO_PORTS];
+    z80_read_io_t port_in_devices[Z80_MAX_PORT_DEVICES];
+    z80_write_io_t port_out_devices[Z80_MAX_PORT_DEVICES];
+    uint8_t port_in_device_count;
+    uint8_t port_out_device_count;
+
+    // Execution trap (e.g. ROM tape routine), see z80_set_exec_trap()
+    z80_exec_trap_t exec_trap;
+    void *exec_trap_data;
+    uint16_t exec_trap_addr;
+
+    // Hot-path profiler (NULL = off), see z80_set_profile()
+    z80_profile_t *profile;
+
+    // Predecoded block cache (NULL = interpreter only), see z80_set_block_engine()
+    z80_block_t *blocks;
+
+    // Watchpoints, see z80_add_watchpoint(). Pages with read or write
+    // watchpoints are left out of read_pages/write_pages, so only accesses
+    // to them take the slow path; mapped_read/mapped_write keep the mapping
+    // z80_map_pages() set up.
+    uint8_t *mapped_read[Z80_NUM_PAGES];
+    uint8_t *mapped_write[Z80_NUM_PAGES];
+    z80_watchpoint_t watchpoints[Z80_MAX_WATCHPOINTS];
+    uint8_t watch_map[Z80_MAX_MEMORY];  // Z80_WATCH_* kinds watched at each address
+    uint8_t watch_pages[Z80_NUM_PAGES]; // Kinds watched anywhere on each page
+    uint8_t watch_kinds;                // Kinds watched anywhere (0 = none set)
+    bool break_hit;                     // The last run stopped at a watchpoint
+    bool break_resume;                  // It stopped before break_pc: run that instruction next
+    uint16_t break_pc;
 } z80_emulator_t;
 
 // Z80 Flags (F register bits)
 #define Z80_FLAG_C 0x01  // Carry
 #define Z80_FLAG_N 0x02  // Subtract
 #define Z80_FLAG_PV 0x04 // Parity/Overflow
+#define Z80_FLAG_X 0x08  // Undocumented (copy of result bit 3)
 #define Z80_FLAG_H 0x10  // Half-carry
+#define Z80_FLAG_Y 0x20  // Undocumented (copy of result bit 5)
 #define Z80_FLAG_Z 0x40  // Zero
 #define Z80_FLAG_S 0x80  // Sign
 
@@ -123,9 +250,56 @@ void z80_set_memory_callbacks(z80_emulator_t *z80,
                               z80_write_memory_t write_fn,
                               void *user_data);
 
+/**
+ * Map a range of the address space directly onto host memory
+ * Mapped pages are accessed inline by the interpreter without calling the
+ * memory callbacks; Z80_PAGE_TRAP restores callback access for the range.
+ * @param z80 Emulator instance
+ * @param start First Z80 address (must be a multiple of Z80_PAGE_SIZE)
+ * @param length Length in bytes (must be a multiple of Z80_PAGE_SIZE)
+ * @param host Host memory backing `start` (ignored for Z80_PAGE_TRAP)
+ * @param type Page type
+ * @return 0 on success, -1 on invalid arguments
+ */
+int z80_map_pages(z80_emulator_t *z80,
+                  uint16_t start,
+                  uint32_t length,
+                  uint8_t *host,
+                  z80_page_type_t type);
+
+/**
+ * Map an IN device by partial address decoding
+ * The device answers every port where (port & mask) == match, the way
+ * Spectrum hardware decodes only a few address lines (the ULA is any even
+ * port: mask 0x0001, match 0x0000). The decoding is resolved into a 64K
+ * port table here, so an IN costs one table lookup. Only one device can
+ * drive the data bus: a later mapping takes over the IN ports it shares with
+ * earlier ones, so map the device that should win an overlap last.
+ * @param z80 Emulator instance
+ * @param mask Address lines the device decodes
+ * @param match Required value of those lines
+ * @param read_fn Callback returning the port value (gets the callback context)
+ * @return 0 on success, -1 if Z80_MAX_PORT_DEVICES handlers are already mapped
+ */
+int z80_map_port_in(z80_emulator_t *z80, uint16_t mask, uint16_t match, z80_read_io_t read_fn);
+
+/**
+ * Map an OUT device by partial address decoding
+ * Same decoding rules as z80_map_port_in(), but devices sharing a port all
+ * receive the write, in the order their handlers were first mapped (on the
+ * 128K, OUT 0x7FFC both sets the border and pages memory).
+ * @param z80 Emulator instance
+ * @param mask Address lines the device decodes
+ * @param match Required value of those lines
+ * @param write_fn Callback handling the written value (gets the callback context)
+ * @return 0 on success, -1 if Z80_MAX_PORT_DEVICES handlers are already mapped
+ */
+int z80_map_port_out(z80_emulator_t *z80, uint16_t mask, uint16_t match, z80_write_io_t write_fn);
+
 /**
  * Register port-specific IN callback
  * Called when CPU executes IN instruction for a specific port
+ * Shorthand for z80_map_port_in() decoding the low byte only.
  * @param z80 Emulator instance
  * @param port Port number (0-255)
  * @param read_fn Callback function that returns the port value
@@ -137,6 +311,7 @@ void z80_register_port_in(z80_emulator_t *z80,
 /**
  * Register port-specific OUT callback
  * Called when CPU executes OUT instruction for a specific port
+ * Shorthand for z80_map_port_out() decoding the low byte only.
  * @param z80 Emulator instance
  * @param port Port number (0-255)
  * @param write_fn Callback function that handles the written value
@@ -152,13 +327,106 @@ void z80_register_port_out(z80_emulator_t *z80,
  */
 void z80_set_io_callbacks(z80_emulator_t *z80, void *io_data);
 
+/**
+ * Set the execution trap
+ * Before each instruction fetch at addr, callback is called; if it returns
+ * non-zero the instruction is considered emulated and is not executed.
+ * Only one trap is supported; pass a NULL callback to clear it.
+ * @param z80 Emulator instance
+ * @param addr Address to trap
+ * @param callback Trap handler (NULL to clear)
+ * @param user_data User data passed to callback
+ */
+void z80_set_exec_trap(z80_emulator_t *z80, uint16_t addr, z80_exec_trap_t callback, void *user_data);
+
+/**
+ * Add a breakpoint or watchpoint
+ * Execute watchpoints fire before the instruction at an address runs, read
+ * and write watchpoints on every access to the range (in the middle of the
+ * instruction making it). If reg is set, the watchpoint only fires while
+ * that register holds value. A callback returning non-zero stops
+ * z80_run_until() or z80_step() with break_hit set: before an execute hit
+ * the instruction is not run (the next run executes it without firing
+ * again), after a read or write hit the instruction is completed.
+ * Only the pages holding watched addresses are checked, so the CPU runs at
+ * full speed while no watchpoint is set, and the block engine keeps
+ * running code that has only execute watchpoints.
+ * @param z80 Emulator instance
+ * @param watch Watchpoint to copy (kinds must be non-zero, start <= end)
+ * @return Watchpoint id, or -1 if the watchpoint is invalid or all
+ *         Z80_MAX_WATCHPOINTS are in use
+ */
+int z80_add_watchpoint(z80_emulator_t *z80, const z80_watchpoint_t *watch);
+
+/**
+ * Remove a watchpoint
+ * @param z80 Emulator instance
+ * @param id Id returned by z80_add_watchpoint()
+ * @return 0 on success, -1 if no such watchpoint is set
+ */
+int z80_remove_watchpoint(z80_emulator_t *z80, int id);
+
+/**
+ * Attach or detach a profiler
+ * While attached, every instruction and accepted interrupt is reported to
+ * the profile (a separate run loop, so a detached profiler costs nothing).
+ * @param z80 Emulator instance
+ * @param profile Profile to fill, or NULL to stop profiling
+ */
+void z80_set_profile(z80_emulator_t *z80, z80_profile_t *profile);
+
+/**
+ * Enable or disable the predecoded block engine
+ * z80_run_until() then decodes straight-line runs of common instructions
+ * into cached handler + operand records keyed by PC and replays them, and
+ * hands everything else (prefixed opcodes, stores, I/O, HALT, interrupts,
+ * the execution trap, profiling) to the interpreter. Results are identical
+ * to the interpreter's, instruction for instruction. A block that branches
+ * back to itself and comes round with every register but R unchanged is an
+ * idle loop (e.g. polling a variable the interrupt handler sets): its
+ * remaining iterations before target_cycle are skipped the way HALT is.
+ * z80_step() always interprets.
+ * @param z80 Emulator instance
+ * @param enabled true to use the block engine, false for the interpreter only
+ * @return 0 on success, -1 if the block cache cannot be allocated
+ */
+int z80_set_block_engine(z80_emulator_t *z80, bool enabled);
+
+/**
+ * Drop predecoded code for a range the host wrote behind the CPU's back
+ * Writes made by the CPU (including those routed to the write callback) and
+ * z80_map_pages() remaps are tracked already; call this after copying a
+ * snapshot, tape block or ROM straight into mapped host memory.
+ * @param z80 Emulator instance
+ * @param start First Z80 address written
+ * @param length Length in bytes (wraps at 64K; 0 does nothing)
+ */
+void z80_invalidate_code(z80_emulator_t *z80, uint16_t start, uint32_t length);
+
 /**
  * Execute a single Z80 instruction
  * @param z80 Emulator instance
- * @return Number of clock cycles consumed by the instruction
+ * @return Number of clock cycles consumed by the instruction (0 if an execute
+ *         watchpoint stopped the CPU before it)
  */
 int z80_step(z80_emulator_t *const z);
 
+/**
+ * Run instructions until the cycle counter reaches a target
+ * Executes whole instructions (with interrupt processing between them, as
+ * z80_step does) until z80->cyc >= target_cycle or max_instructions have run.
+ * The last instruction may overshoot target_cycle by a few T-states.
+ * A halted CPU that cannot accept an interrupt skips its NOPs up to
+ * target_cycle in one go (counting them as instructions and stepping R as
+ * the hardware does), so idle frames cost next to nothing. A watchpoint
+ * asking to stop ends the run early with break_hit set.
+ * @param z Emulator instance
+ * @param target_cycle Absolute cycle count to run up to
+ * @param max_instructions Instruction budget (UINT64_MAX for no limit)
+ * @return Number of instructions executed
+ */
+uint64_t z80_run_until(z80_emulator_t *const z, uint64_t target_cycle, uint64_t max_instructions);
+
 /**
  * Get register value by name
  * @param z80 Emulator instance
@@ -211,6 +479,7 @@ void z80_stop(z80_emulator_t *z80);
 
 /**
  * Pause emulation
+ * Returns once the instruction in flight (if any) has finished
  * @param z80 Emulator instance
  */
 void z80_pause(z80_emulator_t *z80);
@@ -221,6 +490,9 @@ void z80_pause(z80_emulator_t *z80);
  */
 void z80_resume(z80_emulator_t *z80);
 
+// Size of a z80_save_state() record: registers, cycle counter, HALT and interrupt lines
+#define Z80_STATE_SIZE (sizeof(z80_registers_t) + sizeof(uint64_t) + 4)
+
 /**
  * Save emulator state
  * @param z80 Emulator instance
@@ -246,6 +518,24 @@ int z80_load_state(z80_emulator_t *z80, const uint8_t *buffer, size_t buffer_siz
  */
 void z80_gen_int(z80_emulator_t *const z, uint8_t data);
 
+/**
+ * Release the interrupt line
+ * A pending interrupt that has not been accepted yet is dropped
+ * @param z Emulator instance
+ */
+void z80_clear_int(z80_emulator_t *const z);
+
+/**
+ * Set the F register
+ * @param z Emulator instance
+ * @param val New flag byte
+ */
 void set_f(z80_emulator_t *const z, uint8_t val);
+
+/**
+ * Get the F register, evaluating any pending lazy flags
+ * @param z Emulator instance
+ * @return Flag byte
+ */
 uint8_t get_f(z80_emulator_t *const z);
 #endif // Z80_H
@@ -0,0 +1,441 @@
+/**
+ * Z80 Hot-Path Profiler Implementation
+ */
+
+#include "z80profile.h"
+#include "disasm.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Call tree node kinds
+#define NODE_ROOT 0
+#define NODE_CALL 1
+#define NODE_INTERRUPT 2
+
+#define NODE_NONE UINT32_MAX // Empty hash slot
+#define PROFILE_INITIAL_NODES 1024
+
+/**
+ * One call chain: the chain of its parent plus one call target
+ */
+typedef struct
+{
+    uint32_t parent;  // Parent node (NODE_NONE for the root)
+    uint16_t addr;    // Call target or interrupt vector
+    uint8_t kind;     // NODE_*
+    uint64_t cycles;  // T-states spent in this chain (excluding callees)
+} profile_node_t;
+
+/**
+ * Shadow stack frame
+ */
+typedef struct
+{
+    uint32_t node; // Call tree node of the chain up to this frame
+    uint16_t sp;   // Where the return address was pushed
+    uint8_t kind;  // NODE_CALL or NODE_INTERRUPT
+} profile_frame_t;
+
+struct z80_profile_s
+{
+    // Per-PC histograms
+    uint64_t pc_count[65536];
+    uint64_t pc_cycles[65536];
+
+    // Per-opcode histograms
+    uint64_t op_count[Z80_PROFILE_PAGE_COUNT][256];
+    uint64_t op_cycles[Z80_PROFILE_PAGE_COUNT][256];
+
+    // Totals
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t interrupts;
+    uint64_t interrupt_cycles; // Interrupt responses and everything run inside handlers
+
+    // Call tree (node 0 is the root) and its child index
+    profile_node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *node_hash; // Node indexes by (parent, addr, kind), NODE_NONE = empty
+    uint32_t hash_size;  // Power of 2, at least twice node_capacity
+
+    // Shadow stack
+    profile_frame_t stack[Z80_PROFILE_MAX_DEPTH];
+    int depth;
+    int interrupt_depth; // Interrupt frames on the stack
+    uint32_t current;    // Node charged for executed instructions
+};
+
+static const char *const page_names[Z80_PROFILE_PAGE_COUNT] = {"", "CB", "ED", "DD", "FD", "DDCB", "FDCB"};
+
+static uint32_t node_hash_slot(const z80_profile_t *profile, uint32_t parent, uint16_t addr, uint8_t kind)
+{
+    uint32_t h = parent * 0x9E3779B1u ^ ((uint32_t)addr << 2 | kind) * 0x85EBCA77u;
+    return (h ^ (h >> 15)) & (profile->hash_size - 1);
+}
+
+/**
+ * Double the node array and rebuild the child index
+ */
+static int grow_nodes(z80_profile_t *profile)
+{
+    uint32_t capacity = profile->node_capacity * 2;
+    profile_node_t *nodes = realloc(profile->nodes, capacity * sizeof(profile_node_t));
+    if (!nodes)
+        return -1;
+    profile->nodes = nodes;
+
+    uint32_t *hash = malloc((size_t)capacity * 2 * sizeof(uint32_t));
+    if (!hash)
+        return -1;
+    free(profile->node_hash);
+    profile->node_hash = hash;
+    profile->hash_size = capacity * 2;
+    profile->node_capacity = capacity;
+    memset(hash, 0xFF, (size_t)profile->hash_size * sizeof(uint32_t));
+
+    for (uint32_t i = 1; i < profile->node_count; i++)
+    {
+        uint32_t slot = node_hash_slot(profile, nodes[i].parent, nodes[i].addr, nodes[i].kind);
+        while (hash[slot] != NODE_NONE)
+            slot = (slot + 1) & (profile->hash_size - 1);
+        hash[slot] = i;
+    }
+    return 0;
+}
+
+/**
+ * Find or add the child of a chain (the parent itself if the tree is full)
+ */
+static uint32_t child_node(z80_profile_t *profile, uint32_t parent, uint16_t addr, uint8_t kind)
+{
+    uint32_t slot = node_hash_slot(profile, parent, addr, kind);
+    while (profile->node_hash[slot] != NODE_NONE)
+    {
+        const profile_node_t *node = &profile->nodes[profile->node_hash[slot]];
+        if (node->parent == parent && node->addr == addr && node->kind == kind)
+            return profile->node_hash[slot];
+        slot = (slot + 1) & (profile->hash_size - 1);
+    }
+
+    // New chain: grow first (the rebuilt index moves the free slot)
+    if (profile->node_count == profile->node_capacity)
+    {
+        if (profile->node_capacity >= Z80_PROFILE_MAX_NODES || grow_nodes(profile) != 0)
+            return parent; // Tree full: charge the caller
+        slot = node_hash_slot(profile, parent, addr, kind);
+        while (profile->node_hash[slot] != NODE_NONE)
+            slot = (slot + 1) & (profile->hash_size - 1);
+    }
+
+    uint32_t index = profile->node_count++;
+    profile->nodes[index].parent = parent;
+    profile->nodes[index].addr = addr;
+    profile->nodes[index].kind = kind;
+    profile->nodes[index].cycles = 0;
+    profile->node_hash[slot] = index;
+    return index;
+}
+
+/**
+ * Drop frames whose return address slot is at or below sp (no longer live)
+ */
+static void unwind_to(z80_profile_t *profile, uint16_t sp)
+{
+    while (profile->depth > 0 && profile->stack[profile->depth - 1].sp <= sp)
+    {
+        profile->depth--;
+        if (profile->stack[profile->depth].kind == NODE_INTERRUPT)
+            profile->interrupt_depth--;
+    }
+    profile->current = profile->depth > 0 ? profile->stack[profile->depth - 1].node : 0;
+}
+
+/**
+ * Enter a call or interrupt whose return address was pushed at sp
+ */
+static void push_frame(z80_profile_t *profile, uint16_t addr, uint8_t kind, uint16_t sp)
+{
+    // A new return address at sp replaces any frame stored at or below it
+    unwind_to(profile, sp);
+
+    // Too deep: keep charging the deepest frame; the unwind rule stays exact
+    if (profile->depth == Z80_PROFILE_MAX_DEPTH)
+        return;
+
+    uint32_t node = child_node(profile, profile->current, addr, kind);
+    profile_frame_t *frame = &profile->stack[profile->depth++];
+    frame->node = node;
+    frame->sp = sp;
+    frame->kind = kind;
+    if (kind == NODE_INTERRUPT)
+        profile->interrupt_depth++;
+    profile->current = node;
+}
+
+z80_profile_t *z80_profile_create(void)
+{
+    z80_profile_t *profile = calloc(1, sizeof(z80_profile_t));
+    if (!profile)
+        return NULL;
+
+    profile->node_capacity = PROFILE_INITIAL_NODES;
+    profile->hash_size = PROFILE_INITIAL_NODES * 2;
+    profile->nodes = malloc(profile->node_capacity * sizeof(profile_node_t));
+    profile->node_hash = malloc(profile->hash_size * sizeof(uint32_t));
+    if (!profile->nodes || !profile->node_hash)
+    {
+        z80_profile_destroy(profile);
+        return NULL;
+    }
+    memset(profile->node_hash, 0xFF, profile->hash_size * sizeof(uint32_t));
+
+    // Root: code run outside any tracked call
+    profile->nodes[0].parent = NODE_NONE;
+    profile->nodes[0].addr = 0;
+    profile->nodes[0].kind = NODE_ROOT;
+    profile->nodes[0].cycles = 0;
+    profile->node_count = 1;
+    return profile;
+}
+
+void z80_profile_destroy(z80_profile_t *profile)
+{
+    if (!profile)
+        return;
+    free(profile->nodes);
+    free(profile->node_hash);
+    free(profile);
+}
+
+void z80_profile_instruction(z80_profile_t *profile, uint16_t pc, uint16_t pc_after, const uint8_t bytes[4],
+                             uint16_t sp_before, uint16_t sp_after, uint32_t cycles)
+{
+    // Opcode page and opcode
+    z80_profile_page_t page = Z80_PROFILE_PAGE_MAIN;
+    uint8_t op = bytes[0];
+    if (op == 0xCB || op == 0xED)
+    {
+        page = op == 0xCB ? Z80_PROFILE_PAGE_CB : Z80_PROFILE_PAGE_ED;
+        op = bytes[1];
+    }
+    else if (op == 0xDD || op == 0xFD)
+    {
+        int iy = op == 0xFD;
+        if (bytes[1] == 0xCB)
+        {
+            page = iy ? Z80_PROFILE_PAGE_FDCB : Z80_PROFILE_PAGE_DDCB;
+            op = bytes[3];
+        }
+        else
+        {
+            page = iy ? Z80_PROFILE_PAGE_FD : Z80_PROFILE_PAGE_DD;
+            op = bytes[1];
+        }
+    }
+
+    profile->instructions++;
+    profile->cycles += cycles;
+    profile->pc_count[pc]++;
+    profile->pc_cycles[pc] += cycles;
+    profile->op_count[page][op]++;
+    profile->op_cycles[page][op] += cycles;
+    profile->nodes[profile->current].cycles += cycles;
+    if (profile->interrupt_depth > 0)
+        profile->interrupt_cycles += cycles;
+
+    // Calls and returns: only when SP moved by exactly one return address
+    if (page == Z80_PROFILE_PAGE_ED)
+    {
+        if ((op & 0xC7) == 0x45 && sp_after == (uint16_t)(sp_before + 2)) // RETN, RETI
+            unwind_to(profile, (uint16_t)(sp_after - 1));
+    }
+    else if (page == Z80_PROFILE_PAGE_MAIN || page == Z80_PROFILE_PAGE_DD || page == Z80_PROFILE_PAGE_FD)
+    {
+        if ((op == 0xCD || (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7) && sp_after == (uint16_t)(sp_before - 2))
+            push_frame(profile, pc_after, NODE_CALL, sp_after); // CALL, CALL cc, RST
+        else if ((op == 0xC9 || (op & 0xC7) == 0xC0) && sp_after == (uint16_t)(sp_before + 2))
+            unwind_to(profile, (uint16_t)(sp_after - 1)); // RET, RET cc
+    }
+}
+
+void z80_profile_interrupt(z80_profile_t *profile, uint16_t vector, uint16_t sp_after, uint32_t cycles)
+{
+    profile->interrupts++;
+    push_frame(profile, vector, NODE_INTERRUPT, sp_after);
+
+    profile->cycles += cycles;
+    profile->interrupt_cycles += cycles;
+    profile->nodes[profile->current].cycles += cycles;
+}
+
+/**
+ * Print a call tree node's frame name
+ */
+static void write_frame_name(FILE *out, const profile_node_t *node)
+{
+    if (node->kind == NODE_ROOT)
+        fputs("z80", out);
+    else if (node->kind == NODE_INTERRUPT)
+        fprintf(out, "INT@0x%04X", node->addr);
+    else
+        fprintf(out, "0x%04X", node->addr);
+}
+
+void z80_profile_write_collapsed(const z80_profile_t *profile, FILE *out)
+{
+    uint32_t chain[Z80_PROFILE_MAX_DEPTH + 1];
+
+    for (uint32_t i = 0; i < profile->node_count; i++)
+    {
+        if (profile->nodes[i].cycles == 0)
+            continue;
+
+        int length = 0;
+        for (uint32_t n = i; n != NODE_NONE && length <= Z80_PROFILE_MAX_DEPTH; n = profile->nodes[n].parent)
+            chain[length++] = n;
+
+        for (int k = length - 1; k >= 0; k--)
+        {
+            write_frame_name(out, &profile->nodes[chain[k]]);
+            fputc(k > 0 ? ';' : ' ', out);
+        }
+        fprintf(out, "%llu\n", (unsigned long long)profile->nodes[i].cycles);
+    }
+}
+
+// Sort keys for the report (qsort has no context argument)
+static const uint64_t *sort_cycles;
+
+static int compare_by_cycles(const void *a, const void *b)
+{
+    uint64_t ca = sort_cycles[*(const uint32_t *)a];
+    uint64_t cb = sort_cycles[*(const uint32_t *)b];
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+void z80_profile_write_report(const z80_profile_t *profile, FILE *out, const uint8_t *memory)
+{
+    static uint32_t order[65536];
+    uint64_t total = profile->cycles;
+
+    fprintf(out, "Spettrum profile: %llu instructions, %llu T-states\n",
+            (unsigned long long)profile->instructions, (unsigned long long)total);
+    fprintf(out, "Interrupts: %llu accepted, %llu T-states in handlers (%.2f%%)\n",
+            (unsigned long long)profile->interrupts, (unsigned long long)profile->interrupt_cycles,
+            percent(profile->interrupt_cycles, total));
+    fprintf(out, "Call tree: %u call chains\n", profile->node_count);
+
+    // Hot PCs
+    uint32_t count = 0;
+    for (uint32_t pc = 0; pc < 65536; pc++)
+        if (profile->pc_count[pc])
+            order[count++] = pc;
+    sort_cycles = profile->pc_cycles;
+    qsort(order, count, sizeof(order[0]), compare_by_cycles);
+
+    fprintf(out, "\nHot PCs by T-states (%u addresses executed):\n", count);
+    fprintf(out, "  PC       T-states       %%       Count  Instruction\n");
+    for (uint32_t i = 0; i < count && i < Z80_PROFILE_REPORT_TOP; i++)
+    {
+        uint16_t pc = (uint16_t)order[i];
+        char text[64] = "";
+        if (memory)
+        {
+            uint8_t bytes[DISASM_MAX_LENGTH];
+            disasm_insn_t insn;
+            for (int k = 0; k < DISASM_MAX_LENGTH; k++)
+                bytes[k] = memory[(uint16_t)(pc + k)];
+            disasm_decode(bytes, pc, &insn);
+            disasm_format(&insn, text, sizeof(text));
+        }
+        fprintf(out, "  0x%04X %12llu %6.2f%% %11llu  %s\n", pc, (unsigned long long)profile->pc_cycles[pc],
+                percent(profile->pc_cycles[pc], total), (unsigned long long)profile->pc_count[pc], text);
+    }
+
+    // Hot opcodes (index = page * 256 + opcode)
+    static uint64_t op_cycles[Z80_PROFILE_PAGE_COUNT * 256];
+    count = 0;
+    for (uint32_t i = 0; i < Z80_PROFILE_PAGE_COUNT * 256; i++)
+    {
+        op_cycles[i] = profile->op_cycles[i / 256][i % 256];
+        if (profile->op_count[i / 256][i % 256])
+            order[count++] = i;
+    }
+    sort_cycles = op_cycles;
+    qsort(order, count, sizeof(order[0]), compare_by_cycles);
+
+    fprintf(out, "\nHot opcodes by T-states (%u opcodes executed):\n", count);
+    fprintf(out, "  Opcode      T-states       %%       Count  Instruction\n");
+    for (uint32_t i = 0; i < count && i < Z80_PROFILE_REPORT_TOP; i++)
+    {
+        uint32_t page = order[i] / 256;
+        uint8_t op = (uint8_t)(order[i] % 256);
+
+        // Decode the opcode with zero operands (and relative targets) for its name
+        uint8_t bytes[DISASM_MAX_LENGTH] = {op, 0, 0, 0};
+        if (page == Z80_PROFILE_PAGE_CB || page == Z80_PROFILE_PAGE_ED ||
+            page == Z80_PROFILE_PAGE_DD || page == Z80_PROFILE_PAGE_FD)
+        {
+            static const uint8_t prefixes[] = {0, 0xCB, 0xED, 0xDD, 0xFD};
+            bytes[0] = prefixes[page];
+            bytes[1] = op;
+        }
+        else if (page == Z80_PROFILE_PAGE_DDCB || page == Z80_PROFILE_PAGE_FDCB)
+        {
+            bytes[0] = page == Z80_PROFILE_PAGE_DDCB ? 0xDD : 0xFD;
+            bytes[1] = 0xCB;
+            bytes[3] = op;
+        }
+        disasm_insn_t insn;
+        char text[64];
+        disasm_decode(bytes, (uint16_t)-2, &insn);
+        disasm_format(&insn, text, sizeof(text));
+
+        char name[16];
+        snprintf(name, sizeof(name), "%s%s%02X", page_names[page], page ? " " : "", op);
+        fprintf(out, "  %-7s %12llu %6.2f%% %11llu  %s\n", name, (unsigned long long)op_cycles[order[i]],
+                percent(op_cycles[order[i]], total), (unsigned long long)profile->op_count[page][op], text);
+    }
+}
+
+int z80_profile_dump(const z80_profile_t *profile, const char *prefix, const uint8_t *memory)
+{
+    char filename[1024];
+    int result = 0;
+
+    snprintf(filename, sizeof(filename), "%s.txt", prefix);
+    FILE *out = fopen(filename, "w");
+    if (out)
+    {
+        z80_profile_write_report(profile, out, memory);
+        if (fclose(out) != 0)
+            result = -1;
+    }
+    else
+    {
+        fprintf(stderr, "Error: Cannot create profile report '%s'\n", filename);
+        result = -1;
+    }
+
+    snprintf(filename, sizeof(filename), "%s.folded", prefix);
+    out = fopen(filename, "w");
+    if (out)
+    {
+        z80_profile_write_collapsed(profile, out);
+        if (fclose(out) != 0)
+            result = -1;
+    }
+    else
+    {
+        fprintf(stderr, "Error: Cannot create collapsed stacks '%s'\n", filename);
+        result = -1;
+    }
+
+    return result;
+}
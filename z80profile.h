@@ -0,0 +1,115 @@
+/**
+ * Z80 Hot-Path Profiler for Spettrum (--profile)
+ *
+ * Attached to a CPU with z80_set_profile(), the core reports every
+ * instruction it executes: per-PC execution counts and T-states (64K-entry
+ * arrays), per-prefix/opcode counts and T-states, and the time spent inside
+ * interrupt handlers. A detached CPU runs its usual loop, so profiling costs
+ * nothing when off.
+ *
+ * Calls are tracked with a shadow stack built from taken CALL/RST and
+ * RET/RETI/RETN instructions (recognised by the SP moving by one word) and
+ * accepted interrupts. Each distinct chain of call targets is a node of a
+ * call tree that accumulates its own T-states, so the per-instruction cost
+ * is one add; the tree is only searched when a call is taken. Frames whose
+ * return address is dropped (POP, LD SP) are unwound by the next return
+ * that moves SP above them.
+ *
+ * Output: a text report (hot PCs with disassembly, hot opcodes, interrupt
+ * time) and the call tree in the collapsed-stack format read by
+ * flamegraph.pl and speedscope (e.g. "z80;INT@0x0038;0x02BF 1234": T-states
+ * spent in 0x02BF called from the IM 1 handler).
+ */
+
+#ifndef Z80PROFILE_H
+#define Z80PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Opcode pages of the per-opcode histogram
+typedef enum
+{
+    Z80_PROFILE_PAGE_MAIN = 0, // Unprefixed
+    Z80_PROFILE_PAGE_CB,
+    Z80_PROFILE_PAGE_ED,
+    Z80_PROFILE_PAGE_DD,
+    Z80_PROFILE_PAGE_FD,
+    Z80_PROFILE_PAGE_DDCB,
+    Z80_PROFILE_PAGE_FDCB,
+    Z80_PROFILE_PAGE_COUNT
+} z80_profile_page_t;
+
+// Deepest shadow stack tracked; deeper calls are charged to the deepest frame
+#define Z80_PROFILE_MAX_DEPTH 128
+
+// Call tree size limit (distinct call chains)
+#define Z80_PROFILE_MAX_NODES (1 << 20)
+
+// Hot PCs and opcodes listed in the text report
+#define Z80_PROFILE_REPORT_TOP 40
+
+/**
+ * Profiler context
+ */
+typedef struct z80_profile_s z80_profile_t;
+
+/**
+ * Create an empty profile
+ * @return Profile, or NULL on allocation failure
+ */
+z80_profile_t *z80_profile_create(void);
+
+/**
+ * Destroy a profile
+ * @param profile Profile (NULL is ignored)
+ */
+void z80_profile_destroy(z80_profile_t *profile);
+
+/**
+ * Record one executed instruction (called by the CPU core)
+ * @param profile Profile
+ * @param pc Address of the instruction
+ * @param pc_after PC after the instruction (the target of a taken call)
+ * @param bytes Up to 4 instruction bytes (prefix, opcode, operands)
+ * @param sp_before SP before the instruction
+ * @param sp_after SP after the instruction
+ * @param cycles T-states the instruction took
+ */
+void z80_profile_instruction(z80_profile_t *profile, uint16_t pc, uint16_t pc_after, const uint8_t bytes[4],
+                             uint16_t sp_before, uint16_t sp_after, uint32_t cycles);
+
+/**
+ * Record an accepted interrupt or NMI (called by the CPU core)
+ * @param profile Profile
+ * @param vector Address of the handler
+ * @param sp_after SP after the return address was pushed
+ * @param cycles T-states of the interrupt response
+ */
+void z80_profile_interrupt(z80_profile_t *profile, uint16_t vector, uint16_t sp_after, uint32_t cycles);
+
+/**
+ * Write the call tree in collapsed-stack format, one line per call chain
+ * @param profile Profile
+ * @param out Output stream
+ */
+void z80_profile_write_collapsed(const z80_profile_t *profile, FILE *out);
+
+/**
+ * Write the text report
+ * @param profile Profile
+ * @param out Output stream
+ * @param memory 64KB memory image used to disassemble hot PCs (NULL for none)
+ */
+void z80_profile_write_report(const z80_profile_t *profile, FILE *out, const uint8_t *memory);
+
+/**
+ * Write PREFIX.txt (report) and PREFIX.folded (collapsed stacks)
+ * @param profile Profile
+ * @param prefix Output file name prefix
+ * @param memory 64KB memory image for the report (NULL for none)
+ * @return 0 on success, -1 if a file could not be written
+ */
+int z80_profile_dump(const z80_profile_t *profile, const char *prefix, const uint8_t *memory);
+
+#endif
@@ -2,14 +2,20 @@
  * Z80 Snapshot File Handler - Implementation
  *
  * Loads .z80 snapshot files (versions 1, 2, and 3) and restores CPU and memory state.
+ * 128K snapshots are restored bank by bank into the machine's RAM banks.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
 
 #include "z80snapshot.h"
+#include "mapfile.h"
 
 /**
  * Decompress RLE-encoded memory block
@@ -32,10 +38,22 @@ int z80_decompress_block(const uint8_t *compressed, size_t comp_len,
 
     while (in_pos < comp_len && out_pos < decomp_len)
     {
-        uint8_t byte = compressed[in_pos++];
+        // Copy the literal bytes up to the next ED in one go
+        size_t span = comp_len - in_pos;
+        if (span > decomp_len - out_pos)
+            span = decomp_len - out_pos;
+        const uint8_t *marker = memchr(compressed + in_pos, 0xED, span);
+        size_t literal = marker ? (size_t)(marker - (compressed + in_pos)) : span;
+        memcpy(decompressed + out_pos, compressed + in_pos, literal);
+        in_pos += literal;
+        out_pos += literal;
+        if (!marker)
+            continue;
+
+        in_pos++; // Skip the ED
 
         // Check for RLE marker (ED ED)
-        if (byte == 0xED && in_pos < comp_len && compressed[in_pos] == 0xED)
+        if (in_pos < comp_len && compressed[in_pos] == 0xED)
         {
             in_pos++; // Skip second ED
 
@@ -64,8 +82,8 @@ int z80_decompress_block(const uint8_t *compressed, size_t comp_len,
         }
         else
         {
-            // Regular byte, just copy it
-            decompressed[out_pos++] = byte;
+            // A single ED is a regular byte
+            decompressed[out_pos++] = 0xED;
         }
     }
 
@@ -73,25 +91,87 @@ int z80_decompress_block(const uint8_t *compressed, size_t comp_len,
 }
 
 /**
- * Determine Z80 snapshot version from file
- * Version 1: PC is non-zero (program counter at 6-7)
- * Version 2/3: PC is zero (signal for extended format), followed by extra header
+ * Count the bytes equal to p[0] from p, at most max (compares 8 bytes at a time)
  */
-int z80_snapshot_get_version(const char *filename)
+static size_t z80_run_length(const uint8_t *p, size_t max)
 {
-    FILE *file = fopen(filename, "rb");
-    if (!file)
+    uint64_t pattern = p[0] * 0x0101010101010101ULL;
+    size_t run = 1;
+
+    while (run + 8 <= max)
+    {
+        uint64_t word;
+        memcpy(&word, p + run, sizeof(word));
+        if (word != pattern)
+            break;
+        run += 8;
+    }
+    while (run < max && p[run] == p[0])
+        run++;
+    return run;
+}
+
+/**
+ * Compress a memory block with the .z80 RLE scheme
+ */
+int z80_compress_block(const uint8_t *data, size_t len, uint8_t *compressed, size_t comp_cap)
+{
+    if (!data || !compressed)
         return -1;
 
-    uint8_t header[Z80_HEADER_SIZE];
-    size_t bytes_read = fread(header, 1, Z80_HEADER_SIZE, file);
-    fclose(file);
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+
+    while (in_pos < len)
+    {
+        uint8_t byte = data[in_pos];
+        size_t run = 1;
+        if (in_pos + 1 < len && data[in_pos + 1] == byte)
+            run = z80_run_length(data + in_pos, len - in_pos < 255 ? len - in_pos : 255);
+
+        // Runs of 5 or more pay for the 4-byte sequence; any repeated ED must be one
+        if (run >= 5 || (byte == 0xED && run >= 2))
+        {
+            if (out_pos + 4 > comp_cap)
+                return -1;
+            compressed[out_pos++] = 0xED;
+            compressed[out_pos++] = 0xED;
+            compressed[out_pos++] = (uint8_t)run;
+            compressed[out_pos++] = byte;
+            in_pos += run;
+        }
+        else if (byte == 0xED)
+        {
+            // A single ED is followed by a literal byte so it never starts a sequence
+            if (out_pos + 2 > comp_cap)
+                return -1;
+            compressed[out_pos++] = byte;
+            in_pos++;
+            if (in_pos < len)
+                compressed[out_pos++] = data[in_pos++];
+        }
+        else
+        {
+            if (out_pos + run > comp_cap)
+                return -1;
+            while (run-- > 0)
+                compressed[out_pos++] = data[in_pos++];
+        }
+    }
+
+    return (int)out_pos;
+}
 
-    if (bytes_read < Z80_HEADER_SIZE)
+/**
+ * Determine the snapshot version from the start of an image
+ */
+static int z80_image_version(const uint8_t *image, size_t size)
+{
+    if (size < Z80_HEADER_SIZE)
         return -1;
 
     // Read PC from bytes 6-7 (little-endian)
-    uint16_t pc = header[6] | (header[7] << 8);
+    uint16_t pc = image[6] | (image[7] << 8);
 
     if (pc != 0)
     {
@@ -99,12 +179,10 @@ int z80_snapshot_get_version(const char *filename)
         return Z80_VERSION_1;
     }
 
-    // PC is zero, could be V2 or V3. Check if extra header exists.
-    // Try to read extra header length at byte 30-31
-    uint8_t extra_check[2];
-    if (fseek(file, 30, SEEK_SET) == 0 && fread(extra_check, 1, 2, file) == 2)
+    // PC is zero, could be V2 or V3. Check the extra header length at byte 30-31
+    if (size >= Z80_HEADER_SIZE + 2)
     {
-        uint16_t extra_len = extra_check[0] | (extra_check[1] << 8);
+        uint16_t extra_len = image[30] | (image[31] << 8);
 
         // V2 has extra_len == 23, V3 has 54 or 55
         if (extra_len == 23)
@@ -118,19 +196,31 @@ int z80_snapshot_get_version(const char *filename)
 }
 
 /**
- * Load and restore V1 format snapshot (48K only)
+ * Determine Z80 snapshot version from file
+ * Version 1: PC is non-zero (program counter at 6-7)
+ * Version 2/3: PC is zero (signal for extended format), followed by extra header
  */
-static int load_v1_snapshot(FILE *file, z80_emulator_t *cpu, uint8_t *memory)
+int z80_snapshot_get_version(const char *filename)
 {
-    z80_v1_header_t header;
-
-    // Read header
-    uint8_t header_bytes[Z80_HEADER_SIZE];
-    if (fread(header_bytes, 1, Z80_HEADER_SIZE, file) != Z80_HEADER_SIZE)
-    {
-        fprintf(stderr, "Error: Failed to read Z80 V1 header\n");
+    FILE *file = fopen(filename, "rb");
+    if (!file)
         return -1;
-    }
+
+    uint8_t header[Z80_HEADER_SIZE + 2];
+    size_t bytes_read = fread(header, 1, sizeof(header), file);
+    fclose(file);
+
+    return z80_image_version(header, bytes_read);
+}
+
+/**
+ * Restore the CPU registers from the 30-byte base header
+ * The PC is taken from the header; V2/V3 callers override it.
+ * Returns the flags byte (byte 12)
+ */
+static uint8_t restore_base_header(const uint8_t *header_bytes, z80_emulator_t *cpu)
+{
+    z80_v1_header_t header;
 
     // Parse header
     header.a = header_bytes[0];
@@ -186,47 +276,36 @@ static int load_v1_snapshot(FILE *file, z80_emulator_t *cpu, uint8_t *memory)
     cpu->regs.iff1 = header.iff1 ? 1 : 0;
     cpu->regs.iff2 = header.iff2 ? 1 : 0;
 
-    // Restore F register from flags_byte
-    cpu->regs.cf = (header.f >> 0) & 1;
-    cpu->regs.nf = (header.f >> 1) & 1;
-    cpu->regs.pf = (header.f >> 2) & 1;
-    cpu->regs.hf = (header.f >> 4) & 1;
-    cpu->regs.zf = (header.f >> 6) & 1;
-    cpu->regs.sf = (header.f >> 7) & 1;
-    // Note: yf and xf bits are undocumented, not restored
-
-    // Check if memory is compressed (flags_byte bit 5)
-    bool compressed = (flags_byte >> 5) & 1;
+    // Restore F register
+    set_f(cpu, header.f);
 
-    // Read memory (48KB)
-    uint8_t memory_buffer[Z80_V1_MEMORY_SIZE];
+    return flags_byte;
+}
 
-    if (compressed)
+/**
+ * Load and restore V1 format snapshot (48K only)
+ * Memory is decompressed straight from the image into 0x4000-0xFFFF.
+ */
+static int load_v1_snapshot(const uint8_t *image, size_t size, z80_emulator_t *cpu, uint8_t *memory)
+{
+    if (size < Z80_HEADER_SIZE)
     {
-        // Read compressed data until end marker
-        uint8_t compressed_data[Z80_V1_MEMORY_SIZE * 2]; // Enough for worst case
-        size_t comp_pos = 0;
-
-        while (comp_pos < sizeof(compressed_data) - 4)
-        {
-            int byte = fgetc(file);
-            if (byte == EOF)
-                break;
+        fprintf(stderr, "Error: Failed to read Z80 V1 header\n");
+        return -1;
+    }
 
-            compressed_data[comp_pos++] = (uint8_t)byte;
+    uint8_t flags_byte = restore_base_header(image, cpu);
 
-            // Check for end marker (00 ED ED 00)
-            if (comp_pos >= 4 &&
-                compressed_data[comp_pos - 4] == 0x00 &&
-                compressed_data[comp_pos - 3] == 0xED &&
-                compressed_data[comp_pos - 2] == 0xED &&
-                compressed_data[comp_pos - 1] == 0x00)
-            {
-                break;
-            }
-        }
+    // Check if memory is compressed (flags_byte bit 5)
+    bool compressed = (flags_byte >> 5) & 1;
+    const uint8_t *data = image + Z80_HEADER_SIZE;
+    size_t data_len = size - Z80_HEADER_SIZE;
 
-        if (z80_decompress_block(compressed_data, comp_pos, memory_buffer, Z80_V1_MEMORY_SIZE) < 0)
+    // In 48K mode, all 48KB of RAM is loaded at 0x4000
+    if (compressed)
+    {
+        // Decompression stops once 48KB are out, before the 00 ED ED 00 end marker
+        if (z80_decompress_block(data, data_len, memory + 0x4000, Z80_V1_MEMORY_SIZE) < 0)
         {
             fprintf(stderr, "Error: Failed to decompress memory block\n");
             return -1;
@@ -234,81 +313,55 @@ static int load_v1_snapshot(FILE *file, z80_emulator_t *cpu, uint8_t *memory)
     }
     else
     {
-        // Read uncompressed data
-        if (fread(memory_buffer, 1, Z80_V1_MEMORY_SIZE, file) != Z80_V1_MEMORY_SIZE)
+        if (data_len < Z80_V1_MEMORY_SIZE)
         {
             fprintf(stderr, "Error: Failed to read uncompressed memory\n");
             return -1;
         }
+        memcpy(memory + 0x4000, data, Z80_V1_MEMORY_SIZE);
     }
 
-    // Copy memory: 0x0000-0x3FFF (ROM), 0x4000-0xFFFF (RAM)
-    // In 48K mode, all 48KB of RAM is loaded
-    memcpy(memory + 0x4000, memory_buffer, Z80_V1_MEMORY_SIZE);
-
     printf("Loaded Z80 V1 snapshot: PC=0x%04X SP=0x%04X A=0x%02X\n",
            cpu->regs.pc, cpu->regs.sp, cpu->regs.a);
 
     return 0;
 }
 
+/**
+ * Check whether a V2/V3 hardware mode is a 128K or +2
+ */
+static bool is_128k_hardware(uint8_t mode, int version)
+{
+    if (version == Z80_VERSION_2)
+        return mode == 3 || mode == 4;
+    return mode == Z80_HARDWARE_128K || mode == Z80_HARDWARE_128K_IF1 || mode == Z80_HARDWARE_128K_MGT ||
+           mode == Z80_HARDWARE_PLUS2;
+}
+
 /**
  * Load and restore V2/V3 format snapshot
+ * Each 16KB page is decompressed straight from the image into its place in
+ * the 48K address space, or into its RAM bank for 128K hardware.
  */
-static int load_v23_snapshot(FILE *file, z80_emulator_t *cpu, uint8_t *memory, int version)
+static int load_v23_snapshot(const uint8_t *image, size_t size, z80_emulator_t *cpu,
+                             z80_snapshot_memory_t *memory, int version)
 {
-    z80_v1_header_t header;
     z80_v2_header_t v2_header;
 
-    // Read V1 header (first 30 bytes)
-    uint8_t header_bytes[Z80_HEADER_SIZE];
-    if (fread(header_bytes, 1, Z80_HEADER_SIZE, file) != Z80_HEADER_SIZE)
+    if (size < Z80_HEADER_SIZE + 2)
     {
         fprintf(stderr, "Error: Failed to read Z80 V2/3 base header\n");
         return -1;
     }
 
-    // Parse V1 header fields (same as V1 but PC will be overridden)
-    header.a = header_bytes[0];
-    header.f = header_bytes[1];
-    header.bc = header_bytes[2] | (header_bytes[3] << 8);
-    header.hl = header_bytes[4] | (header_bytes[5] << 8);
-    header.sp = header_bytes[8] | (header_bytes[9] << 8);
-    header.i = header_bytes[10];
-    header.r = header_bytes[11];
-    uint8_t flags_byte = header_bytes[12];
-    header.de = header_bytes[13] | (header_bytes[14] << 8);
-    header.bc_ = header_bytes[15] | (header_bytes[16] << 8);
-    header.de_ = header_bytes[17] | (header_bytes[18] << 8);
-    header.hl_ = header_bytes[19] | (header_bytes[20] << 8);
-    header.a_ = header_bytes[21];
-    header.f_ = header_bytes[22];
-    header.iy = header_bytes[23] | (header_bytes[24] << 8);
-    header.ix = header_bytes[25] | (header_bytes[26] << 8);
-    header.iff1 = header_bytes[27];
-    header.iff2 = header_bytes[28];
-    header.im = header_bytes[29] & 0x03;
-
-    // Read extra header
-    uint8_t extra_header[2];
-    if (fread(extra_header, 1, 2, file) != 2)
-    {
-        fprintf(stderr, "Error: Failed to read extended header length\n");
-        return -1;
-    }
-
-    uint16_t extra_len = extra_header[0] | (extra_header[1] << 8);
-    uint8_t *extra_data = malloc(extra_len);
-    if (!extra_data)
-    {
-        fprintf(stderr, "Error: Failed to allocate extended header buffer\n");
-        return -1;
-    }
+    restore_base_header(image, cpu);
 
-    if (fread(extra_data, 1, extra_len, file) != extra_len)
+    // Extended header
+    uint16_t extra_len = image[30] | (image[31] << 8);
+    const uint8_t *extra_data = image + Z80_HEADER_SIZE + 2;
+    if (extra_len < 2 || size < Z80_HEADER_SIZE + 2 + (size_t)extra_len)
     {
         fprintf(stderr, "Error: Failed to read extended header\n");
-        free(extra_data);
         return -1;
     }
 
@@ -319,176 +372,268 @@ static int load_v23_snapshot(FILE *file, z80_emulator_t *cpu, uint8_t *memory, i
     v2_header.interface_rom = (extra_len > 4) ? extra_data[4] : 0;
     v2_header.emulation_flags = (extra_len > 5) ? extra_data[5] : 0;
 
-    free(extra_data);
-
-    // Restore CPU state from V1 header
-    cpu->regs.a = header.a;
-    cpu->regs.b = header.bc >> 8;
-    cpu->regs.c = header.bc & 0xFF;
-    cpu->regs.d = header.de >> 8;
-    cpu->regs.e = header.de & 0xFF;
-    cpu->regs.h = header.hl >> 8;
-    cpu->regs.l = header.hl & 0xFF;
     cpu->regs.pc = v2_header.pc; // Use PC from extended header
-    cpu->regs.sp = header.sp;
-    cpu->regs.i = header.i;
-    cpu->regs.r = header.r & 0x7F;
-    if (flags_byte & 0x01)
-        cpu->regs.r |= 0x80;
-
-    // Restore alternate registers
-    cpu->regs.a_ = header.a_;
-    cpu->regs.b_ = header.bc_ >> 8;
-    cpu->regs.c_ = header.bc_ & 0xFF;
-    cpu->regs.d_ = header.de_ >> 8;
-    cpu->regs.e_ = header.de_ & 0xFF;
-    cpu->regs.h_ = header.hl_ >> 8;
-    cpu->regs.l_ = header.hl_ & 0xFF;
-    cpu->regs.f_ = header.f_;
-
-    // Restore special registers
-    cpu->regs.ix = header.ix;
-    cpu->regs.iy = header.iy;
-    cpu->regs.im = header.im;
-    cpu->regs.iff1 = header.iff1 ? 1 : 0;
-    cpu->regs.iff2 = header.iff2 ? 1 : 0;
 
-    // Restore F register
-    cpu->regs.cf = (header.f >> 0) & 1;
-    cpu->regs.nf = (header.f >> 1) & 1;
-    cpu->regs.pf = (header.f >> 2) & 1;
-    cpu->regs.hf = (header.f >> 4) & 1;
-    cpu->regs.zf = (header.f >> 6) & 1;
-    cpu->regs.sf = (header.f >> 7) & 1;
-
-    // Read memory blocks for 48K mode (pages 4, 5, 8)
-    // For now, support only 48K mode
-    while (!feof(file))
+    memory->is_128k = is_128k_hardware(v2_header.hardware_mode, version);
+    memory->paging = memory->is_128k ? v2_header.paging_register : 0;
+    if (memory->is_128k && !memory->ram_banks[0])
     {
-        uint8_t block_header[Z80_MEMORY_BLOCK_HEADER_SIZE];
-        if (fread(block_header, 1, Z80_MEMORY_BLOCK_HEADER_SIZE, file) != Z80_MEMORY_BLOCK_HEADER_SIZE)
-        {
-            break; // End of file
-        }
+        fprintf(stderr, "Error: 128K snapshot needs a 128K machine (load a 32KB 128K ROM)\n");
+        return -1;
+    }
 
+    // Read memory blocks: pages 4, 5, 8 (and the ROM, page 0) for 48K,
+    // RAM banks 0-7 as pages 3-10 for 128K
+    size_t pos = Z80_HEADER_SIZE + 2 + extra_len;
+    while (pos + Z80_MEMORY_BLOCK_HEADER_SIZE <= size)
+    {
+        const uint8_t *block_header = image + pos;
         uint16_t comp_length = block_header[0] | (block_header[1] << 8);
         uint8_t page_number = block_header[2];
+        pos += Z80_MEMORY_BLOCK_HEADER_SIZE;
 
-        // Read compressed data for this block
-        uint8_t *block_data = malloc(comp_length);
-        if (!block_data)
+        // Uncompressed: length 0xFFFF means 16384 bytes raw data
+        size_t data_len = comp_length == 0xFFFF ? Z80_PAGE_BYTES : comp_length;
+        if (pos + data_len > size)
         {
-            fprintf(stderr, "Error: Failed to allocate memory block buffer\n");
+            fprintf(stderr, "Error: Failed to read memory block\n");
             return -1;
         }
+        const uint8_t *block_data = image + pos;
+        pos += data_len;
 
-        if (fread(block_data, 1, comp_length, file) != comp_length)
+        // Map the page to its RAM bank (128K) or address (48K)
+        uint8_t *target = NULL;
+        if (memory->is_128k)
         {
-            fprintf(stderr, "Error: Failed to read memory block\n");
-            free(block_data);
-            return -1;
+            if (page_number >= Z80_PAGE_128K_RAM0 && page_number < Z80_PAGE_128K_RAM0 + Z80_RAM_BANKS)
+                target = memory->ram_banks[page_number - Z80_PAGE_128K_RAM0];
+        }
+        else
+        {
+            switch (page_number)
+            {
+            case Z80_PAGE_48K_ROM:
+                target = memory->memory + 0x0000; // ROM
+                break;
+            case Z80_PAGE_48K_VRAM:
+                target = memory->memory + 0x4000; // Video RAM
+                break;
+            case Z80_PAGE_48K_RAM4:
+                target = memory->memory + 0x8000; // RAM page 4
+                break;
+            case Z80_PAGE_48K_RAM5:
+                target = memory->memory + 0xC000; // RAM page 5
+                break;
+            default:
+                break;
+            }
+        }
+        if (!target)
+        {
+            // Skip unknown pages
+            fprintf(stderr, "Warning: Skipping unknown memory page %d\n", page_number);
+            continue;
         }
 
-        // Decompress block
-        uint8_t decompressed[16384]; // 16KB max for one page
-        int decomp_len = comp_length;
+        // Decompress block into its page
         if (comp_length != 0xFFFF)
         {
-            decomp_len = z80_decompress_block(block_data, comp_length, decompressed, sizeof(decompressed));
-            if (decomp_len < 0)
+            if (z80_decompress_block(block_data, data_len, target, Z80_PAGE_BYTES) < 0)
             {
                 fprintf(stderr, "Error: Failed to decompress memory block page %d\n", page_number);
-                free(block_data);
                 return -1;
             }
         }
         else
         {
-            // Uncompressed: length 0xFFFF means 16384 bytes raw data
-            memcpy(decompressed, block_data, 16384);
-            decomp_len = 16384;
+            memcpy(target, block_data, Z80_PAGE_BYTES);
         }
+    }
 
-        // Map page to memory address for 48K mode
-        uint16_t target_addr = 0;
-        switch (page_number)
-        {
-        case Z80_PAGE_48K_ROM:
-            target_addr = 0x0000; // ROM
-            break;
-        case Z80_PAGE_48K_VRAM:
-            target_addr = 0x4000; // Video RAM
-            break;
-        case Z80_PAGE_48K_RAM4:
-            target_addr = 0x8000; // RAM page 4
-            break;
-        case Z80_PAGE_48K_RAM5:
-            target_addr = 0xC000; // RAM page 5
-            break;
-        default:
-            // Skip unknown pages
-            fprintf(stderr, "Warning: Skipping unknown memory page %d\n", page_number);
-            free(block_data);
-            continue;
-        }
+    printf("Loaded Z80 V%d %s snapshot: PC=0x%04X SP=0x%04X A=0x%02X\n",
+           version, memory->is_128k ? "128K" : "48K", cpu->regs.pc, cpu->regs.sp, cpu->regs.a);
 
-        // Copy decompressed data to memory
-        memcpy(memory + target_addr, decompressed, decomp_len);
+    return 0;
+}
 
-        free(block_data);
-    }
+/**
+ * Restore a Z80 snapshot from an image in memory
+ */
+int z80_snapshot_load_image(const uint8_t *image, size_t size, z80_emulator_t *cpu, z80_snapshot_memory_t *memory)
+{
+    if (!image || !cpu || !memory || !memory->memory)
+        return -1;
+    memory->is_128k = false;
+    memory->paging = 0;
 
-    printf("Loaded Z80 V%d snapshot: PC=0x%04X SP=0x%04X A=0x%02X\n",
-           version, cpu->regs.pc, cpu->regs.sp, cpu->regs.a);
+    int version = z80_image_version(image, size);
+    if (version < 0)
+    {
+        fprintf(stderr, "Error: Failed to determine Z80 file version\n");
+        return -1;
+    }
 
-    return 0;
+    if (version == Z80_VERSION_1)
+        return load_v1_snapshot(image, size, cpu, memory->memory);
+    return load_v23_snapshot(image, size, cpu, memory, version);
 }
 
 /**
  * Load and restore Z80 snapshot
  */
-int z80_snapshot_load(const char *filename, z80_emulator_t *cpu, uint8_t *memory)
+int z80_snapshot_load(const char *filename, z80_emulator_t *cpu, z80_snapshot_memory_t *memory)
 {
     if (!filename || !cpu || !memory)
         return -1;
 
-    FILE *file = fopen(filename, "rb");
-    if (!file)
+    size_t size;
+    const uint8_t *image = mapfile_map(AT_FDCWD, filename, &size);
+    if (!image)
     {
         fprintf(stderr, "Error: Cannot open Z80 snapshot file '%s'\n", filename);
         return -1;
     }
 
-    // Determine version
-    int version = z80_snapshot_get_version(filename);
-    if (version < 0)
+    int result = z80_snapshot_load_image(image, size, cpu, memory);
+    mapfile_unmap(image, size);
+    return result;
+}
+
+/**
+ * Snapshot library: a directory of snapshots opened once
+ */
+struct z80_snapshot_library_s
+{
+    int dir_fd;     // Directory the names are relative to
+    char **names;   // Snapshot file names, sorted
+    uint32_t count; // Number of snapshots
+};
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * Check for a .z80 extension (any case)
+ */
+static int is_snapshot_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".z80") == 0;
+}
+
+/**
+ * Open a directory of snapshots
+ */
+z80_snapshot_library_t *z80_snapshot_library_open(const char *dirname)
+{
+    if (!dirname)
+        return NULL;
+
+    z80_snapshot_library_t *library = calloc(1, sizeof(z80_snapshot_library_t));
+    if (!library)
     {
-        fprintf(stderr, "Error: Failed to determine Z80 file version\n");
-        fclose(file);
-        return -1;
+        fprintf(stderr, "Error: Memory allocation failed for snapshot library\n");
+        return NULL;
     }
 
-    // Reset file pointer
-    rewind(file);
-
-    int result = -1;
-    if (version == Z80_VERSION_1)
+    library->dir_fd = open(dirname, O_RDONLY | O_DIRECTORY);
+    DIR *dir = library->dir_fd >= 0 ? fdopendir(dup(library->dir_fd)) : NULL;
+    if (!dir)
     {
-        result = load_v1_snapshot(file, cpu, memory);
+        fprintf(stderr, "Error: Cannot open snapshot directory '%s'\n", dirname);
+        z80_snapshot_library_close(library);
+        return NULL;
     }
-    else if (version == Z80_VERSION_2)
+
+    uint32_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
     {
-        result = load_v23_snapshot(file, cpu, memory, Z80_VERSION_2);
+        if (!is_snapshot_name(entry->d_name))
+            continue;
+
+        if (library->count == capacity)
+        {
+            uint32_t new_capacity = capacity ? capacity * 2 : 64;
+            char **names = realloc(library->names, new_capacity * sizeof(char *));
+            if (!names)
+                break;
+            library->names = names;
+            capacity = new_capacity;
+        }
+        library->names[library->count] = strdup(entry->d_name);
+        if (!library->names[library->count])
+            break;
+        library->count++;
     }
-    else if (version == Z80_VERSION_3)
+    closedir(dir);
+
+    if (entry != NULL)
     {
-        result = load_v23_snapshot(file, cpu, memory, Z80_VERSION_3);
+        fprintf(stderr, "Error: Memory allocation failed for snapshot library\n");
+        z80_snapshot_library_close(library);
+        return NULL;
     }
-    else
+
+    qsort(library->names, library->count, sizeof(char *), compare_names);
+    return library;
+}
+
+/**
+ * Close a snapshot library and free resources
+ */
+void z80_snapshot_library_close(z80_snapshot_library_t *library)
+{
+    if (!library)
+        return;
+    for (uint32_t i = 0; i < library->count; i++)
+        free(library->names[i]);
+    free(library->names);
+    if (library->dir_fd >= 0)
+        close(library->dir_fd);
+    free(library);
+}
+
+/**
+ * Get the number of snapshots in a library
+ */
+uint32_t z80_snapshot_library_count(const z80_snapshot_library_t *library)
+{
+    return library ? library->count : 0;
+}
+
+/**
+ * Get the file name of a snapshot in a library
+ */
+const char *z80_snapshot_library_name(const z80_snapshot_library_t *library, uint32_t index)
+{
+    if (!library || index >= library->count)
+        return NULL;
+    return library->names[index];
+}
+
+/**
+ * Load a snapshot from a library
+ */
+int z80_snapshot_library_load(const z80_snapshot_library_t *library, uint32_t index,
+                              z80_emulator_t *cpu, z80_snapshot_memory_t *memory)
+{
+    const char *name = z80_snapshot_library_name(library, index);
+    if (!name || !cpu || !memory)
+        return -1;
+
+    size_t size;
+    const uint8_t *image = mapfile_map(library->dir_fd, name, &size);
+    if (!image)
     {
-        fprintf(stderr, "Error: Unsupported Z80 file version\n");
+        fprintf(stderr, "Error: Cannot open Z80 snapshot file '%s'\n", name);
+        return -1;
     }
 
-    fclose(file);
+    int result = z80_snapshot_load_image(image, size, cpu, memory);
+    mapfile_unmap(image, size);
     return result;
 }
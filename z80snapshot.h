@@ -8,7 +8,7 @@
  * - Version 1 (48K only): 30-byte header + compressed memory
  * - Version 2/3 (48K, 128K, +3, etc.): Extended header + multiple memory blocks
  * - CPU state restoration (registers, flags, interrupts)
- * - Memory state restoration (VRAM and RAM)
+ * - Memory state restoration (VRAM and RAM, all eight banks of a 128K)
  * - Compression/decompression (RLE: ED ED xx yy format)
  */
 
@@ -16,6 +16,7 @@
 #define Z80_SNAPSHOT_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include "z80.h"
 
@@ -24,13 +25,17 @@
 #define Z80_V1_MEMORY_SIZE (48 * 1024) // 48KB
 #define Z80_V2_EXTRA_HEADER_MIN_SIZE 2 // At least length field
 #define Z80_MEMORY_BLOCK_HEADER_SIZE 3 // Length (2 bytes) + Page (1 byte)
+#define Z80_PAGE_BYTES 16384           // Every memory block expands to one 16KB page
+#define Z80_RAM_BANKS 8                // 128K RAM banks, stored as pages 3-10
+#define Z80_PAGE_128K_RAM0 3           // Page number of RAM bank 0 in 128K snapshots
 
 // Version identifiers
 #define Z80_VERSION_1 1
 #define Z80_VERSION_2 2
 #define Z80_VERSION_3 3
 
-// Hardware modes (version 2/3 field at byte 34)
+// Hardware modes (version 2/3 field at byte 34, version 3 numbering; version 2
+// files use 3 and 4 for 128K and 128K + Interface 1)
 typedef enum
 {
     Z80_HARDWARE_48K = 0,
@@ -41,6 +46,7 @@ typedef enum
     Z80_HARDWARE_128K_IF1 = 5,
     Z80_HARDWARE_128K_MGT = 6,
     Z80_HARDWARE_PLUS3 = 7,
+    Z80_HARDWARE_PLUS2 = 12,
     Z80_HARDWARE_PLUS2A = 13,
     Z80_HARDWARE_PENTAGON = 9,
     Z80_HARDWARE_SCORPION = 10,
@@ -86,6 +92,22 @@ typedef struct
     // Additional fields in V3 only...
 } z80_v2_header_t;
 
+/**
+ * Memory a snapshot is restored into
+ *
+ * 48K snapshots fill 0x4000-0xFFFF of memory (and 0x0000-0x3FFF if they
+ * carry a ROM page). 128K snapshots are decompressed straight into
+ * ram_banks; a machine without them (all NULL) refuses 128K snapshots.
+ * is_128k and paging are set on return.
+ */
+typedef struct
+{
+    uint8_t *memory;                    // 64KB address space of a 48K machine
+    uint8_t *ram_banks[Z80_RAM_BANKS];  // 16KB RAM banks 0-7, or NULL on a 48K machine
+    bool is_128k;                       // The snapshot is for a 128K machine
+    uint8_t paging;                     // Its last write to port 0x7FFD
+} z80_snapshot_memory_t;
+
 // Memory block header (part of compressed memory)
 typedef struct
 {
@@ -98,10 +120,77 @@ typedef struct
  *
  * @param filename      Path to .z80 snapshot file
  * @param cpu           Z80 CPU emulator to restore
- * @param memory        64KB memory buffer to restore
+ * @param memory        Memory to restore (see z80_snapshot_memory_t)
+ * @return              0 on success, -1 on error
+ */
+int z80_snapshot_load(const char *filename, z80_emulator_t *cpu, z80_snapshot_memory_t *memory);
+
+/**
+ * Restore CPU and memory from a snapshot image already in memory
+ *
+ * Memory pages are decompressed straight from the image into memory; nothing
+ * is allocated. z80_snapshot_load() runs this on a read-only mapping of the file.
+ *
+ * @param image         .z80 file contents
+ * @param size          Size of the image
+ * @param cpu           Z80 CPU emulator to restore
+ * @param memory        Memory to restore (see z80_snapshot_memory_t)
+ * @return              0 on success, -1 on error
+ */
+int z80_snapshot_load_image(const uint8_t *image, size_t size, z80_emulator_t *cpu, z80_snapshot_memory_t *memory);
+
+/**
+ * Snapshot library: a directory of .z80 files opened once
+ *
+ * The directory is scanned a single time; each snapshot is then mapped
+ * relative to the open directory, so iterating thousands of images costs one
+ * open/mmap per image and no path lookups from the root.
+ */
+typedef struct z80_snapshot_library_s z80_snapshot_library_t;
+
+/**
+ * Open a directory of snapshots (files ending in .z80, sorted by name)
+ *
+ * @param dirname       Directory to scan
+ * @return              Library, or NULL on error
+ */
+z80_snapshot_library_t *z80_snapshot_library_open(const char *dirname);
+
+/**
+ * Close a snapshot library and free resources
+ *
+ * @param library       Library to close
+ */
+void z80_snapshot_library_close(z80_snapshot_library_t *library);
+
+/**
+ * Get the number of snapshots in a library
+ *
+ * @param library       Library
+ * @return              Number of snapshots
+ */
+uint32_t z80_snapshot_library_count(const z80_snapshot_library_t *library);
+
+/**
+ * Get the file name of a snapshot in a library
+ *
+ * @param library       Library
+ * @param index         Snapshot index (0 to count - 1)
+ * @return              File name relative to the directory, or NULL if out of range
+ */
+const char *z80_snapshot_library_name(const z80_snapshot_library_t *library, uint32_t index);
+
+/**
+ * Load a snapshot from a library
+ *
+ * @param library       Library
+ * @param index         Snapshot index (0 to count - 1)
+ * @param cpu           Z80 CPU emulator to restore
+ * @param memory        Memory to restore (see z80_snapshot_memory_t)
  * @return              0 on success, -1 on error
  */
-int z80_snapshot_load(const char *filename, z80_emulator_t *cpu, uint8_t *memory);
+int z80_snapshot_library_load(const z80_snapshot_library_t *library, uint32_t index,
+                              z80_emulator_t *cpu, z80_snapshot_memory_t *memory);
 
 /**
  * Decompress RLE-encoded memory block
@@ -115,6 +204,20 @@ int z80_snapshot_load(const char *filename, z80_emulator_t *cpu, uint8_t *memory
 int z80_decompress_block(const uint8_t *compressed, size_t comp_len,
                          uint8_t *decompressed, size_t decomp_len);
 
+/**
+ * Compress a memory block with the same RLE scheme (inverse of z80_decompress_block)
+ *
+ * Runs of 5 or more equal bytes (2 or more for 0xED) become ED ED count byte.
+ * No end marker is written.
+ *
+ * @param data          Data to compress
+ * @param len           Length of data
+ * @param compressed    Output buffer
+ * @param comp_cap      Size of the output buffer (2 * len is always enough)
+ * @return              Compressed length, or -1 if the output buffer is too small
+ */
+int z80_compress_block(const uint8_t *data, size_t len, uint8_t *compressed, size_t comp_cap);
+
 /**
  * Determine Z80 snapshot version from file header
  *